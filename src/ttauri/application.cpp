@@ -7,6 +7,7 @@
 #include "static_resource_view.hpp"
 #include "logger.hpp"
 #include "timer.hpp"
+#include "codec/image_loader.hpp"
 #include "os_detect.hpp"
 #include "version.hpp"
 #include "trace.hpp"
@@ -91,6 +92,7 @@ void application::init()
 void application::init_foundation()
 {
     timer::global = std::make_unique<timer>("Maintenance Timer");
+    image_loader::global = std::make_unique<image_loader>();
 
     main_thread_id = current_thread_id();
 
@@ -208,6 +210,8 @@ void application::deinit()
 
 void application::deinit_foundation()
 {
+    image_loader::global = {};
+
     // Force all timers to finish.
     timer::global->stop();
     timer::global->remove_callback(clock_maintenance_callback);
@@ -0,0 +1,277 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "required.hpp"
+#include "assert.hpp"
+#include "check.hpp"
+#include "endian.hpp"
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace tt {
+
+/** A reader of a stream of bits.
+ * Bits are ordered LSB first, as used by deflate.
+ *
+ * The reader keeps up to 64 bits in an accumulator. `refill()` tops up the accumulator
+ * to at least 56 bits, reading 8 bytes at a time without bounds checks while at least 8 bytes
+ * remain in the buffer. Near the end of the buffer bytes are added one at a time, and bits beyond
+ * the end of the buffer are read as zero.
+ *
+ * The caller may consume at most 56 bits between calls to `refill()`. Reading beyond the
+ * end of the buffer is detected lazily by `refill()` and `byte_offset()`, so that decoders
+ * do not need to check bounds for every symbol.
+ *
+ * For streaming decoders the state of the accumulator can be carried over to the next
+ * buffer. Such a decoder uses `try_refill()` to only consume the bits that are
+ * actually available, and `rewind()` to return unused whole bytes to the buffer.
+ */
+class bit_reader {
+public:
+    /** The number of bits guaranteed in the accumulator after `refill()`.
+     */
+    static constexpr int refill_bits = 56;
+
+    bit_reader(std::span<std::byte const> bytes, ssize_t byte_offset = 0) noexcept :
+        _begin(bytes.data()), _ptr(bytes.data() + byte_offset), _end(bytes.data() + std::ssize(bytes))
+    {
+        tt_axiom(byte_offset >= 0 && byte_offset <= std::ssize(bytes));
+    }
+
+    /** Continue reading a stream of bits in a new buffer.
+     *
+     * @param bytes The next bytes of the stream.
+     * @param accumulator The accumulator of the reader of the previous buffer.
+     * @param bit_count The number of valid bits in the accumulator.
+     */
+    bit_reader(std::span<std::byte const> bytes, uint64_t accumulator, int bit_count) noexcept :
+        _begin(bytes.data()),
+        _ptr(bytes.data()),
+        _end(bytes.data() + std::ssize(bytes)),
+        _accumulator(accumulator),
+        _bit_count(bit_count)
+    {
+        tt_axiom(bit_count >= 0 && bit_count <= 64);
+    }
+
+    /** The valid bits in the accumulator.
+     */
+    [[nodiscard]] uint64_t accumulator() const noexcept
+    {
+        return _bit_count >= 64 ? _accumulator : _accumulator & ((uint64_t{1} << _bit_count) - 1);
+    }
+
+    /** The number of valid bits in the accumulator.
+     */
+    [[nodiscard]] int bit_count() const noexcept
+    {
+        return _bit_count;
+    }
+
+    /** The number of bytes read from the buffer into the accumulator.
+     */
+    [[nodiscard]] ssize_t consumed() const noexcept
+    {
+        return _ptr - _begin;
+    }
+
+    /** The number of bytes in the buffer not yet read into the accumulator.
+     */
+    [[nodiscard]] ssize_t available() const noexcept
+    {
+        return _end - _ptr;
+    }
+
+    /** Fill the accumulator with at least `refill_bits` bits.
+     *
+     * @throw parse_error When more bits were consumed than available in the buffer.
+     */
+    tt_force_inline void refill()
+    {
+        if (_end - _ptr >= 8) [[likely]] {
+            // Branchless refill: load 8 bytes and advance by the number of whole bytes that fitted.
+            _accumulator |= load_le64(_ptr) << _bit_count;
+            _ptr += (63 - _bit_count) >> 3;
+            _bit_count |= refill_bits;
+        } else {
+            refill_slow();
+        }
+    }
+
+    /** Fill the accumulator with at least the given number of bits.
+     * Unlike `refill()`, only bytes that are available in the buffer are read
+     * into the accumulator.
+     *
+     * @param nr_bits The number of bits needed, at most 57.
+     * @return true if the accumulator contains at least nr_bits.
+     */
+    [[nodiscard]] bool try_refill(int nr_bits) noexcept
+    {
+        tt_axiom(nr_bits <= refill_bits + 1);
+        while (_bit_count < nr_bits) {
+            if (_ptr == _end) {
+                return false;
+            }
+            _accumulator |= static_cast<uint64_t>(*_ptr++) << _bit_count;
+            _bit_count += 8;
+        }
+        return true;
+    }
+
+    /** Return the whole unused bytes in the accumulator back to the buffer.
+     * Only bytes that were read from the current buffer are returned.
+     */
+    void rewind() noexcept
+    {
+        tt_axiom(_bit_count >= 0);
+        ttlet nr_bytes = std::min(static_cast<ssize_t>(_bit_count >> 3), consumed());
+        _ptr -= nr_bytes;
+        _bit_count -= static_cast<int>(nr_bytes * 8);
+        _accumulator = accumulator();
+    }
+
+    /** Peek at the next bits without consuming them.
+     *
+     * @param nr_bits The number of bits to return, at most 32.
+     * @return The bits in the least significant bits of the result.
+     */
+    [[nodiscard]] tt_force_inline uint32_t peek(int nr_bits) const noexcept
+    {
+        tt_axiom(nr_bits >= 0 && nr_bits <= 32);
+        return static_cast<uint32_t>(_accumulator & ((uint64_t{1} << nr_bits) - 1));
+    }
+
+    /** Peek at the next 32 bits without consuming them.
+     */
+    [[nodiscard]] tt_force_inline uint32_t peek() const noexcept
+    {
+        return static_cast<uint32_t>(_accumulator);
+    }
+
+    /** Consume bits.
+     *
+     * @param nr_bits The number of bits to consume.
+     */
+    tt_force_inline void skip(int nr_bits) noexcept
+    {
+        tt_axiom(nr_bits >= 0 && nr_bits <= 32);
+        _accumulator >>= nr_bits;
+        _bit_count -= nr_bits;
+    }
+
+    /** Read and consume bits.
+     *
+     * @param nr_bits The number of bits to read, at most 32.
+     * @return The bits in the least significant bits of the result.
+     */
+    [[nodiscard]] tt_force_inline uint32_t get(int nr_bits) noexcept
+    {
+        ttlet r = peek(nr_bits);
+        skip(nr_bits);
+        return r;
+    }
+
+    /** Read and consume a single bit.
+     */
+    [[nodiscard]] tt_force_inline bool get_bit() noexcept
+    {
+        return static_cast<bool>(get(1));
+    }
+
+    /** Skip the bits up to the next byte boundary.
+     */
+    void align() noexcept
+    {
+        skip(_bit_count & 7);
+    }
+
+    /** The offset of the next byte to read.
+     * The reader must be aligned to a byte boundary.
+     *
+     * @throw parse_error When more bits were consumed than available in the buffer.
+     */
+    [[nodiscard]] ssize_t byte_offset() const
+    {
+        tt_axiom((_bit_count & 7) == 0);
+        tt_parse_check(_bit_count >= 0, "Reading beyond end of buffer");
+        return (_ptr - _begin) - (_bit_count >> 3);
+    }
+
+    /** The number of bytes remaining after the byte offset.
+     * The reader must be aligned to a byte boundary.
+     */
+    [[nodiscard]] ssize_t bytes_remaining() const
+    {
+        return (_end - _begin) - byte_offset();
+    }
+
+    /** Get a span of bytes and move the reader beyond those bytes.
+     * The reader must be aligned to a byte boundary. This is used for reading
+     * stored data which is embedded in the bit stream.
+     *
+     * @param size The number of bytes to read.
+     * @throw parse_error When there are less bytes remaining in the buffer.
+     */
+    [[nodiscard]] std::span<std::byte const> get_bytes(ssize_t size)
+    {
+        ttlet offset = byte_offset();
+        tt_parse_check(size >= 0 && offset + size <= _end - _begin, "Reading beyond end of buffer");
+
+        _ptr = _begin + offset + size;
+        _accumulator = 0;
+        _bit_count = 0;
+        return {_begin + offset, static_cast<size_t>(size)};
+    }
+
+    /** Get a span of bytes directly from the buffer.
+     * The accumulator must be empty, this is used for reading stored data
+     * from a stream which is split over multiple buffers.
+     *
+     * @param max_size The maximum number of bytes to read.
+     * @return Up to max_size bytes, less when the buffer ends.
+     */
+    [[nodiscard]] std::span<std::byte const> take_bytes(ssize_t max_size) noexcept
+    {
+        tt_axiom(_bit_count == 0);
+        ttlet size = std::min(max_size, available());
+        auto r = std::span<std::byte const>{_ptr, static_cast<size_t>(size)};
+        _ptr += size;
+        _accumulator = 0;
+        return r;
+    }
+
+private:
+    std::byte const *_begin;
+    std::byte const *_ptr;
+    std::byte const *_end;
+    uint64_t _accumulator = 0;
+
+    /** The number of valid bits in the accumulator.
+     * This becomes negative when more bits where consumed than available.
+     */
+    int _bit_count = 0;
+
+    [[nodiscard]] static tt_force_inline uint64_t load_le64(std::byte const *ptr) noexcept
+    {
+        uint64_t r;
+        std::memcpy(&r, ptr, sizeof(r));
+        return little_to_native(r);
+    }
+
+    tt_no_inline void refill_slow()
+    {
+        tt_parse_check(_bit_count >= 0, "Reading beyond end of buffer");
+        while (_bit_count <= refill_bits && _ptr != _end) {
+            _accumulator |= static_cast<uint64_t>(*_ptr++) << _bit_count;
+            _bit_count += 8;
+        }
+    }
+};
+
+} // namespace tt
@@ -0,0 +1,79 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/bit_reader.hpp"
+#include "ttauri/bits.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace tt;
+
+TEST(bit_reader, same_as_get_bits)
+{
+    ttlet bytes = make_random_bytes(100);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    auto reader = bit_reader{span};
+    ssize_t index = 0;
+
+    // Read with varying lengths, crossing the fast and slow refill paths.
+    int length = 1;
+    while (index + length <= 100 * 8) {
+        reader.refill();
+        ASSERT_EQ(reader.get(length), static_cast<uint32_t>(get_bits(span, index, length)));
+        length = length % 17 + 1;
+    }
+}
+
+TEST(bit_reader, get_bit)
+{
+    ttlet bytes = make_random_bytes(3);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    auto reader = bit_reader{span};
+    ssize_t index = 0;
+    for (int i = 0; i != 24; ++i) {
+        reader.refill();
+        ASSERT_EQ(reader.get_bit(), get_bit(span, index));
+    }
+}
+
+TEST(bit_reader, align_and_get_bytes)
+{
+    ttlet bytes = make_random_bytes(20);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    auto reader = bit_reader{span, 2};
+    reader.refill();
+    ASSERT_EQ(reader.get(3), static_cast<uint32_t>(bytes[2]) & 7);
+    reader.align();
+    ASSERT_EQ(reader.byte_offset(), 3);
+
+    ttlet data = reader.get_bytes(4);
+    ASSERT_EQ(data.data(), &bytes[3]);
+    ASSERT_EQ(data.size(), 4);
+    ASSERT_EQ(reader.byte_offset(), 7);
+    ASSERT_EQ(reader.bytes_remaining(), 13);
+
+    reader.refill();
+    ASSERT_EQ(reader.get(8), static_cast<uint32_t>(bytes[7]));
+}
+
+TEST(bit_reader, overrun)
+{
+    ttlet bytes = make_random_bytes(2);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    auto reader = bit_reader{span};
+    reader.refill();
+    ASSERT_EQ(reader.get(16), static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8));
+
+    // Bits beyond the end are read as zero, the overrun is detected lazily.
+    ASSERT_EQ(reader.get(8), 0);
+    ASSERT_THROW(reader.refill(), parse_error);
+    ASSERT_THROW((void)reader.byte_offset(), parse_error);
+    ASSERT_THROW((void)reader.get_bytes(1), parse_error);
+}
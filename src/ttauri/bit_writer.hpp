@@ -0,0 +1,102 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "required.hpp"
+#include "assert.hpp"
+#include "byte_string.hpp"
+#include "endian.hpp"
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace tt {
+
+/** A writer of a stream of bits.
+ * Bits are ordered LSB first, as used by deflate.
+ *
+ * The bits are collected in a 64-bit accumulator, and written to the output
+ * string 32 bits at a time.
+ *
+ * For streaming encoders the state of the accumulator can be carried over
+ * to a writer of the next output string.
+ */
+class bit_writer {
+public:
+    /** Write a stream of bits.
+     *
+     * @param output The string to append the bytes to.
+     * @param accumulator The accumulator of the writer of the previous string.
+     * @param bit_count The number of valid bits in the accumulator, less than 32.
+     */
+    bit_writer(bstring &output, uint64_t accumulator = 0, int bit_count = 0) noexcept :
+        _output(output), _accumulator(accumulator), _bit_count(bit_count)
+    {
+        tt_axiom(bit_count >= 0 && bit_count < 32);
+    }
+
+    /** The bits in the accumulator that are not yet written to the string.
+     */
+    [[nodiscard]] uint64_t accumulator() const noexcept
+    {
+        return _accumulator;
+    }
+
+    /** The number of bits in the accumulator that are not yet written to the string.
+     */
+    [[nodiscard]] int bit_count() const noexcept
+    {
+        return _bit_count;
+    }
+
+    /** Write bits.
+     *
+     * @param value The bits to write in the least significant bits, the other bits must be zero.
+     * @param nr_bits The number of bits to write, at most 32.
+     */
+    tt_force_inline void put(uint32_t value, int nr_bits) noexcept
+    {
+        tt_axiom(nr_bits >= 0 && nr_bits <= 32);
+        tt_axiom(nr_bits == 32 || (value >> nr_bits) == 0);
+
+        _accumulator |= static_cast<uint64_t>(value) << _bit_count;
+        _bit_count += nr_bits;
+        if (_bit_count >= 32) {
+            ttlet word = native_to_little(static_cast<uint32_t>(_accumulator));
+            _output.append(reinterpret_cast<std::byte const *>(&word), sizeof(word));
+            _accumulator >>= 32;
+            _bit_count -= 32;
+        }
+    }
+
+    /** Pad with zero bits up to the next byte boundary, and write the whole bytes to the string.
+     */
+    void align() noexcept
+    {
+        _bit_count = (_bit_count + 7) & ~7;
+        while (_bit_count != 0) {
+            _output += static_cast<std::byte>(_accumulator);
+            _accumulator >>= 8;
+            _bit_count -= 8;
+        }
+    }
+
+    /** Write bytes directly to the string.
+     * The writer must be aligned to a byte boundary. This is used for writing
+     * stored data which is embedded in the bit stream.
+     */
+    void put_bytes(std::span<std::byte const> bytes) noexcept
+    {
+        tt_axiom(_bit_count == 0);
+        _output.append(bytes.data(), bytes.size());
+    }
+
+private:
+    bstring &_output;
+    uint64_t _accumulator;
+    int _bit_count;
+};
+
+} // namespace tt
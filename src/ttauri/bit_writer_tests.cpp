@@ -0,0 +1,84 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/bit_writer.hpp"
+#include "ttauri/bit_reader.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+#include <array>
+
+using namespace std;
+using namespace tt;
+
+TEST(bit_writer, same_as_bit_reader)
+{
+    auto output = bstring{};
+    auto writer = bit_writer{output};
+
+    // Write with varying lengths, including full 32 bit words.
+    auto values = std::vector<std::pair<uint32_t, int>>{};
+    auto generator = test_random{};
+    int length = 1;
+    for (int i = 0; i != 1000; ++i) {
+        ttlet x = generator();
+        ttlet value = length == 32 ? x : x & ((uint32_t{1} << length) - 1);
+        values.emplace_back(value, length);
+        writer.put(value, length);
+        length = length % 32 + 1;
+    }
+    writer.align();
+    ASSERT_EQ(writer.bit_count(), 0);
+
+    auto reader = bit_reader{output};
+    for (ttlet &[value, nr_bits] : values) {
+        reader.refill();
+        ASSERT_EQ(reader.get(nr_bits), value);
+    }
+}
+
+TEST(bit_writer, align_and_put_bytes)
+{
+    auto output = bstring{};
+    auto writer = bit_writer{output};
+
+    writer.put(5, 3);
+    writer.align();
+    ASSERT_EQ(std::ssize(output), 1);
+
+    ttlet bytes = std::array{std::byte{0x12}, std::byte{0x34}};
+    writer.put_bytes(bytes);
+    writer.put(1, 1);
+    writer.align();
+
+    ASSERT_EQ(std::ssize(output), 4);
+    ASSERT_EQ(output[0], std::byte{5});
+    ASSERT_EQ(output[1], std::byte{0x12});
+    ASSERT_EQ(output[2], std::byte{0x34});
+    ASSERT_EQ(output[3], std::byte{1});
+}
+
+TEST(bit_writer, carry_over)
+{
+    // Continue writing in a second string, using the state of the first writer.
+    auto first = bstring{};
+    auto first_writer = bit_writer{first};
+    first_writer.put(0x1ff, 9);
+    first_writer.put(0x2a, 7);
+    first_writer.put(0x5, 3);
+
+    auto second = bstring{};
+    auto second_writer = bit_writer{second, first_writer.accumulator(), first_writer.bit_count()};
+    second_writer.put(0x1f, 5);
+    second_writer.align();
+
+    ttlet combined = first + second;
+    auto reader = bit_reader{combined};
+    reader.refill();
+    ASSERT_EQ(reader.get(9), 0x1ffU);
+    ASSERT_EQ(reader.get(7), 0x2aU);
+    ASSERT_EQ(reader.get(3), 0x5U);
+    ASSERT_EQ(reader.get(5), 0x1fU);
+}
@@ -1,11 +1,320 @@
+// Copyright Take Vos 2020-2021.
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
-
 #include "BON8.hpp"
+#include "BON8_reader.hpp"
+#include "BON8_view.hpp"
+#include "../file_view.hpp"
+#include <algorithm>
+#include <utility>
+#include <array>
+#include <limits>
 
 namespace tt {
+namespace detail {
+
+[[nodiscard]] static std::u8string_view to_u8string_view(std::string_view str) noexcept
+{
+    return std::u8string_view{reinterpret_cast<char8_t const *>(str.data()), str.size()};
+}
+
+void BON8_encoder::grow(size_t count)
+{
+    if (_is_external) {
+        throw operation_error("BON8 message does not fit in buffer of {} bytes", _last - _first);
+    }
+
+    ttlet used = size();
+    output.resize(std::max({output.size() * 2, used + count, size_t{256}}));
+    _first = output.data();
+    _ptr = _first + used;
+    _last = _first + output.size();
+}
+
+void BON8_encoder::add(datum const &value)
+{
+    auto buffer = datum::string_buffer_type{};
+
+    if (value.is_string()) {
+        add(to_u8string_view(value.string_view(buffer)));
+    } else if (value.is_url()) {
+        add(to_u8string_view(static_cast<std::string>(value)));
+    } else if (value.is_bool()) {
+        add(static_cast<bool>(value));
+    } else if (value.is_null()) {
+        add(nullptr);
+    } else if (value.is_integer()) {
+        add(static_cast<signed long long>(value));
+    } else if (value.is_float()) {
+        add(static_cast<double>(value));
+    } else if (value.is_vector()) {
+        open_string = false;
+        if (value.size() == 0) {
+            write_big(BON8_code_array_empty, 1);
+        } else {
+            write_big(BON8_code_array, 1);
+            for (auto i = value.vector_begin(); i != value.vector_end(); ++i) {
+                add(*i);
+            }
+            write_big(BON8_code_eoc, 1);
+        }
+        open_string = false;
+    } else if (value.is_map()) {
+        open_string = false;
+        if (value.size() == 0) {
+            write_big(BON8_code_object_empty, 1);
+        } else {
+            // Keys must be ordered lexically.
+            using item_type = std::pair<std::string, datum const *>;
+            auto sorted_items = std::vector<item_type>{};
+            sorted_items.reserve(value.size());
+            for (auto i = value.map_begin(); i != value.map_end(); ++i) {
+                if (!i->first.is_string()) {
+                    throw operation_error("Key of an object must be a string to be encoded to BON8");
+                }
+                sorted_items.emplace_back(static_cast<std::string>(i->first), &i->second);
+            }
+            std::sort(sorted_items.begin(), sorted_items.end(), [](item_type const &a, item_type const &b) {
+                return a.first < b.first;
+            });
+
+            write_big(BON8_code_object, 1);
+            for (ttlet &item : sorted_items) {
+                add(to_u8string_view(item.first));
+                add(*item.second);
+            }
+            write_big(BON8_code_eoc, 1);
+        }
+        open_string = false;
+    } else {
+        throw operation_error("Datum value can not be encoded to BON8");
+    }
+}
+
+[[nodiscard]] bstring BON8_encoder::get_index() const
+{
+    return make_BON8_index(std::span<std::byte const>{_first, _ptr});
+}
+
+[[nodiscard]] static size_t BON8_integer_size(long long value) noexcept
+{
+    if (value < std::numeric_limits<int32_t>::min()) {
+        return 9;
+    } else if (value < -33554432) {
+        return 5;
+    } else if (value < -262144) {
+        return 4;
+    } else if (value < -1920) {
+        return 3;
+    } else if (value < -10) {
+        return 2;
+    } else if (value <= 47) {
+        return 1;
+    } else if (value <= 3839) {
+        return 2;
+    } else if (value <= 524287) {
+        return 3;
+    } else if (value <= 67108863) {
+        return 4;
+    } else if (value <= std::numeric_limits<int32_t>::max()) {
+        return 5;
+    } else {
+        return 9;
+    }
+}
+
+[[nodiscard]] static size_t BON8_floating_point_size(double value) noexcept
+{
+    if (value == -1.0 || value == 0.0 || value == 1.0) {
+        return 1;
+    } else if (static_cast<double>(static_cast<float>(value)) == value) {
+        return 5;
+    } else {
+        return 9;
+    }
+}
+
+/** The size of a string, including the end-of-text that separates it from a previous string.
+ */
+[[nodiscard]] static size_t BON8_string_size(size_t size, bool &open_string) noexcept
+{
+    ttlet separator = open_string ? size_t{1} : size_t{0};
+    open_string = size != 0;
+    return separator + (size == 0 ? 1 : size);
+}
+
+[[nodiscard]] static size_t BON8_encoded_size(datum const &value, bool &open_string)
+{
+    auto buffer = datum::string_buffer_type{};
+
+    if (value.is_string()) {
+        return BON8_string_size(value.string_view(buffer).size(), open_string);
+    } else if (value.is_url()) {
+        return BON8_string_size(static_cast<std::string>(value).size(), open_string);
+    }
+
+    open_string = false;
+    if (value.is_bool() || value.is_null()) {
+        return 1;
+    } else if (value.is_integer()) {
+        return BON8_integer_size(static_cast<signed long long>(value));
+    } else if (value.is_float()) {
+        return BON8_floating_point_size(static_cast<double>(value));
+
+    } else if (value.is_vector()) {
+        if (value.size() == 0) {
+            return 1;
+        }
+
+        auto r = size_t{2};
+        for (auto i = value.vector_begin(); i != value.vector_end(); ++i) {
+            r += BON8_encoded_size(*i, open_string);
+        }
+        open_string = false;
+        return r;
+
+    } else if (value.is_map()) {
+        if (value.size() == 0) {
+            return 1;
+        }
+
+        // The members are encoded in key order. A member whose value is a non-empty string
+        // needs an end-of-text before the key of the next member, unless it is the last member.
+        auto r = size_t{2};
+        auto last_key = std::string_view{};
+        auto last_key_buffer = datum::string_buffer_type{};
+        auto last_is_open = false;
+        auto nr_open = size_t{0};
+        for (auto i = value.map_begin(); i != value.map_end(); ++i) {
+            if (!i->first.is_string()) {
+                throw operation_error("Key of an object must be a string to be encoded to BON8");
+            }
+
+            ttlet key = i->first.string_view(buffer);
+            auto is_open = false;
+            r += BON8_string_size(key.size(), is_open);
+            r += BON8_encoded_size(i->second, is_open);
+
+            if (is_open) {
+                ++nr_open;
+            }
+            if (i == value.map_begin() || last_key < key) {
+                last_key = i->first.string_view(last_key_buffer);
+                last_is_open = is_open;
+            }
+        }
+        open_string = false;
+        return r + nr_open - (last_is_open ? 1 : 0);
+
+    } else {
+        throw operation_error("Datum value can not be encoded to BON8");
+    }
+}
+
+[[nodiscard]] static datum decode_BON8_value(BON8_reader &reader, BON8_event event, std::pmr::memory_resource *resource)
+{
+    switch (event) {
+    case BON8_event::begin_array: {
+        auto array = datum::vector(resource);
+        while ((event = reader.next()) != BON8_event::end_array) {
+            array.push_back(decode_BON8_value(reader, event, resource));
+        }
+        return datum{std::move(array)};
+    }
+
+    case BON8_event::begin_object: {
+        auto object = datum::map(resource);
+        while ((event = reader.next()) != BON8_event::end_object) {
+            tt_axiom(event == BON8_event::key);
+            auto key = datum{reader.string(), resource};
+            auto value = decode_BON8_value(reader, reader.next(), resource);
+            object.emplace(std::move(key), std::move(value));
+        }
+        return datum{std::move(object)};
+    }
+
+    case BON8_event::string: return datum{reader.string(), resource};
+    case BON8_event::integer: return datum{reader.integer()};
+    case BON8_event::floating_point: return datum{reader.floating_point()};
+    case BON8_event::boolean: return datum{reader.boolean()};
+    case BON8_event::null: return datum{datum::null{}};
+    default: tt_no_default();
+    }
+}
+
+[[nodiscard]] datum decode_BON8(cbyteptr &ptr, cbyteptr last, std::pmr::memory_resource *resource)
+{
+    auto reader = BON8_reader{std::span{ptr, last}};
+    auto r = decode_BON8_value(reader, reader.next(), resource);
+    ptr += reader.offset();
+    return r;
+}
+
+} // namespace detail
+
+[[nodiscard]] datum decode_BON8(std::span<const std::byte> buffer)
+{
+    auto *ptr = buffer.data();
+    auto *last = ptr + buffer.size();
+    return detail::decode_BON8(ptr, last);
+}
+
+[[nodiscard]] datum decode_BON8(bstring const &buffer)
+{
+    auto *ptr = buffer.data();
+    auto *last = ptr + buffer.size();
+    return detail::decode_BON8(ptr, last);
+}
+
+[[nodiscard]] datum decode_BON8(bstring_view buffer)
+{
+    auto *ptr = buffer.data();
+    auto *last = ptr + buffer.size();
+    return detail::decode_BON8(ptr, last);
+}
+
+datum &decode_BON8(std::span<const std::byte> buffer, datum_document &document)
+{
+    auto *ptr = buffer.data();
+    auto *last = ptr + buffer.size();
+    document.root() = detail::decode_BON8(ptr, last, document.resource());
+    return document.root();
+}
+
+datum &decode_BON8(bstring const &buffer, datum_document &document)
+{
+    return decode_BON8(bstring_view{buffer}, document);
+}
+
+datum &decode_BON8(bstring_view buffer, datum_document &document)
+{
+    return decode_BON8(std::span{buffer.data(), buffer.size()}, document);
+}
+
+[[nodiscard]] size_t BON8_encoded_size(datum const &value)
+{
+    auto open_string = false;
+    return detail::BON8_encoded_size(value, open_string);
+}
+
+[[nodiscard]] bstring encode_BON8(datum const &value)
+{
+    auto encoder = detail::BON8_encoder{};
+    encoder.add(value);
+    return std::move(encoder).get();
+}
 
+size_t encode_BON8(datum const &value, std::span<std::byte> buffer)
+{
+    auto encoder = detail::BON8_encoder{buffer};
+    encoder.add(value);
+    return encoder.size();
+}
 
+size_t encode_BON8(datum const &value, file_view &view)
+{
+    return encode_BON8(value, view.bytes());
+}
 
-}
\ No newline at end of file
+} // namespace tt
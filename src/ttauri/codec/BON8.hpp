@@ -5,13 +5,27 @@
 #include "../byte_string.hpp"
 #include "../required.hpp"
 #include "../datum.hpp"
+#include "../datum_document.hpp"
 #include "../exception.hpp"
 #include "../cast.hpp"
+#include "../endian.hpp"
+#include "../os_detect.hpp"
+#include <span>
+#include <map>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <bit>
+#include <cstring>
 #include <cstddef>
+#include <memory_resource>
 
 #pragma once
 
 namespace tt {
+class file_view;
+
 namespace detail {
 constexpr auto BON8_code_float_min_one = uint8_t{0xba};
 constexpr auto BON8_code_float_zero    = uint8_t{0xbb};
@@ -34,223 +48,243 @@ constexpr auto BON8_code_eot           = uint8_t{0xff};
  * @param ptr [in,out] Pointer to start of byte-buffer. After the call
  *            ptr will point one beyond the message.
  * @param last Pointer one beyond the end of the message.
+ * @param resource The memory resource to allocate strings, vectors and maps from.
  * @return The decoded message.
  */
-[[nodiscard]] datum decode_BON8(cbyteptr &ptr, cbyteptr last);
-
-[[nodiscard]] bstring encode_BON8(datum const &value);
-
+[[nodiscard]] datum
+decode_BON8(cbyteptr &ptr, cbyteptr last, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
 /** BON8 encoder.
+ *
+ * The encoder writes through a raw pointer; integers, floating point numbers and strings are
+ * written with a single store or memcpy instead of one byte at a time.
+ *
+ * By default the encoder writes into its own buffer, which grows geometrically. Call `reserve()`
+ * with the result of `BON8_encoded_size()` to encode without any reallocation.
+ * The encoder can also write into a caller supplied buffer, such as a memory mapped `file_view`.
  */
 class BON8_encoder {
-    bool open_string;
-    bstring output;
-
 public:
+    /** Create an encoder which writes into its own buffer.
+     */
     BON8_encoder() noexcept :
-        open_string(false), output() {}
+        open_string(false), output(), _is_external(false) {}
+
+    /** Create an encoder which writes into a buffer supplied by the caller.
+     *
+     * @param buffer The buffer to write into, which must outlive the encoder.
+     *               An operation_error is thrown when the message does not fit.
+     */
+    explicit BON8_encoder(std::span<std::byte> buffer) noexcept :
+        open_string(false), output(), _first(buffer.data()), _ptr(buffer.data()), _last(buffer.data() + buffer.size()), _is_external(true) {}
+
+    BON8_encoder(BON8_encoder const &) = delete;
+    BON8_encoder(BON8_encoder &&) = delete;
+    BON8_encoder &operator=(BON8_encoder const &) = delete;
+    BON8_encoder &operator=(BON8_encoder &&) = delete;
 
     /** Return a byte_string of the encoded object.
+     * Only valid for an encoder which writes into its own buffer.
      */
-    bstring const &get() const noexcept {
+    [[nodiscard]] bstring const &get() & noexcept {
+        tt_axiom(!_is_external);
+        output.resize(size());
+        _first = output.data();
+        _ptr = _last = _first + output.size();
         return output;
     }
 
+    /** Move the byte_string of the encoded object out of the encoder.
+     * Only valid for an encoder which writes into its own buffer.
+     */
+    [[nodiscard]] bstring get() && noexcept {
+        tt_axiom(!_is_external);
+        output.resize(size());
+        return std::move(output);
+    }
+
+    /** The number of bytes that have been encoded.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        return narrow_cast<size_t>(_ptr - _first);
+    }
+
+    /** Make sure that at least `count` more bytes can be encoded without reallocation.
+     */
+    void reserve(size_t count) {
+        if (narrow_cast<size_t>(_last - _ptr) < count) {
+            grow(count);
+        }
+    }
+
+    /** Return the side index of the encoded object.
+     * The index is used by `BON8_view` to find a value without decoding the whole message.
+     */
+    [[nodiscard]] bstring get_index() const;
+
     /** And a signed integer.
      * @param value A signed integer.
      */
-    void add(signed long long value) noexcept {
+    void add(signed long long value) {
         open_string = false;
 
         if (value < std::numeric_limits<int32_t>::min()) {
-            output += static_cast<std::byte>(BON8_code_int64);
-            for (int i = 0; i != 8; ++i) {
-                output += static_cast<std::byte>(value >> (56 - i*8));
-            }
+            write_big(BON8_code_int64, 1);
+            write_big(static_cast<uint64_t>(value), 8);
 
         } else if (value < -33554432) {
-            output += static_cast<std::byte>(BON8_code_int32);
-            for (int i = 0; i != 4; ++i) {
-                output += static_cast<std::byte>(value >> (24 - i*8));
-            }
+            write_big((uint64_t{BON8_code_int32} << 32) | static_cast<uint32_t>(value), 5);
 
         } else if (value < -262144) {
-            value = -value - 1;
-            output += static_cast<std::byte>(0xf0 + (value >> 22 & 0x07));
-            output += static_cast<std::byte>(0xc0 + (value >> 16 & 0x3f));
-            output += static_cast<std::byte>(value >> 8);
-            output += static_cast<std::byte>(value);
+            ttlet v = static_cast<uint64_t>(-value - 1);
+            write_big(0xf0c0'0000 | ((v << 2) & 0x0700'0000) | (v & 0x003f'ffff), 4);
 
         } else if (value < -1920) {
-            value = -value - 1;
-            output += static_cast<std::byte>(0xe0 + (value >> 14 & 0x0f));
-            output += static_cast<std::byte>(0xc0 + (value >> 8 & 0x3f));
-            output += static_cast<std::byte>(value);
+            ttlet v = static_cast<uint64_t>(-value - 1);
+            write_big(0xe0'c000 | ((v << 2) & 0x0f'0000) | (v & 0x3fff), 3);
 
         } else if (value < -10) {
-            value = -value - 1;
-            output += static_cast<std::byte>(0xc2 + (value >> 6 & 0x1f));
-            output += static_cast<std::byte>(0xc0 + (value & 0x3f));
+            ttlet v = static_cast<uint64_t>(-value - 1);
+            write_big(((0xc2 + (v >> 6)) << 8) | 0xc0 | (v & 0x3f), 2);
 
         } else if (value < 0) {
-            value = -value - 1;
-            output += static_cast<std::byte>(0xb0 + value);
+            write_big(0xb0 + static_cast<uint64_t>(-value - 1), 1);
 
         } else if (value <= 47) {
-            output += static_cast<std::byte>(0x80 + value);
+            write_big(0x80 + static_cast<uint64_t>(value), 1);
 
         } else if (value <= 3839) {
-            output += static_cast<std::byte>(0xc2 + (value >> 7 & 0x1f));
-            output += static_cast<std::byte>(value & 0x7f);
+            ttlet v = static_cast<uint64_t>(value);
+            write_big(((0xc2 + (v >> 7)) << 8) | (v & 0x7f), 2);
 
         } else if (value <= 524287) {
-            output += static_cast<std::byte>(0xe0 + (value >> 15 & 0x0f));
-            output += static_cast<std::byte>(value >> 8 & 0x7f);
-            output += static_cast<std::byte>(value);
+            ttlet v = static_cast<uint64_t>(value);
+            write_big(0xe0'0000 | ((v << 1) & 0x0f'0000) | (v & 0x7fff), 3);
 
         } else if (value <= 67108863) {
-            output += static_cast<std::byte>(0xf0 + (value >> 23 & 0x17));
-            output += static_cast<std::byte>(value >> 16 & 0x7f);
-            output += static_cast<std::byte>(value >> 8);
-            output += static_cast<std::byte>(value);
+            ttlet v = static_cast<uint64_t>(value);
+            write_big(0xf000'0000 | ((v << 1) & 0x0700'0000) | (v & 0x007f'ffff), 4);
 
         } else if (value <= std::numeric_limits<int32_t>::max()) {
-            output += static_cast<std::byte>(BON8_code_int32);
-            for (int i = 0; i != 4; ++i) {
-                output += static_cast<std::byte>(value >> (24 - i*8));
-            }
+            write_big((uint64_t{BON8_code_int32} << 32) | static_cast<uint32_t>(value), 5);
 
         } else {
-            output += static_cast<std::byte>(BON8_code_int64);
-            for (int i = 0; i != 8; ++i) {
-                output += static_cast<std::byte>(value >> (56 - i*8));
-            }
+            write_big(BON8_code_int64, 1);
+            write_big(static_cast<uint64_t>(value), 8);
         }
     }
 
     /** And a unsigned integer.
      * @param value A unsigned integer.
      */
-    void add(unsigned long long value) noexcept {
+    void add(unsigned long long value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a signed integer.
      * @param value A signed integer.
      */
-    void add(signed long value) noexcept {
+    void add(signed long value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a unsigned integer.
      * @param value A unsigned integer.
      */
-    void add(unsigned long value) noexcept {
+    void add(unsigned long value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a signed integer.
      * @param value A signed integer.
      */
-    void add(signed int value) noexcept {
+    void add(signed int value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a unsigned integer.
      * @param value A unsigned integer.
      */
-    void add(unsigned int value) noexcept {
+    void add(unsigned int value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a signed integer.
      * @param value A signed integer.
      */
-    void add(signed short value) noexcept {
+    void add(signed short value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a unsigned integer.
      * @param value A unsigned integer.
      */
-    void add(unsigned short value) noexcept {
+    void add(unsigned short value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a signed integer.
      * @param value A signed integer.
      */
-    void add(signed char value) noexcept {
+    void add(signed char value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** And a unsigned integer.
      * @param value A unsigned integer.
      */
-    void add(unsigned char value) noexcept {
+    void add(unsigned char value) {
         return add(narrow_cast<signed long long>(value));
     }
 
     /** Add a floating point number.
      * @param value A floating point number.
      */
-    void add(double value) noexcept {
+    void add(double value) {
         open_string = false;
 
         ttlet f32 = static_cast<float>(value);
         ttlet f32_64 = static_cast<double>(f32);
 
         if (value == -1.0) {
-            output += static_cast<std::byte>(BON8_code_float_min_one);
+            write_big(BON8_code_float_min_one, 1);
 
         } else if (value == 0.0 || value == -0.0) {
-            output += static_cast<std::byte>(BON8_code_float_zero);
+            write_big(BON8_code_float_zero, 1);
 
         } else if (value == 1.0) {
-            output += static_cast<std::byte>(BON8_code_float_one);
+            write_big(BON8_code_float_one, 1);
 
         } else if (f32_64 == value) {
-            uint32_t u32;
-            std::memcpy(&u32, &f32, sizeof(u32));
-
-            output += static_cast<std::byte>(BON8_code_binary32);
-            for (int i = 0; i != 4; ++i) {
-                output += static_cast<std::byte>(u32 >> (24 - i*8));
-            }
+            write_big((uint64_t{BON8_code_binary32} << 32) | std::bit_cast<uint32_t>(f32), 5);
 
         } else {
-            uint64_t u64;
-            std::memcpy(&u64, &value, sizeof(u64));
-
-            output += static_cast<std::byte>(BON8_code_binary64);
-            for (int i = 0; i != 8; ++i) {
-                output += static_cast<std::byte>(u64 >> (56 - i*8));
-            }
+            write_big(BON8_code_binary64, 1);
+            write_big(std::bit_cast<uint64_t>(value), 8);
         }
     }
 
     /** Add a floating point number.
      * @param value A floating point number.
      */
-    void add(float value) noexcept {
+    void add(float value) {
         return add(narrow_cast<double>(value));
     }
 
     /** Add a boolean.
      * @param value A boolean value.
      */
-    void add(bool value) noexcept {
+    void add(bool value) {
         open_string = false;
-        output += static_cast<std::byte>(value ? BON8_code_bool_true : BON8_code_bool_false);
+        write_big(value ? BON8_code_bool_true : BON8_code_bool_false, 1);
     }
 
     /** Add a null.
      * @param value A null pointer.
      */
-    void add(nullptr_t value) noexcept {
+    void add(nullptr_t value) {
         open_string = false;
-        output += static_cast<std::byte>(BON8_code_null);
+        write_big(BON8_code_null, 1);
     }
 
     /** Add a UTF-8 string.
@@ -258,44 +292,43 @@ public:
      *
      * @param value A UTF-8 string.
      */
-    void add(std::u8string_view value) noexcept {
-        if (open_string) {
-            output += static_cast<std::byte>(BON8_code_eot);
-        }
-
-        if (std::ssize(value) == 0) {
-            output += static_cast<std::byte>(BON8_code_eot);
-            open_string = false;
-
-        } else {
+    void add(std::u8string_view value) {
+        if constexpr (BuildType::current == BuildType::Debug) {
             int multi_byte = 0;
-
             for (ttlet _c : value) {
                 ttlet c = static_cast<uint8_t>(_c);
 
-                if constexpr (BuildType::current == BuildType::Debug) {
-                    if (multi_byte == 0) {
-                        if (c >= 0xc2 && c <= 0xdf) {
-                            multi_byte = 1;
-                        } else if (c >= 0xe0 && c <= 0xef) {
-                            multi_byte = 2;
-                        } else if (c >= 0xf0 && c <= 0xf7) {
-                            multi_byte = 3;
-                        } else {
-                            tt_assert(c <= 0x7f);
-                        }
-
+                if (multi_byte == 0) {
+                    if (c >= 0xc2 && c <= 0xdf) {
+                        multi_byte = 1;
+                    } else if (c >= 0xe0 && c <= 0xef) {
+                        multi_byte = 2;
+                    } else if (c >= 0xf0 && c <= 0xf7) {
+                        multi_byte = 3;
                     } else {
-                        tt_assert(c >= 0x80 && c <= 0xbf);
-                        --multi_byte;
+                        tt_assert(c <= 0x7f);
                     }
-                }
 
-                output += static_cast<std::byte>(c);
+                } else {
+                    tt_assert(c >= 0x80 && c <= 0xbf);
+                    --multi_byte;
+                }
             }
-
             tt_assert(multi_byte == 0);
+        }
+
+        reserve(value.size() + (open_string ? 1 : 0) + (value.empty() ? 1 : 0));
+        if (open_string) {
+            *_ptr++ = static_cast<std::byte>(BON8_code_eot);
+        }
 
+        if (value.empty()) {
+            *_ptr++ = static_cast<std::byte>(BON8_code_eot);
+            open_string = false;
+
+        } else {
+            std::memcpy(_ptr, value.data(), value.size());
+            _ptr += value.size();
             open_string = true;
         }
     }
@@ -305,7 +338,7 @@ public:
      *
      * @param value A UTF-8 string
      */
-    void add(std::u8string const &value) noexcept {
+    void add(std::u8string const &value) {
         return add(std::u8string_view{value});
     }
 
@@ -314,7 +347,7 @@ public:
      *
      * @param value A UTF-8 string.
      */
-    void add(char8_t const *value) noexcept {
+    void add(char8_t const *value) {
         return add(std::u8string_view{value});
     }
 
@@ -331,15 +364,15 @@ public:
     void add(std::vector<T> const &items) {
         open_string = false;
         if (std::ssize(items) == 0) {
-            output += static_cast<std::byte>(BON8_code_array_empty);
+            write_big(BON8_code_array_empty, 1);
         } else {
-            output += static_cast<std::byte>(BON8_code_array);
+            write_big(BON8_code_array, 1);
 
             for (ttlet &item: items) {
                 add(item);
             }
 
-            output += static_cast<std::byte>(BON8_code_eoc);
+            write_big(BON8_code_eoc, 1);
         }
         open_string = false;
     }
@@ -355,349 +388,141 @@ public:
 
         open_string = false;
         if (std::ssize(items) == 0) {
-            output += static_cast<std::byte>(BON8_code_object_empty);
+            write_big(BON8_code_object_empty, 1);
         } else {
             // Keys must be ordered lexically.
-            auto sorted_items = std::vector<std::reference_wrapper<item_type>>{items.begin(), items.end()};
+            auto sorted_items = std::vector<std::reference_wrapper<item_type const>>{items.begin(), items.end()};
             std::sort(sorted_items.begin(), sorted_items.end(), [](item_type const &a, item_type const &b) {
                 return
                     static_cast<std::u8string_view>(a.first) <
                     static_cast<std::u8string_view>(b.first);
             });
 
-            output += static_cast<std::byte>(BON8_code_object);
+            write_big(BON8_code_object, 1);
             for (item_type const &item: sorted_items) {
                 add(static_cast<std::u8string_view>(item.first));
                 add(item.second);
             }
-            output += static_cast<std::byte>(BON8_code_eoc);
+            write_big(BON8_code_eoc, 1);
         }
         open_string = false;
     }
-};
-
-void BON8_encoder::add(datum const &value) {
-    if (value.is_string() || value.is_url()) {
-        add(static_cast<std::string>(value));
-    } else if (value.is_bool()) {
-        add(static_cast<bool>(value));
-    } else if (value.is_null()) {
-        add(nullptr);
-    } else if (value.is_integer()) {
-        add(static_cast<signed long long>(value));
-    } else if (value.is_float()) {
-        add(static_cast<double>(value));
-    } else if (value.is_vector()) {
-        add(static_cast<datum::vector>(value));
-    } else if (value.is_map()) {
-        add(static_cast<datum::map>(value));
-    } else {
-        throw operation_error("Datum value can not be encoded to BON8");
-    }
-}
-
-/** Count the number of UTF-8-like code units
- * This does not really decode the character, just calculate the size.
- *
- * @param ptr The pointer to the first byte of a UTF-8-like multibyte sequence
- * @param last The pointer beyond the buffer.
- * @return When positive: the number of bytes in the UTF-8 character.
- *         When negative: the number of bytes in the integer.
- */
-[[nodiscard]] int BON8_multibyte_count(cbyteptr ptr, cbyteptr last) {
-    ttlet c0 = static_cast<uint8_t>(*ptr);
-    int count =
-        c0 <= 0xdf ? 2 :
-        c0 <= 0xef ? 3 :
-        4;
-
-    tt_parse_check(ptr + count <= last, "Incomplete Multi-byte character at end of buffer");
-
-    ttlet c1 = static_cast<uint8_t>(*(ptr + 1));
-    return (c1 < 0x80 || c1 > 0xbf) ? -count : count;
-}
-
-/** Decode a 4, or 8 byte signed integer.
- *
- * @param [in,out] ptr The pointer to the first byte of the integer.
- *                     On return this points beyond the integer.
- * @param last The pointer beyond the buffer.
- * @param count The number of bytes used to encode the integer.
- * @return The integer as a datum.
- */
-[[nodiscard]] datum decode_BON8_int(cbyteptr &ptr, cbyteptr last, int count)
-{
-    tt_axiom(count == 4 || count == 8);
-
-    auto u64 = uint64_t{0};
-    for (int i = 0; i != count; ++i) {
-        tt_parse_check(ptr != last, "Incomplete signed integer at end of buffer");
-        u64 <<= 8;
-        u64 |= static_cast<uint64_t>(*(ptr++));
-    }
-
-    if (count == 4) {
-        ttlet u32 = static_cast<uint32_t>(u64);
-        ttlet i32 = static_cast<int32_t>(u32);
-        return datum{i32};
-    } else {
-        ttlet i64 = static_cast<int64_t>(u64);
-        return datum{i64};
-    }
-}
-
-[[nodiscard]] datum decode_BON8_float(cbyteptr &ptr, cbyteptr last, int count)
-{
-    tt_axiom(count == 4 || count == 8);
-
-    auto u64 = uint64_t{0};
-    for (int i = 0; i != count; ++i) {
-        tt_parse_check(ptr != last, "Incomplete signed integer at end of buffer");
-        u64 <<= 8;
-        u64 |= static_cast<uint64_t>(*(ptr++));
-    }
-
-    if (count == 4) {
-        ttlet u32 = static_cast<uint32_t>(u64);
-        float f32;
-        std::memcpy(&f32, &u32, sizeof(f32));
-        return datum{f32};
-
-    } else {
-        double f64;
-        std::memcpy(&f64, &u64, sizeof(f64));
-        return datum{f64};
-    }
-}
-
-[[nodiscard]] datum decode_BON8_array(cbyteptr &ptr, cbyteptr last)
-{
-    auto r = datum::vector{};
 
-    while (ptr != last) {
-        if (*ptr == static_cast<std::byte>(BON8_code_eoc)) {
-            ++ptr;
-            return datum{std::move(r)};
-
-        } else {
-            r.push_back(decode_BON8(ptr, last));
-        }
-    }
-    throw parse_error("Incomplete array at end of buffer");
-}
-
-[[nodiscard]] datum decode_BON8_object(cbyteptr &ptr, cbyteptr last)
-{
-    auto r = datum::map{};
-
-    while (ptr != last) {
-        if (*ptr == static_cast<std::byte>(BON8_code_eoc)) {
-            ++ptr;
-            return datum{std::move(r)};
-
-        } else {
-            auto key = decode_BON8(ptr, last);
-            tt_parse_check(key.is_string(), "Key in object is not a string");
-
-            auto value = decode_BON8(ptr, last);
-            r.emplace(std::move(key), std::move(value));
-        }
-    }
-    throw parse_error("Incomplete array at end of buffer");
-}
-
-[[nodiscard]] datum decode_BON8_UTF8_like_int(cbyteptr &ptr, cbyteptr last, int count) noexcept
-{
-    tt_axiom(count >= 2 && count <= 4);
-    tt_axiom(ptr != last);
-    ttlet c0 = static_cast<uint8_t>(*(ptr++));
-
-    ttlet mask = int{0b0111'1111} >> count;
-    auto value = static_cast<int>(c0) & mask;
-    if (count == 2) {
-        value -= 2;
-    }
-
-    tt_axiom(ptr != last);
-    ttlet c1 = static_cast<uint8_t>(*(ptr++));
-    ttlet is_positive = c1 <= 0x7f;
-    if (is_positive) {
-        value <<= 7;
-        value |= static_cast<int>(c1);
-    } else {
-        value <<= 6;
-        value |= static_cast<int>(c1 & 0b0011'11111);
-    }
-
-    switch (count) {
-    case 4:
-        tt_axiom(ptr != last);
-        value <<= 8;
-        value |= static_cast<int>(*(ptr++));
-        [[fallthrough]];
-    case 3:
-        tt_axiom(ptr != last);
-        value <<= 8;
-        value |= static_cast<int>(*(ptr++));
-        [[fallthrough]];
-    default:;
-    }
-
-    return datum{is_positive ? value : -value};
-}
-
-[[nodiscard]] datum decode_BON8(cbyteptr &ptr, cbyteptr last) {
-    std::string str;
-
-    while (ptr != last) {
-        ttlet c = static_cast<uint8_t>(*ptr);
-
-        if (c == BON8_code_eot) {
-            // End of string found, return the current string.
-            ++ptr;
-            return datum{str};
-
-        } else if (c <= 0x7f) {
-            // ASCII character.
-            str += static_cast<char>(*(ptr++));
-            continue;
-
-        } else if (c >= 0xc2 && c <= 0xf7) {
-            ttlet count = BON8_multibyte_count(ptr, last);
-            if (count > 0) {
-                // Multibyte UTF-8 character
-                for (int i = 0; i != count; ++i) {
-                    str += static_cast<char>(*(ptr++));
-                }
-                continue;
+private:
+    bool open_string;
 
-            } else if (std::ssize(str) != 0) {
-                // Multibyte integer found, but first return the current string.
-                return datum{str};
+    /** The buffer of an encoder which writes into its own buffer.
+     * The size of the buffer is its capacity, the encoded bytes are between `_first` and `_ptr`.
+     */
+    bstring output;
 
-            } else {
-                // Multibyte integer.
-                return decode_BON8_UTF8_like_int(ptr, last, -count);
-            }
+    std::byte *_first = nullptr;
+    std::byte *_ptr = nullptr;
+    std::byte *_last = nullptr;
+    bool _is_external;
 
-        } else if (std::ssize(str) != 0) {
-            // This must be a non-string type, but first return the current string.
-            return datum{str};
+    /** Make room for at least `count` more bytes.
+     * @throw operation_error When a buffer supplied by the caller is too small.
+     */
+    void grow(size_t count);
 
-        // Everything below this, are non-string types.
-        } else if (c <= 0xaf) {
-            // 1 byte positive integer
-            return datum{c - 0x80};
+    /** Write the `count` least significant bytes of `value` in big-endian order.
+     * When there is room this is done with a single 64 bit store.
+     */
+    void write_big(uint64_t value, size_t count) {
+        tt_axiom(count >= 1 && count <= 8);
 
-        } else if (c <= 0xb9) {
-            // 1 byte negative integer
-            return datum{-static_cast<int>(c - 0xb0)};
+        if (_last - _ptr >= 8) [[likely]] {
+            ttlet tmp = native_to_big(value << (64 - count * 8));
+            std::memcpy(_ptr, &tmp, sizeof(tmp));
 
         } else {
-            // This is one of the non-string types.
-            switch (c) {
-            case BON8_code_null:
-                ++ptr;
-                return datum{datum::null{}};
-
-            case BON8_code_bool_false:
-                ++ptr;
-                return datum{false};
-
-            case BON8_code_bool_true:
-                ++ptr;
-                return datum{true};
-
-            case BON8_code_float_min_one:
-                ++ptr;
-                return datum{-1.0f};
-
-            case BON8_code_float_zero:
-                ++ptr;
-                return datum{-0.0f};
-
-            case BON8_code_float_one:
-                ++ptr;
-                return datum{1.0f};
-
-            case BON8_code_int32:
-                ++ptr;
-                return decode_BON8_int(ptr, last, 4);
-
-            case BON8_code_int64:
-                ++ptr;
-                return decode_BON8_int(ptr, last, 8);
-
-            case BON8_code_binary32:
-                ++ptr;
-                return decode_BON8_float(ptr, last, 4);
-
-            case BON8_code_binary64:
-                ++ptr;
-                return decode_BON8_float(ptr, last, 8);
-
-            case BON8_code_eoc:
-                throw parse_error("Unexpected end-of-container");
-
-            case BON8_code_array:
-                ++ptr;
-                return decode_BON8_array(ptr, last);
-
-            case BON8_code_object:
-                ++ptr;
-                return decode_BON8_object(ptr, last);
-
-            default:
-                tt_no_default();
+            reserve(count);
+            for (size_t i = 0; i != count; ++i) {
+                _ptr[i] = static_cast<std::byte>(value >> ((count - 1 - i) * 8));
             }
         }
+        _ptr += count;
     }
-    throw parse_error("Unexpected end-of-buffer");
-}
+};
+
 } // namespace detail
 
+/** The number of bytes of the BON8 encoding of a value.
+ *
+ * This is a cheap pass over the value which does not encode anything.
+ * It is used to size the buffer, or memory mapped file, before encoding.
+ */
+[[nodiscard]] size_t BON8_encoded_size(datum const &value);
+
 /** Decode BON8 message from buffer.
+ * To read a message without constructing a datum use `BON8_reader`.
+ *
  * @param buffer A buffer to a BON8 encoded message.
  * @return The decoded message.
  */
-[[nodiscard]] datum decode_BON8(std::span<const std::byte> buffer)
-{
-    auto *ptr = buffer.data();
-    auto *last = ptr + buffer.size();
-    return detail::decode_BON8(ptr, last);
-}
+[[nodiscard]] datum decode_BON8(std::span<const std::byte> buffer);
 
 /** Decode BON8 message from buffer.
  * @param buffer A buffer to a BON8 encoded message.
  * @return The decoded message.
  */
-[[nodiscard]] datum decode_BON8(bstring const &buffer)
-{
-    auto *ptr = buffer.data();
-    auto *last = ptr + buffer.size();
-    return detail::decode_BON8(ptr, last);
-}
+[[nodiscard]] datum decode_BON8(bstring const &buffer);
 
 /** Decode BON8 message from buffer.
  * @param buffer A buffer to a BON8 encoded message.
  * @return The decoded message.
  */
-[[nodiscard]] datum decode_BON8(bstring_view buffer)
-{
-    auto *ptr = buffer.data();
-    auto *last = ptr + buffer.size();
-    return detail::decode_BON8(ptr, last);
-}
+[[nodiscard]] datum decode_BON8(bstring_view buffer);
+
+/** Decode BON8 message from buffer into a document.
+ * The strings, vectors and maps of the message are allocated from the arena of the document.
+ *
+ * @param buffer A buffer to a BON8 encoded message.
+ * @param document The document which will hold the decoded message as its root.
+ * @return The root of the document.
+ */
+datum &decode_BON8(std::span<const std::byte> buffer, datum_document &document);
+
+/** Decode BON8 message from buffer into a document.
+ * @param buffer A buffer to a BON8 encoded message.
+ * @param document The document which will hold the decoded message as its root.
+ * @return The root of the document.
+ */
+datum &decode_BON8(bstring const &buffer, datum_document &document);
+
+/** Decode BON8 message from buffer into a document.
+ * @param buffer A buffer to a BON8 encoded message.
+ * @param document The document which will hold the decoded message as its root.
+ * @return The root of the document.
+ */
+datum &decode_BON8(bstring_view buffer, datum_document &document);
 
 /** Encode a value to a BON8 message.
  * @param value The data to encode
  * @return The encoded message as a byte_string.
  */
-[[nodiscard]] bstring encode_BON8(datum const &value)
-{
-    auto encoder = detail::BON8_encoder{};
-    encoder.add(value);
-    return encoder.get();
-}
+[[nodiscard]] bstring encode_BON8(datum const &value);
+
+/** Encode a value to a BON8 message in a buffer.
+ *
+ * @param value The data to encode.
+ * @param buffer The buffer to write into, of at least `BON8_encoded_size(value)` bytes.
+ * @return The number of bytes written.
+ * @throw operation_error When the buffer is too small.
+ */
+size_t encode_BON8(datum const &value, std::span<std::byte> buffer);
+
+/** Encode a value to a BON8 message directly into memory mapped file.
+ *
+ * The view should be created with a size of `BON8_encoded_size(value)` bytes, so that
+ * the file contains exactly the message.
+ *
+ * @param value The data to encode.
+ * @param view A writable view of a file.
+ * @return The number of bytes written.
+ * @throw operation_error When the view is too small.
+ */
+size_t encode_BON8(datum const &value, file_view &view);
 
 }
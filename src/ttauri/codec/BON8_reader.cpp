@@ -0,0 +1,423 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BON8_reader.hpp"
+#include "BON8.hpp"
+#include "../endian.hpp"
+#include "../exception.hpp"
+#include <emmintrin.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace tt {
+using namespace detail;
+
+BON8_reader::BON8_reader() noexcept
+{
+    // Most messages are not nested very deeply.
+    _stack.reserve(16);
+}
+
+BON8_reader::BON8_reader(std::span<std::byte const> bytes) noexcept : BON8_reader()
+{
+    feed(bytes, true);
+}
+
+void BON8_reader::feed(std::span<std::byte const> bytes, bool is_last) noexcept
+{
+    tt_axiom(_pending || _chunk.empty() || _done);
+
+    _chunk_offset += _chunk.size();
+    _chunk = bytes;
+    _is_last = is_last;
+
+    if (_pending) {
+        // Complete the split value with the first bytes of the chunk, this is enough for
+        // every value except long strings, which will append the rest of the chunk.
+        _pending = false;
+        _carry_appended = std::min(bytes.size(), size_t{16});
+        _carry.insert(_carry.end(), bytes.begin(), bytes.begin() + _carry_appended);
+        _in_carry = true;
+        _ptr = _carry.data();
+        _last = _carry.data() + _carry.size();
+
+    } else {
+        _in_carry = false;
+        _ptr = bytes.data();
+        _last = bytes.data() + bytes.size();
+    }
+}
+
+[[nodiscard]] size_t BON8_reader::offset() const noexcept
+{
+    if (_pending) {
+        return _chunk_offset + _chunk.size() - _carry_tail;
+    } else if (_in_carry) {
+        return _chunk_offset - _carry_tail + narrow_cast<size_t>(_ptr - _carry.data());
+    } else {
+        return _chunk_offset + narrow_cast<size_t>(_ptr - _chunk.data());
+    }
+}
+
+[[nodiscard]] bool BON8_reader::at_end_of_message() const noexcept
+{
+    return _is_last && !(_in_carry && _carry_appended != _chunk.size());
+}
+
+[[nodiscard]] BON8_event BON8_reader::incomplete(char const *message) const
+{
+    if (at_end_of_message()) {
+        throw parse_error(message);
+    }
+    return BON8_event::incomplete;
+}
+
+void BON8_reader::consumed(cbyteptr ptr) noexcept
+{
+    _ptr = ptr;
+    if (_in_carry) {
+        ttlet position = narrow_cast<size_t>(ptr - _carry.data());
+        if (position >= _carry_tail) {
+            // The split value is complete, continue in the chunk.
+            _ptr = _chunk.data() + (position - _carry_tail);
+            _last = _chunk.data() + _chunk.size();
+            _in_carry = false;
+        }
+    }
+}
+
+void BON8_reader::after_value() noexcept
+{
+    if (_stack.empty()) {
+        _done = true;
+    } else {
+        _expect_key = _stack.back() == BON8_code_object;
+    }
+}
+
+[[nodiscard]] BON8_event BON8_reader::open_container(uint8_t code, bool empty) noexcept
+{
+    _stack.push_back(code);
+    _expect_key = code == BON8_code_object;
+    _close_empty = empty;
+    return code == BON8_code_object ? BON8_event::begin_object : BON8_event::begin_array;
+}
+
+[[nodiscard]] BON8_event BON8_reader::close_container()
+{
+    if (_stack.empty()) {
+        throw parse_error("Unexpected end-of-container");
+    }
+
+    ttlet code = _stack.back();
+    if (code == BON8_code_object && !_expect_key) {
+        throw parse_error("Missing value after key in object");
+    }
+
+    _stack.pop_back();
+    after_value();
+    return code == BON8_code_object ? BON8_event::end_object : BON8_event::end_array;
+}
+
+[[nodiscard]] BON8_event BON8_reader::read_string(cbyteptr &ptr)
+{
+    ttlet first = ptr;
+    auto is_terminated = false;
+
+    while (true) {
+        // Skip over ASCII characters 16 at a time.
+        while (_last - ptr >= 16) {
+            ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+            if (ttlet non_ascii = static_cast<uint32_t>(_mm_movemask_epi8(chars))) {
+                ptr += std::countr_zero(non_ascii);
+                break;
+            }
+            ptr += 16;
+        }
+
+        if (ptr == _last) {
+            if (!at_end_of_message()) {
+                // The string may continue in the next chunk.
+                return BON8_event::incomplete;
+            }
+            break;
+        }
+
+        ttlet c = static_cast<uint8_t>(*ptr);
+        if (c <= 0x7f) {
+            ++ptr;
+
+        } else if (c == BON8_code_eot) {
+            is_terminated = true;
+            break;
+
+        } else if (c >= 0xc2 && c <= 0xf7) {
+            if (_last - ptr < 2) {
+                return incomplete("Incomplete multi-byte character at end of buffer");
+            }
+
+            ttlet c1 = static_cast<uint8_t>(ptr[1]);
+            if (c1 < 0x80 || c1 > 0xbf) {
+                // A multi-byte integer follows the string.
+                break;
+            }
+
+            ttlet count = c <= 0xdf ? 2 : c <= 0xef ? 3 : 4;
+            if (_last - ptr < count) {
+                return incomplete("Incomplete multi-byte character at end of buffer");
+            }
+            ptr += count;
+
+        } else {
+            // A non-string value follows the string.
+            break;
+        }
+    }
+
+    _string = std::string_view{reinterpret_cast<char const *>(first), narrow_cast<size_t>(ptr - first)};
+    if (is_terminated) {
+        ++ptr;
+    }
+
+    if (_expect_key) {
+        _expect_key = false;
+        return BON8_event::key;
+    } else {
+        after_value();
+        return BON8_event::string;
+    }
+}
+
+[[nodiscard]] BON8_event BON8_reader::read_multi_byte_integer(cbyteptr &ptr, int count) noexcept
+{
+    tt_axiom(count >= 2 && count <= 4);
+    tt_axiom(_last - ptr >= count);
+
+    ttlet c0 = static_cast<uint8_t>(ptr[0]);
+    ttlet c1 = static_cast<uint8_t>(ptr[1]);
+
+    auto value = static_cast<long long>(c0 & (0b0111'1111 >> count));
+    if (count == 2) {
+        value -= 2;
+    }
+
+    ttlet is_positive = c1 <= 0x7f;
+    if (is_positive) {
+        value <<= 7;
+        value |= c1;
+    } else {
+        value <<= 6;
+        value |= c1 & 0b0011'1111;
+    }
+
+    for (int i = 2; i < count; ++i) {
+        value <<= 8;
+        value |= static_cast<uint8_t>(ptr[i]);
+    }
+
+    ptr += count;
+    _integer = is_positive ? value : -value - 1;
+    after_value();
+    return BON8_event::integer;
+}
+
+[[nodiscard]] BON8_event BON8_reader::read_fixed(cbyteptr &ptr, int count, BON8_event event)
+{
+    tt_axiom(count == 4 || count == 8);
+
+    if (_last - ptr < count + 1) {
+        return incomplete("Incomplete number at end of buffer");
+    }
+    ++ptr;
+
+    if (count == 4) {
+        auto u32 = uint32_t{};
+        std::memcpy(&u32, ptr, sizeof(u32));
+        u32 = big_to_native(u32);
+
+        if (event == BON8_event::integer) {
+            _integer = static_cast<int32_t>(u32);
+        } else {
+            _floating_point = std::bit_cast<float>(u32);
+        }
+
+    } else {
+        auto u64 = uint64_t{};
+        std::memcpy(&u64, ptr, sizeof(u64));
+        u64 = big_to_native(u64);
+
+        if (event == BON8_event::integer) {
+            _integer = static_cast<int64_t>(u64);
+        } else {
+            _floating_point = std::bit_cast<double>(u64);
+        }
+    }
+
+    ptr += count;
+    after_value();
+    return event;
+}
+
+[[nodiscard]] BON8_event BON8_reader::read_event(cbyteptr &ptr)
+{
+    if (_close_empty) {
+        _close_empty = false;
+        return close_container();
+    }
+
+    if (ptr == _last) {
+        return incomplete("Unexpected end-of-buffer");
+    }
+
+    ttlet c = static_cast<uint8_t>(*ptr);
+    if (c <= 0x7f || c == BON8_code_eot) {
+        return read_string(ptr);
+
+    } else if (c >= 0xc2 && c <= 0xf7) {
+        if (_last - ptr < 2) {
+            return incomplete("Incomplete multi-byte character at end of buffer");
+        }
+
+        ttlet c1 = static_cast<uint8_t>(ptr[1]);
+        if (c1 >= 0x80 && c1 <= 0xbf) {
+            return read_string(ptr);
+        }
+
+        if (_expect_key) {
+            throw parse_error("Key in object is not a string");
+        }
+
+        ttlet count = c <= 0xdf ? 2 : c <= 0xef ? 3 : 4;
+        if (_last - ptr < count) {
+            return incomplete("Incomplete integer at end of buffer");
+        }
+        return read_multi_byte_integer(ptr, count);
+    }
+
+    if (c == BON8_code_eoc) {
+        ++ptr;
+        return close_container();
+
+    } else if (_expect_key) {
+        throw parse_error("Key in object is not a string");
+
+    } else if (c <= 0xaf) {
+        // 1 byte positive integer.
+        ++ptr;
+        _integer = c - 0x80;
+        after_value();
+        return BON8_event::integer;
+
+    } else if (c <= 0xb9) {
+        // 1 byte negative integer.
+        ++ptr;
+        _integer = -static_cast<int>(c - 0xb0) - 1;
+        after_value();
+        return BON8_event::integer;
+    }
+
+    switch (c) {
+    case BON8_code_float_min_one:
+    case BON8_code_float_zero:
+    case BON8_code_float_one:
+        ++ptr;
+        _floating_point = static_cast<double>(static_cast<int>(c) - BON8_code_float_zero);
+        after_value();
+        return BON8_event::floating_point;
+
+    case BON8_code_null:
+        ++ptr;
+        after_value();
+        return BON8_event::null;
+
+    case BON8_code_bool_false:
+    case BON8_code_bool_true:
+        ++ptr;
+        _integer = c == BON8_code_bool_true ? 1 : 0;
+        after_value();
+        return BON8_event::boolean;
+
+    case BON8_code_array_empty: ++ptr; return open_container(BON8_code_array, true);
+    case BON8_code_object_empty: ++ptr; return open_container(BON8_code_object, true);
+    case BON8_code_array: ++ptr; return open_container(BON8_code_array, false);
+    case BON8_code_object: ++ptr; return open_container(BON8_code_object, false);
+    case BON8_code_int32: return read_fixed(ptr, 4, BON8_event::integer);
+    case BON8_code_int64: return read_fixed(ptr, 8, BON8_event::integer);
+    case BON8_code_binary32: return read_fixed(ptr, 4, BON8_event::floating_point);
+    case BON8_code_binary64: return read_fixed(ptr, 8, BON8_event::floating_point);
+    default: tt_no_default();
+    }
+}
+
+[[nodiscard]] BON8_event BON8_reader::read_next()
+{
+    while (true) {
+        if (_done) {
+            return BON8_event::end;
+        } else if (_pending) {
+            return BON8_event::incomplete;
+        }
+
+        auto ptr = _ptr;
+        ttlet event = read_event(ptr);
+        if (event != BON8_event::incomplete) {
+            consumed(ptr);
+            return event;
+        }
+
+        if (_in_carry && _carry_appended != _chunk.size()) {
+            // The split value is longer than expected, append the rest of the chunk.
+            ttlet position = _ptr - _carry.data();
+            _carry.insert(_carry.end(), _chunk.begin() + _carry_appended, _chunk.end());
+            _carry_appended = _chunk.size();
+            _ptr = _carry.data() + position;
+            _last = _carry.data() + _carry.size();
+            continue;
+        }
+
+        // Keep the start of the split value until the next chunk is fed.
+        if (_in_carry) {
+            _carry.erase(_carry.begin(), _carry.begin() + (_ptr - _carry.data()));
+        } else {
+            _carry.assign(_ptr, _last);
+        }
+        _carry_tail = _carry.size();
+        _in_carry = false;
+        _pending = true;
+        return BON8_event::incomplete;
+    }
+}
+
+[[nodiscard]] BON8_event BON8_reader::next()
+{
+    while (_skip_depth >= 0) {
+        if (read_next() == BON8_event::incomplete) {
+            return BON8_event::incomplete;
+        }
+        if (depth() == _skip_depth) {
+            _skip_depth = -1;
+        }
+    }
+
+    return read_next();
+}
+
+void BON8_reader::skip()
+{
+    tt_axiom(!_stack.empty());
+    tt_axiom(_skip_depth < 0);
+
+    _skip_depth = depth() - 1;
+    while (_skip_depth >= 0) {
+        if (read_next() == BON8_event::incomplete) {
+            return;
+        }
+        if (depth() == _skip_depth) {
+            _skip_depth = -1;
+        }
+    }
+}
+
+} // namespace tt
@@ -0,0 +1,212 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../byte_string.hpp"
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace tt {
+
+/** An event produced by the BON8 reader.
+ */
+enum class BON8_event : uint8_t {
+    /** The complete message has been read.
+     */
+    end,
+
+    /** The rest of the message has not been fed to the reader yet.
+     */
+    incomplete,
+
+    begin_array,
+    end_array,
+    begin_object,
+    end_object,
+
+    /** The name of a member of an object, the next event is the value of the member.
+     */
+    key,
+    string,
+    integer,
+    floating_point,
+    boolean,
+    null
+};
+
+/** A cursor over a BON8 encoded message.
+ *
+ * Each call to `next()` reads the message up to the next event, no datum is constructed.
+ * Strings are returned as views of the UTF-8 code-units inside the message.
+ *
+ * The message may be fed to the reader in chunks. When a value is split between two chunks
+ * `next()` returns `BON8_event::incomplete`, the bytes of the split value are copied and the
+ * value is completed when the next chunk is fed.
+ */
+class BON8_reader {
+public:
+    /** Create a reader for a message that is fed in chunks.
+     */
+    BON8_reader() noexcept;
+
+    /** Create a reader for a complete message.
+     *
+     * @param bytes The message, which must outlive the reader and the string views returned by `string()`.
+     */
+    explicit BON8_reader(std::span<std::byte const> bytes) noexcept;
+
+    BON8_reader(BON8_reader const &) = delete;
+    BON8_reader(BON8_reader &&) = delete;
+    BON8_reader &operator=(BON8_reader const &) = delete;
+    BON8_reader &operator=(BON8_reader &&) = delete;
+
+    /** Feed the next chunk of the message.
+     *
+     * May only be called at the start, or after `next()` returned `BON8_event::incomplete`.
+     *
+     * @param bytes The next chunk, which must stay valid until `next()` returns `BON8_event::incomplete`
+     *              again, or until the string views returned by `string()` are no longer used.
+     * @param is_last True if this is the last chunk of the message.
+     */
+    void feed(std::span<std::byte const> bytes, bool is_last = false) noexcept;
+
+    /** Read the next event.
+     *
+     * After `BON8_event::end` is returned, every call returns `BON8_event::end`.
+     *
+     * @return The event that was read.
+     * @throw parse_error When the message is not valid BON8.
+     */
+    [[nodiscard]] BON8_event next();
+
+    /** Skip over the rest of an array or object.
+     *
+     * Must be called directly after a `BON8_event::begin_array` or `BON8_event::begin_object` event.
+     * The values inside the container are skipped without producing events. When the rest of the
+     * container has not been fed yet, the following calls to `next()` return `BON8_event::incomplete`
+     * until the container is completely skipped.
+     *
+     * @throw parse_error When the message is not valid BON8.
+     */
+    void skip();
+
+    /** The UTF-8 string of the current `BON8_event::key` or `BON8_event::string` event.
+     * The view is valid until the next call to `next()`.
+     */
+    [[nodiscard]] std::string_view string() const noexcept
+    {
+        return _string;
+    }
+
+    /** The value of the current `BON8_event::integer` event.
+     */
+    [[nodiscard]] long long integer() const noexcept
+    {
+        return _integer;
+    }
+
+    /** The value of the current `BON8_event::floating_point` event.
+     */
+    [[nodiscard]] double floating_point() const noexcept
+    {
+        return _floating_point;
+    }
+
+    /** The value of the current `BON8_event::boolean` event.
+     */
+    [[nodiscard]] bool boolean() const noexcept
+    {
+        return _integer != 0;
+    }
+
+    /** The number of arrays and objects the reader is inside of.
+     */
+    [[nodiscard]] ssize_t depth() const noexcept
+    {
+        return std::ssize(_stack);
+    }
+
+    /** The number of bytes of the message that have been consumed.
+     */
+    [[nodiscard]] size_t offset() const noexcept;
+
+private:
+    /** The current window of bytes; either the fed chunk or the `_carry` buffer.
+     */
+    cbyteptr _ptr = nullptr;
+    cbyteptr _last = nullptr;
+
+    /** The chunk that was fed last.
+     */
+    std::span<std::byte const> _chunk;
+
+    /** The bytes of a value that is split between chunks, followed by the first bytes of the next chunk.
+     */
+    std::vector<std::byte> _carry;
+
+    /** The number of bytes in `_carry` that came from previous chunks.
+     */
+    size_t _carry_tail = 0;
+
+    /** The number of bytes of the current chunk that are appended to `_carry`.
+     */
+    size_t _carry_appended = 0;
+
+    /** The total size of the chunks before the current chunk.
+     */
+    size_t _chunk_offset = 0;
+
+    bool _is_last = false;
+
+    /** The window is the `_carry` buffer.
+     */
+    bool _in_carry = false;
+
+    /** `_carry` holds a split value, waiting for the next chunk.
+     */
+    bool _pending = false;
+
+    /** An empty array or object was read, the next event closes it.
+     */
+    bool _close_empty = false;
+
+    /** The next value in the current object is a key.
+     */
+    bool _expect_key = false;
+
+    /** The root value has been read.
+     */
+    bool _done = false;
+
+    /** The depth to return to while skipping, or -1 when not skipping.
+     */
+    ssize_t _skip_depth = -1;
+
+    /** The open containers, `BON8_code_array` or `BON8_code_object`.
+     */
+    std::vector<uint8_t> _stack;
+
+    std::string_view _string;
+    long long _integer = 0;
+    double _floating_point = 0.0;
+
+    [[nodiscard]] bool at_end_of_message() const noexcept;
+    [[nodiscard]] BON8_event incomplete(char const *message) const;
+    [[nodiscard]] BON8_event read_next();
+    [[nodiscard]] BON8_event read_event(cbyteptr &ptr);
+    [[nodiscard]] BON8_event read_string(cbyteptr &ptr);
+    [[nodiscard]] BON8_event read_multi_byte_integer(cbyteptr &ptr, int count) noexcept;
+    [[nodiscard]] BON8_event read_fixed(cbyteptr &ptr, int count, BON8_event event);
+    [[nodiscard]] BON8_event open_container(uint8_t code, bool empty) noexcept;
+    [[nodiscard]] BON8_event close_container();
+    void after_value() noexcept;
+    void consumed(cbyteptr ptr) noexcept;
+};
+
+} // namespace tt
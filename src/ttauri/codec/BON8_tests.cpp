@@ -0,0 +1,527 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/BON8.hpp"
+#include "ttauri/codec/BON8_reader.hpp"
+#include "ttauri/codec/BON8_view.hpp"
+#include "ttauri/byte_string.hpp"
+#include "ttauri/required.hpp"
+#include "ttauri/exception.hpp"
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <limits>
+
+using namespace std;
+using namespace tt;
+
+static bstring make_message(std::initializer_list<int> bytes)
+{
+    auto r = bstring{};
+    for (ttlet byte : bytes) {
+        r += static_cast<std::byte>(byte);
+    }
+    return r;
+}
+
+/** Read all events of a message fed in chunks of `chunk_size` bytes, as text.
+ */
+static std::vector<std::string> read_events(bstring const &message, size_t chunk_size)
+{
+    auto r = std::vector<std::string>{};
+    auto reader = BON8_reader{};
+
+    auto offset = size_t{0};
+    auto feed = [&] {
+        ttlet size = std::min(chunk_size, message.size() - offset);
+        reader.feed(std::span{message.data() + offset, size}, offset + size == message.size());
+        offset += size;
+    };
+
+    feed();
+    while (true) {
+        switch (reader.next()) {
+        case BON8_event::end: r.push_back("end"); return r;
+        case BON8_event::incomplete: feed(); break;
+        case BON8_event::begin_array: r.push_back("["); break;
+        case BON8_event::end_array: r.push_back("]"); break;
+        case BON8_event::begin_object: r.push_back("{"); break;
+        case BON8_event::end_object: r.push_back("}"); break;
+        case BON8_event::key: r.push_back("key:" + std::string{reader.string()}); break;
+        case BON8_event::string: r.push_back("string:" + std::string{reader.string()}); break;
+        case BON8_event::integer: r.push_back("integer:" + std::to_string(reader.integer())); break;
+        case BON8_event::floating_point: r.push_back("float:" + std::to_string(reader.floating_point())); break;
+        case BON8_event::boolean: r.push_back(reader.boolean() ? "true" : "false"); break;
+        case BON8_event::null: r.push_back("null"); break;
+        default: tt_no_default();
+        }
+    }
+}
+
+TEST(BON8Reader, Events)
+{
+    ttlet message = make_message({0xfd, 'a', 0x81, 'b', 0xfc, 0xc1, 0xbf, 0xbb, 0xbd, 0xfe, 'c', 0xff, 'x', 'y', 0xfe});
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+
+    ASSERT_EQ(reader.next(), BON8_event::begin_object);
+    ASSERT_EQ(reader.depth(), 1);
+    ASSERT_EQ(reader.next(), BON8_event::key);
+    ASSERT_EQ(reader.string(), "a");
+    ASSERT_EQ(reader.next(), BON8_event::integer);
+    ASSERT_EQ(reader.integer(), 1);
+    ASSERT_EQ(reader.next(), BON8_event::key);
+    ASSERT_EQ(reader.string(), "b");
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    ASSERT_EQ(reader.depth(), 2);
+    ASSERT_EQ(reader.next(), BON8_event::boolean);
+    ASSERT_EQ(reader.boolean(), true);
+    ASSERT_EQ(reader.next(), BON8_event::null);
+    ASSERT_EQ(reader.next(), BON8_event::floating_point);
+    ASSERT_EQ(reader.floating_point(), 0.0);
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+    ASSERT_EQ(reader.next(), BON8_event::key);
+    ASSERT_EQ(reader.string(), "c");
+    ASSERT_EQ(reader.next(), BON8_event::string);
+    ASSERT_EQ(reader.string(), "xy");
+    ASSERT_EQ(reader.next(), BON8_event::end_object);
+    ASSERT_EQ(reader.depth(), 0);
+    ASSERT_EQ(reader.next(), BON8_event::end);
+    ASSERT_EQ(reader.next(), BON8_event::end);
+    ASSERT_EQ(reader.offset(), message.size());
+}
+
+TEST(BON8Reader, Integers)
+{
+    ttlet message = make_message({
+        0xfc,
+        0x80,
+        0xaf,
+        0xb0,
+        0xb9,
+        0xc2, 0x64,
+        0xdf, 0x7f,
+        0xc2, 0xca,
+        0xe0, 0x0f, 0xa0,
+        0xe0, 0xc7, 0xcf,
+        0xf0, 0x0f, 0x42, 0x40,
+        0xf0, 0xc4, 0x93, 0xdf,
+        0xf8, 0x80, 0x00, 0x00, 0x00,
+        0xf9, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xfe});
+
+    ttlet expected = std::vector<long long>{0, 47, -1, -10, 100, 3839, -11, 4000, -2000, 1000000, -300000, -2147483648, -2};
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    for (ttlet value : expected) {
+        ASSERT_EQ(reader.next(), BON8_event::integer);
+        ASSERT_EQ(reader.integer(), value);
+    }
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+    ASSERT_EQ(reader.next(), BON8_event::end);
+}
+
+TEST(BON8Reader, FloatingPoint)
+{
+    ttlet message = make_message(
+        {0xfc, 0xba, 0xbc, 0xfa, 0x3f, 0xc0, 0x00, 0x00, 0xfb, 0x40, 0x09, 0x21, 0xfb, 0x54, 0x44, 0x2d, 0x18, 0xfe});
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    ASSERT_EQ(reader.next(), BON8_event::floating_point);
+    ASSERT_EQ(reader.floating_point(), -1.0);
+    ASSERT_EQ(reader.next(), BON8_event::floating_point);
+    ASSERT_EQ(reader.floating_point(), 1.0);
+    ASSERT_EQ(reader.next(), BON8_event::floating_point);
+    ASSERT_EQ(reader.floating_point(), 1.5);
+    ASSERT_EQ(reader.next(), BON8_event::floating_point);
+    ASSERT_EQ(reader.floating_point(), 3.141592653589793);
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+}
+
+TEST(BON8Reader, Strings)
+{
+    // Two strings are separated by end-of-text, an empty string is only end-of-text.
+    ttlet message = make_message({0xfc, 'a', 'b', 0xff, 'c', 0xc3, 0xa9, 0xff, 0xe2, 0x82, 0xac, 0xfe});
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    ASSERT_EQ(reader.next(), BON8_event::string);
+    ASSERT_EQ(reader.string(), "ab");
+    ASSERT_EQ(reader.next(), BON8_event::string);
+    ASSERT_EQ(reader.string(), "c\xc3\xa9");
+    ASSERT_EQ(reader.next(), BON8_event::string);
+    ASSERT_EQ(reader.string(), "\xe2\x82\xac");
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+
+    ttlet empty = make_message({0xff});
+    auto empty_reader = BON8_reader{std::span{empty.data(), empty.size()}};
+    ASSERT_EQ(empty_reader.next(), BON8_event::string);
+    ASSERT_EQ(empty_reader.string(), "");
+    ASSERT_EQ(empty_reader.next(), BON8_event::end);
+}
+
+TEST(BON8Reader, LongStrings)
+{
+    for (int length = 1; length != 70; ++length) {
+        auto text = std::string{};
+        for (int i = 0; i != length; ++i) {
+            text += (i % 7 == 3) ? "\xc3\xa9" : "x";
+        }
+
+        auto message = make_message({0xfc});
+        message += to_bstring(text);
+        message += make_message({0x81, 0xfe});
+
+        auto reader = BON8_reader{std::span{message.data(), message.size()}};
+        ASSERT_EQ(reader.next(), BON8_event::begin_array);
+        ASSERT_EQ(reader.next(), BON8_event::string);
+        ASSERT_EQ(reader.string(), text);
+        ASSERT_EQ(reader.next(), BON8_event::integer);
+        ASSERT_EQ(reader.next(), BON8_event::end_array);
+    }
+}
+
+TEST(BON8Reader, Skip)
+{
+    ttlet message = make_message({0xfd, 'a', 0xfc, 0x81, 0xfd, 'x', 0xfc, 0x82, 0xfe, 0xfe, 0xfe, 'b', 0x83, 0xfe});
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_object);
+    ASSERT_EQ(reader.next(), BON8_event::key);
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    reader.skip();
+    ASSERT_EQ(reader.depth(), 1);
+    ASSERT_EQ(reader.next(), BON8_event::key);
+    ASSERT_EQ(reader.string(), "b");
+    ASSERT_EQ(reader.next(), BON8_event::integer);
+    ASSERT_EQ(reader.integer(), 3);
+    ASSERT_EQ(reader.next(), BON8_event::end_object);
+    ASSERT_EQ(reader.next(), BON8_event::end);
+}
+
+TEST(BON8Reader, Chunks)
+{
+    auto message = make_message({0xfd, 'n', 'a', 'm', 'e', 0xfc, 0xc2, 0x64, 0xe0, 0xc7, 0xcf, 0xc3, 0xa9, 0xc3, 0xa9});
+    message += to_bstring(std::string(40, 'z'));
+    message += make_message({0xfb, 0x40, 0x09, 0x21, 0xfb, 0x54, 0x44, 0x2d, 0x18, 0xbd, 0xf9, 0, 0, 0, 1, 0, 0, 0, 0});
+    message += make_message({0xfe, 'b', 0xc0, 0xfe});
+
+    ttlet expected = read_events(message, message.size());
+    ASSERT_EQ(expected.size(), 15);
+
+    for (size_t chunk_size = 1; chunk_size != message.size(); ++chunk_size) {
+        ASSERT_EQ(read_events(message, chunk_size), expected);
+    }
+}
+
+TEST(BON8Reader, ChunkedSkip)
+{
+    auto message = make_message({0xfc, 0xfc});
+    message += to_bstring(std::string(40, 'z'));
+    message += make_message({0xf9, 0, 0, 0, 1, 0, 0, 0, 0, 0xfe, 0x81, 0xfe});
+
+    for (size_t chunk_size = 1; chunk_size != message.size(); ++chunk_size) {
+        auto reader = BON8_reader{};
+        reader.feed(std::span{message.data(), chunk_size});
+        auto offset = chunk_size;
+
+        ASSERT_EQ(reader.next(), BON8_event::begin_array);
+        auto event = reader.next();
+        while (event == BON8_event::incomplete) {
+            reader.feed(std::span{message.data() + offset, 1}, offset + 1 == message.size());
+            ++offset;
+            event = reader.next();
+        }
+        ASSERT_EQ(event, BON8_event::begin_array);
+        reader.skip();
+
+        while ((event = reader.next()) == BON8_event::incomplete) {
+            reader.feed(std::span{message.data() + offset, 1}, offset + 1 == message.size());
+            ++offset;
+        }
+        ASSERT_EQ(event, BON8_event::integer);
+        ASSERT_EQ(reader.integer(), 1);
+    }
+}
+
+TEST(BON8Reader, Errors)
+{
+    ttlet truncated = make_message({0xfc, 0x81});
+    auto reader = BON8_reader{std::span{truncated.data(), truncated.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    ASSERT_EQ(reader.next(), BON8_event::integer);
+    ASSERT_THROW(std::ignore = reader.next(), parse_error);
+
+    ttlet truncated_float = make_message({0xfb, 0x40, 0x09});
+    auto float_reader = BON8_reader{std::span{truncated_float.data(), truncated_float.size()}};
+    ASSERT_THROW(std::ignore = float_reader.next(), parse_error);
+
+    ttlet integer_key = make_message({0xfd, 0x81, 0x82, 0xfe});
+    auto key_reader = BON8_reader{std::span{integer_key.data(), integer_key.size()}};
+    ASSERT_EQ(key_reader.next(), BON8_event::begin_object);
+    ASSERT_THROW(std::ignore = key_reader.next(), parse_error);
+
+    ttlet missing_value = make_message({0xfd, 'a', 0xfe});
+    auto value_reader = BON8_reader{std::span{missing_value.data(), missing_value.size()}};
+    ASSERT_EQ(value_reader.next(), BON8_event::begin_object);
+    ASSERT_EQ(value_reader.next(), BON8_event::key);
+    ASSERT_THROW(std::ignore = value_reader.next(), parse_error);
+}
+
+TEST(BON8, DecodeNegativeIntegers)
+{
+    ASSERT_EQ(decode_BON8(make_message({0xb0})), -1);
+    ASSERT_EQ(decode_BON8(make_message({0xc2, 0xca})), -11);
+    ASSERT_EQ(decode_BON8(make_message({0xe0, 0xc7, 0xcf})), -2000);
+    ASSERT_EQ(decode_BON8(make_message({0xf0, 0xc4, 0x93, 0xdf})), -300000);
+}
+
+TEST(BON8, RoundTrip)
+{
+    auto object = datum::map{};
+    object[datum{"name"}] = datum{"value"};
+    object[datum{"number"}] = datum{-2000};
+    object[datum{"list"}] = datum{datum::vector{datum{1}, datum{2.5}, datum{true}, datum{datum::null{}}, datum{"x"}}};
+    ttlet value = datum{std::move(object)};
+
+    ASSERT_EQ(decode_BON8(encode_BON8(value)), value);
+}
+
+TEST(BON8, DecodeDocument)
+{
+    auto object = datum::map{};
+    object[datum{"a long name"}] = datum{"a long value"};
+    object[datum{"list"}] = datum{datum::vector{datum{1}, datum{"a long string"}, datum{datum::map{}}}};
+    ttlet value = datum{std::move(object)};
+    ttlet message = encode_BON8(value);
+
+    auto document = datum_document{};
+    ASSERT_EQ(decode_BON8(message, document), value);
+    ASSERT_EQ(document.root(), value);
+}
+
+TEST(BON8Encoder, Integers)
+{
+    auto values = std::vector<long long>{};
+    for (auto v = 1ll; v < (1ll << 60); v = v * 3 / 2 + 1) {
+        for (ttlet w : {v - 1, v, v + 1}) {
+            values.push_back(w);
+            values.push_back(-w);
+        }
+    }
+    for (ttlet boundary : {10ll, 11ll, 47ll, 48ll, 1920ll, 1921ll, 3839ll, 3840ll, 262144ll, 262145ll, 524287ll, 524288ll,
+                           33554432ll, 33554433ll, 67108863ll, 67108864ll, 2147483647ll, 2147483648ll, 2147483649ll}) {
+        values.push_back(boundary);
+        values.push_back(-boundary);
+    }
+    values.push_back(std::numeric_limits<long long>::max());
+    values.push_back(std::numeric_limits<long long>::min());
+
+    auto encoder = detail::BON8_encoder{};
+    encoder.add(values);
+    ttlet message = encoder.get();
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    for (ttlet value : values) {
+        ASSERT_EQ(reader.next(), BON8_event::integer);
+        ASSERT_EQ(reader.integer(), value);
+    }
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+    ASSERT_EQ(reader.next(), BON8_event::end);
+}
+
+TEST(BON8Encoder, FloatingPoint)
+{
+    ttlet values = std::vector<double>{-1.0, 0.0, 1.0, 1.5, -0.25, 3.141592653589793, 1e300};
+
+    auto encoder = detail::BON8_encoder{};
+    encoder.add(values);
+    ttlet message = encoder.get();
+    ASSERT_EQ(message.size(), 2 + 3 + 5 + 5 + 9 + 9);
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    for (ttlet value : values) {
+        ASSERT_EQ(reader.next(), BON8_event::floating_point);
+        ASSERT_EQ(reader.floating_point(), value);
+    }
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+}
+
+TEST(BON8Encoder, Strings)
+{
+    ttlet values = std::vector<std::u8string>{u8"a", u8"", u8"", u8"b\u00e9", std::u8string(100, u8'x'), u8"c"};
+
+    auto encoder = detail::BON8_encoder{};
+    encoder.add(values);
+    ttlet message = encoder.get();
+    ASSERT_EQ(message, make_message({0xfc, 'a', 0xff, 0xff, 0xff, 'b', 0xc3, 0xa9}) + to_bstring(std::string(1, '\xff') + std::string(100, 'x') + "\xff" "c") + make_message({0xfe}));
+
+    auto reader = BON8_reader{std::span{message.data(), message.size()}};
+    ASSERT_EQ(reader.next(), BON8_event::begin_array);
+    for (ttlet &value : values) {
+        ASSERT_EQ(reader.next(), BON8_event::string);
+        ASSERT_EQ(reader.string(), std::string(reinterpret_cast<char const *>(value.data()), value.size()));
+    }
+    ASSERT_EQ(reader.next(), BON8_event::end_array);
+}
+
+TEST(BON8Encoder, Buffer)
+{
+    ttlet values = std::vector<long long>{1, 1000, -1000, 1'000'000, -1'000'000'000'000};
+
+    auto reference = detail::BON8_encoder{};
+    reference.add(values);
+    ttlet expected = reference.get();
+
+    auto buffer = bstring(expected.size(), std::byte{0});
+    auto encoder = detail::BON8_encoder{std::span{buffer.data(), buffer.size()}};
+    encoder.add(values);
+    ASSERT_EQ(encoder.size(), expected.size());
+    ASSERT_EQ(buffer, expected);
+
+    auto small_buffer = bstring(expected.size() - 1, std::byte{0});
+    auto small_encoder = detail::BON8_encoder{std::span{small_buffer.data(), small_buffer.size()}};
+    ASSERT_THROW(small_encoder.add(values), operation_error);
+}
+
+TEST(BON8, EncodedSize)
+{
+    auto object = datum::map{};
+    object[datum{""}] = datum{"x"};
+    object[datum{"a"}] = datum{""};
+    object[datum{"b"}] = datum{"long string value"};
+    object[datum{"c"}] = datum{-300000};
+    object[datum{"d"}] = datum{datum::vector{datum{"p"}, datum{"q"}, datum{""}, datum{1.5}, datum{"r"}}};
+    object[datum{"zz"}] = datum{"last"};
+
+    ttlet values = std::vector<datum>{
+        datum{1}, datum{-2000}, datum{1e100}, datum{"abc"}, datum{""}, datum{datum::vector{}}, datum{datum::map{}}, datum{object}};
+
+    for (ttlet &value : values) {
+        ttlet message = encode_BON8(value);
+        ASSERT_EQ(BON8_encoded_size(value), message.size());
+        ASSERT_EQ(decode_BON8(message), value);
+
+        auto buffer = bstring(message.size(), std::byte{0});
+        ASSERT_EQ(encode_BON8(value, std::span{buffer.data(), buffer.size()}), message.size());
+        ASSERT_EQ(buffer, message);
+    }
+}
+
+TEST(BON8, ExactBufferEndingInString)
+{
+    // The last string of a message does not need an end-of-text, so it must fit in a buffer of exactly the encoded size.
+    auto object = datum::map{};
+    object[datum{"a"}] = datum{1};
+    object[datum{"b"}] = datum{"a long string value"};
+
+    ttlet values = std::vector<datum>{
+        datum{"x"},
+        datum{"six ch"},
+        datum{"a long string value"},
+        datum{datum::vector{datum{1}, datum{"abc"}}},
+        datum{datum::vector{datum{""}, datum{"a long string value"}}},
+        datum{object}};
+
+    for (ttlet &value : values) {
+        ttlet size = BON8_encoded_size(value);
+        auto buffer = bstring(size, std::byte{0});
+        ASSERT_EQ(encode_BON8(value, std::span{buffer.data(), buffer.size()}), size);
+        ASSERT_EQ(decode_BON8(buffer), value);
+    }
+}
+
+TEST(BON8View, Lookup)
+{
+    // The keys of the object are not sorted in the message.
+    ttlet message = make_message({0xfd, 'b', 0xfc, 0x81, 0xfd, 'z', 0x82, 0xfe, 0x83, 0xfe, 'a', 0xff, 'x', 'y', 0xff, 0xfe});
+    ttlet index = make_BON8_index(std::span{message.data(), message.size()});
+
+    ttlet root = BON8_view{std::span{message.data(), message.size()}, std::span{index.data(), index.size()}};
+    ASSERT_TRUE(root.is_object());
+    ASSERT_EQ(root.size(), 2);
+
+    ASSERT_EQ(root["a"].value(), "xy");
+    ASSERT_FALSE(root["a"].is_array());
+    ASSERT_FALSE(root.find("c"));
+
+    ttlet b = root["b"];
+    ASSERT_TRUE(b.is_array());
+    ASSERT_EQ(b.size(), 3);
+    ASSERT_EQ(b[0].value(), 1);
+    ASSERT_EQ(b[1]["z"].value(), 2);
+    ASSERT_EQ(b[2].value(), 3);
+
+    ASSERT_THROW(std::ignore = b[3], operation_error);
+    ASSERT_THROW(std::ignore = b["z"], operation_error);
+    ASSERT_THROW(std::ignore = root[0], operation_error);
+    ASSERT_THROW(std::ignore = root["c"], operation_error);
+}
+
+TEST(BON8View, Scalar)
+{
+    ttlet message = make_message({0xc2, 0x64});
+    ttlet index = make_BON8_index(std::span{message.data(), message.size()});
+
+    ttlet root = BON8_view{std::span{message.data(), message.size()}, std::span{index.data(), index.size()}};
+    ASSERT_FALSE(root.is_array());
+    ASSERT_FALSE(root.is_object());
+    ASSERT_EQ(root.value(), 100);
+    ASSERT_THROW(std::ignore = root.size(), operation_error);
+}
+
+TEST(BON8View, WrongIndex)
+{
+    ttlet message = make_message({0xfc, 0x81, 0xfe});
+    ttlet other = make_message({0xfc, 0x81, 0x82, 0xfe});
+    ttlet index = make_BON8_index(std::span{other.data(), other.size()});
+
+    ASSERT_THROW(
+        std::ignore = BON8_view(std::span{message.data(), message.size()}, std::span{index.data(), index.size()}),
+        parse_error);
+    ASSERT_THROW(
+        std::ignore = BON8_view(std::span{message.data(), message.size()}, std::span{index.data(), 4}), parse_error);
+}
+
+static datum make_items_datum(int nr_items)
+{
+    auto items = datum::vector{};
+    for (int i = 0; i != nr_items; ++i) {
+        auto item = datum::map{};
+        item[datum{"id"}] = datum{i};
+        item[datum{"name"}] = datum{"item " + std::to_string(i)};
+        item[datum{"values"}] = datum{datum::vector{datum{i}, datum{i + 1}, datum{i + 2}}};
+        items.push_back(datum{std::move(item)});
+    }
+
+    auto root = datum::map{};
+    root[datum{"version"}] = datum{1};
+    root[datum{"items"}] = datum{std::move(items)};
+    return datum{std::move(root)};
+}
+
+TEST(BON8View, Encoder)
+{
+    ttlet value = make_items_datum(100);
+
+    auto encoder = detail::BON8_encoder{};
+    encoder.add(value);
+    ttlet message = encoder.get();
+    ttlet index = encoder.get_index();
+
+    ttlet root = BON8_view{std::span{message.data(), message.size()}, std::span{index.data(), index.size()}};
+    ASSERT_EQ(root["version"].value(), 1);
+    ASSERT_EQ(root["items"].size(), 100);
+    for (size_t i = 0; i != 100; ++i) {
+        ASSERT_EQ(root["items"][i]["values"][1].value(), value["items"][i]["values"][1]);
+        ASSERT_EQ(root["items"][i].value(), value["items"][i]);
+    }
+    ASSERT_EQ(root.value(), value);
+}
@@ -0,0 +1,262 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BON8_view.hpp"
+#include "BON8_reader.hpp"
+#include "BON8.hpp"
+#include "../endian.hpp"
+#include "../exception.hpp"
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <cstring>
+
+namespace tt {
+using namespace detail;
+
+/** "BON8" as a little-endian integer.
+ */
+constexpr auto BON8_index_magic = uint32_t{0x384e'4f42};
+
+constexpr size_t BON8_index_header_size = 12;
+constexpr size_t BON8_index_record_header_size = 8;
+constexpr size_t BON8_index_array_entry_size = 8;
+constexpr size_t BON8_index_object_entry_size = 16;
+
+namespace {
+
+struct BON8_index_entry {
+    uint32_t key_offset;
+    uint32_t key_size;
+    uint32_t value_offset;
+    uint32_t record;
+};
+
+struct BON8_index_frame {
+    uint8_t kind;
+    size_t first_entry;
+};
+
+} // namespace
+
+static void append_uint32(bstring &index, uint32_t value) noexcept
+{
+    value = native_to_little(value);
+    index.append(reinterpret_cast<std::byte const *>(&value), sizeof(value));
+}
+
+[[nodiscard]] static std::string_view key_view(std::span<std::byte const> message, uint32_t offset, uint32_t size) noexcept
+{
+    return std::string_view{reinterpret_cast<char const *>(message.data() + offset), size};
+}
+
+[[nodiscard]] bstring make_BON8_index(std::span<std::byte const> message)
+{
+    if (message.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw operation_error("BON8 message of {} bytes is too large to be indexed", message.size());
+    }
+
+    auto index = bstring{};
+    append_uint32(index, BON8_index_magic);
+    append_uint32(index, narrow_cast<uint32_t>(message.size()));
+    append_uint32(index, BON8_view::no_record);
+
+    // The entries of the open containers, the entries of a nested container follow those of its parent.
+    auto entries = std::vector<BON8_index_entry>{};
+    auto frames = std::vector<BON8_index_frame>{};
+    auto key_offset = uint32_t{0};
+    auto key_size = uint32_t{0};
+
+    auto reader = BON8_reader{message};
+    while (true) {
+        ttlet offset = narrow_cast<uint32_t>(reader.offset());
+
+        switch (ttlet event = reader.next()) {
+        case BON8_event::end: return index;
+
+        case BON8_event::key:
+            key_offset = offset;
+            key_size = narrow_cast<uint32_t>(reader.string().size());
+            break;
+
+        case BON8_event::begin_array:
+        case BON8_event::begin_object:
+            if (!frames.empty()) {
+                entries.push_back({key_offset, key_size, offset, BON8_view::no_record});
+            }
+            frames.push_back({event == BON8_event::begin_object ? BON8_code_object : BON8_code_array, entries.size()});
+            break;
+
+        case BON8_event::end_array:
+        case BON8_event::end_object: {
+            ttlet frame = frames.back();
+            frames.pop_back();
+
+            ttlet first = entries.begin() + frame.first_entry;
+            if (frame.kind == BON8_code_object) {
+                std::sort(first, entries.end(), [message](ttlet &a, ttlet &b) {
+                    return key_view(message, a.key_offset, a.key_size) < key_view(message, b.key_offset, b.key_size);
+                });
+            }
+
+            if (index.size() >= std::numeric_limits<uint32_t>::max()) {
+                throw operation_error("BON8 index of message of {} bytes is too large", message.size());
+            }
+            ttlet record = narrow_cast<uint32_t>(index.size());
+
+            append_uint32(index, frame.kind);
+            append_uint32(index, narrow_cast<uint32_t>(entries.end() - first));
+            for (auto i = first; i != entries.end(); ++i) {
+                if (frame.kind == BON8_code_object) {
+                    append_uint32(index, i->key_offset);
+                    append_uint32(index, i->key_size);
+                }
+                append_uint32(index, i->value_offset);
+                append_uint32(index, i->record);
+            }
+            entries.erase(first, entries.end());
+
+            if (frames.empty()) {
+                ttlet root = native_to_little(record);
+                std::memcpy(index.data() + 8, &root, sizeof(root));
+            } else {
+                entries.back().record = record;
+            }
+        } break;
+
+        case BON8_event::incomplete: tt_no_default();
+
+        default:
+            if (!frames.empty()) {
+                entries.push_back({key_offset, key_size, offset, BON8_view::no_record});
+            }
+        }
+    }
+}
+
+BON8_view::BON8_view(std::span<std::byte const> message, std::span<std::byte const> index) :
+    BON8_view(message, index, 0, no_record)
+{
+    if (_index.size() < BON8_index_header_size || load(0) != BON8_index_magic || load(4) != _message.size()) {
+        throw parse_error("BON8 index does not belong to the message");
+    }
+
+    *this = BON8_view{_message, _index, 0, load(8)};
+}
+
+BON8_view::BON8_view(
+    std::span<std::byte const> message,
+    std::span<std::byte const> index,
+    uint32_t value_offset,
+    uint32_t record) :
+    _message(message), _index(index), _value_offset(value_offset), _record(record), _kind(0)
+{
+    if (_record != no_record) {
+        _kind = narrow_cast<uint8_t>(load(_record));
+        if (_kind != BON8_code_array && _kind != BON8_code_object) {
+            throw parse_error("BON8 index is corrupt");
+        }
+    }
+}
+
+[[nodiscard]] uint32_t BON8_view::load(size_t offset) const
+{
+    if (offset + sizeof(uint32_t) > _index.size()) {
+        throw parse_error("BON8 index is corrupt");
+    }
+
+    auto value = uint32_t{};
+    std::memcpy(&value, _index.data() + offset, sizeof(value));
+    return little_to_native(value);
+}
+
+[[nodiscard]] BON8_view BON8_view::make_child(size_t offset) const
+{
+    ttlet value_offset = load(offset);
+    if (value_offset >= _message.size()) {
+        throw parse_error("BON8 index is corrupt");
+    }
+    return BON8_view{_message, _index, value_offset, load(offset + 4)};
+}
+
+[[nodiscard]] bool BON8_view::is_array() const noexcept
+{
+    return _kind == BON8_code_array;
+}
+
+[[nodiscard]] bool BON8_view::is_object() const noexcept
+{
+    return _kind == BON8_code_object;
+}
+
+[[nodiscard]] size_t BON8_view::size() const
+{
+    if (_record == no_record) {
+        throw operation_error("BON8 value is not an array or object");
+    }
+    return load(size_t{_record} + 4);
+}
+
+[[nodiscard]] std::optional<BON8_view> BON8_view::find(std::string_view key) const
+{
+    if (!is_object()) {
+        throw operation_error("BON8 value is not an object");
+    }
+
+    ttlet first_entry = size_t{_record} + BON8_index_record_header_size;
+
+    // Binary search through the members, which are sorted by key.
+    auto first = size_t{0};
+    auto last = size();
+    while (first != last) {
+        ttlet middle = first + (last - first) / 2;
+        ttlet entry = first_entry + middle * BON8_index_object_entry_size;
+
+        ttlet key_offset = load(entry);
+        ttlet key_size = load(entry + 4);
+        if (size_t{key_offset} + key_size > _message.size()) {
+            throw parse_error("BON8 index is corrupt");
+        }
+
+        ttlet middle_key = key_view(_message, key_offset, key_size);
+        if (middle_key < key) {
+            first = middle + 1;
+        } else if (key < middle_key) {
+            last = middle;
+        } else {
+            return make_child(entry + 8);
+        }
+    }
+    return {};
+}
+
+[[nodiscard]] BON8_view BON8_view::operator[](std::string_view key) const
+{
+    if (auto r = find(key)) {
+        return *r;
+    }
+    throw operation_error("Could not find key {} in BON8 object", key);
+}
+
+[[nodiscard]] BON8_view BON8_view::operator[](size_t index) const
+{
+    if (!is_array()) {
+        throw operation_error("BON8 value is not an array");
+    }
+
+    ttlet nr_items = size();
+    if (index >= nr_items) {
+        throw operation_error("Index {} out of range of BON8 array of size {}", index, nr_items);
+    }
+
+    return make_child(size_t{_record} + BON8_index_record_header_size + index * BON8_index_array_entry_size);
+}
+
+[[nodiscard]] datum BON8_view::value() const
+{
+    auto ptr = _message.data() + _value_offset;
+    return detail::decode_BON8(ptr, _message.data() + _message.size());
+}
+
+} // namespace tt
@@ -0,0 +1,129 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../byte_string.hpp"
+#include "../datum.hpp"
+#include <span>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace tt {
+
+/** Build a side index for a BON8 message.
+ *
+ * The index holds, for each array and object in the message, the byte offsets of its items and
+ * the offset of the index record of each nested array or object. The members of an object are
+ * sorted by key, so that a member can be found with a binary search.
+ *
+ * The index is a sequence of little-endian 32 bit integers:
+ *  - header: magic "BON8", size of the message, offset of the record of the root value.
+ *  - array record: `BON8_code_array`, item count, then for each item: value offset, record offset.
+ *  - object record: `BON8_code_object`, member count, then for each member:
+ *    key offset, key size, value offset, record offset.
+ *
+ * The record offset of a value that is not an array or object is 0xffff'ffff.
+ *
+ * @param message A complete BON8 message of less than 4 GiB.
+ * @return The index.
+ * @throw parse_error When the message is not valid BON8.
+ * @throw operation_error When the message is too large to be indexed.
+ */
+[[nodiscard]] bstring make_BON8_index(std::span<std::byte const> message);
+
+/** A lazy accessor of a value inside a BON8 message.
+ *
+ * With the side index created by `make_BON8_index()` a value can be found without decoding the
+ * rest of the message; a member of an object is found in O(log n), an item of an array in O(1).
+ * Only the value that is retrieved with `value()` is decoded.
+ *
+ * Both the message and the index may be memory mapped, for example with a `file_view`:
+ * ```
+ * auto message = file_view{URL{"file:snapshot.bon8"}};
+ * auto index = file_view{URL{"file:snapshot.bon8idx"}};
+ * auto root = BON8_view{message.bytes(), index.bytes()};
+ * auto x = root["a"]["b"][1000].value();
+ * ```
+ *
+ * The view does not own the message or index, which must outlive the view.
+ */
+class BON8_view {
+public:
+    /** Create a view of the root value of a message.
+     *
+     * @param message A BON8 message.
+     * @param index The index of the message created with `make_BON8_index()`.
+     * @throw parse_error When the index does not belong to the message.
+     */
+    BON8_view(std::span<std::byte const> message, std::span<std::byte const> index);
+
+    [[nodiscard]] bool is_array() const noexcept;
+    [[nodiscard]] bool is_object() const noexcept;
+
+    /** The number of items in an array or members in an object.
+     *
+     * @throw operation_error When the value is not an array or object.
+     */
+    [[nodiscard]] size_t size() const;
+
+    /** Find a member of an object.
+     *
+     * @param key The key of the member.
+     * @return The value of the member, or empty when the object has no member with this key.
+     * @throw operation_error When the value is not an object.
+     * @throw parse_error When the index is corrupt.
+     */
+    [[nodiscard]] std::optional<BON8_view> find(std::string_view key) const;
+
+    /** Get a member of an object.
+     *
+     * @throw operation_error When the value is not an object, or does not have a member with this key.
+     * @throw parse_error When the index is corrupt.
+     */
+    [[nodiscard]] BON8_view operator[](std::string_view key) const;
+
+    /** Get an item of an array.
+     *
+     * @throw operation_error When the value is not an array, or the index is out of range.
+     * @throw parse_error When the index is corrupt.
+     */
+    [[nodiscard]] BON8_view operator[](size_t index) const;
+
+    /** Decode the value, including all nested values.
+     *
+     * @throw parse_error When the message is not valid BON8.
+     */
+    [[nodiscard]] datum value() const;
+
+private:
+    static constexpr uint32_t no_record = 0xffff'ffff;
+
+    std::span<std::byte const> _message;
+    std::span<std::byte const> _index;
+
+    /** The offset in the message of the value.
+     */
+    uint32_t _value_offset;
+
+    /** The offset in the index of the record of an array or object, or `no_record`.
+     */
+    uint32_t _record;
+
+    /** `BON8_code_array`, `BON8_code_object` or zero for other values.
+     */
+    uint8_t _kind;
+
+    BON8_view(std::span<std::byte const> message, std::span<std::byte const> index, uint32_t value_offset, uint32_t record);
+
+    [[nodiscard]] uint32_t load(size_t offset) const;
+    [[nodiscard]] BON8_view make_child(size_t offset) const;
+
+    friend bstring make_BON8_index(std::span<std::byte const> message);
+};
+
+} // namespace tt
@@ -3,292 +3,95 @@
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
 #include "JSON.hpp"
-#include "../tokenizer.hpp"
+#include "JSON_pull_parser.hpp"
+#include "JSON_writer.hpp"
 #include "../strings.hpp"
 #include "../datum.hpp"
+#include "../datum_document.hpp"
 #include "../exception.hpp"
 #include "../error_info.hpp"
-#include "../indent.hpp"
 #include <vector>
-#include <optional>
+#include <memory_resource>
 
 namespace tt {
 
-struct parse_context_t {
-    std::string_view::const_iterator text_begin;
-
-};
-
-[[nodiscard]] static parse_result<datum> parseValue(parse_context_t &context, token_iterator token);
-
-[[nodiscard]] static parse_result<datum> parseArray(parse_context_t &context, token_iterator token)
+/** Parse a JSON value.
+ *
+ * @param parser The parser.
+ * @param event The first event of the value.
+ * @param resource The memory resource to allocate strings, vectors and maps from.
+ */
+[[nodiscard]] static datum parse_JSON_value(JSON_pull_parser &parser, JSON_event event, std::pmr::memory_resource *resource)
 {
-    auto array = datum{datum::vector{}};
-
-    // Required '['
-    if ((*token == tokenizer_name_t::Operator) && (*token == "[")) {
-        token++; 
-    } else {
-        return {};
-    }
-
-    bool commaAfterValue = true;
-    while (true) {
-        // A ']' is required at end of configuration-items.
-        if ((*token == tokenizer_name_t::Operator) && (*token == "]")) {
-            token++;
-            break;
-
-        // Required a value.
-        } else if (auto result = parseValue(context, token)) {
-            if (!commaAfterValue) {
-                tt_error_info().set<"parse_location">(token->location);
-                throw parse_error("Missing expected ','");
-            }
-
-            array.push_back(*result);
-            token = result.next_token;
-
-            if ((*token == tokenizer_name_t::Operator) && (*token == ",")) {
-                token++;
-                commaAfterValue = true;
-            } else {
-                commaAfterValue = false;
-            }
-
-        } else {
-            tt_error_info().set<"parse_location">(token->location);
-            throw parse_error("Expecting a value as the next item in an array.");
+    switch (event) {
+    case JSON_event::begin_object: {
+        auto object = datum::map(resource);
+        while ((event = parser.next()) != JSON_event::end_object) {
+            tt_axiom(event == JSON_event::key);
+            // The key must be copied before the parser continues with the value.
+            auto name = datum{parser.string(), resource};
+            auto value = parse_JSON_value(parser, parser.next(), resource);
+            object.insert_or_assign(std::move(name), std::move(value));
         }
+        return datum{std::move(object)};
     }
 
-    return {std::move(array), token};
-}
-
-[[nodiscard]] static parse_result<datum> parseObject(parse_context_t &context, token_iterator token)
-{
-    auto object = datum{datum::map{}};
-
-    // Required '{'
-    if ((*token == tokenizer_name_t::Operator) && (*token == "{")) {
-        token++; 
-    } else {
-        return {};
-    }
-
-    bool commaAfterValue = true;
-    while (true) {
-        // A '}' is required at end of configuration-items.
-        if ((*token == tokenizer_name_t::Operator) && (*token == "}")) {
-            token++;
-            break;
-
-        // Required a string name.
-        } else if (*token == tokenizer_name_t::StringLiteral) {
-            if (!commaAfterValue) {
-                tt_error_info().set<"parse_location">(token->location);
-                throw parse_error("Missing expected ','");
-            }
-
-            auto name = static_cast<std::string>(*token++);
-
-            if ((*token == tokenizer_name_t::Operator) && (*token == ":")) {
-                token++;
-            } else {
-                tt_error_info().set<"parse_location">(token->location);
-                throw parse_error("Missing expected ':'");
-            }
-
-            if (auto result = parseValue(context, token)) {
-                object[name] = *result;
-                token = result.next_token;
-
-            } else {
-                tt_error_info().set<"parse_location">(token->location);
-                throw parse_error("Missing JSON value");
-            }
-
-            if ((*token == tokenizer_name_t::Operator) && (*token == ",")) {
-                token++;
-                commaAfterValue = true;
-            } else {
-                commaAfterValue = false;
-            }
-
-        } else {
-            tt_error_info().set<"parse_location">(token->location);
-            throw parse_error(fmt::format("Unexpected token {}, expected a key or close-brace.", *token));
+    case JSON_event::begin_array: {
+        auto array = datum::vector(resource);
+        while ((event = parser.next()) != JSON_event::end_array) {
+            array.push_back(parse_JSON_value(parser, event, resource));
         }
+        return datum{std::move(array)};
     }
 
-    return {std::move(object), token};
-}
-
-[[nodiscard]] static parse_result<datum> parseValue(parse_context_t &context, token_iterator token)
-{
-    switch (token->name) {
-    case tokenizer_name_t::StringLiteral: {
-        auto value = datum{static_cast<std::string>(*token++)};
-        return {std::move(value), token};
-        } break;
-    case tokenizer_name_t::IntegerLiteral: {
-        auto value = datum{static_cast<long long>(*token++)};
-        return {std::move(value), token};
-        } break;
-    case tokenizer_name_t::FloatLiteral: {
-        auto value = datum{static_cast<double>(*token++)};
-        return {std::move(value), token};
-        } break;
-    case tokenizer_name_t::Name: {
-        ttlet name = static_cast<std::string>(*token++);
-        if (name == "true") {
-            return {datum{true}, token};
-        } else if (name == "false") {
-            return {datum{false}, token};
-        } else if (name == "null") {
-            return {datum{datum::null{}}, token};
-        } else {
-            tt_error_info().set<"parse_location">(token->location);
-            throw parse_error(fmt::format("Unexpected name '{}'", name));
-        }
-        } break;
-    default:
-        if (auto result1 = parseObject(context, token)) {
-            return result1;
-        } else if (auto result2 = parseArray(context, token)) {
-            return result2;
-        } else {
-            tt_error_info().set<"parse_location">(token->location);
-            throw parse_error(fmt::format("Unexpected token '{}'", token->name));
-        }
+    case JSON_event::string: return datum{parser.string(), resource};
+    case JSON_event::integer: return datum{parser.integer()};
+    case JSON_event::floating_point: return datum{parser.floating_point()};
+    case JSON_event::boolean: return datum{parser.boolean()};
+    case JSON_event::null: return datum{datum::null{}};
+    default: tt_no_default();
     }
 }
 
-[[nodiscard]] datum parse_JSON(std::string_view text)
+[[nodiscard]] static datum parse_JSON(std::string_view text, std::pmr::memory_resource *resource)
 {
-    token_vector tokens = parseTokens(text);
+    auto parser = JSON_pull_parser{text};
 
-    datum root;
-
-    tt_axiom(tokens.back() == tokenizer_name_t::End);
-    parse_context_t context;
-    context.text_begin = text.begin();
-
-    auto token = tokens.begin();
-
-    if (auto result = parseObject(context, token)) {
-        root = std::move(*result);
-        token = result.next_token;
-
-    } else {
-        tt_error_info().set<"parse_location">(token->location);
+    ttlet event = parser.next();
+    if (event != JSON_event::begin_object) {
+        tt_error_info().set<"parse_location">(parser.location());
         throw parse_error("Missing JSON object");
     }
 
-    if (*token != tokenizer_name_t::End) {
-        tt_error_info().set<"parse_location">(token->location);
-        throw parse_error("Unexpected text after JSON root object");
-    }
+    auto root = parse_JSON_value(parser, event, resource);
 
+    // Throws a parse_error when there is text after the root object.
+    [[maybe_unused]] ttlet end_event = parser.next();
+    tt_axiom(end_event == JSON_event::end);
     return root;
 }
 
-[[nodiscard]] datum parse_JSON(URL const &url)
+[[nodiscard]] datum parse_JSON(std::string_view text)
 {
-    return parse_JSON(url.loadView()->string_view());
+    return parse_JSON(text, std::pmr::get_default_resource());
 }
 
-static void format_JSON_impl(datum const &value, std::string &result, tt::indent indent={})
+datum &parse_JSON(std::string_view text, datum_document &document)
 {
-    bool first_item = true;
-
-    switch (value.type()) {
-    case datum_type_t::Null:
-        result += "null";
-        break;
-
-    case datum_type_t::Boolean:
-        result += value ? "true" : "false";
-        break;
-
-    case datum_type_t::Integer:
-        result += tt::to_string(static_cast<long long>(value));
-        break;
-
-    case datum_type_t::Float:
-        result += tt::to_string(static_cast<double>(value));
-        break;
-
-    case datum_type_t::String:
-    case datum_type_t::URL:
-        result += '"';
-        for (ttlet c: static_cast<std::string>(value)) {
-            switch (c) {
-            case '\n': result += '\\'; result += 'n'; break;
-            case '\r': result += '\\'; result += 'r'; break;
-            case '\t': result += '\\'; result += 't'; break;
-            case '\f': result += '\\'; result += 'f'; break;
-            case '"': result += '\\'; result += '"'; break;
-            default: result += c;
-            }
-        }
-        result += '"';
-        break;
-
-    case datum_type_t::Vector:
-        result += indent;
-        result += '[';
-        result += '\n';
-
-        for (auto i = value.vector_begin(); i != value.vector_end(); i++, first_item = true) {
-            if (!first_item) {
-                result += ',';
-                result += '\n';
-            }
-            result += indent + 1;
-
-            format_JSON_impl(*i, result, indent + 1);
-        }
-
-        result += '\n';
-        result += indent;
-        result += ']';
-        break;
-
-    case datum_type_t::Map:
-        result += indent;
-        result += '{';
-        result += '\n';
-
-        for (auto i = value.map_begin(); i != value.map_end(); i++, first_item = true) {
-            if (!first_item) {
-                result += ',';
-                result += '\n';
-            }
-            result += indent + 1;
-
-            format_JSON_impl(i->first, result, indent + 1);
-            result += ':';
-            result += ' ';
-            format_JSON_impl(i->second, result, indent + 1);
-        }
-
-        result += '\n';
-        result += indent;
-        result += '}';
-        break;
+    document.root() = parse_JSON(text, document.resource());
+    return document.root();
+}
 
-    default:
-        tt_no_default();
-    }
+[[nodiscard]] datum parse_JSON(URL const &url)
+{
+    return parse_JSON(url.loadView()->string_view());
 }
 
-[[nodiscard]] std::string format_JSON(datum const &root)
+[[nodiscard]] std::string format_JSON(datum const &root, JSON_style style)
 {
-    auto r = std::string{};
-    format_JSON_impl(root, r);
-    r += '\n';
-    return r;
+    auto writer = JSON_writer{style};
+    writer.value(root);
+    return std::string{writer.str()};
 }
 
 
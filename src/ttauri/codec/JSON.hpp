@@ -4,10 +4,12 @@
 
 #pragma once
 
+#include "JSON_writer.hpp"
 #include "../tokenizer.hpp"
 #include "../required.hpp"
 #include "../URL.hpp"
 #include "../datum.hpp"
+#include "../datum_document.hpp"
 #include <string>
 #include <optional>
 #include <string_view>
@@ -20,6 +22,15 @@ namespace tt {
  */
 [[nodiscard]] datum parse_JSON(std::string_view text);
 
+/** Parse a JSON string into a document.
+ * The strings, vectors and maps of the parsed object are allocated from the arena of the document.
+ *
+ * @param text The text to parse.
+ * @param document The document which will hold the parsed object as its root.
+ * @return The root of the document.
+ */
+datum &parse_JSON(std::string_view text, datum_document &document);
+
 /** Parse a JSON string.
  * @param file URL pointing to the file to parse.
  * @return A datum representing the parsed object.
@@ -27,9 +38,12 @@ namespace tt {
 [[nodiscard]] datum parse_JSON(tt::URL const &file);
 
 /** Dump an datum object into a JSON string.
+ * To write large documents directly to a file use `JSON_writer`.
+ *
  * @param root datum-object to serialize
+ * @param style The layout of the text.
  * @return The JSON serialized object as a string
  */
-[[nodiscard]] std::string format_JSON(datum const &root);
+[[nodiscard]] std::string format_JSON(datum const &root, JSON_style style = JSON_style::indented);
 
 }
@@ -0,0 +1,451 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "JSON_pull_parser.hpp"
+#include "UTF.hpp"
+#include "../structural_scanner.hpp"
+#include "../exception.hpp"
+#include "../error_info.hpp"
+#include <charconv>
+#include <iterator>
+#include <array>
+#include <cstring>
+
+namespace tt {
+
+JSON_pull_parser::JSON_pull_parser(std::string_view text) noexcept :
+    _first(text.data()), _last(text.data() + text.size()), _ptr(text.data()), _event_start(text.data())
+{
+    // Most documents are not nested very deeply.
+    _stack.reserve(16);
+}
+
+[[nodiscard]] parse_location JSON_pull_parser::location(char const *ptr) const noexcept
+{
+    auto r = parse_location{1, 1};
+    for (auto it = _first; it != ptr; ++it) {
+        r += *it;
+    }
+    return r;
+}
+
+[[noreturn]] void JSON_pull_parser::throw_error(char const *ptr, char const *message) const
+{
+    tt_error_info().set<"parse_location">(location(ptr));
+    throw parse_error(message);
+}
+
+void JSON_pull_parser::skip_whitespace()
+{
+    while (true) {
+        _ptr = tt::skip_whitespace(_ptr, _last);
+        if (_ptr == _last) {
+            return;
+        }
+
+        switch (*_ptr) {
+        case '#':
+            while (_ptr != _last && *_ptr != '\n') {
+                ++_ptr;
+            }
+            break;
+
+        case '/':
+            if (_ptr + 1 != _last && _ptr[1] == '/') {
+                while (_ptr != _last && *_ptr != '\n') {
+                    ++_ptr;
+                }
+
+            } else if (_ptr + 1 != _last && _ptr[1] == '*') {
+                ttlet start = _ptr;
+                _ptr += 2;
+                while (true) {
+                    if (_ptr == _last || _ptr + 1 == _last) {
+                        throw_error(start, "Unexpected end of text in block comment.");
+                    } else if (_ptr[0] == '*' && _ptr[1] == '/') {
+                        _ptr += 2;
+                        break;
+                    } else {
+                        ++_ptr;
+                    }
+                }
+
+            } else {
+                return;
+            }
+            break;
+
+        default: return;
+        }
+    }
+}
+
+[[nodiscard]] char32_t JSON_pull_parser::parse_unicode_escape(char const *&ptr) const
+{
+    // ptr points after the "\u".
+    if (_last - ptr < 4) {
+        throw_error(ptr, "Unexpected end of text in unicode escape sequence.");
+    }
+
+    auto r = char32_t{0};
+    for (int i = 0; i != 4; ++i) {
+        ttlet c = *ptr++;
+        r <<= 4;
+        if (c >= '0' && c <= '9') {
+            r |= static_cast<char32_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            r |= static_cast<char32_t>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            r |= static_cast<char32_t>(c - 'A' + 10);
+        } else {
+            throw_error(ptr - 1, "Expecting a hexadecimal digit in unicode escape sequence.");
+        }
+    }
+    return r;
+}
+
+void JSON_pull_parser::parse_escaped_string(char const *ptr)
+{
+    // _ptr points to the first character of the string, ptr to the first escape sequence.
+    _buffer.assign(_ptr, ptr);
+
+    while (true) {
+        // Copy the run of plain characters up to the next escape sequence in one go.
+        ttlet plain_last = find_string_special(ptr, _last);
+        _buffer.append(ptr, plain_last);
+        ptr = plain_last;
+
+        if (ptr == _last) {
+            throw_error(_event_start, "Unexpected end of text in string.");
+        }
+
+        ttlet c = *ptr++;
+        if (c == '"') {
+            break;
+
+        } else if (c == '\n') {
+            throw_error(ptr - 1, "Unexpected line-feed in string.");
+
+        } else if (c != '\\') {
+            _buffer += c;
+
+        } else if (ptr == _last) {
+            throw_error(_event_start, "Unexpected end of text in string.");
+
+        } else {
+            switch (ttlet escape = *ptr++) {
+            case 'a': _buffer += '\a'; break;
+            case 'b': _buffer += '\b'; break;
+            case 'f': _buffer += '\f'; break;
+            case 'n': _buffer += '\n'; break;
+            case 'r': _buffer += '\r'; break;
+            case 't': _buffer += '\t'; break;
+            case 'v': _buffer += '\v'; break;
+            case 'u': {
+                auto code_point = parse_unicode_escape(ptr);
+                if (code_point >= 0xd800 && code_point <= 0xdbff) {
+                    // A high surrogate must be followed by an escaped low surrogate.
+                    auto low_ptr = ptr;
+                    if (_last - ptr >= 2 && ptr[0] == '\\' && ptr[1] == 'u') {
+                        low_ptr += 2;
+                        ttlet low_surrogate = parse_unicode_escape(low_ptr);
+                        if (low_surrogate >= 0xdc00 && low_surrogate <= 0xdfff) {
+                            code_point = ((code_point - 0xd800) << 10 | (low_surrogate - 0xdc00)) + 0x1'0000;
+                            ptr = low_ptr;
+                        }
+                    }
+                }
+                if (code_point >= 0xd800 && code_point <= 0xdfff) {
+                    // Unpaired surrogate.
+                    code_point = 0xfffd;
+                }
+
+                auto it = std::back_inserter(_buffer);
+                utf32_to_utf8(code_point, it);
+            } break;
+
+            // Any other escaped character, including '"', '\\' and '/' is copied literally.
+            default: _buffer += escape;
+            }
+        }
+    }
+
+    _string = _buffer;
+    _ptr = ptr;
+}
+
+void JSON_pull_parser::parse_string()
+{
+    // Skip over the open quote.
+    ++_ptr;
+
+    for (auto ptr = find_string_special(_ptr, _last); ptr != _last; ptr = find_string_special(ptr + 1, _last)) {
+        ttlet c = *ptr;
+        if (c == '"') {
+            // Fast path, a string without escape sequences is a view into the text.
+            _string = std::string_view{_ptr, narrow_cast<size_t>(ptr - _ptr)};
+            _ptr = ptr + 1;
+            return;
+
+        } else if (c == '\\') {
+            return parse_escaped_string(ptr);
+
+        } else if (c == '\n') {
+            throw_error(ptr, "Unexpected line-feed in string.");
+        }
+    }
+    throw_error(_event_start, "Unexpected end of text in string.");
+}
+
+[[nodiscard]] JSON_event JSON_pull_parser::parse_number()
+{
+    auto first = _ptr;
+    if (*first == '+') {
+        // std::from_chars() does not accept a plus sign.
+        ++first;
+    }
+
+    auto is_float = false;
+    auto ptr = first;
+    if (ptr != _last && *ptr == '-') {
+        ++ptr;
+    }
+    for (; ptr != _last; ++ptr) {
+        ttlet c = *ptr;
+        if (c >= '0' && c <= '9') {
+            continue;
+        } else if (c == '.' || c == 'e' || c == 'E') {
+            is_float = true;
+        } else if ((c == '-' || c == '+') && (ptr[-1] == 'e' || ptr[-1] == 'E')) {
+            continue;
+        } else {
+            break;
+        }
+    }
+
+    if (is_float) {
+        ttlet[last, ec] = std::from_chars(first, ptr, _floating_point);
+        if (ec != std::errc{} || last != ptr) {
+            throw_error(_ptr, "Invalid floating point number.");
+        }
+        _ptr = ptr;
+        return JSON_event::floating_point;
+
+    } else {
+        ttlet[last, ec] = std::from_chars(first, ptr, _integer);
+        if (ec != std::errc{} || last != ptr) {
+            throw_error(_ptr, "Invalid integer number.");
+        }
+        _ptr = ptr;
+        return JSON_event::integer;
+    }
+}
+
+[[nodiscard]] JSON_event JSON_pull_parser::parse_name()
+{
+    auto ptr = _ptr;
+    while (ptr != _last &&
+           ((*ptr >= 'a' && *ptr <= 'z') || (*ptr >= 'A' && *ptr <= 'Z') || (*ptr >= '0' && *ptr <= '9') || *ptr == '_' ||
+            *ptr == '-')) {
+        ++ptr;
+    }
+
+    ttlet name = std::string_view{_ptr, narrow_cast<size_t>(ptr - _ptr)};
+    if (name == "true") {
+        _integer = 1;
+        _ptr = ptr;
+        return JSON_event::boolean;
+    } else if (name == "false") {
+        _integer = 0;
+        _ptr = ptr;
+        return JSON_event::boolean;
+    } else if (name == "null") {
+        _ptr = ptr;
+        return JSON_event::null;
+    } else {
+        throw_error(_ptr, "Unexpected name, expecting true, false or null.");
+    }
+}
+
+[[nodiscard]] JSON_event JSON_pull_parser::parse_value()
+{
+    if (_ptr == _last) {
+        throw_error(_ptr, "Unexpected end of text, expecting a value.");
+    }
+
+    auto r = JSON_event::end;
+    switch (*_ptr) {
+    case '{':
+        ++_ptr;
+        _stack.push_back('{');
+        _state = state_type::key_or_close;
+        return JSON_event::begin_object;
+
+    case '[':
+        ++_ptr;
+        _stack.push_back('[');
+        _state = state_type::value_or_close;
+        return JSON_event::begin_array;
+
+    case '"':
+        parse_string();
+        r = JSON_event::string;
+        break;
+
+    case '-':
+    case '+':
+    case '.':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9': r = parse_number(); break;
+
+    default:
+        if ((*_ptr >= 'a' && *_ptr <= 'z') || (*_ptr >= 'A' && *_ptr <= 'Z')) {
+            r = parse_name();
+        } else {
+            throw_error(_ptr, "Unexpected character, expecting a value.");
+        }
+    }
+
+    _state = _stack.empty() ? state_type::end : state_type::comma_or_close;
+    return r;
+}
+
+[[nodiscard]] JSON_event JSON_pull_parser::parse_close(char c) noexcept
+{
+    tt_axiom(!_stack.empty());
+
+    ++_ptr;
+    _stack.pop_back();
+    _state = _stack.empty() ? state_type::end : state_type::comma_or_close;
+    return c == '}' ? JSON_event::end_object : JSON_event::end_array;
+}
+
+[[nodiscard]] JSON_event JSON_pull_parser::next()
+{
+    skip_whitespace();
+    _event_start = _ptr;
+
+    ttlet c = _ptr != _last ? *_ptr : '\0';
+    switch (_state) {
+    case state_type::root: return parse_value();
+
+    case state_type::value_or_close:
+        if (c == ']') {
+            return parse_close(c);
+        } else {
+            return parse_value();
+        }
+
+    case state_type::key_or_close:
+        if (c == '}') {
+            return parse_close(c);
+        } else if (c == '"') {
+            parse_string();
+            _state = state_type::colon;
+            return JSON_event::key;
+        } else {
+            throw_error(_ptr, "Unexpected character, expecting a key or close-brace.");
+        }
+
+    case state_type::colon:
+        if (c != ':') {
+            throw_error(_ptr, "Missing expected ':'.");
+        }
+        ++_ptr;
+        skip_whitespace();
+        _event_start = _ptr;
+        return parse_value();
+
+    case state_type::comma_or_close:
+        if (c == ',') {
+            ++_ptr;
+            _state = _stack.back() == '{' ? state_type::key_or_close : state_type::value_or_close;
+            return next();
+        } else if (c == _stack.back() + 2) {
+            // The close-bracket ']' and close-brace '}' follow their open character with an offset of 2.
+            return parse_close(c);
+        } else if (c == ']' || c == '}') {
+            throw_error(_ptr, "Mismatched close-bracket or close-brace.");
+        } else {
+            throw_error(_ptr, "Missing expected ','.");
+        }
+
+    case state_type::end:
+        if (_ptr != _last) {
+            throw_error(_ptr, "Unexpected text after JSON root value.");
+        }
+        return JSON_event::end;
+
+    default: tt_no_default();
+    }
+}
+
+[[nodiscard]] char const *JSON_pull_parser::find_close(char const *ptr) const noexcept
+{
+    auto depth = 1;
+    auto escape_carry = uint64_t{0};
+    auto in_string = uint64_t{0};
+
+    // The last partial block is padded with spaces.
+    auto padded = std::array<char, 64>{};
+
+    while (ptr < _last) {
+        auto block_ptr = ptr;
+        if (_last - ptr < 64) {
+            padded.fill(' ');
+            std::memcpy(padded.data(), ptr, narrow_cast<size_t>(_last - ptr));
+            block_ptr = padded.data();
+        }
+
+        ttlet block = classify_structural_block(block_ptr);
+        ttlet escaped = escaped_characters(block.backslash, escape_carry);
+        ttlet strings = string_mask(block.quote & ~escaped, in_string);
+
+        if (block.comment & ~strings) {
+            // Comments may contain quotes and brackets, let the scalar parser handle them.
+            return nullptr;
+        }
+
+        for (auto structural = block.structural & ~strings; structural != 0; structural &= structural - 1) {
+            ttlet i = std::countr_zero(structural);
+            ttlet c = block_ptr[i];
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return ptr + i;
+            }
+        }
+
+        ptr += 64;
+    }
+    return nullptr;
+}
+
+void JSON_pull_parser::skip()
+{
+    tt_axiom(!_stack.empty());
+
+    if (ttlet close = find_close(_ptr)) {
+        _event_start = close;
+        _ptr = close + 1;
+        _stack.pop_back();
+        _state = _stack.empty() ? state_type::end : state_type::comma_or_close;
+        return;
+    }
+
+    ttlet depth = std::ssize(_stack);
+    while (std::ssize(_stack) >= depth) {
+        std::ignore = next();
+    }
+}
+
+} // namespace tt
@@ -0,0 +1,202 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../parse_location.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace tt {
+
+/** An event produced by the JSON pull parser.
+ */
+enum class JSON_event : uint8_t {
+    /** The complete JSON value has been parsed.
+     */
+    end,
+    begin_object,
+    end_object,
+    begin_array,
+    end_array,
+
+    /** The name of a member of an object, the next event is the value of the member.
+     */
+    key,
+    string,
+    integer,
+    floating_point,
+    boolean,
+    null
+};
+
+/** A pull parser for JSON text.
+ *
+ * Each call to `next()` parses the text up to the next event, there is no intermediate list
+ * of tokens. Strings without escape sequences are returned as a view into the text; strings with escape
+ * sequences are unescaped into a buffer which is reused for the next string.
+ *
+ * Whitespace and the plain characters of strings are skipped in bulk with the `structural_scanner.hpp`
+ * functions. The parser does not build an index of token starts up front; the time is spent producing
+ * the events, and such an index would need a second pass over the text and memory proportional to the
+ * number of tokens, and it would have to understand comments.
+ *
+ * The parser accepts the same extensions as the original token based JSON parser:
+ *  - Comments starting with `//` or `#` until the end of the line, and C-style block comments.
+ *  - A trailing comma after the last item in an array or object.
+ *  - A leading `+` sign on numbers.
+ */
+class JSON_pull_parser {
+public:
+    /** Create a parser.
+     *
+     * @param text The JSON text, which must outlive the parser and the string views returned by `string()`.
+     */
+    explicit JSON_pull_parser(std::string_view text) noexcept;
+
+    JSON_pull_parser(JSON_pull_parser const &) = delete;
+    JSON_pull_parser(JSON_pull_parser &&) = delete;
+    JSON_pull_parser &operator=(JSON_pull_parser const &) = delete;
+    JSON_pull_parser &operator=(JSON_pull_parser &&) = delete;
+
+    /** Parse the next event.
+     *
+     * After `JSON_event::end` is returned, every call returns `JSON_event::end`.
+     *
+     * @return The event that was parsed.
+     * @throw parse_error When the text is not valid JSON; the location is set in the error_info.
+     */
+    [[nodiscard]] JSON_event next();
+
+    /** Skip over the rest of an array or object.
+     *
+     * Must be called directly after a `JSON_event::begin_object` or `JSON_event::begin_array` event,
+     * after the call the parser is positioned after the matching end event.
+     *
+     * The matching end is found by classifying 64 bytes at a time; the skipped text is only checked
+     * for balanced brackets outside of strings. When the skipped text contains a comment the
+     * text is parsed and validated event by event instead.
+     *
+     * @throw parse_error When the text is not valid JSON.
+     */
+    void skip();
+
+    /** The string of the current `JSON_event::key` or `JSON_event::string` event.
+     * The view is valid until the next call to `next()`.
+     */
+    [[nodiscard]] std::string_view string() const noexcept
+    {
+        return _string;
+    }
+
+    /** The value of the current `JSON_event::integer` event.
+     */
+    [[nodiscard]] long long integer() const noexcept
+    {
+        return _integer;
+    }
+
+    /** The value of the current `JSON_event::floating_point` event.
+     */
+    [[nodiscard]] double floating_point() const noexcept
+    {
+        return _floating_point;
+    }
+
+    /** The value of the current `JSON_event::boolean` event.
+     */
+    [[nodiscard]] bool boolean() const noexcept
+    {
+        return _integer != 0;
+    }
+
+    /** The number of arrays and objects the parser is inside of.
+     */
+    [[nodiscard]] ssize_t depth() const noexcept
+    {
+        return std::ssize(_stack);
+    }
+
+    /** The location in the text of the start of the current event.
+     * The line and column are calculated on each call.
+     */
+    [[nodiscard]] parse_location location() const noexcept
+    {
+        return location(_event_start);
+    }
+
+private:
+    enum class state_type : uint8_t {
+        /** Expecting the root value.
+         */
+        root,
+
+        /** Expecting a value or the end of the array.
+         */
+        value_or_close,
+
+        /** Expecting a key or the end of the object.
+         */
+        key_or_close,
+
+        /** Expecting a colon followed by a value.
+         */
+        colon,
+
+        /** Expecting a comma or the end of the array or object.
+         */
+        comma_or_close,
+
+        /** Expecting the end of the text.
+         */
+        end
+    };
+
+    char const *_first;
+    char const *_last;
+    char const *_ptr;
+
+    /** The start of the current event.
+     */
+    char const *_event_start;
+
+    state_type _state = state_type::root;
+
+    /** The open arrays and objects, '[' or '{'.
+     */
+    std::vector<char> _stack;
+
+    std::string_view _string;
+    long long _integer = 0;
+    double _floating_point = 0.0;
+
+    /** The buffer for strings with escape sequences.
+     */
+    std::string _buffer;
+
+    [[nodiscard]] parse_location location(char const *ptr) const noexcept;
+    [[noreturn]] void throw_error(char const *ptr, char const *message) const;
+
+    void skip_whitespace();
+    [[nodiscard]] JSON_event parse_value();
+    [[nodiscard]] JSON_event parse_close(char c) noexcept;
+    void parse_string();
+    void parse_escaped_string(char const *ptr);
+    [[nodiscard]] char32_t parse_unicode_escape(char const *&ptr) const;
+    [[nodiscard]] JSON_event parse_number();
+    [[nodiscard]] JSON_event parse_name();
+
+    /** Find the close-bracket or close-brace that matches an open-bracket or open-brace.
+     *
+     * @param ptr A pointer just after the open-bracket or open-brace.
+     * @return A pointer to the matching close-bracket or close-brace, or nullptr when a comment
+     *         is found or the text ends first.
+     */
+    [[nodiscard]] char const *find_close(char const *ptr) const noexcept;
+};
+
+} // namespace tt
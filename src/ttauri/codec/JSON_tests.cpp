@@ -3,13 +3,36 @@
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
 #include "ttauri/codec/JSON.hpp"
+#include "ttauri/codec/JSON_pull_parser.hpp"
+#include "ttauri/codec/JSON_writer.hpp"
+#include "ttauri/tokenizer.hpp"
 #include "ttauri/required.hpp"
+#include "ttauri/error_info.hpp"
+#include "ttauri/parse_location.hpp"
 #include <gtest/gtest.h>
 #include <iostream>
 
 using namespace std;
 using namespace tt;
 
+/** Get the location of a parse error.
+ * This closes the error_info transaction of the parse_error.
+ *
+ * @param f A function which throws a parse_error.
+ * @return The line and column of the error, or {0, 0} when there was no parse_error with a location.
+ */
+template<typename F>
+static std::pair<int, int> parse_error_location(F const &f)
+{
+    try {
+        f();
+    } catch (parse_error const &) {
+        if (ttlet location = error_info::pop<parse_location, "parse_location">()) {
+            return location->line_and_column();
+        }
+    }
+    return {0, 0};
+}
 
 TEST(JSON, ParseEmpty) {
     ASSERT_EQ(parse_JSON("{}"), datum::map{});
@@ -92,4 +115,249 @@ TEST(JSON, ParseTwoItemObject) {
     expected["foo"]["baz"] = 43;
     ASSERT_EQ(parse_JSON("{\"foo\": {\"bar\": 42, \"baz\": 43}}"), expected);
     ASSERT_EQ(parse_JSON("{\"foo\": {\"bar\": 42, \"baz\": 43,}}"), expected);
-}
\ No newline at end of file
+}
+TEST(JSON, ParseEscapes) {
+    auto expected = datum::map{};
+    expected["foo"] = "a\"b\\c/d\n\t";
+    ASSERT_EQ(parse_JSON("{\"foo\": \"a\\\"b\\\\c\\/d\\n\\t\"}"), expected);
+
+    expected["foo"] = "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+    ASSERT_EQ(parse_JSON("{\"foo\": \"\\u00e9\\u20AC\\ud83d\\ude00\"}"), expected);
+
+    // Unpaired surrogates are replaced by U+FFFD.
+    expected["foo"] = "\xef\xbf\xbd" "a\xef\xbf\xbd";
+    ASSERT_EQ(parse_JSON("{\"foo\": \"\\ud83da\\ude00\"}"), expected);
+}
+
+TEST(JSON, ParseComments) {
+    auto expected = datum::map{};
+    expected["foo"] = 42;
+    expected["bar"] = datum::vector{1, 2};
+    ASSERT_EQ(parse_JSON(
+        "// comment\n"
+        "{\n"
+        "    # comment\n"
+        "    \"foo\": /* comment */ 42,\n"
+        "    \"bar\": [1, 2], // comment\n"
+        "}\n"), expected);
+}
+
+TEST(JSON, ParseErrors) {
+    ASSERT_EQ(parse_error_location([] { return parse_JSON(""); }), std::pair(1, 1));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("[]"); }), std::pair(1, 1));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": 42 \"bar\": 43}"); }), std::pair(1, 12));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\" 42}"); }), std::pair(1, 8));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": \"bar}"); }), std::pair(1, 9));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": \"b\nar\"}"); }), std::pair(1, 11));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": [42}"); }), std::pair(1, 12));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": foo}"); }), std::pair(1, 9));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": 42"); }), std::pair(1, 11));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": 42} 43"); }), std::pair(1, 13));
+    ASSERT_EQ(parse_error_location([] { return parse_JSON("{\"foo\": 42} /* comment"); }), std::pair(1, 13));
+}
+
+TEST(JSONPullParser, Events) {
+    auto parser = JSON_pull_parser{"{\"foo\": [1, 2.5, \"bar\", true, null], \"baz\": {}}"};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_object);
+    ASSERT_EQ(parser.next(), JSON_event::key);
+    ASSERT_EQ(parser.string(), "foo");
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    ASSERT_EQ(parser.depth(), 2);
+    ASSERT_EQ(parser.next(), JSON_event::integer);
+    ASSERT_EQ(parser.integer(), 1);
+    ASSERT_EQ(parser.next(), JSON_event::floating_point);
+    ASSERT_EQ(parser.floating_point(), 2.5);
+    ASSERT_EQ(parser.next(), JSON_event::string);
+    ASSERT_EQ(parser.string(), "bar");
+    ASSERT_EQ(parser.next(), JSON_event::boolean);
+    ASSERT_EQ(parser.boolean(), true);
+    ASSERT_EQ(parser.next(), JSON_event::null);
+    ASSERT_EQ(parser.next(), JSON_event::end_array);
+    ASSERT_EQ(parser.next(), JSON_event::key);
+    ASSERT_EQ(parser.string(), "baz");
+    ASSERT_EQ(parser.next(), JSON_event::begin_object);
+    ASSERT_EQ(parser.next(), JSON_event::end_object);
+    ASSERT_EQ(parser.next(), JSON_event::end_object);
+    ASSERT_EQ(parser.depth(), 0);
+    ASSERT_EQ(parser.next(), JSON_event::end);
+    ASSERT_EQ(parser.next(), JSON_event::end);
+}
+
+TEST(JSONPullParser, ZeroCopy) {
+    ttlet text = std::string_view{"[\"foo\", \"b\\nar\"]"};
+    auto parser = JSON_pull_parser{text};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+
+    // A string without escape sequences points into the text.
+    ASSERT_EQ(parser.next(), JSON_event::string);
+    ASSERT_EQ(parser.string(), "foo");
+    ASSERT_EQ(parser.string().data(), text.data() + 2);
+
+    ASSERT_EQ(parser.next(), JSON_event::string);
+    ASSERT_EQ(parser.string(), "b\nar");
+}
+
+TEST(JSONPullParser, Skip) {
+    auto parser = JSON_pull_parser{"{\"foo\": {\"a\": [1, {\"b\": 2}], \"c\": 3}, \"bar\": 4}"};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_object);
+    ASSERT_EQ(parser.next(), JSON_event::key);
+    ASSERT_EQ(parser.next(), JSON_event::begin_object);
+    parser.skip();
+    ASSERT_EQ(parser.next(), JSON_event::key);
+    ASSERT_EQ(parser.string(), "bar");
+    ASSERT_EQ(parser.next(), JSON_event::integer);
+    ASSERT_EQ(parser.integer(), 4);
+    ASSERT_EQ(parser.next(), JSON_event::end_object);
+}
+
+TEST(JSONPullParser, SkipStrings) {
+    // Brackets inside strings, escaped quotes and a text longer than a single 64 byte block.
+    ttlet text = "[[\"]\", \"\\\"]\", \"\\\\\", {\"a\": \"}}}\"}, \"" + std::string(100, 'x') + "\"], 42]";
+    auto parser = JSON_pull_parser{text};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    parser.skip();
+    ASSERT_EQ(parser.depth(), 1);
+    ASSERT_EQ(parser.next(), JSON_event::integer);
+    ASSERT_EQ(parser.integer(), 42);
+    ASSERT_EQ(parser.next(), JSON_event::end_array);
+    ASSERT_EQ(parser.next(), JSON_event::end);
+}
+
+TEST(JSONPullParser, SkipComments) {
+    auto parser = JSON_pull_parser{"[[1, # ]\n 2 /* ] */], 3]"};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    parser.skip();
+    ASSERT_EQ(parser.next(), JSON_event::integer);
+    ASSERT_EQ(parser.integer(), 3);
+    ASSERT_EQ(parser.next(), JSON_event::end_array);
+}
+
+TEST(JSONPullParser, LongStrings) {
+    ttlet long_string = std::string(100, 'a');
+    ttlet text = "[\"" + long_string + "\", \"" + long_string + "\\n" + long_string + "\"]";
+    auto parser = JSON_pull_parser{text};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_array);
+    ASSERT_EQ(parser.next(), JSON_event::string);
+    ASSERT_EQ(parser.string(), long_string);
+    ASSERT_EQ(parser.next(), JSON_event::string);
+    ASSERT_EQ(parser.string(), long_string + "\n" + long_string);
+    ASSERT_EQ(parser.next(), JSON_event::end_array);
+}
+
+TEST(JSONPullParser, Location) {
+    auto parser = JSON_pull_parser{"{\n    \"foo\": 42\n    \"bar\": 43\n}"};
+
+    ASSERT_EQ(parser.next(), JSON_event::begin_object);
+    ASSERT_EQ(parser.next(), JSON_event::key);
+    ASSERT_EQ(parser.next(), JSON_event::integer);
+    ASSERT_EQ(parser.location().line_and_column(), std::pair(2, 12));
+    ASSERT_EQ(parse_error_location([&] { return parser.next(); }), std::pair(3, 5));
+    ASSERT_EQ(parser.location().line_and_column(), std::pair(3, 5));
+}
+
+TEST(JSONWriter, Compact) {
+    auto writer = JSON_writer{JSON_style::compact};
+    writer.begin_object();
+    writer.key("foo");
+    writer.begin_array();
+    writer.integer(1);
+    writer.floating_point(2.5);
+    writer.string("bar");
+    writer.boolean(true);
+    writer.null();
+    writer.end_array();
+    writer.key("baz");
+    writer.begin_object();
+    writer.end_object();
+    writer.end_object();
+
+    ASSERT_EQ(writer.str(), "{\"foo\":[1,2.5,\"bar\",true,null],\"baz\":{}}");
+}
+
+TEST(JSONWriter, Indented) {
+    auto writer = JSON_writer{};
+    writer.begin_object();
+    writer.key("foo");
+    writer.begin_array();
+    writer.integer(1);
+    writer.integer(2);
+    writer.end_array();
+    writer.key("bar");
+    writer.begin_array();
+    writer.end_array();
+    writer.end_object();
+
+    ASSERT_EQ(writer.str(), "{\n    \"foo\": [\n        1,\n        2\n    ],\n    \"bar\": []\n}\n");
+}
+
+TEST(JSONWriter, Escapes) {
+    auto writer = JSON_writer{JSON_style::compact};
+    writer.string("a\"b\\c\nd\te\x01" "f/g" + std::string(40, 'h') + "\"");
+
+    ASSERT_EQ(writer.str(), "\"a\\\"b\\\\c\\nd\\te\\u0001f/g" + std::string(40, 'h') + "\\\"\"");
+}
+
+TEST(JSONWriter, FloatingPoint) {
+    auto writer = JSON_writer{JSON_style::compact};
+    writer.begin_array();
+    writer.floating_point(0.1);
+    writer.floating_point(1.0);
+    writer.floating_point(-1e100);
+    writer.floating_point(std::numeric_limits<double>::infinity());
+    writer.end_array();
+
+    ASSERT_EQ(writer.str(), "[0.1,1.0,-1e+100,null]");
+}
+
+TEST(JSONWriter, Sink) {
+    auto text = std::string{};
+    auto flush_count = 0;
+    auto writer = JSON_writer{
+        [&](std::string_view chunk) {
+            text += chunk;
+            ++flush_count;
+        },
+        JSON_style::compact,
+        16};
+
+    writer.begin_array();
+    for (int i = 0; i != 100; ++i) {
+        writer.integer(i);
+    }
+    writer.end_array();
+    writer.flush();
+
+    ASSERT_GT(flush_count, 10);
+    ASSERT_EQ(text.size(), 291);
+    ASSERT_EQ(parse_JSON("{\"a\": " + text + "}")["a"].size(), 100);
+}
+
+TEST(JSONWriter, RoundTrip) {
+    ttlet text = std::string{"{\"foo\": [1, 2.5, \"a long string with \\\"escapes\\\"\", true, null], \"bar\": {\"baz\": \"\"}}"};
+    ttlet root = parse_JSON(text);
+
+    ASSERT_EQ(parse_JSON(format_JSON(root)), root);
+    ASSERT_EQ(parse_JSON(format_JSON(root, JSON_style::compact)), root);
+}
+
+TEST(JSON, ParseDocument) {
+    ttlet text = std::string{"{\"a long key\": [1, 2.5, \"a long string value\", true, null], \"bar\": {\"baz\": \"\"}}"};
+
+    auto document = datum_document{};
+    ttlet &root = parse_JSON(text, document);
+    ASSERT_EQ(root, parse_JSON(text));
+    ASSERT_EQ(&root, &document.root());
+
+    // The copy must remain valid after the document is destroyed.
+    auto copy = root;
+    document = datum_document{};
+    ASSERT_EQ(copy, parse_JSON(text));
+}
@@ -0,0 +1,258 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "JSON_writer.hpp"
+#include "../structural_scanner.hpp"
+#include "../file.hpp"
+#include "../exception.hpp"
+#include <charconv>
+#include <array>
+#include <cmath>
+
+namespace tt {
+
+JSON_writer::JSON_writer(JSON_style style) noexcept : _sink(), _flush_threshold(0), _style(style) {}
+
+JSON_writer::JSON_writer(sink_type sink, JSON_style style, size_t flush_threshold) noexcept :
+    _sink(std::move(sink)), _flush_threshold(flush_threshold), _style(style)
+{
+    // Leave room for the value that crosses the threshold.
+    _buffer.reserve(flush_threshold + flush_threshold / 4);
+}
+
+JSON_writer::JSON_writer(file &file, JSON_style style) noexcept :
+    JSON_writer(
+        [&file](std::string_view text) {
+            file.write(text);
+        },
+        style)
+{
+}
+
+void JSON_writer::write_newline()
+{
+    if (_style == JSON_style::indented) {
+        _buffer += '\n';
+        _buffer.append(_first_item.size() * 4, ' ');
+    }
+}
+
+void JSON_writer::begin_value()
+{
+    if (_after_key) {
+        _after_key = false;
+
+    } else if (!_first_item.empty()) {
+        if (!_first_item.back()) {
+            _buffer += ',';
+        }
+        _first_item.back() = false;
+        write_newline();
+    }
+}
+
+void JSON_writer::end_value()
+{
+    if (_first_item.empty() && _style == JSON_style::indented) {
+        // End the text with a line-feed after the root value.
+        _buffer += '\n';
+    }
+
+    if (_sink && _buffer.size() >= _flush_threshold) {
+        flush();
+    }
+}
+
+void JSON_writer::begin_container(char c)
+{
+    begin_value();
+    _buffer += c;
+    _first_item.push_back(true);
+}
+
+void JSON_writer::end_container(char c)
+{
+    tt_axiom(!_first_item.empty());
+    tt_axiom(!_after_key);
+
+    ttlet empty = _first_item.back();
+    _first_item.pop_back();
+    if (!empty) {
+        write_newline();
+    }
+    _buffer += c;
+    end_value();
+}
+
+void JSON_writer::begin_object()
+{
+    begin_container('{');
+}
+
+void JSON_writer::end_object()
+{
+    end_container('}');
+}
+
+void JSON_writer::begin_array()
+{
+    begin_container('[');
+}
+
+void JSON_writer::end_array()
+{
+    end_container(']');
+}
+
+void JSON_writer::write_string(std::string_view text)
+{
+    constexpr auto hex_digits = std::string_view{"0123456789abcdef"};
+
+    _buffer += '"';
+
+    auto first = text.data();
+    ttlet last = first + text.size();
+    while (true) {
+        // Copy the run of characters that do not need escaping in one go.
+        ttlet special = find_string_special(first, last);
+        _buffer.append(first, special);
+        if (special == last) {
+            break;
+        }
+
+        switch (ttlet c = *special) {
+        case '"': _buffer += "\\\""; break;
+        case '\\': _buffer += "\\\\"; break;
+        case '\b': _buffer += "\\b"; break;
+        case '\f': _buffer += "\\f"; break;
+        case '\n': _buffer += "\\n"; break;
+        case '\r': _buffer += "\\r"; break;
+        case '\t': _buffer += "\\t"; break;
+        default:
+            _buffer += "\\u00";
+            _buffer += hex_digits[(c >> 4) & 0xf];
+            _buffer += hex_digits[c & 0xf];
+        }
+        first = special + 1;
+    }
+
+    _buffer += '"';
+}
+
+void JSON_writer::key(std::string_view name)
+{
+    tt_axiom(!_first_item.empty());
+    tt_axiom(!_after_key);
+
+    begin_value();
+    write_string(name);
+    _buffer += ':';
+    if (_style == JSON_style::indented) {
+        _buffer += ' ';
+    }
+    _after_key = true;
+}
+
+void JSON_writer::string(std::string_view value)
+{
+    begin_value();
+    write_string(value);
+    end_value();
+}
+
+void JSON_writer::integer(long long value)
+{
+    begin_value();
+
+    auto buffer = std::array<char, 24>{};
+    ttlet[last, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    tt_axiom(ec == std::errc{});
+    _buffer.append(buffer.data(), last);
+
+    end_value();
+}
+
+void JSON_writer::floating_point(double value)
+{
+    begin_value();
+
+    if (std::isfinite(value)) {
+        // Without a format std::to_chars() produces the shortest text that round-trips.
+        auto buffer = std::array<char, 32>{};
+        ttlet[last, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        tt_axiom(ec == std::errc{});
+
+        ttlet text = std::string_view{buffer.data(), narrow_cast<size_t>(last - buffer.data())};
+        _buffer += text;
+        if (text.find_first_of(".e") == std::string_view::npos) {
+            _buffer += ".0";
+        }
+
+    } else {
+        _buffer += "null";
+    }
+
+    end_value();
+}
+
+void JSON_writer::boolean(bool value)
+{
+    begin_value();
+    _buffer += value ? "true" : "false";
+    end_value();
+}
+
+void JSON_writer::null()
+{
+    begin_value();
+    _buffer += "null";
+    end_value();
+}
+
+void JSON_writer::value(datum const &value)
+{
+    auto buffer = datum::string_buffer_type{};
+
+    switch (value.type()) {
+    case datum_type_t::Null: null(); break;
+    case datum_type_t::Boolean: boolean(static_cast<bool>(value)); break;
+    case datum_type_t::Integer: integer(static_cast<long long>(value)); break;
+    case datum_type_t::Float: floating_point(static_cast<double>(value)); break;
+    case datum_type_t::String: string(value.string_view(buffer)); break;
+    case datum_type_t::URL: string(static_cast<std::string>(value)); break;
+
+    case datum_type_t::Vector:
+        begin_array();
+        for (auto i = value.vector_begin(); i != value.vector_end(); ++i) {
+            this->value(*i);
+        }
+        end_array();
+        break;
+
+    case datum_type_t::Map:
+        begin_object();
+        for (auto i = value.map_begin(); i != value.map_end(); ++i) {
+            if (i->first.is_string()) {
+                key(i->first.string_view(buffer));
+            } else {
+                key(static_cast<std::string>(i->first));
+            }
+            this->value(i->second);
+        }
+        end_object();
+        break;
+
+    default: throw operation_error("Can not write a value of type {} as JSON.", value.type_name());
+    }
+}
+
+void JSON_writer::flush()
+{
+    if (_sink && !_buffer.empty()) {
+        _sink(_buffer);
+        _buffer.clear();
+    }
+}
+
+} // namespace tt
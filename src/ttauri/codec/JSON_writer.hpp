@@ -0,0 +1,131 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../datum.hpp"
+#include <string>
+#include <string_view>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+namespace tt {
+class file;
+
+/** The layout of the text produced by the JSON writer.
+ */
+enum class JSON_style : uint8_t {
+    /** No whitespace between tokens.
+     */
+    compact,
+
+    /** Each member or item on its own line, indented by 4 spaces per level.
+     */
+    indented
+};
+
+/** A streaming writer of JSON text.
+ *
+ * Values are written with one call per event, in the same order as the events of `JSON_pull_parser`.
+ * Commas, colons and indentation are added by the writer.
+ *
+ * The text is written in a buffer which is reused. When the writer has a sink, the buffer is passed to
+ * the sink and cleared each time it grows beyond the flush threshold, and on `flush()`.
+ */
+class JSON_writer {
+public:
+    using sink_type = std::function<void(std::string_view)>;
+
+    /** Create a writer which keeps the text in memory.
+     * The text is retrieved with `str()`.
+     */
+    explicit JSON_writer(JSON_style style = JSON_style::indented) noexcept;
+
+    /** Create a writer which passes the text to a sink.
+     *
+     * @param sink The function that consumes a chunk of text.
+     * @param style The layout of the text.
+     * @param flush_threshold The size of the buffer at which it is passed to the sink.
+     */
+    JSON_writer(sink_type sink, JSON_style style = JSON_style::indented, size_t flush_threshold = 65536) noexcept;
+
+    /** Create a writer which writes the text to a file.
+     * The file must outlive the writer.
+     */
+    JSON_writer(file &file, JSON_style style = JSON_style::indented) noexcept;
+
+    JSON_writer(JSON_writer const &) = delete;
+    JSON_writer(JSON_writer &&) = delete;
+    JSON_writer &operator=(JSON_writer const &) = delete;
+    JSON_writer &operator=(JSON_writer &&) = delete;
+
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+
+    /** Write the name of a member of an object, must be followed by the value of the member.
+     */
+    void key(std::string_view name);
+
+    void string(std::string_view value);
+    void integer(long long value);
+
+    /** Write a floating point number.
+     *
+     * The number is written with the least digits that convert back to the same value.
+     * A number without a fraction or exponent gets a ".0" suffix so that it is read back as floating point.
+     * Infinite and NaN values, which JSON can not represent, are written as null.
+     */
+    void floating_point(double value);
+
+    void boolean(bool value);
+    void null();
+
+    /** Write a datum recursively.
+     *
+     * @throw operation_error When the datum contains a type that can not be represented in JSON.
+     */
+    void value(datum const &value);
+
+    /** Pass the buffered text to the sink.
+     * Must be called after the last value has been written to a writer with a sink.
+     */
+    void flush();
+
+    /** The text written since the last flush.
+     */
+    [[nodiscard]] std::string_view str() const noexcept
+    {
+        return _buffer;
+    }
+
+private:
+    sink_type _sink;
+    size_t _flush_threshold;
+    JSON_style _style;
+
+    /** The text, reused between flushes.
+     */
+    std::string _buffer;
+
+    /** For each open array or object, true when no item has been written yet.
+     */
+    std::vector<bool> _first_item;
+
+    /** True after a key was written, the next value follows on the same line.
+     */
+    bool _after_key = false;
+
+    void begin_value();
+    void end_value();
+    void begin_container(char c);
+    void end_container(char c);
+    void write_string(std::string_view text);
+    void write_newline();
+};
+
+} // namespace tt
@@ -0,0 +1,317 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "SHA2.hpp"
+#include "../endian.hpp"
+#if TT_PROCESSOR == TT_CPU_X64
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+namespace tt {
+namespace detail::SHA2 {
+
+#if TT_PROCESSOR == TT_CPU_X64
+
+tt_target("sha,sse4.1") void SHA256_compress_SHA_NI(state<uint32_t> &state, std::byte const *ptr, size_t nr_blocks) noexcept
+{
+    static_assert(sizeof(state) == 32);
+
+    // Convert big-endian message words to native.
+    ttlet byte_swap = _mm_set_epi64x(0x0c0d0e0f'08090a0b, 0x04050607'00010203);
+
+    // The SHA instructions keep the state as {a, b, e, f} and {c, d, g, h}.
+    ttlet dcba = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&state.a));
+    ttlet hgfe = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&state.e));
+    ttlet cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    ttlet efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    auto abef = _mm_alignr_epi8(cdab, efgh, 8);
+    auto cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; nr_blocks != 0; --nr_blocks, ptr += 64) {
+        ttlet abef_save = abef;
+        ttlet cdgh_save = cdgh;
+
+        // The last four groups of four message words.
+        __m128i w[4];
+
+        for (size_t i = 0; i != 16; ++i) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + i * 16)), byte_swap);
+            } else {
+                // W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16]
+                auto tmp = _mm_sha256msg1_epu32(w[i % 4], w[(i + 1) % 4]);
+                tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(i + 3) % 4], w[(i + 2) % 4], 4));
+                w[i % 4] = _mm_sha256msg2_epu32(tmp, w[(i + 3) % 4]);
+            }
+
+            ttlet wk = _mm_add_epi32(w[i % 4], _mm_load_si128(reinterpret_cast<__m128i const *>(K32.data() + i * 4)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+        }
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    // Back to {a, b, c, d} and {e, f, g, h}.
+    ttlet feba = _mm_shuffle_epi32(abef, 0x1b);
+    ttlet dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state.a), _mm_blend_epi16(feba, dchg, 0xf0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state.e), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+template<int N>
+[[nodiscard]] tt_target("avx2") static __m256i rotr_x8(__m256i x) noexcept
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+}
+
+/** Compress one 64 byte block for each of eight independent SHA-256 states.
+ *
+ * @param state The eight states, transposed so that each word holds one lane per state.
+ * @param blocks The block for each state.
+ */
+tt_target("avx2") static void
+SHA256_compress_x8_AVX2(std::array<std::array<uint32_t, 8>, 8> &state, std::array<std::byte const *, 8> const &blocks) noexcept
+{
+    ttlet byte_swap = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    auto load32 = [](std::byte const *ptr) {
+        auto r = int32_t{};
+        std::memcpy(&r, ptr, sizeof(r));
+        return r;
+    };
+
+    __m256i w[16];
+    for (size_t i = 0; i != 16; ++i) {
+        ttlet offset = i * 4;
+        w[i] = _mm256_shuffle_epi8(
+            _mm256_set_epi32(
+                load32(blocks[7] + offset),
+                load32(blocks[6] + offset),
+                load32(blocks[5] + offset),
+                load32(blocks[4] + offset),
+                load32(blocks[3] + offset),
+                load32(blocks[2] + offset),
+                load32(blocks[1] + offset),
+                load32(blocks[0] + offset)),
+            byte_swap);
+    }
+
+    __m256i s[8];
+    for (size_t i = 0; i != 8; ++i) {
+        s[i] = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(state[i].data()));
+    }
+
+    auto a = s[0];
+    auto b = s[1];
+    auto c = s[2];
+    auto d = s[3];
+    auto e = s[4];
+    auto f = s[5];
+    auto g = s[6];
+    auto h = s[7];
+
+    for (size_t t = 0; t != 64; ++t) {
+        if (t >= 16) {
+            ttlet w2 = w[(t - 2) % 16];
+            ttlet w15 = w[(t - 15) % 16];
+            ttlet s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8<7>(w15), rotr_x8<18>(w15)), _mm256_srli_epi32(w15, 3));
+            ttlet s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8<17>(w2), rotr_x8<19>(w2)), _mm256_srli_epi32(w2, 10));
+            w[t % 16] = _mm256_add_epi32(_mm256_add_epi32(w[t % 16], s0), _mm256_add_epi32(w[(t - 7) % 16], s1));
+        }
+
+        ttlet S1 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8<6>(e), rotr_x8<11>(e)), rotr_x8<25>(e));
+        ttlet ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        ttlet kw = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(K32[t])), w[t % 16]);
+        ttlet tmp1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, kw));
+
+        ttlet S0 = _mm256_xor_si256(_mm256_xor_si256(rotr_x8<2>(a), rotr_x8<13>(a)), rotr_x8<22>(a));
+        ttlet maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        ttlet tmp2 = _mm256_add_epi32(S0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, tmp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(tmp1, tmp2);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[0].data()), _mm256_add_epi32(s[0], a));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[1].data()), _mm256_add_epi32(s[1], b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[2].data()), _mm256_add_epi32(s[2], c));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[3].data()), _mm256_add_epi32(s[3], d));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[4].data()), _mm256_add_epi32(s[4], e));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[5].data()), _mm256_add_epi32(s[5], f));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[6].data()), _mm256_add_epi32(s[6], g));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[7].data()), _mm256_add_epi32(s[7], h));
+}
+
+namespace {
+
+/** A message that is being hashed in one of the lanes of the multi-buffer hash.
+ */
+struct SHA256_lane {
+    static constexpr size_t idle = std::numeric_limits<size_t>::max();
+
+    /** Index of the message, or `idle`.
+     */
+    size_t message = idle;
+
+    /** The next block to hash.
+     */
+    std::byte const *ptr = nullptr;
+
+    /** Number of blocks left, in the message or in the tail.
+     */
+    size_t nr_blocks = 0;
+
+    bool in_tail = false;
+    size_t nr_tail_blocks = 0;
+
+    /** The last partial block of the message followed by the padding, one or two blocks.
+     */
+    std::array<std::byte, 128> tail;
+
+    void start(size_t index, std::span<std::byte const> bytes) noexcept
+    {
+        message = index;
+        ptr = bytes.data();
+        nr_blocks = bytes.size() / 64;
+        in_tail = false;
+
+        ttlet rest = bytes.size() % 64;
+        tail.fill(std::byte{0x00});
+        if (rest != 0) {
+            std::memcpy(tail.data(), bytes.data() + nr_blocks * 64, rest);
+        }
+        tail[rest] = std::byte{0x80};
+
+        // The length of the message in bits must fit after the 0x80 marker.
+        nr_tail_blocks = rest + 1 + sizeof(uint64_t) <= 64 ? 1 : 2;
+        ttlet nr_of_bits = native_to_big(static_cast<uint64_t>(bytes.size()) * 8);
+        std::memcpy(tail.data() + nr_tail_blocks * 64 - sizeof(nr_of_bits), &nr_of_bits, sizeof(nr_of_bits));
+
+        if (nr_blocks == 0) {
+            start_tail();
+        }
+    }
+
+    void start_tail() noexcept
+    {
+        in_tail = true;
+        ptr = tail.data();
+        nr_blocks = nr_tail_blocks;
+    }
+
+    /** Advance to the next block.
+     *
+     * @return True when the last block of the message was hashed.
+     */
+    [[nodiscard]] bool advance() noexcept
+    {
+        ptr += 64;
+        if (--nr_blocks == 0) {
+            if (in_tail) {
+                return true;
+            }
+            start_tail();
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+void SHA256_batch_AVX2(std::span<std::span<std::byte const> const> messages, std::span<bstring> digests)
+{
+    tt_axiom(messages.size() == digests.size());
+
+    constexpr auto initial_state =
+        std::array<uint32_t, 8>{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    // Lanes without a message hash this block, the result is discarded.
+    alignas(64) static constexpr auto idle_block = std::array<std::byte, 64>{};
+
+    auto state = std::array<std::array<uint32_t, 8>, 8>{};
+    auto lanes = std::array<SHA256_lane, 8>{};
+    auto blocks = std::array<std::byte const *, 8>{};
+    auto next_message = size_t{0};
+    auto nr_active = size_t{0};
+
+    ttlet start_lane = [&](size_t lane) {
+        if (next_message == messages.size()) {
+            lanes[lane].message = SHA256_lane::idle;
+            return;
+        }
+
+        lanes[lane].start(next_message, messages[next_message]);
+        for (size_t i = 0; i != 8; ++i) {
+            state[i][lane] = initial_state[i];
+        }
+        ++next_message;
+        ++nr_active;
+    };
+
+    for (size_t lane = 0; lane != 8; ++lane) {
+        start_lane(lane);
+    }
+
+    while (nr_active != 0) {
+        for (size_t lane = 0; lane != 8; ++lane) {
+            blocks[lane] = lanes[lane].message == SHA256_lane::idle ? idle_block.data() : lanes[lane].ptr;
+        }
+
+        SHA256_compress_x8_AVX2(state, blocks);
+
+        for (size_t lane = 0; lane != 8; ++lane) {
+            if (lanes[lane].message == SHA256_lane::idle || !lanes[lane].advance()) {
+                continue;
+            }
+
+            auto &digest = digests[lanes[lane].message];
+            digest.resize(32);
+            for (size_t i = 0; i != 8; ++i) {
+                ttlet word = native_to_big(state[i][lane]);
+                std::memcpy(digest.data() + i * 4, &word, sizeof(word));
+            }
+
+            --nr_active;
+            start_lane(lane);
+        }
+    }
+}
+
+#endif
+
+} // namespace detail::SHA2
+
+[[nodiscard]] std::vector<bstring> SHA256_batch(std::span<std::span<std::byte const> const> messages)
+{
+    auto r = std::vector<bstring>(messages.size());
+
+#if TT_PROCESSOR == TT_CPU_X64
+    // The SHA extensions are faster on a single message than AVX2 on eight messages at the same time.
+    if (!detail::SHA2::has_SHA_NI() && detail::SHA2::has_AVX2() && messages.size() > 1) {
+        detail::SHA2::SHA256_batch_AVX2(messages, r);
+        return r;
+    }
+#endif
+
+    for (size_t i = 0; i != messages.size(); ++i) {
+        auto hash = SHA256{};
+        hash.add(messages[i]);
+        r[i] = hash.get_bytes();
+    }
+    return r;
+}
+
+} // namespace tt
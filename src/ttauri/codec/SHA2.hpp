@@ -7,14 +7,47 @@
 #include "../byte_string.hpp"
 #include "../required.hpp"
 #include "../assert.hpp"
+#include "../os_detect.hpp"
+#if TT_PROCESSOR == TT_CPU_X64
+#include "../cpu_id.hpp"
+#endif
 #include <bit>
 #include <array>
 #include <cstdint>
 #include <span>
+#include <vector>
+#include <type_traits>
 
 namespace tt {
 namespace detail::SHA2 {
 
+/** The round constants of SHA-224 and SHA-256.
+ */
+alignas(16) constexpr std::array<uint32_t,64> K32 = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#if TT_PROCESSOR == TT_CPU_X64
+[[nodiscard]] inline bool has_SHA_NI() noexcept
+{
+    static bool const r = cpu_has_sha() && cpu_has_sse4_1();
+    return r;
+}
+
+[[nodiscard]] inline bool has_AVX2() noexcept
+{
+    static bool const r = cpu_has_avx2();
+    return r;
+}
+#endif
+
 template<typename T>
 struct state {
     T a;
@@ -102,6 +135,19 @@ struct block {
 
 };
 
+#if TT_PROCESSOR == TT_CPU_X64
+/** Compress 64 byte blocks into the SHA-256 state using the x86 SHA extensions.
+ */
+void SHA256_compress_SHA_NI(state<uint32_t> &state, std::byte const *ptr, size_t nr_blocks) noexcept;
+
+/** Hash a batch of messages with SHA-256, eight at a time using AVX2.
+ *
+ * @param messages The messages to hash.
+ * @param[out] digests The 32 byte digest of each message.
+ */
+void SHA256_batch_AVX2(std::span<std::span<std::byte const> const> messages, std::span<bstring> digests);
+#endif
+
 }
 
 template<typename T, size_t Bits>
@@ -123,17 +169,6 @@ class SHA2 {
     size_t size;
 
     [[nodiscard]] static constexpr T K(size_t i) noexcept {
-        constexpr std::array<uint32_t,64> K32 = {
-            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-        };
-
         constexpr std::array<uint64_t,80> K64 = {
             0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538, 
             0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe, 
@@ -154,7 +189,7 @@ class SHA2 {
         };
 
         if constexpr (std::is_same_v<T,uint32_t>) {
-            return K32[i];
+            return detail::SHA2::K32[i];
         } else {
             return K64[i];
         }
@@ -252,6 +287,21 @@ class SHA2 {
         state += tmp;
     }
 
+    constexpr void add_blocks(cbyteptr ptr, size_t nr_blocks) noexcept
+    {
+#if TT_PROCESSOR == TT_CPU_X64
+        if constexpr (std::is_same_v<T,uint32_t>) {
+            if (!std::is_constant_evaluated() && detail::SHA2::has_SHA_NI()) {
+                return detail::SHA2::SHA256_compress_SHA_NI(state, ptr, nr_blocks);
+            }
+        }
+#endif
+
+        for (; nr_blocks != 0; --nr_blocks, ptr += block_type::size) {
+            add(block_type{ptr});
+        }
+    }
+
     constexpr void add_to_overflow(cbyteptr &ptr, std::byte const *last) noexcept {
         while (overflow_it != overflow.end() && ptr != last) {
             *(overflow_it++) = *(ptr++);
@@ -271,7 +321,7 @@ class SHA2 {
             while (overflow_it != overflow.end()) {
                 *(overflow_it++) = std::byte{0x00};
             }
-            add(block_type{overflow.data()});
+            add_blocks(overflow.data(), 1);
             overflow_it = overflow.begin();
         }
 
@@ -286,8 +336,7 @@ class SHA2 {
             *(overflow_it++) = i < sizeof(nr_of_bits) ? static_cast<std::byte>(nr_of_bits >> i * 8) : std::byte{0x00};
         }
 
-        auto b = block_type{overflow.data()};
-        add(b);
+        add_blocks(overflow.data(), 1);
     }
 
 public:
@@ -304,7 +353,7 @@ public:
             add_to_overflow(ptr, last);
 
             if (overflow_it == overflow.end()) {
-                add(block_type{overflow.data()});
+                add_blocks(overflow.data(), 1);
                 overflow_it = overflow.begin();
 
             } else {
@@ -315,10 +364,9 @@ public:
             }
         }
 
-        while (ptr + block_type::size <= last) {
-            add(block_type{ptr});
-            ptr += block_type::size;
-        }
+        ttlet nr_blocks = static_cast<size_t>(last - ptr) / block_type::size;
+        add_blocks(ptr, nr_blocks);
+        ptr += nr_blocks * block_type::size;
 
         add_to_overflow(ptr, last);
 
@@ -382,6 +430,16 @@ public:
         ) {}
 };
 
+/** Calculate the SHA-256 of each message in a batch of independent messages.
+ *
+ * When the CPU has the SHA extensions each message is hashed with those. Otherwise, when the CPU
+ * has AVX2, eight messages are hashed at the same time, each in its own 32 bit lane.
+ *
+ * @param messages The messages to hash.
+ * @return The 32 byte digest of each message, in the same order as the messages.
+ */
+[[nodiscard]] std::vector<bstring> SHA256_batch(std::span<std::span<std::byte const> const> messages);
+
 class SHA384 final : public SHA2<uint64_t,384> {
 public:
     SHA384() noexcept :
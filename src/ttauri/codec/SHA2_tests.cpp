@@ -163,3 +163,62 @@ TEST(SHA2, NESSIE512Set1) {
         "DE0FF244877EA60A4CB0432CE577C31B"
         "EB009C5C2C49AA2E4EADB217AD8CC09B");
 }
+
+[[nodiscard]] static std::vector<bstring> make_SHA256_batch_messages()
+{
+    auto r = std::vector<bstring>{};
+    for (size_t size = 0; size != 200; ++size) {
+        auto message = bstring{};
+        for (size_t i = 0; i != size; ++i) {
+            message += static_cast<std::byte>(size * 7 + i);
+        }
+        r.push_back(std::move(message));
+    }
+
+    r.push_back(to_bstring("abc"));
+    r.push_back(to_bstring("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+    r.push_back(to_bstring(std::string(1'000'000, 'a')));
+    return r;
+}
+
+TEST(SHA2, SHA256Batch) {
+    ttlet messages = make_SHA256_batch_messages();
+    ttlet spans = std::vector<std::span<std::byte const>>(messages.begin(), messages.end());
+
+    ttlet digests = SHA256_batch(spans);
+    ASSERT_EQ(digests.size(), messages.size());
+    for (size_t i = 0; i != messages.size(); ++i) {
+        auto hash = SHA256{};
+        hash.add(messages[i]);
+        ASSERT_EQ(digests[i], hash.get_bytes()) << "message " << i;
+    }
+
+    ASSERT_CASEEQ(base16::encode(digests[200]), "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD");
+    ASSERT_CASEEQ(base16::encode(digests[201]), "248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1");
+    ASSERT_CASEEQ(base16::encode(digests[202]), "CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0");
+
+    ASSERT_TRUE(SHA256_batch({}).empty());
+}
+
+#if TT_PROCESSOR == TT_CPU_X64
+TEST(SHA2, SHA256BatchAVX2) {
+    if (!detail::SHA2::has_AVX2()) {
+        GTEST_SKIP() << "CPU does not support AVX2";
+    }
+
+    ttlet messages = make_SHA256_batch_messages();
+    ttlet spans = std::vector<std::span<std::byte const>>(messages.begin(), messages.end());
+
+    // Also batches smaller than the eight lanes.
+    for (ttlet nr_messages : {size_t{1}, size_t{3}, size_t{8}, size_t{9}, spans.size()}) {
+        auto digests = std::vector<bstring>(nr_messages);
+        detail::SHA2::SHA256_batch_AVX2(std::span(spans).first(nr_messages), digests);
+
+        for (size_t i = 0; i != nr_messages; ++i) {
+            auto hash = SHA256{};
+            hash.add(messages[i]);
+            ASSERT_EQ(digests[i], hash.get_bytes()) << "message " << i;
+        }
+    }
+}
+#endif
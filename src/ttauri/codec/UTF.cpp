@@ -0,0 +1,314 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "UTF.hpp"
+#include "../os_detect.hpp"
+#if TT_PROCESSOR == TT_CPU_X64
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#endif
+
+namespace tt {
+namespace detail {
+
+#if TT_PROCESSOR == TT_CPU_X64
+
+/** Validate the UTF-8 sequences in a block of 16 code units.
+ *
+ * This is the lookup-table algorithm by John Keiser and Daniel Lemire. Each pair of adjacent code
+ * units is classified by three nibble lookups, a pair is invalid when a bit remains in all three.
+ * The block must start at the start of a code point; a sequence which continues beyond the end
+ * of the block is only checked up to the end of the block.
+ *
+ * @return True when there are no invalid sequences in the block.
+ */
+[[nodiscard]] static bool utf8_block_is_valid(__m128i input) noexcept
+{
+    constexpr char too_short = 1 << 0; // 11______ 0_______, 11______ 11______
+    constexpr char too_long = 1 << 1; // 0_______ 10______
+    constexpr char overlong_3 = 1 << 2; // 11100000 100_____
+    constexpr char too_large = 1 << 3; // 11110100 1001____, 11110100 101_____, 11110101+ 1001____+
+    constexpr char surrogate = 1 << 4; // 11101101 101_____
+    constexpr char overlong_2 = 1 << 5; // 1100000_ 10______
+    constexpr char too_large_1000 = 1 << 6; // 11110101+ 1000____
+    constexpr char overlong_4 = 1 << 6; // 11110000 1000____
+    constexpr char two_conts = static_cast<char>(1 << 7); // 10______ 10______
+    constexpr char carry = too_short | too_long | two_conts;
+
+    ttlet byte_1_high_table = _mm_setr_epi8(
+        too_long,
+        too_long,
+        too_long,
+        too_long,
+        too_long,
+        too_long,
+        too_long,
+        too_long,
+        two_conts,
+        two_conts,
+        two_conts,
+        two_conts,
+        too_short | overlong_2,
+        too_short,
+        too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4);
+
+    ttlet byte_1_low_table = _mm_setr_epi8(
+        carry | overlong_3 | overlong_2 | overlong_4,
+        carry | overlong_2,
+        carry,
+        carry,
+        carry | too_large,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000);
+
+    ttlet byte_2_high_table = _mm_setr_epi8(
+        too_short,
+        too_short,
+        too_short,
+        too_short,
+        too_short,
+        too_short,
+        too_short,
+        too_short,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_short,
+        too_short,
+        too_short,
+        too_short);
+
+    ttlet nibble_mask = _mm_set1_epi8(0x0f);
+
+    // The block starts at a code point, so the code units before it are treated as ASCII.
+    ttlet prev1 = _mm_slli_si128(input, 1);
+    ttlet prev2 = _mm_slli_si128(input, 2);
+    ttlet prev3 = _mm_slli_si128(input, 3);
+
+    ttlet byte_1_high = _mm_shuffle_epi8(byte_1_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble_mask));
+    ttlet byte_1_low = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, nibble_mask));
+    ttlet byte_2_high = _mm_shuffle_epi8(byte_2_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), nibble_mask));
+    ttlet special_cases = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // The third and fourth code unit of a sequence must be a continuation, which is only
+    // marked by `two_conts` above.
+    ttlet is_third_byte = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    ttlet is_fourth_byte = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    ttlet must_be_continuation = _mm_and_si128(_mm_or_si128(is_third_byte, is_fourth_byte), _mm_set1_epi8(two_conts));
+
+    return _mm_testz_si128(_mm_xor_si128(must_be_continuation, special_cases), _mm_set1_epi8(-1));
+}
+
+/** The number of code units in a valid block up to a code point that continues beyond the block.
+ */
+[[nodiscard]] static size_t utf8_complete_size(char8_t const *ptr) noexcept
+{
+    for (size_t i = 1; i != 4; ++i) {
+        ttlet cu = ptr[16 - i];
+        if (cu <= 0x7f) {
+            return 16;
+        } else if (cu >= 0xc0) {
+            ttlet length = cu >= 0xf0 ? size_t{4} : cu >= 0xe0 ? size_t{3} : size_t{2};
+            return length > i ? 16 - i : 16;
+        }
+    }
+    return 16;
+}
+
+#endif
+
+/** Decode UTF-8.
+ *
+ * @param ptr The first UTF-8 code unit.
+ * @param last One beyond the last UTF-8 code unit.
+ * @param ascii A function called with 16 ASCII code units.
+ * @param code_point A function called with each other code point.
+ */
+template<typename Ascii, typename CodePoint>
+static void transcode_utf8(char8_t const *ptr, char8_t const *last, Ascii const &ascii, CodePoint const &code_point) noexcept
+{
+    while (true) {
+#if TT_PROCESSOR == TT_CPU_X64
+        while (last - ptr >= 16) {
+            ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+            if (_mm_movemask_epi8(chars) == 0) {
+                ascii(chars);
+                ptr += 16;
+                continue;
+            }
+
+            if (!utf8_block_is_valid(chars)) {
+                break;
+            }
+
+            // The sequences are valid, decode without checking.
+            ttlet end = ptr + utf8_complete_size(ptr);
+            while (ptr != end) {
+                code_point(tt::utf8_to_utf32(ptr));
+            }
+        }
+#endif
+
+        if (ptr == last) {
+            return;
+        }
+
+        // Decode a block with invalid code units, or the end of the text, while checking.
+        ttlet end = last - ptr >= 16 ? ptr + 16 : last;
+        while (ptr < end) {
+            auto c32 = char32_t{};
+            tt::utf8_to_utf32(ptr, last, c32);
+            code_point(c32);
+        }
+    }
+}
+
+[[nodiscard]] char32_t *transcode_utf8_to_utf32(char8_t const *first, char8_t const *last, char32_t *out) noexcept
+{
+    transcode_utf8(
+        first,
+        last,
+        [&out](auto chars) {
+#if TT_PROCESSOR == TT_CPU_X64
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_cvtepu8_epi32(chars));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_cvtepu8_epi32(_mm_srli_si128(chars, 4)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_cvtepu8_epi32(_mm_srli_si128(chars, 8)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_cvtepu8_epi32(_mm_srli_si128(chars, 12)));
+            out += 16;
+#endif
+        },
+        [&out](char32_t c32) {
+            *(out++) = c32;
+        });
+    return out;
+}
+
+[[nodiscard]] char16_t *transcode_utf8_to_utf16(char8_t const *first, char8_t const *last, char16_t *out) noexcept
+{
+    transcode_utf8(
+        first,
+        last,
+        [&out](auto chars) {
+#if TT_PROCESSOR == TT_CPU_X64
+            ttlet zero = _mm_setzero_si128();
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(chars, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(chars, zero));
+            out += 16;
+#endif
+        },
+        [&out](char32_t c32) {
+            if (c32 <= 0xffff) {
+                *(out++) = static_cast<char16_t>(c32);
+            } else {
+                c32 -= 0x10000;
+                *(out++) = static_cast<char16_t>((c32 >> 10) | 0xd800);
+                *(out++) = static_cast<char16_t>((c32 & 0x03ff) | 0xdc00);
+            }
+        });
+    return out;
+}
+
+[[nodiscard]] char8_t *transcode_utf32_to_utf8(char32_t const *ptr, char32_t const *last, char8_t *out) noexcept
+{
+    while (ptr != last) {
+#if TT_PROCESSOR == TT_CPU_X64
+        if (last - ptr >= 16) {
+            ttlet a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+            ttlet b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 4));
+            ttlet c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 8));
+            ttlet d = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 12));
+            ttlet all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+
+            if (_mm_testz_si128(all, _mm_set1_epi32(~0x7f))) {
+                ttlet chars = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+                ptr += 16;
+                out += 16;
+                continue;
+            }
+        }
+#endif
+
+        // Encode up to the next block.
+        ttlet end = last - ptr >= 16 ? ptr + 16 : last;
+        for (; ptr != end; ++ptr) {
+            auto c32 = *ptr;
+            if (c32 > 0x10ffff || (c32 >= 0xd800 && c32 <= 0xdfff)) {
+                c32 = U'\ufffd';
+            }
+
+            if (c32 <= 0x7f) {
+                *(out++) = static_cast<char8_t>(c32);
+
+            } else if (c32 <= 0x07ff) {
+                *(out++) = static_cast<char8_t>((c32 >> 6) | 0xc0);
+                *(out++) = static_cast<char8_t>((c32 & 0x3f) | 0x80);
+
+            } else if (c32 <= 0xffff) {
+                *(out++) = static_cast<char8_t>((c32 >> 12) | 0xe0);
+                *(out++) = static_cast<char8_t>(((c32 >> 6) & 0x3f) | 0x80);
+                *(out++) = static_cast<char8_t>((c32 & 0x3f) | 0x80);
+
+            } else {
+                *(out++) = static_cast<char8_t>((c32 >> 18) | 0xf0);
+                *(out++) = static_cast<char8_t>(((c32 >> 12) & 0x3f) | 0x80);
+                *(out++) = static_cast<char8_t>(((c32 >> 6) & 0x3f) | 0x80);
+                *(out++) = static_cast<char8_t>((c32 & 0x3f) | 0x80);
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace detail
+
+[[nodiscard]] size_t find_invalid_utf8(std::u8string_view text) noexcept
+{
+    ttlet first = text.data();
+    ttlet last = first + text.size();
+    auto ptr = first;
+
+    while (true) {
+#if TT_PROCESSOR == TT_CPU_X64
+        while (last - ptr >= 16) {
+            ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+            if (_mm_movemask_epi8(chars) == 0) {
+                ptr += 16;
+            } else if (detail::utf8_block_is_valid(chars)) {
+                ptr += detail::utf8_complete_size(ptr);
+            } else {
+                break;
+            }
+        }
+#endif
+
+        if (ptr == last) {
+            return text.size();
+        }
+
+        // Find the invalid sequence in the block, or check the end of the text.
+        ttlet end = last - ptr >= 16 ? ptr + 16 : last;
+        while (ptr < end) {
+            ttlet code_point_first = ptr;
+            auto c32 = char32_t{};
+            if (!utf8_to_utf32(ptr, last, c32)) {
+                return narrow_cast<size_t>(code_point_first - first);
+            }
+        }
+    }
+}
+
+} // namespace tt
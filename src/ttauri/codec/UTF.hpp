@@ -7,9 +7,12 @@
 #include "../required.hpp"
 #include "../endian.hpp"
 #include "../CP1252.hpp"
+#include "../cast.hpp"
 #include <type_traits>
 #include <iterator>
 #include <bit>
+#include <string>
+#include <string_view>
 
 namespace tt {
 
@@ -91,7 +94,7 @@ template<typename Iterator>
         cp |= static_cast<char32_t>(*(it++) & 0x3f);
         cp <<= 6;
         cp |= static_cast<char32_t>(*(it++) & 0x3f);
-        tt_axiom(cp >= 0x100000 && cp <= 0x10ffff, "UTF-8 Overlong encoding");
+        tt_axiom(cp >= 0x010000 && cp <= 0x10ffff, "UTF-8 Overlong encoding");
         return cp;
     }
 }
@@ -153,13 +156,14 @@ constexpr bool utf8_to_utf32(Iterator &it, Iterator last, char32_t &code_point)
         }
 
         code_point <<= 6;
-        code_point = *(it++) & 0x3f;
+        code_point |= *(it++) & 0x3f;
     }
 
     if ((code_point >= 0xd800 && code_point <= 0xdfff) || // Surrogate pair
         (continuation_count == 1 && code_point < 0x0080) || // Overlong
         (continuation_count == 2 && code_point < 0x0800) || // Overlong
-        (continuation_count == 3 && code_point < 0x10000) // Overlong
+        (continuation_count == 3 && code_point < 0x10000) || // Overlong
+        code_point > 0x10ffff // Beyond the 17 planes
     ) {
         // Surrogate pair
         code_point = CP1252_to_UTF32(static_cast<char>(first_cu));
@@ -233,6 +237,53 @@ constexpr void utf32_to_utf8(char32_t code_point, BackInsertIterator &it) noexce
     }
 }
 
+/** Find the first invalid UTF-8 code unit.
+ *
+ * Blocks of code units are validated with vector instructions.
+ *
+ * @param text UTF-8 text, which may be invalid.
+ * @return The offset of the first code unit of the first invalid sequence, or the size of the
+ *         text when the text is valid UTF-8.
+ */
+[[nodiscard]] size_t find_invalid_utf8(std::u8string_view text) noexcept;
+
+namespace detail {
+
+/** Convert UTF-8 to UTF-32.
+ *
+ * Blocks of ASCII are converted at full vector width. Other blocks are validated with vector
+ * instructions before being decoded. Invalid code units are decoded in the same way as
+ * `utf8_to_utf32(it, last, code_point)`.
+ *
+ * @param first The first UTF-8 code unit.
+ * @param last One beyond the last UTF-8 code unit.
+ * @param out A buffer with room for `last - first` code units.
+ * @return One beyond the last written code unit.
+ */
+[[nodiscard]] char32_t *transcode_utf8_to_utf32(char8_t const *first, char8_t const *last, char32_t *out) noexcept;
+
+/** Convert UTF-8 to UTF-16.
+ *
+ * @see transcode_utf8_to_utf32()
+ * @param out A buffer with room for `last - first` code units.
+ * @return One beyond the last written code unit.
+ */
+[[nodiscard]] char16_t *transcode_utf8_to_utf16(char8_t const *first, char8_t const *last, char16_t *out) noexcept;
+
+/** Convert UTF-32 to UTF-8.
+ *
+ * Blocks of ASCII are converted at full vector width. Surrogates and code points beyond the
+ * 17 planes are replaced with U+FFFD.
+ *
+ * @param first The first UTF-32 code unit.
+ * @param last One beyond the last UTF-32 code unit.
+ * @param out A buffer with room for `(last - first) * 4` code units.
+ * @return One beyond the last written code unit.
+ */
+[[nodiscard]] char8_t *transcode_utf32_to_utf8(char32_t const *first, char32_t const *last, char8_t *out) noexcept;
+
+} // namespace detail
+
 /** Sanitize a UTF-32 string so it contains only valid encoded Unicode code points.
  *
  * This function will replace invalid code units with the unicode-replacement-character 0xfffd.
@@ -381,32 +432,21 @@ template<typename Container>
 {
     auto r = std::move(rhs);
 
-    ttlet first = begin(rhs);
-    ttlet last = end(rhs);
-
-    auto code_point = char32_t{};
-    auto valid = true;
-    auto old_it = first;
-    for (auto it = first; valid && it != last;) {
-        old_it = it;
-        valid &= utf8_to_utf32(it, last, code_point);
-    }
-
-    if (valid) {
+    ttlet valid_size = find_invalid_utf8(r);
+    if (valid_size == r.size()) {
         return r;
     }
 
     // Copy the valid UTF-8 code units and prepare for
     // re-encoding the rest of the string.
-    auto tmp = std::u8string{begin(r), old_it};
+    auto tmp = std::u8string{r.data(), valid_size};
     tmp.reserve(size(r));
-
-    // Add the last decoded code point.
     auto tmp_i = std::back_inserter(tmp);
-    utf32_to_utf8(code_point, tmp_i);
 
     // Re-encode the rest of the string.
-    for (auto it = old_it + 1; it != last;) {
+    ttlet last = end(r);
+    for (auto it = begin(r) + valid_size; it != last;) {
+        auto code_point = char32_t{};
         utf8_to_utf32(it, last, code_point);
         utf32_to_utf8(code_point, tmp_i);
     }
@@ -435,12 +475,11 @@ template<typename StringT>
 [[nodiscard]] inline StringT to_u8string(std::u32string_view const &rhs) noexcept
 {
     auto r = StringT{};
-    r.reserve(rhs.size());
-    auto r_it = std::back_inserter(r);
+    r.resize(rhs.size() * 4);
 
-    for (auto c32 : rhs) {
-        utf32_to_utf8(c32, r_it);
-    }
+    ttlet first = reinterpret_cast<char8_t *>(r.data());
+    ttlet last = transcode_utf32_to_utf8(rhs.data(), rhs.data() + rhs.size(), first);
+    r.resize(narrow_cast<size_t>(last - first));
     return r;
 }
 
@@ -514,21 +553,18 @@ template<typename StringT>
 }
 
 /** UTF-8 string to UTF-16 string conversion.
- * It is undefined behavior if the given string is not a valid UTF-8 string.
+ * Invalid code units are decoded as CP-1252 characters, the same as `utf8_to_utf32(it, last, code_point)`.
  *
- * @param rhs The given valid UTF-8 encoded string.
+ * @param rhs A UTF-8 encoded string, which may be invalid.
  * @return A UTF-16 encoded string.
  */
 [[nodiscard]] inline std::u16string to_u16string(std::u8string_view const &rhs) noexcept
 {
     auto r = std::u16string{};
-    r.reserve(rhs.size());
-    auto r_it = std::back_inserter(r);
+    r.resize(rhs.size());
 
-    for (auto it = std::begin(rhs); it != std::end(rhs);) {
-        ttlet c32 = utf8_to_utf32(it);
-        utf32_to_utf16(c32, r_it);
-    }
+    ttlet last = detail::transcode_utf8_to_utf16(rhs.data(), rhs.data() + rhs.size(), r.data());
+    r.resize(narrow_cast<size_t>(last - r.data()));
     return r;
 }
 
@@ -551,19 +587,18 @@ template<typename StringT>
 }
 
 /** UTF-8 string to UTF-32 string conversion.
- * It is undefined behavior if the given string is not a valid UTF-8 string.
+ * Invalid code units are decoded as CP-1252 characters, the same as `utf8_to_utf32(it, last, code_point)`.
  *
- * @param rhs The given valid UTF-8 encoded string.
+ * @param rhs A UTF-8 encoded string, which may be invalid.
  * @return A UTF-32 encoded string.
  */
 [[nodiscard]] inline std::u32string to_u32string(std::u8string_view const &rhs) noexcept
 {
     auto r = std::u32string{};
-    r.reserve(rhs.size());
+    r.resize(rhs.size());
 
-    for (auto it = std::begin(rhs); it != std::end(rhs);) {
-        r += utf8_to_utf32(it);
-    }
+    ttlet last = detail::transcode_utf8_to_utf32(rhs.data(), rhs.data() + rhs.size(), r.data());
+    r.resize(narrow_cast<size_t>(last - r.data()));
     return r;
 }
 
@@ -603,7 +638,7 @@ template<typename StringT>
  */
 [[nodiscard]] inline std::u16string to_u16string(std::string_view const &rhs) noexcept
 {
-    return to_u16string(sanitize_u8string(std::u8string{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()}));
+    return to_u16string(std::u8string_view{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()});
 }
 
 /** Convert a string to a UTF-32 encoded string.
@@ -614,7 +649,7 @@ template<typename StringT>
  */
 [[nodiscard]] inline std::u32string to_u32string(std::string_view const &rhs) noexcept
 {
-    return to_u32string(sanitize_u8string(std::u8string{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()}));
+    return to_u32string(std::u8string_view{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()});
 }
 
 /** Convert a wide-string to a UTF-8 encoded string.
@@ -672,7 +707,7 @@ template<typename StringT>
 }
 
 /** Convert a UTF-8 encoded string to a wide-string.
- * It is undefined behavior if the given string contains invalid UTF-8 code points.
+ * Invalid code units are decoded as CP-1252 characters.
  *
  * @param rhs A UTF-8 encoded string, which may be invalid.
  * @return A valid wide string.
@@ -696,8 +731,7 @@ template<typename StringT>
  */
 [[nodiscard]] inline std::wstring to_wstring(std::string_view const &rhs) noexcept
 {
-    auto s8 = sanitize_u8string(std::u8string{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()});
-    return to_wstring(s8);
+    return to_wstring(std::u8string_view{reinterpret_cast<char8_t const *>(rhs.data()), rhs.size()});
 }
 
 /** Convert a UTF-16 encoded string to a wide-string.
@@ -0,0 +1,185 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/UTF.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace tt;
+
+/** Decode UTF-8 one code point at a time, the reference for the bulk transcoders.
+ */
+static std::u32string reference_u32string(std::u8string_view text)
+{
+    auto r = std::u32string{};
+    auto it = text.begin();
+    ttlet last = text.end();
+    while (it != last) {
+        auto code_point = char32_t{};
+        utf8_to_utf32(it, last, code_point);
+        r += code_point;
+    }
+    return r;
+}
+
+static size_t reference_find_invalid_utf8(std::u8string_view text)
+{
+    auto it = text.begin();
+    ttlet last = text.end();
+    while (it != last) {
+        ttlet first = it;
+        auto code_point = char32_t{};
+        if (!utf8_to_utf32(it, last, code_point)) {
+            return static_cast<size_t>(first - text.begin());
+        }
+    }
+    return text.size();
+}
+
+static std::u16string reference_u16string(std::u32string_view text)
+{
+    auto r = std::u16string{};
+    auto it = std::back_inserter(r);
+    for (ttlet code_point : text) {
+        utf32_to_utf16(code_point, it);
+    }
+    return r;
+}
+
+/** Mixed text of 1, 2, 3 and 4 code unit sequences, long enough to cross many blocks.
+ */
+static std::u8string mixed_text()
+{
+    auto r = std::u8string{};
+    for (int i = 0; i != 20; ++i) {
+        r += u8"Hello World, ";
+        r += u8"\u00e9t\u00e9 ";
+        r += u8"\u65e5\u672c\u8a9e ";
+        r += u8"\U0001f600\U0001f680 ";
+        r += u8"The quick brown fox jumps over the lazy dog. ";
+    }
+    return r;
+}
+
+TEST(UTF, ascii)
+{
+    ttlet text = std::u8string{u8"The quick brown fox jumps over the lazy dog, 0123456789."};
+    ASSERT_EQ(find_invalid_utf8(text), text.size());
+    ASSERT_EQ(to_u32string(text), U"The quick brown fox jumps over the lazy dog, 0123456789.");
+    ASSERT_EQ(to_u16string(text), u"The quick brown fox jumps over the lazy dog, 0123456789.");
+    ASSERT_EQ(to_u8string(to_u32string(text)), text);
+    ASSERT_EQ(to_u8string(to_u16string(text)), text);
+}
+
+TEST(UTF, mixed)
+{
+    ttlet text = mixed_text();
+    ASSERT_EQ(find_invalid_utf8(text), text.size());
+
+    ttlet u32 = to_u32string(text);
+    ASSERT_EQ(u32, reference_u32string(text));
+    ASSERT_EQ(to_u16string(text), reference_u16string(u32));
+    ASSERT_EQ(to_u8string(u32), text);
+    ASSERT_EQ(sanitize_u8string(std::u8string{text}), text);
+}
+
+TEST(UTF, sequence_at_every_offset)
+{
+    ttlet sequences = std::vector<std::u8string>{u8"\u00e9", u8"\u65e5", u8"\U0001f600", u8"\U0010ffff", u8"\ufffd"};
+
+    for (ttlet &sequence : sequences) {
+        for (size_t offset = 0; offset != 40; ++offset) {
+            auto text = std::u8string(offset, u8'a') + sequence + std::u8string(40, u8'b');
+            ASSERT_EQ(find_invalid_utf8(text), text.size()) << "offset " << offset;
+            ASSERT_EQ(to_u32string(text), reference_u32string(text)) << "offset " << offset;
+            ASSERT_EQ(to_u8string(to_u32string(text)), text) << "offset " << offset;
+            ASSERT_EQ(to_u8string(to_u16string(text)), text) << "offset " << offset;
+        }
+    }
+}
+
+TEST(UTF, invalid_at_every_offset)
+{
+    ttlet sequences = std::vector<std::u8string>{
+        u8"\x80", // Stray continuation.
+        u8"\xbf\x80", // Two stray continuations.
+        u8"\xc3", // Truncated 2 code unit sequence.
+        u8"\xe6\x97", // Truncated 3 code unit sequence.
+        u8"\xf0\x9f\x98", // Truncated 4 code unit sequence.
+        u8"\xc0\xaf", // Overlong 2 code unit sequence.
+        u8"\xc1\xbf", // Overlong 2 code unit sequence.
+        u8"\xe0\x80\xaf", // Overlong 3 code unit sequence.
+        u8"\xf0\x80\x80\xaf", // Overlong 4 code unit sequence.
+        u8"\xed\xa0\x80", // Surrogate.
+        u8"\xed\xbf\xbf", // Surrogate.
+        u8"\xf4\x90\x80\x80", // Beyond U+10FFFF.
+        u8"\xf5\x80\x80\x80", // Beyond U+10FFFF.
+        u8"\xf8\x88\x80\x80\x80", // 5 code unit sequence.
+        u8"\xff", // Invalid code unit.
+        u8"\xe6\x97\xa5\x80", // Extra continuation.
+    };
+
+    for (ttlet &sequence : sequences) {
+        for (size_t offset = 0; offset != 40; ++offset) {
+            for (ttlet &tail : {std::u8string{}, std::u8string(40, u8'b'), std::u8string{u8"\u65e5\u672c\u8a9e\u65e5\u672c\u8a9e"}}) {
+                auto text = std::u8string(offset, u8'a') + sequence + tail;
+                ASSERT_EQ(find_invalid_utf8(text), reference_find_invalid_utf8(text)) << "offset " << offset;
+                ASSERT_EQ(to_u32string(text), reference_u32string(text)) << "offset " << offset;
+                ASSERT_EQ(to_u16string(text), reference_u16string(reference_u32string(text))) << "offset " << offset;
+            }
+        }
+    }
+}
+
+TEST(UTF, all_code_units)
+{
+    for (int c = 0; c != 256; ++c) {
+        auto text = std::u8string(20, u8'a');
+        text[3] = static_cast<char8_t>(c);
+
+        ASSERT_EQ(find_invalid_utf8(text), reference_find_invalid_utf8(text)) << "code unit " << c;
+        ASSERT_EQ(to_u32string(text), reference_u32string(text)) << "code unit " << c;
+    }
+}
+
+TEST(UTF, find_invalid_utf8)
+{
+    ASSERT_EQ(find_invalid_utf8(u8""), 0);
+    ASSERT_EQ(find_invalid_utf8(u8"\x80"), 0);
+    ASSERT_EQ(find_invalid_utf8(u8"abc\xc3"), 3);
+
+    auto text = mixed_text();
+    ttlet size = text.size();
+    text += u8"\xed\xa0\x80";
+    text += mixed_text();
+    ASSERT_EQ(find_invalid_utf8(text), size);
+}
+
+TEST(UTF, utf32_to_utf8_invalid)
+{
+    ASSERT_EQ(to_u8string(std::u32string_view{U"a\U0010ffffb"}), std::u8string{u8"a\U0010ffffb"});
+
+    auto text = std::u32string(40, U'a');
+    text[5] = 0xd800;
+    text[20] = 0x110000;
+    text[39] = 0xdfff;
+
+    auto expected = std::u8string(40, u8'a');
+    expected.replace(39, 1, u8"\ufffd");
+    expected.replace(20, 1, u8"\ufffd");
+    expected.replace(5, 1, u8"\ufffd");
+    ASSERT_EQ(to_u8string(text), expected);
+}
+
+TEST(UTF, sanitize_u8string)
+{
+    auto text = std::u8string(30, u8'a') + u8"\xc3(" + mixed_text();
+    ttlet expected = to_u8string(reference_u32string(text));
+
+    ttlet sanitized = sanitize_u8string(std::move(text));
+    ASSERT_EQ(sanitized, expected);
+    ASSERT_EQ(find_invalid_utf8(sanitized), sanitized.size());
+}
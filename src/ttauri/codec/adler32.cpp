@@ -0,0 +1,79 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "adler32.hpp"
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <algorithm>
+
+namespace tt {
+
+/** The modulo of the Adler-32 sums.
+ */
+constexpr uint32_t adler32_base = 65521;
+
+/** The maximum number of bytes that can be summed before the 32 bit sums overflow.
+ */
+constexpr ssize_t adler32_max_run = 5552;
+
+uint32_t adler32(std::span<std::byte const> bytes, uint32_t adler) noexcept
+{
+    auto ptr = bytes.data();
+    auto size = std::ssize(bytes);
+
+    auto s1 = adler & 0xffff;
+    auto s2 = adler >> 16;
+
+    // The weight of each byte for s2 is the number of bytes until the end of the 32 byte block.
+    ttlet weights1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    ttlet weights2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    ttlet ones = _mm_set1_epi16(1);
+    ttlet zero = _mm_setzero_si128();
+
+    while (size >= 32) {
+        ttlet nr_blocks = std::min(size, adler32_max_run) / 32;
+        size -= nr_blocks * 32;
+
+        // v_prev_s1 accumulates s1 at the start of each block, which is multiplied by 32 at the end.
+        auto v_prev_s1 = _mm_cvtsi32_si128(static_cast<int>(s1 * nr_blocks));
+        auto v_s1 = zero;
+        auto v_s2 = _mm_cvtsi32_si128(static_cast<int>(s2));
+
+        for (ssize_t i = 0; i != nr_blocks; ++i) {
+            ttlet bytes1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+            ttlet bytes2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 16));
+            ptr += 32;
+
+            v_prev_s1 = _mm_add_epi32(v_prev_s1, v_s1);
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weights1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weights2), ones));
+        }
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_prev_s1, 5));
+
+        // Horizontal sums.
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += static_cast<uint32_t>(_mm_cvtsi128_si32(v_s1));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(v_s2));
+
+        s1 %= adler32_base;
+        s2 %= adler32_base;
+    }
+
+    for (ssize_t i = 0; i != size; ++i) {
+        s1 += static_cast<uint8_t>(ptr[i]);
+        s2 += s1;
+    }
+    s1 %= adler32_base;
+    s2 %= adler32_base;
+
+    return (s2 << 16) | s1;
+}
+
+} // namespace tt
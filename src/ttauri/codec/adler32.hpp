@@ -0,0 +1,27 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace tt {
+
+/** Calculate the Adler-32 checksum of data, as used by zlib.
+ *
+ * The checksum can be calculated incrementally by passing the result of the
+ * previous call as the initial value of the next call.
+ *
+ * The data is summed 32 bytes at a time using SSSE3 multiply-add instructions.
+ *
+ * @param bytes The data to calculate the checksum of.
+ * @param adler The checksum of the preceding data, or 1.
+ * @return The checksum of the preceding data together with `bytes`.
+ */
+[[nodiscard]] uint32_t adler32(std::span<std::byte const> bytes, uint32_t adler = 1) noexcept;
+
+} // namespace tt
@@ -0,0 +1,55 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/adler32.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/byte_string.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace tt;
+
+/** Reference implementation, one byte at a time.
+ */
+static uint32_t adler32_reference(std::span<std::byte const> bytes)
+{
+    uint32_t s1 = 1;
+    uint32_t s2 = 0;
+    for (ttlet c : bytes) {
+        s1 = (s1 + static_cast<uint8_t>(c)) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+TEST(Adler32, CheckValue) {
+    ASSERT_EQ(adler32(to_bstring("")), 1);
+    ASSERT_EQ(adler32(to_bstring("Wikipedia")), 0x11e6'0398);
+}
+
+TEST(Adler32, SameAsReference) {
+    // All 0xff bytes result in the largest intermediate sums.
+    ttlet ones = bstring(20000, std::byte{0xff});
+    ASSERT_EQ(adler32(ones), adler32_reference(ones));
+
+    ttlet bytes = make_random_bytes(12000);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    for (ssize_t offset = 0; offset != 17; ++offset) {
+        for (ssize_t size = 0; size < 11900; size += 97) {
+            ttlet data = span.subspan(offset, size);
+            ASSERT_EQ(adler32(data), adler32_reference(data));
+        }
+    }
+}
+
+TEST(Adler32, Incremental) {
+    ttlet bytes = make_random_bytes(20000);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    for (ssize_t split = 0; split < 20000; split += 1333) {
+        ASSERT_EQ(adler32(span.subspan(split), adler32(span.first(split))), adler32(span));
+    }
+}
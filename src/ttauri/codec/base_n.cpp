@@ -0,0 +1,253 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "base_n.hpp"
+#if TT_PROCESSOR == TT_CPU_X64
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#endif
+#include <cstring>
+
+namespace tt::detail {
+
+#if TT_PROCESSOR == TT_CPU_X64
+
+/** Check for each byte if it is less or equal to a value, as unsigned integers.
+ */
+[[nodiscard]] static __m128i less_equal_epu8(__m128i x, char value) noexcept
+{
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(value)), x);
+}
+
+static void store_12(std::byte *out, __m128i x) noexcept
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), x);
+    ttlet tail = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+    std::memcpy(out + 8, &tail, sizeof(tail));
+}
+
+static void store_10(std::byte *out, __m128i x) noexcept
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), x);
+    ttlet tail = static_cast<uint16_t>(_mm_extract_epi16(x, 4));
+    std::memcpy(out + 8, &tail, sizeof(tail));
+}
+
+void base16_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out) noexcept
+{
+    ttlet table = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    ttlet nibble_mask = _mm_set1_epi8(0x0f);
+
+    while (last - ptr >= 16) {
+        ttlet bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+        ttlet hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask));
+        ttlet lo = _mm_shuffle_epi8(table, _mm_and_si128(bytes, nibble_mask));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), _mm_unpackhi_epi8(hi, lo));
+        ptr += 16;
+        out += 32;
+    }
+}
+
+/** Convert 16 base-16 characters to their values.
+ *
+ * @return True when all the characters are in the alphabet.
+ */
+[[nodiscard]] static bool base16_values(__m128i chars, __m128i &values) noexcept
+{
+    ttlet digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    ttlet is_digit = less_equal_epu8(digits, 9);
+
+    // Upper and lower case letters.
+    ttlet letters = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    ttlet is_letter = less_equal_epu8(letters, 5);
+
+    values = _mm_blendv_epi8(_mm_add_epi8(letters, _mm_set1_epi8(10)), digits, is_digit);
+    return _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) == 0xffff;
+}
+
+void base16_decode_SSE(char const *&ptr, char const *last, std::byte *&out) noexcept
+{
+    // Each pair of nibbles as {hi * 16 + lo}.
+    ttlet merge = _mm_set1_epi16(0x0110);
+
+    while (last - ptr >= 32) {
+        __m128i lo_values;
+        __m128i hi_values;
+        if (!base16_values(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr)), lo_values) ||
+            !base16_values(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + 16)), hi_values)) {
+            return;
+        }
+
+        ttlet bytes = _mm_packus_epi16(_mm_maddubs_epi16(lo_values, merge), _mm_maddubs_epi16(hi_values, merge));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+        ptr += 32;
+        out += 16;
+    }
+}
+
+void base32_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out, bool hex) noexcept
+{
+    // For each of the 8 characters of a block the big-endian pair of bytes that holds its 5 bits,
+    // and a multiplier that shifts those bits to the bottom with a 16 bit multiply-high.
+    ttlet pairs = _mm_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4);
+    ttlet shifts = _mm_setr_epi16(1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+    ttlet mask = _mm_set1_epi16(0x1f);
+
+    // The values of the first range of characters, and the offset to the second range.
+    ttlet first = _mm_set1_epi8(hex ? '0' : 'A');
+    ttlet first_size = _mm_set1_epi8(hex ? 9 : 25);
+    ttlet second = _mm_set1_epi8(hex ? 'A' - 10 - '0' : '2' - 26 - 'A');
+
+    while (last - ptr >= 16) {
+        ttlet bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+        ttlet block0 = _mm_mulhi_epu16(_mm_shuffle_epi8(bytes, pairs), shifts);
+        ttlet block1 = _mm_mulhi_epu16(_mm_shuffle_epi8(_mm_srli_si128(bytes, 5), pairs), shifts);
+        ttlet values = _mm_packus_epi16(_mm_and_si128(block0, mask), _mm_and_si128(block1, mask));
+
+        auto chars = _mm_add_epi8(values, first);
+        chars = _mm_add_epi8(chars, _mm_and_si128(_mm_cmpgt_epi8(values, first_size), second));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+        ptr += 10;
+        out += 16;
+    }
+}
+
+void base32_decode_SSE(char const *&ptr, char const *last, std::byte *&out, bool hex) noexcept
+{
+    // The ranges of digits and case-insensitive letters, and the value of their first character.
+    ttlet first_digit = _mm_set1_epi8(hex ? '0' : '2');
+    ttlet nr_digits = hex ? 10 : 6;
+    ttlet digit_value = _mm_set1_epi8(hex ? 0 : 26);
+    ttlet nr_letters = hex ? 22 : 26;
+    ttlet letter_value = _mm_set1_epi8(hex ? 10 : 0);
+
+    ttlet byte_order = _mm_setr_epi8(4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1);
+
+    while (last - ptr >= 16) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+
+        ttlet digits = _mm_sub_epi8(chars, first_digit);
+        ttlet is_digit = less_equal_epu8(digits, narrow_cast<char>(nr_digits - 1));
+        ttlet letters = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        ttlet is_letter = less_equal_epu8(letters, narrow_cast<char>(nr_letters - 1));
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff) {
+            return;
+        }
+
+        ttlet values =
+            _mm_blendv_epi8(_mm_add_epi8(letters, letter_value), _mm_add_epi8(digits, digit_value), is_digit);
+
+        // Merge 5 bit values into 10 bits, then 20 bits, then the 40 bits of a block.
+        ttlet v10 = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0120));
+        ttlet v20 = _mm_madd_epi16(v10, _mm_set1_epi32(0x0001'0400));
+        ttlet v40 = _mm_or_si128(
+            _mm_slli_epi64(_mm_and_si128(v20, _mm_set1_epi64x(0xffff'ffff)), 20), _mm_srli_epi64(v20, 32));
+
+        store_10(out, _mm_shuffle_epi8(v40, byte_order));
+        ptr += 16;
+        out += 10;
+    }
+}
+
+void base64_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out, bool url) noexcept
+{
+    // Each 32 bit lane gets the 3 bytes of a block as {b1, b0, b2, b1}.
+    ttlet triplets = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    // The offset from a value to its character, indexed by the range the value is in.
+    ttlet offsets = _mm_setr_epi8(
+        'a' - 26,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        '0' - 52,
+        url ? '-' - 62 : '+' - 62,
+        url ? '_' - 63 : '/' - 63,
+        'A',
+        0,
+        0);
+
+    while (last - ptr >= 16) {
+        ttlet bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr)), triplets);
+
+        // Move each 6 bit value into its own byte.
+        ttlet ac = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0'fc00)), _mm_set1_epi32(0x0400'0040));
+        ttlet bd = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f'03f0)), _mm_set1_epi32(0x0100'0010));
+        ttlet values = _mm_or_si128(ac, bd);
+
+        // 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12
+        auto range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+        range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), values), _mm_set1_epi8(13)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range)));
+        ptr += 12;
+        out += 16;
+    }
+}
+
+void base64_decode_SSE(char const *&ptr, char const *last, std::byte *&out, bool url) noexcept
+{
+    // A character is valid when the entries for its low and high nibble have no bits in common.
+    // Each bit of the high nibble table selects a row of characters:
+    //  - 0x01: 0x2_, of which only '+' and '/', or '-', are valid.
+    //  - 0x02: 0x3_, only the digits.
+    //  - 0x04: 0x4_ and 0x6_, all but '@' and '`'.
+    //  - 0x08: 0x5_, up to 'Z' and for the url alphabet '_'; for the standard alphabet also 0x7_.
+    //  - 0x10: all other rows, never valid.
+    //  - 0x20: 0x7_ for the url alphabet, up to 'z'.
+    ttlet lo_table = url ? _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33) :
+                           _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    ttlet hi_table = url ? _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10) :
+                           _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+
+    // The offset from a character to its value, indexed by the high nibble. For the standard
+    // alphabet '/' is moved to index 1; for the url alphabet '_' is corrected afterwards.
+    ttlet roll_table = url ? _mm_setr_epi8(0, 0, 62 - '-', 52 - '0', -'A', -'A', 26 - 'a', 26 - 'a', 0, 0, 0, 0, 0, 0, 0, 0) :
+                             _mm_setr_epi8(0, 63 - '/', 62 - '+', 52 - '0', -'A', -'A', 26 - 'a', 26 - 'a', 0, 0, 0, 0, 0, 0, 0, 0);
+    ttlet nibble_mask = _mm_set1_epi8(0x0f);
+
+    ttlet byte_order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    while (last - ptr >= 16) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr));
+        ttlet hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibble_mask);
+        ttlet lo_nibbles = _mm_and_si128(chars, nibble_mask);
+
+        if (!_mm_testz_si128(_mm_shuffle_epi8(lo_table, lo_nibbles), _mm_shuffle_epi8(hi_table, hi_nibbles))) {
+            return;
+        }
+
+        __m128i values;
+        if (url) {
+            ttlet underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+            values = _mm_add_epi8(chars, _mm_shuffle_epi8(roll_table, hi_nibbles));
+            values = _mm_add_epi8(values, _mm_and_si128(underscore, _mm_set1_epi8(63 - ('_' - 'A'))));
+        } else {
+            ttlet slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+            values = _mm_add_epi8(chars, _mm_shuffle_epi8(roll_table, _mm_add_epi8(slash, hi_nibbles)));
+        }
+
+        // Merge 6 bit values into 12 bits, then into the 24 bits of a block.
+        ttlet v12 = _mm_maddubs_epi16(values, _mm_set1_epi32(0x0140'0140));
+        ttlet v24 = _mm_madd_epi16(v12, _mm_set1_epi32(0x0001'1000));
+
+        store_12(out, _mm_shuffle_epi8(v24, byte_order));
+        ptr += 16;
+        out += 12;
+    }
+}
+
+#endif
+
+} // namespace tt::detail
@@ -6,12 +6,16 @@
 #include "../required.hpp"
 #include "../assert.hpp"
 #include "../check.hpp"
+#include "../exception.hpp"
+#include "../os_detect.hpp"
 #include <span>
 #include <string>
 #include <cstdint>
 #include <array>
 #include <string>
 #include <string_view>
+#include <bit>
+#include <type_traits>
 
 #pragma once
 
@@ -82,8 +86,10 @@ struct base_n_alphabet {
 
     constexpr int8_t int_from_char(char c) const noexcept
     {
-        return int_from_char_table[narrow_cast<size_t>(c)];
+        return int_from_char_table[static_cast<uint8_t>(c)];
     }
+
+    [[nodiscard]] constexpr friend bool operator==(base_n_alphabet const &lhs, base_n_alphabet const &rhs) noexcept = default;
 };
 
 constexpr auto base2_alphabet = base_n_alphabet{"01"};
@@ -110,6 +116,21 @@ constexpr auto base85_rfc1924_alphabet =
 constexpr auto base85_btoa_alphabet =
     base_n_alphabet{"!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstu"};
 
+#if TT_PROCESSOR == TT_CPU_X64
+/* Vectorized encoders and decoders for the standard alphabets.
+ *
+ * Each function handles as many groups of whole blocks as possible and advances the pointers
+ * past them; the caller handles the rest. The decoders stop at a group that contains a character
+ * which is not in the alphabet, such as white-space, padding or an invalid character.
+ */
+void base16_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out) noexcept;
+void base16_decode_SSE(char const *&ptr, char const *last, std::byte *&out) noexcept;
+void base32_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out, bool hex) noexcept;
+void base32_decode_SSE(char const *&ptr, char const *last, std::byte *&out, bool hex) noexcept;
+void base64_encode_SSE(std::byte const *&ptr, std::byte const *last, char *&out, bool url) noexcept;
+void base64_decode_SSE(char const *&ptr, char const *last, std::byte *&out, bool url) noexcept;
+#endif
+
 } // namespace detail
 
 template<detail::base_n_alphabet Alphabet, int CharsPerBlock, int BytesPerBlock>
@@ -153,7 +174,7 @@ public:
             block |= static_cast<long long>(*(ptr++)) << shift;
 
             if (++byte_index_in_block == bytes_per_block) {
-                encode_block(block, bytes_per_block, output);
+                output = encode_block(block, bytes_per_block, output);
                 block = 0;
                 byte_index_in_block = 0;
             }
@@ -185,7 +206,11 @@ public:
      */
     static constexpr std::string encode(std::span<std::byte const> bytes) noexcept
     {
-        return encode(begin(bytes), end(bytes));
+        auto r = std::string{};
+        auto e = encoder{};
+        e.feed(bytes, r);
+        e.finish(r);
+        return r;
     }
 
     /** Decodes a UTF-8 string into bytes.
@@ -216,7 +241,7 @@ public:
                 block += digit;
 
                 if (++char_index_in_block == chars_per_block) {
-                    decode_block(block, chars_per_block, output);
+                    output = decode_block(block, bytes_per_block, output);
                     block = 0;
                     char_index_in_block = 0;
                 }
@@ -228,52 +253,283 @@ public:
             for (auto i = char_index_in_block; i != chars_per_block; ++i) {
                 block *= radix;
             }
-            decode_block(block, char_index_in_block, output);
+            decode_block(block, nr_bytes_for_chars(char_index_in_block), output);
         }
         return ptr;
     }
 
-    static constexpr bstring decode(std::string_view str)
+    /** Decodes a string into bytes.
+     *
+     * @param str The base-n encoded text.
+     * @param strict Only accept the canonical encoding, see `decoder`.
+     * @return The decoded bytes.
+     * @throw parse_error When the text contains an invalid character or is not canonical in strict mode.
+     */
+    static constexpr bstring decode(std::string_view str, bool strict = false)
     {
         auto r = bstring{};
-        auto i = decode(begin(str), end(str), std::back_inserter(r));
-        tt_parse_check(i == end(str));
+        auto d = decoder{strict};
+        d.feed(str, r);
+        d.finish(r);
         return r;
     }
 
-private:
-    template<typename ItOut>
-    static constexpr void encode_block(long long block, long long nr_bytes, ItOut output) noexcept
+    /** The number of characters used to encode the bytes of a partial block.
+     *
+     * This is the smallest number of characters which can represent every value of the bytes.
+     */
+    [[nodiscard]] static constexpr long long nr_chars_for_bytes(long long nr_bytes) noexcept
     {
-        ttlet padding = bytes_per_block - nr_bytes;
+        tt_axiom(nr_bytes >= 0 && nr_bytes <= bytes_per_block);
+
+        ttlet bytes_range = 1LL << (8 * nr_bytes);
+        auto chars_range = 1LL;
+        auto nr_chars = 0LL;
+        while (chars_range < bytes_range) {
+            chars_range *= radix;
+            ++nr_chars;
+        }
+        return nr_chars;
+    }
 
-        // Construct a block in little-endian, using easy division/modulo.
-        auto char_block = std::string{};
-        for (long long i = 0; i != chars_per_block; ++i) {
-            ttlet v = block % radix;
-            block /= radix;
+    /** The number of bytes encoded in the characters of a partial block.
+     */
+    [[nodiscard]] static constexpr long long nr_bytes_for_chars(long long nr_chars) noexcept
+    {
+        tt_axiom(nr_chars >= 0 && nr_chars <= chars_per_block);
+
+        if (nr_chars == chars_per_block) {
+            return bytes_per_block;
+        }
+
+        auto nr_bytes = 0LL;
+        while (nr_bytes + 1 < bytes_per_block && nr_chars_for_bytes(nr_bytes + 1) <= nr_chars) {
+            ++nr_bytes;
+        }
+        return nr_bytes;
+    }
 
-            if (i < padding) {
-                tt_assume(v != 0);
-                if (padding_char != 0) {
-                    char_block += padding_char;
+    /** An encoder for data which arrives in chunks.
+     */
+    class encoder {
+    public:
+        /** Encode a chunk of bytes.
+         *
+         * The bytes of an incomplete block are kept until the next call to `feed()` or `finish()`.
+         *
+         * @param bytes The next chunk of bytes.
+         * @param output The string to append the characters to.
+         */
+        constexpr void feed(std::span<std::byte const> bytes, std::string &output) noexcept
+        {
+            auto ptr = bytes.data();
+            ttlet last = ptr + bytes.size();
+
+            // Complete the block started by the previous chunk.
+            while (_nr_bytes != 0 && ptr != last) {
+                add_byte(*(ptr++), output);
+            }
+
+            ttlet nr_blocks = (last - ptr) / bytes_per_block;
+            if (nr_blocks != 0) {
+                ttlet offset = output.size();
+                output.resize(offset + nr_blocks * chars_per_block);
+                auto out = output.data() + offset;
+
+                if (!std::is_constant_evaluated()) {
+                    encode_SIMD(ptr, last, out);
+                }
+
+                for (; last - ptr >= bytes_per_block; ptr += bytes_per_block) {
+                    auto block = 0LL;
+                    for (long long i = 0; i != bytes_per_block; ++i) {
+                        block <<= 8;
+                        block |= static_cast<long long>(ptr[i]);
+                    }
+                    out = encode_block(block, bytes_per_block, out);
                 }
-            } else {
-                char_block += char_from_int(v);
+            }
+
+            while (ptr != last) {
+                add_byte(*(ptr++), output);
             }
         }
 
+        /** Encode the last incomplete block.
+         *
+         * @param output The string to append the characters to.
+         */
+        constexpr void finish(std::string &output) noexcept
+        {
+            if (_nr_bytes != 0) {
+                encode_block(_block, _nr_bytes, std::back_inserter(output));
+            }
+            _block = 0;
+            _nr_bytes = 0;
+        }
+
+    private:
+        long long _block = 0;
+        long long _nr_bytes = 0;
+
+        constexpr void add_byte(std::byte byte, std::string &output) noexcept
+        {
+            ttlet shift = 8 * ((bytes_per_block - 1) - _nr_bytes);
+            _block |= static_cast<long long>(byte) << shift;
+
+            if (++_nr_bytes == bytes_per_block) {
+                encode_block(_block, bytes_per_block, std::back_inserter(output));
+                _block = 0;
+                _nr_bytes = 0;
+            }
+        }
+    };
+
+    /** A decoder for text which arrives in chunks.
+     *
+     * By default white-space is ignored and the padding characters are optional. In strict mode
+     * only the canonical encoding is accepted:
+     *  - no white-space,
+     *  - for alphabets with a padding character, the last block is completed with padding,
+     *  - a partial last block has a valid number of characters, and
+     *  - for radix 16, 32 and 64 the unused bits of a partial last block are zero.
+     */
+    class decoder {
+    public:
+        constexpr explicit decoder(bool strict = false) noexcept : _strict(strict) {}
+
+        /** Decode a chunk of text.
+         *
+         * The characters of an incomplete block are kept until the next call to `feed()` or `finish()`.
+         *
+         * @param chunk The next chunk of the text.
+         * @param output The bytes to append the decoded data to.
+         * @throw parse_error When the text contains an invalid character or is not canonical in strict mode.
+         */
+        constexpr void feed(std::string_view chunk, bstring &output)
+        {
+            auto ptr = chunk.data();
+            ttlet last = ptr + chunk.size();
+
+            ttlet offset = output.size();
+            output.resize(offset + (chunk.size() + chars_per_block) / chars_per_block * bytes_per_block);
+            auto out = output.data() + offset;
+
+            while (true) {
+                if (_nr_chars == 0 && _nr_padding == 0 && !std::is_constant_evaluated()) {
+                    decode_SIMD(ptr, last, out);
+                }
+
+                if (ptr == last) {
+                    break;
+                }
+
+                ttlet c = *(ptr++);
+                ttlet digit = int_from_char<long long>(c);
+                if (digit >= 0) {
+                    if (_nr_padding != 0 && _strict) {
+                        throw parse_error("Unexpected character after padding in base-{} text", radix);
+                    }
+
+                    _block *= radix;
+                    _block += digit;
+                    if (++_nr_chars == chars_per_block) {
+                        out = decode_block(_block, bytes_per_block, out);
+                        _block = 0;
+                        _nr_chars = 0;
+                    }
+
+                } else if (padding_char != 0 && c == padding_char) {
+                    if (_strict) {
+                        ++_nr_padding;
+                        if (_nr_chars == 0 || _nr_chars + _nr_padding > chars_per_block) {
+                            throw parse_error("Unexpected padding in base-{} text", radix);
+                        }
+                    }
+
+                } else if (digit == -1) {
+                    if (_strict) {
+                        throw parse_error("Unexpected white-space in base-{} text", radix);
+                    }
+
+                } else {
+                    throw parse_error("Invalid character in base-{} text", radix);
+                }
+            }
+
+            output.resize(narrow_cast<size_t>(out - output.data()));
+        }
+
+        /** Decode the last incomplete block.
+         *
+         * @param output The bytes to append the decoded data to.
+         * @throw parse_error When the text does not end in a canonical way in strict mode.
+         */
+        constexpr void finish(bstring &output)
+        {
+            if (_nr_chars != 0) {
+                ttlet nr_bytes = nr_bytes_for_chars(_nr_chars);
+
+                for (auto i = _nr_chars; i != chars_per_block; ++i) {
+                    _block *= radix;
+                }
+
+                if (_strict) {
+                    if (nr_chars_for_bytes(nr_bytes) != _nr_chars) {
+                        throw parse_error("Incomplete block at end of base-{} text", radix);
+                    }
+                    if (padding_char != 0 && _nr_chars + _nr_padding != chars_per_block) {
+                        throw parse_error("Missing padding at end of base-{} text", radix);
+                    }
+                    if (std::has_single_bit(static_cast<unsigned long long>(radix)) &&
+                        (_block & ((1LL << (8 * (bytes_per_block - nr_bytes))) - 1)) != 0) {
+                        throw parse_error("Non-zero unused bits at end of base-{} text", radix);
+                    }
+                }
+
+                decode_block(_block, nr_bytes, std::back_inserter(output));
+            }
+
+            _block = 0;
+            _nr_chars = 0;
+            _nr_padding = 0;
+        }
+
+    private:
+        long long _block = 0;
+        long long _nr_chars = 0;
+        long long _nr_padding = 0;
+        bool _strict;
+    };
+
+private:
+    template<typename ItOut>
+    static constexpr ItOut encode_block(long long block, long long nr_bytes, ItOut output) noexcept
+    {
+        ttlet nr_chars = nr_chars_for_bytes(nr_bytes);
+
+        // Construct the characters from the least significant, using easy division/modulo.
+        auto char_block = std::array<char, chars_per_block>{};
+        for (auto i = chars_per_block - 1; i >= 0; --i) {
+            char_block[i] = char_from_int(block % radix);
+            block /= radix;
+        }
+
         // A block should be output as a big-endian radix-number.
-        std::copy(rbegin(char_block), rend(char_block), output);
+        output = std::copy(begin(char_block), begin(char_block) + nr_chars, output);
+
+        if constexpr (padding_char != 0) {
+            for (auto i = nr_chars; i != chars_per_block; ++i) {
+                *(output++) = padding_char;
+            }
+        }
+        return output;
     }
 
     template<typename ItOut>
-    static constexpr void decode_block(long long block, long long nr_chars, ItOut output) noexcept
+    static constexpr ItOut decode_block(long long block, long long nr_bytes, ItOut output) noexcept
     {
-        ttlet padding = chars_per_block - nr_chars;
-
-        // Construct a block in little-endian, using easy division/modulo.
-        for (long long i = 0; i != (bytes_per_block - padding); ++i) {
+        for (long long i = 0; i != nr_bytes; ++i) {
             ttlet shift = 8 * ((bytes_per_block - 1) - i);
             ttlet byte = static_cast<std::byte>((block >> shift) & 0xff);
 
@@ -281,6 +537,41 @@ private:
         }
 
         // The output data will not contain the padding.
+        return output;
+    }
+
+    static void encode_SIMD(std::byte const *&ptr, std::byte const *last, char *&out) noexcept
+    {
+#if TT_PROCESSOR == TT_CPU_X64
+        if constexpr (chars_per_block == 2 && alphabet == detail::base16_alphabet) {
+            detail::base16_encode_SSE(ptr, last, out);
+        } else if constexpr (chars_per_block == 8 && alphabet == detail::base32_rfc4648_alphabet) {
+            detail::base32_encode_SSE(ptr, last, out, false);
+        } else if constexpr (chars_per_block == 8 && alphabet == detail::base32hex_rfc4648_alphabet) {
+            detail::base32_encode_SSE(ptr, last, out, true);
+        } else if constexpr (chars_per_block == 4 && alphabet == detail::base64_rfc4648_alphabet) {
+            detail::base64_encode_SSE(ptr, last, out, false);
+        } else if constexpr (chars_per_block == 4 && alphabet == detail::base64url_rfc4648_alphabet) {
+            detail::base64_encode_SSE(ptr, last, out, true);
+        }
+#endif
+    }
+
+    static void decode_SIMD(char const *&ptr, char const *last, std::byte *&out) noexcept
+    {
+#if TT_PROCESSOR == TT_CPU_X64
+        if constexpr (chars_per_block == 2 && alphabet == detail::base16_alphabet) {
+            detail::base16_decode_SSE(ptr, last, out);
+        } else if constexpr (chars_per_block == 8 && alphabet == detail::base32_rfc4648_alphabet) {
+            detail::base32_decode_SSE(ptr, last, out, false);
+        } else if constexpr (chars_per_block == 8 && alphabet == detail::base32hex_rfc4648_alphabet) {
+            detail::base32_decode_SSE(ptr, last, out, true);
+        } else if constexpr (chars_per_block == 4 && alphabet == detail::base64_rfc4648_alphabet) {
+            detail::base64_decode_SSE(ptr, last, out, false);
+        } else if constexpr (chars_per_block == 4 && alphabet == detail::base64url_rfc4648_alphabet) {
+            detail::base64_decode_SSE(ptr, last, out, true);
+        }
+#endif
     }
 };
 
@@ -57,3 +57,205 @@ TEST(base_n, base64_decode) {
     ASSERT_EQ(base64::decode("SGVsb G8g\nV29ybGQK"), to_bstring("Hello World\n"));
     ASSERT_THROW(base64::decode("SGVsbG8g,V29ybGQK"), parse_error);
 }
+
+TEST(base_n, base16_decode)
+{
+    ASSERT_EQ(base16::decode(""), to_bstring(""));
+    ASSERT_EQ(base16::decode("66"), to_bstring("f"));
+    ASSERT_EQ(base16::decode("666F6F626172"), to_bstring("foobar"));
+    ASSERT_EQ(base16::decode("666f6f626172"), to_bstring("foobar"));
+    ASSERT_THROW(base16::decode("666G"), parse_error);
+    ASSERT_THROW(base16::decode("666", true), parse_error);
+}
+
+TEST(base_n, base32_encode)
+{
+    ASSERT_EQ(base32::encode(to_bstring("")), "");
+    ASSERT_EQ(base32::encode(to_bstring("f")), "MY");
+    ASSERT_EQ(base32::encode(to_bstring("fo")), "MZXQ");
+    ASSERT_EQ(base32::encode(to_bstring("foo")), "MZXW6");
+    ASSERT_EQ(base32::encode(to_bstring("foob")), "MZXW6YQ");
+    ASSERT_EQ(base32::encode(to_bstring("fooba")), "MZXW6YTB");
+    ASSERT_EQ(base32::encode(to_bstring("foobar")), "MZXW6YTBOI");
+
+    ASSERT_EQ(base32hex::encode(to_bstring("f")), "CO");
+    ASSERT_EQ(base32hex::encode(to_bstring("foobar")), "CPNMUOJ1E8");
+}
+
+TEST(base_n, base32_decode)
+{
+    ASSERT_EQ(base32::decode("MY"), to_bstring("f"));
+    ASSERT_EQ(base32::decode("MZXQ"), to_bstring("fo"));
+    ASSERT_EQ(base32::decode("MZXW6"), to_bstring("foo"));
+    ASSERT_EQ(base32::decode("MZXW6YQ"), to_bstring("foob"));
+    ASSERT_EQ(base32::decode("MZXW6YTB"), to_bstring("fooba"));
+    ASSERT_EQ(base32::decode("mzxw6ytboi"), to_bstring("foobar"));
+    ASSERT_EQ(base32hex::decode("CPNMUOJ1E8"), to_bstring("foobar"));
+
+    ASSERT_THROW(base32::decode("MZX", true), parse_error);
+    ASSERT_THROW(base32::decode("MZ", true), parse_error);
+}
+
+TEST(base_n, base64url)
+{
+    ASSERT_EQ(base64url::encode(to_bstring("\xfb\xff\xbf")), "-_-_");
+    ASSERT_EQ(base64url::decode("-_-_"), to_bstring("\xfb\xff\xbf"));
+    ASSERT_THROW(base64url::decode("+/+/"), parse_error);
+    ASSERT_THROW(base64::decode("-_-_"), parse_error);
+}
+
+TEST(base_n, base64_strict)
+{
+    ASSERT_EQ(base64::decode("Zm9vYg==", true), to_bstring("foob"));
+    ASSERT_EQ(base64::decode("Zm9vYmE=", true), to_bstring("fooba"));
+    ASSERT_EQ(base64::decode("Zm9vYmFy", true), to_bstring("foobar"));
+
+    // Missing or too much padding.
+    ASSERT_THROW(base64::decode("Zm9vYg", true), parse_error);
+    ASSERT_THROW(base64::decode("Zm9vYg=", true), parse_error);
+    ASSERT_THROW(base64::decode("Zm9vYg===", true), parse_error);
+    ASSERT_THROW(base64::decode("Zm9v====", true), parse_error);
+
+    // Data after padding.
+    ASSERT_THROW(base64::decode("Zg==Zm9v", true), parse_error);
+
+    // White-space.
+    ASSERT_THROW(base64::decode("Zm9v Zm9v", true), parse_error);
+
+    // Incomplete block.
+    ASSERT_THROW(base64::decode("Zm9vY===", true), parse_error);
+
+    // Non-zero unused bits.
+    ASSERT_THROW(base64::decode("Zh==", true), parse_error);
+    ASSERT_EQ(base64::decode("Zh=="), to_bstring("f"));
+}
+
+[[nodiscard]] static bstring make_base_n_test_data(size_t size)
+{
+    auto r = bstring{};
+    for (size_t i = 0; i != size; ++i) {
+        r += static_cast<std::byte>((i * 167 + size) & 0xff);
+    }
+    return r;
+}
+
+template<typename Base>
+static void test_base_n_round_trip()
+{
+    for (size_t size = 0; size != 300; ++size) {
+        ttlet data = make_base_n_test_data(size);
+
+        // The iterator interface does not use the vectorized kernels.
+        ttlet expected = Base::encode(data.begin(), data.end());
+        ttlet text = Base::encode(data);
+        ASSERT_EQ(text, expected);
+
+        ASSERT_EQ(Base::decode(text), data);
+        ASSERT_EQ(Base::decode(text, true), data);
+
+        auto lower_text = text;
+        for (auto &c : lower_text) {
+            if (Base::radix <= 32 && c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        ASSERT_EQ(Base::decode(lower_text), data);
+
+        // White-space between the lines.
+        auto lines = std::string{};
+        for (size_t i = 0; i < text.size(); i += 76) {
+            lines += text.substr(i, 76);
+            lines += "\r\n";
+        }
+        ASSERT_EQ(Base::decode(lines), data);
+        if (!text.empty()) {
+            ASSERT_THROW(Base::decode(lines, true), parse_error);
+        }
+
+        // An invalid character at every position of a vector.
+        if (size == 299) {
+            for (size_t i = 0; i != 64; ++i) {
+                auto invalid = text;
+                invalid[i] = '!';
+                ASSERT_THROW(Base::decode(invalid), parse_error);
+            }
+        }
+    }
+}
+
+TEST(base_n, round_trip)
+{
+    test_base_n_round_trip<base16>();
+    test_base_n_round_trip<base32>();
+    test_base_n_round_trip<base32hex>();
+    test_base_n_round_trip<base64>();
+    test_base_n_round_trip<base64url>();
+}
+
+template<typename Base>
+static void test_base_n_chunks()
+{
+    ttlet data = make_base_n_test_data(1000);
+    ttlet text = Base::encode(data);
+
+    for (ttlet chunk_size : {size_t{1}, size_t{3}, size_t{7}, size_t{16}, size_t{31}, size_t{100}}) {
+        auto encoded = std::string{};
+        auto encoder = typename Base::encoder{};
+        for (size_t i = 0; i < data.size(); i += chunk_size) {
+            encoder.feed(std::span(data).subspan(i, std::min(chunk_size, data.size() - i)), encoded);
+        }
+        encoder.finish(encoded);
+        ASSERT_EQ(encoded, text);
+
+        auto decoded = bstring{};
+        auto decoder = typename Base::decoder{true};
+        for (size_t i = 0; i < text.size(); i += chunk_size) {
+            decoder.feed(std::string_view(text).substr(i, chunk_size), decoded);
+        }
+        decoder.finish(decoded);
+        ASSERT_EQ(decoded, data);
+    }
+}
+
+TEST(base_n, chunks)
+{
+    test_base_n_chunks<base16>();
+    test_base_n_chunks<base32>();
+    test_base_n_chunks<base64>();
+    test_base_n_chunks<base64url>();
+}
+
+template<typename Base>
+static void test_base_n_all_characters()
+{
+    // Each character must be accepted or rejected the same by the vectorized and scalar decoders.
+    for (int c = 0; c != 256; ++c) {
+        auto text = std::string(64, 'A');
+        text[17] = static_cast<char>(c);
+
+        for (ttlet strict : {false, true}) {
+            auto expected = bstring{};
+            auto expected_valid = Base::decode(text.begin(), text.end(), std::back_inserter(expected)) == text.end();
+            if (strict) {
+                expected_valid &= Base::template int_from_char<int>(static_cast<char>(c)) >= 0;
+            }
+
+            auto valid = true;
+            try {
+                ASSERT_EQ(Base::decode(text, strict), expected);
+            } catch (parse_error const &) {
+                valid = false;
+            }
+            ASSERT_EQ(valid, expected_valid);
+        }
+    }
+}
+
+TEST(base_n, all_characters)
+{
+    test_base_n_all_characters<base16>();
+    test_base_n_all_characters<base32>();
+    test_base_n_all_characters<base32hex>();
+    test_base_n_all_characters<base64>();
+    test_base_n_all_characters<base64url>();
+}
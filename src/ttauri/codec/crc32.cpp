@@ -0,0 +1,158 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "crc32.hpp"
+#include "../endian.hpp"
+#include "../assert.hpp"
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#include <array>
+#include <cstring>
+
+namespace tt {
+
+/** Tables for calculating the crc 8 bytes at a time.
+ * Table 0 is the classic byte-at-a-time table of the reflected polynomial 0xedb88320,
+ * table n is the crc of a byte followed by n zero bytes.
+ */
+constexpr auto crc32_tables = []() {
+    auto r = std::array<std::array<uint32_t, 256>, 8>{};
+
+    for (uint32_t i = 0; i != 256; ++i) {
+        auto c = i;
+        for (int k = 0; k != 8; ++k) {
+            c = (c & 1) ? (c >> 1) ^ 0xedb8'8320 : c >> 1;
+        }
+        r[0][i] = c;
+    }
+
+    for (uint32_t i = 0; i != 256; ++i) {
+        for (int t = 1; t != 8; ++t) {
+            r[t][i] = (r[t - 1][i] >> 8) ^ r[0][r[t - 1][i] & 0xff];
+        }
+    }
+    return r;
+}();
+
+/** Calculate the crc using slice-by-8 tables.
+ *
+ * @param crc The inverted crc.
+ * @return The inverted crc.
+ */
+[[nodiscard]] static uint32_t crc32_slice_by_8(std::byte const *ptr, std::byte const *end, uint32_t crc) noexcept
+{
+    ttlet &t = crc32_tables;
+
+    while (end - ptr >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, ptr, sizeof(lo));
+        std::memcpy(&hi, ptr + 4, sizeof(hi));
+        lo = little_to_native(lo) ^ crc;
+        hi = little_to_native(hi);
+
+        // clang-format off
+        crc =
+            t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        // clang-format on
+        ptr += 8;
+    }
+
+    while (ptr != end) {
+        crc = (crc >> 8) ^ t[0][(crc ^ static_cast<uint8_t>(*ptr++)) & 0xff];
+    }
+    return crc;
+}
+
+/** Calculate the crc by folding 64 bytes at a time with carry-less multiplication.
+ * The constants are from "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+ * by Gopal, Ozturk, Guilford, et al., for the bit-reflected polynomial.
+ *
+ * @param size The number of bytes, at least 64 and a multiple of 16.
+ * @param crc The inverted crc.
+ * @return The inverted crc.
+ */
+[[nodiscard]] static uint32_t crc32_fold(std::byte const *ptr, ssize_t size, uint32_t crc) noexcept
+{
+    tt_axiom(size >= 64 && size % 16 == 0);
+
+    ttlet k1k2 = _mm_set_epi64x(0x01'c6e4'1596, 0x01'5444'2bd4);
+    ttlet k3k4 = _mm_set_epi64x(0x00'ccaa'009e, 0x01'7519'97d0);
+    ttlet k5k0 = _mm_set_epi64x(0x00'0000'0000, 0x01'63cd'6124);
+    ttlet poly = _mm_set_epi64x(0x01'f701'1641, 0x01'db71'0641);
+    ttlet mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+
+    auto load = [](std::byte const *p) {
+        return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+    };
+
+    auto fold = [](__m128i x, __m128i k, __m128i y) {
+        ttlet lo = _mm_clmulepi64_si128(x, k, 0x00);
+        ttlet hi = _mm_clmulepi64_si128(x, k, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(hi, lo), y);
+    };
+
+    auto x1 = _mm_xor_si128(load(ptr), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    auto x2 = load(ptr + 0x10);
+    auto x3 = load(ptr + 0x20);
+    auto x4 = load(ptr + 0x30);
+    ptr += 64;
+    size -= 64;
+
+    // Fold four independent streams of 128 bits, 64 bytes at a time.
+    while (size >= 64) {
+        x1 = fold(x1, k1k2, load(ptr));
+        x2 = fold(x2, k1k2, load(ptr + 0x10));
+        x3 = fold(x3, k1k2, load(ptr + 0x20));
+        x4 = fold(x4, k1k2, load(ptr + 0x30));
+        ptr += 64;
+        size -= 64;
+    }
+
+    // Fold the four streams together, then fold the remaining 16 byte blocks.
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+    while (size >= 16) {
+        x1 = fold(x1, k3k4, load(ptr));
+        ptr += 16;
+        size -= 16;
+    }
+
+    // Fold 128 bits to 64 bits.
+    auto y = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), y);
+
+    y = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, y);
+
+    // Barrett reduction to 32 bits.
+    y = _mm_and_si128(x1, mask32);
+    y = _mm_clmulepi64_si128(y, poly, 0x10);
+    y = _mm_and_si128(y, mask32);
+    y = _mm_clmulepi64_si128(y, poly, 0x00);
+    x1 = _mm_xor_si128(x1, y);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+uint32_t crc32(std::span<std::byte const> bytes, uint32_t crc) noexcept
+{
+    auto ptr = bytes.data();
+    ttlet end = ptr + std::ssize(bytes);
+
+    crc = ~crc;
+    if (ttlet fold_size = std::ssize(bytes) & ~ssize_t{15}; fold_size >= 64) {
+        crc = crc32_fold(ptr, fold_size, crc);
+        ptr += fold_size;
+    }
+    crc = crc32_slice_by_8(ptr, end, crc);
+    return ~crc;
+}
+
+} // namespace tt
@@ -0,0 +1,29 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace tt {
+
+/** Calculate the CRC-32 of data.
+ * This is the CRC-32 of ISO-3309 as used by gzip and PNG.
+ *
+ * The crc can be calculated incrementally by passing the result of the
+ * previous call as the initial value of the next call.
+ *
+ * Large buffers are handled by folding 64 bytes at a time using carry-less multiplication,
+ * small buffers and the tail are handled using slice-by-8 tables.
+ *
+ * @param bytes The data to calculate the crc of.
+ * @param crc The crc of the preceding data, or zero.
+ * @return The crc of the preceding data together with `bytes`.
+ */
+[[nodiscard]] uint32_t crc32(std::span<std::byte const> bytes, uint32_t crc = 0) noexcept;
+
+} // namespace tt
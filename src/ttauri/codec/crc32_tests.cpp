@@ -0,0 +1,54 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/crc32.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/byte_string.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace tt;
+
+/** Reference implementation, one bit at a time.
+ */
+static uint32_t crc32_reference(std::span<std::byte const> bytes)
+{
+    uint32_t crc = 0xffff'ffff;
+    for (ttlet c : bytes) {
+        crc ^= static_cast<uint8_t>(c);
+        for (int k = 0; k != 8; ++k) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb8'8320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+TEST(CRC32, CheckValue) {
+    ASSERT_EQ(crc32(to_bstring("")), 0);
+    ASSERT_EQ(crc32(to_bstring("123456789")), 0xcbf4'3926);
+    ASSERT_EQ(crc32(to_bstring("The quick brown fox jumps over the lazy dog")), 0x414f'a339);
+}
+
+TEST(CRC32, SameAsReference) {
+    ttlet bytes = make_random_bytes(1000);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    // Lengths and alignments crossing the folding and table based paths.
+    for (ssize_t offset = 0; offset != 17; ++offset) {
+        for (ssize_t size = 0; size < 900; size += 7) {
+            ttlet data = span.subspan(offset, size);
+            ASSERT_EQ(crc32(data), crc32_reference(data));
+        }
+    }
+}
+
+TEST(CRC32, Incremental) {
+    ttlet bytes = make_random_bytes(5000);
+    ttlet span = std::span<std::byte const>(bytes);
+
+    for (ssize_t split = 0; split < 5000; split += 333) {
+        ASSERT_EQ(crc32(span.subspan(split), crc32(span.first(split))), crc32(span));
+    }
+}
@@ -0,0 +1,715 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "deflate.hpp"
+#include "../bit_writer.hpp"
+#include "../endian.hpp"
+#include "../assert.hpp"
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <bit>
+#include <cstring>
+
+namespace tt {
+
+constexpr auto deflate_length_base = std::array<uint16_t, 29>{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr auto deflate_length_extra = std::array<uint8_t, 29>{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+constexpr auto deflate_distance_base = std::array<uint16_t, 30>{
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr auto deflate_distance_extra = std::array<uint8_t, 30>{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/** The order in which the code lengths of the code length alphabet are written.
+ */
+constexpr auto deflate_code_length_order = std::array<int, 19>{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/** The length code (0-28) for each length 0-258.
+ */
+constexpr auto deflate_length_codes = []() {
+    auto r = std::array<uint8_t, 259>{};
+    for (int i = 0; i != 29; ++i) {
+        for (int length = deflate_length_base[i]; length < deflate_length_base[i] + (1 << deflate_length_extra[i]); ++length) {
+            r[length] = static_cast<uint8_t>(i);
+        }
+    }
+    // Length 258 has its own code, even though it can also be encoded by code 27.
+    r[258] = 28;
+    return r;
+}();
+
+/** The distance code (0-29) for distance - 1 below 256, and for 256 + (distance - 1) / 128 above.
+ */
+constexpr auto deflate_distance_codes = []() {
+    auto r = std::array<uint8_t, 512>{};
+    for (int i = 0; i != 30; ++i) {
+        for (int distance = deflate_distance_base[i]; distance < deflate_distance_base[i] + (1 << deflate_distance_extra[i]);
+             ++distance) {
+            ttlet index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+            r[index] = static_cast<uint8_t>(i);
+        }
+    }
+    return r;
+}();
+
+[[nodiscard]] static int deflate_distance_code(int distance) noexcept
+{
+    return distance <= 256 ? deflate_distance_codes[distance - 1] : deflate_distance_codes[256 + ((distance - 1) >> 7)];
+}
+
+/** The code lengths of the fixed huffman literal/length code.
+ */
+constexpr auto deflate_fixed_literal_lengths = []() {
+    auto r = std::array<int, 288>{};
+    for (int i = 0; i != 288; ++i) {
+        r[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    return r;
+}();
+
+constexpr auto deflate_fixed_distance_lengths = []() {
+    auto r = std::array<int, 30>{};
+    for (auto &length : r) {
+        length = 5;
+    }
+    return r;
+}();
+
+/** Calculate length limited huffman code lengths.
+ *
+ * A huffman tree is built from the frequencies. When the tree is too deep, the number
+ * of codes of each length is adjusted so that no code is longer than the maximum,
+ * after which the codes are assigned to the symbols in order of frequency.
+ *
+ * @param frequencies The frequency of each symbol.
+ * @param max_length The maximum code length.
+ * @return The code length of each symbol, zero for symbols that do not occur.
+ */
+[[nodiscard]] static std::vector<int> deflate_code_lengths(std::span<uint32_t const> frequencies, int max_length) noexcept
+{
+    auto r = std::vector<int>(frequencies.size(), 0);
+
+    auto symbols = std::vector<int>{};
+    for (int symbol = 0; symbol != std::ssize(frequencies); ++symbol) {
+        if (frequencies[symbol] != 0) {
+            symbols.push_back(symbol);
+        }
+    }
+
+    if (symbols.empty()) {
+        return r;
+    } else if (symbols.size() == 1) {
+        r[symbols.front()] = 1;
+        return r;
+    }
+
+    // Least frequent symbols first, they will get the longest codes.
+    std::stable_sort(symbols.begin(), symbols.end(), [&](ttlet a, ttlet b) {
+        return frequencies[a] < frequencies[b];
+    });
+
+    // Build the huffman tree; the leaves are the sorted symbols, followed by the internal nodes.
+    ttlet nr_leaves = std::ssize(symbols);
+    auto parent = std::vector<int>(nr_leaves * 2 - 1, 0);
+
+    using node_type = std::pair<uint64_t, int>;
+    auto queue = std::priority_queue<node_type, std::vector<node_type>, std::greater<node_type>>{};
+    for (int i = 0; i != nr_leaves; ++i) {
+        queue.emplace(frequencies[symbols[i]], i);
+    }
+
+    auto next_node = static_cast<int>(nr_leaves);
+    while (queue.size() > 1) {
+        ttlet a = queue.top();
+        queue.pop();
+        ttlet b = queue.top();
+        queue.pop();
+        parent[a.second] = next_node;
+        parent[b.second] = next_node;
+        queue.emplace(a.first + b.first, next_node++);
+    }
+
+    // The depth of a node is one more than its parent, the root is the last node.
+    auto depth = std::vector<int>(parent.size(), 0);
+    for (auto i = std::ssize(parent) - 2; i >= 0; --i) {
+        depth[i] = depth[parent[i]] + 1;
+    }
+
+    // Count the number of codes of each length, clamping to the maximum length.
+    auto length_count = std::vector<int>(max_length + 1, 0);
+    for (int i = 0; i != nr_leaves; ++i) {
+        ++length_count[std::min(depth[i], max_length)];
+    }
+
+    // Fix the Kraft sum after clamping, by moving codes to longer lengths.
+    uint32_t total = 0;
+    for (int length = 1; length <= max_length; ++length) {
+        total += static_cast<uint32_t>(length_count[length]) << (max_length - length);
+    }
+    while (total != (uint32_t{1} << max_length)) {
+        --length_count[max_length];
+        for (int length = max_length - 1; length > 0; --length) {
+            if (length_count[length] != 0) {
+                --length_count[length];
+                length_count[length + 1] += 2;
+                break;
+            }
+        }
+        --total;
+    }
+
+    // Assign the longest codes to the least frequent symbols.
+    auto it = symbols.cbegin();
+    for (int length = max_length; length > 0; --length) {
+        for (int i = 0; i != length_count[length]; ++i) {
+            r[*it++] = length;
+        }
+    }
+    return r;
+}
+
+/** Calculate the canonical huffman codes from code lengths.
+ *
+ * @return For each symbol the code, bit reversed so that it can be written LSB first.
+ */
+[[nodiscard]] static std::vector<uint16_t> deflate_codes(std::span<int const> lengths) noexcept
+{
+    auto length_count = std::array<int, 16>{};
+    for (ttlet length : lengths) {
+        ++length_count[length];
+    }
+    length_count[0] = 0;
+
+    auto next_code = std::array<int, 16>{};
+    for (int length = 1; length != 16; ++length) {
+        next_code[length] = (next_code[length - 1] + length_count[length - 1]) << 1;
+    }
+
+    auto r = std::vector<uint16_t>(lengths.size(), 0);
+    for (ssize_t symbol = 0; symbol != std::ssize(lengths); ++symbol) {
+        ttlet length = lengths[symbol];
+        if (length != 0) {
+            ttlet code = next_code[length]++;
+            uint32_t reversed = 0;
+            for (int i = 0; i != length; ++i) {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            r[symbol] = static_cast<uint16_t>(reversed);
+        }
+    }
+    return r;
+}
+
+/** The number of bits needed to encode the symbols with the given code lengths.
+ */
+[[nodiscard]] static uint64_t deflate_cost(std::span<uint32_t const> frequencies, std::span<int const> lengths) noexcept
+{
+    uint64_t r = 0;
+    for (ssize_t i = 0; i != std::ssize(frequencies); ++i) {
+        r += static_cast<uint64_t>(frequencies[i]) * lengths[i];
+    }
+    return r;
+}
+
+deflate_compressor::deflate_compressor(int level) noexcept : _level(level)
+{
+    tt_axiom(level >= 0 && level <= 9);
+
+    // clang-format off
+    constexpr auto levels = std::array<level_type, 10>{{
+        {  0,   0,  0,    0}, // Stored.
+        {258,   0,  0,    0}, // Run-length encoding.
+        { 16,   5,  4,    8}, // Greedy.
+        { 32,   6,  4,   32},
+        { 16,   4,  4,   16}, // Lazy.
+        { 32,  16,  8,   32},
+        {128,  16,  8,  128},
+        {128,  32,  8,  256},
+        {258, 128, 32, 1024},
+        {258, 258, 32, 4096}
+    }};
+    // clang-format on
+    _parameters = levels[level];
+
+    _buffer.reserve(window_size * 2);
+    _symbols.reserve(max_block_symbols);
+    if (_level >= 2) {
+        _head.resize(hash_size, -1);
+        _prev.resize(window_size, -1);
+    }
+}
+
+uint32_t deflate_compressor::hash(ssize_t position) const noexcept
+{
+    ttlet *p = _buffer.data() + position;
+    ttlet x = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16);
+    return (x * 0x9e37'79b1) >> (32 - hash_bits);
+}
+
+/** Insert the string at position in the hash table.
+ *
+ * @return The previous position with the same hash, or -1.
+ */
+int32_t deflate_compressor::insert(ssize_t position) noexcept
+{
+    ttlet h = hash(position);
+    ttlet r = _head[h];
+    _prev[position % window_size] = r;
+    _head[h] = static_cast<int32_t>(position);
+    return r;
+}
+
+/** The number of bytes that are equal, up to max_length.
+ */
+[[nodiscard]] static tt_force_inline int deflate_match_length(std::byte const *a, std::byte const *b, int max_length) noexcept
+{
+    int r = 0;
+    while (r + 8 <= max_length) {
+        uint64_t x;
+        uint64_t y;
+        std::memcpy(&x, a + r, sizeof(x));
+        std::memcpy(&y, b + r, sizeof(y));
+        if (ttlet diff = little_to_native(x) ^ little_to_native(y)) {
+            return r + std::countr_zero(diff) / 8;
+        }
+        r += 8;
+    }
+    while (r < max_length && a[r] == b[r]) {
+        ++r;
+    }
+    return r;
+}
+
+/** Find the longest match by following the hash chain.
+ *
+ * @param position The position of the string to find a match for.
+ * @param chain The first position in the hash chain.
+ * @param prev_length Only matches longer than this are considered.
+ * @param [out] distance The distance of the match, when a longer match was found.
+ * @return The length of the longest match, or prev_length if no longer match was found.
+ */
+int deflate_compressor::longest_match(ssize_t position, int32_t chain, int prev_length, int &distance) const noexcept
+{
+    ttlet max_length = static_cast<int>(std::min(ssize_t{max_match}, std::ssize(_buffer) - position));
+    ttlet nice_length = std::min(_parameters.nice_length, max_length);
+    // Stop at positions that are too far away, or at the end of the chain.
+    ttlet limit = std::max(position - window_size, ssize_t{-1});
+    ttlet *scan = _buffer.data() + position;
+
+    auto best_length = prev_length;
+    if (best_length >= max_length) {
+        return best_length;
+    }
+
+    auto chain_length = prev_length >= _parameters.good_length ? _parameters.max_chain >> 2 : _parameters.max_chain;
+    while (chain > limit && chain_length-- > 0) {
+        ttlet *match = _buffer.data() + chain;
+
+        // Quickly reject matches that can not be longer than the best match.
+        if (match[best_length] == scan[best_length] && match[0] == scan[0] && match[1] == scan[1]) {
+            ttlet length = deflate_match_length(scan, match, max_length);
+            if (length > best_length) {
+                best_length = length;
+                distance = static_cast<int>(position - chain);
+                if (length >= nice_length) {
+                    break;
+                }
+            }
+        }
+
+        chain = _prev[chain % window_size];
+    }
+    return best_length;
+}
+
+/** The length of the run of the previous byte.
+ */
+int deflate_compressor::run_length(ssize_t position) const noexcept
+{
+    if (position == 0) {
+        return 0;
+    }
+
+    ttlet max_length = static_cast<int>(std::min(ssize_t{max_match}, std::ssize(_buffer) - position));
+    ttlet *scan = _buffer.data() + position;
+    return deflate_match_length(scan, scan - 1, max_length);
+}
+
+void deflate_compressor::add_literal(bstring &output, std::byte c) noexcept
+{
+    _symbols.push_back({static_cast<uint16_t>(c), 0});
+    ++_literal_frequencies[static_cast<uint8_t>(c)];
+
+    if (std::ssize(_symbols) == max_block_symbols) {
+        write_block(output, false);
+    }
+}
+
+void deflate_compressor::add_match(bstring &output, int length, int distance) noexcept
+{
+    tt_axiom(length >= min_match && length <= max_match);
+    tt_axiom(distance >= 1 && distance <= window_size);
+
+    _symbols.push_back({static_cast<uint16_t>(length), static_cast<uint16_t>(distance)});
+    ++_literal_frequencies[257 + deflate_length_codes[length]];
+    ++_distance_frequencies[deflate_distance_code(distance)];
+
+    if (std::ssize(_symbols) == max_block_symbols) {
+        write_block(output, false);
+    }
+}
+
+/** Move the second half of the buffer to the first half.
+ * The data that is moved out is no longer reachable by back-references.
+ */
+void deflate_compressor::slide(bstring &output) noexcept
+{
+    tt_axiom(_position >= window_size);
+
+    // The current block must not reference data that is moved out of the buffer.
+    if (_block_start < window_size) {
+        write_block(output, false);
+    }
+    tt_axiom(_block_start >= window_size);
+
+    _buffer.erase(0, window_size);
+    _position -= window_size;
+    _block_start -= window_size;
+
+    auto rebase = [](int32_t &x) {
+        x = x >= window_size ? static_cast<int32_t>(x - window_size) : -1;
+    };
+    std::for_each(_head.begin(), _head.end(), rebase);
+    std::for_each(_prev.begin(), _prev.end(), rebase);
+}
+
+/** Find matches using greedy matching; or run-length encoding for level 1.
+ */
+void deflate_compressor::process_greedy(bstring &output, bool finish) noexcept
+{
+    while (true) {
+        ttlet lookahead = std::ssize(_buffer) - _position;
+        if (lookahead == 0 || (lookahead < min_lookahead && !finish)) {
+            break;
+        }
+
+        int length = 0;
+        int distance = 0;
+        if (_level == 1) {
+            length = run_length(_position);
+            distance = 1;
+
+        } else if (lookahead >= min_match) {
+            ttlet chain = insert(_position);
+            length = longest_match(_position, chain, min_match - 1, distance);
+            if (length == min_match && distance > 4096) {
+                // A short match far away costs more bits than the literals.
+                length = 0;
+            }
+        }
+
+        if (length >= min_match) {
+            add_match(output, length, distance);
+
+            if (_level != 1 && length <= _parameters.max_lazy) {
+                ttlet end = _position + length;
+                for (auto i = _position + 1; i < end && std::ssize(_buffer) - i >= min_match; ++i) {
+                    (void)insert(i);
+                }
+            }
+            _position += length;
+
+        } else {
+            add_literal(output, _buffer[_position++]);
+        }
+    }
+}
+
+/** Find matches using lazy matching.
+ * A match is only used when the match at the next position is not longer,
+ * otherwise a literal is emitted and the match at the next position is considered.
+ */
+void deflate_compressor::process_lazy(bstring &output, bool finish) noexcept
+{
+    while (true) {
+        ttlet lookahead = std::ssize(_buffer) - _position;
+        if (lookahead == 0 || (lookahead < min_lookahead && !finish)) {
+            break;
+        }
+
+        int32_t chain = -1;
+        if (lookahead >= min_match) {
+            chain = insert(_position);
+        }
+
+        int length = min_match - 1;
+        int distance = 0;
+        if (chain >= 0 && _prev_length < _parameters.max_lazy) {
+            length = longest_match(_position, chain, _prev_length, distance);
+            if (length == min_match && distance > 4096) {
+                // A short match far away costs more bits than the literals.
+                length = min_match - 1;
+            }
+        }
+
+        if (_prev_length >= min_match && length <= _prev_length) {
+            // The match at the previous position is at least as long, use it.
+            add_match(output, _prev_length, _prev_distance);
+
+            // The previous and current positions are already inserted.
+            ttlet end = _position - 1 + _prev_length;
+            for (++_position; _position < end; ++_position) {
+                if (std::ssize(_buffer) - _position >= min_match) {
+                    (void)insert(_position);
+                }
+            }
+
+            _match_available = false;
+            _prev_length = min_match - 1;
+
+        } else {
+            if (_match_available) {
+                add_literal(output, _buffer[_position - 1]);
+            }
+            _match_available = true;
+            _prev_length = length;
+            _prev_distance = distance;
+            ++_position;
+        }
+    }
+
+    if (finish && _match_available) {
+        add_literal(output, _buffer[_position - 1]);
+        _match_available = false;
+    }
+}
+
+void deflate_compressor::process(bstring &output, bool finish) noexcept
+{
+    if (_level == 0) {
+        _position = std::ssize(_buffer);
+    } else if (_level <= 3) {
+        process_greedy(output, finish);
+    } else {
+        process_lazy(output, finish);
+    }
+
+    if (!finish && std::ssize(_buffer) == window_size * 2) {
+        slide(output);
+    }
+}
+
+void deflate_compressor::write_block(bstring &output, bool final_block) noexcept
+{
+    // The number of bytes of input in this block.
+    auto size = ssize_t{0};
+    if (_level == 0) {
+        size = _position - _block_start;
+    } else {
+        for (ttlet &symbol : _symbols) {
+            size += symbol.distance == 0 ? 1 : symbol.value;
+        }
+    }
+
+    if (size == 0 && !final_block) {
+        return;
+    }
+
+    auto writer = bit_writer{output, _accumulator, _bit_count};
+
+    // Determine the dynamic huffman codes.
+    _literal_frequencies[256] = 1;
+    ttlet literal_lengths = deflate_code_lengths(_literal_frequencies, 15);
+    auto distance_lengths = deflate_code_lengths(_distance_frequencies, 15);
+    if (std::all_of(distance_lengths.begin(), distance_lengths.end(), [](ttlet x) { return x == 0; })) {
+        // At least one distance code must be written.
+        distance_lengths[0] = 1;
+    }
+
+    ttlet nr_literal_codes =
+        std::max(257, static_cast<int>(std::distance(
+                          std::find_if(literal_lengths.rbegin(), literal_lengths.rend(), [](ttlet x) { return x != 0; }),
+                          literal_lengths.rend())));
+    ttlet nr_distance_codes = static_cast<int>(std::distance(
+        std::find_if(distance_lengths.rbegin(), distance_lengths.rend(), [](ttlet x) { return x != 0; }),
+        distance_lengths.rend()));
+
+    auto lengths = std::vector<int>{};
+    lengths.insert(lengths.end(), literal_lengths.begin(), literal_lengths.begin() + nr_literal_codes);
+    lengths.insert(lengths.end(), distance_lengths.begin(), distance_lengths.begin() + nr_distance_codes);
+
+    // Run-length encode the code lengths: symbol 16 repeats the previous length 3-6 times,
+    // 17 repeats zero 3-10 times and 18 repeats zero 11-138 times.
+    auto code_length_symbols = std::vector<std::pair<int, int>>{};
+    for (ssize_t i = 0; i != std::ssize(lengths);) {
+        ttlet length = lengths[i];
+        auto run = ssize_t{1};
+        while (i + run != std::ssize(lengths) && lengths[i + run] == length) {
+            ++run;
+        }
+        i += run;
+
+        if (length == 0) {
+            while (run >= 11) {
+                ttlet n = std::min(run, ssize_t{138});
+                code_length_symbols.emplace_back(18, static_cast<int>(n - 11));
+                run -= n;
+            }
+            if (run >= 3) {
+                code_length_symbols.emplace_back(17, static_cast<int>(run - 3));
+                run = 0;
+            }
+        } else {
+            code_length_symbols.emplace_back(length, 0);
+            --run;
+            while (run >= 3) {
+                ttlet n = std::min(run, ssize_t{6});
+                code_length_symbols.emplace_back(16, static_cast<int>(n - 3));
+                run -= n;
+            }
+        }
+        for (; run != 0; --run) {
+            code_length_symbols.emplace_back(length, 0);
+        }
+    }
+
+    auto code_length_frequencies = std::array<uint32_t, 19>{};
+    for (ttlet &[symbol, extra] : code_length_symbols) {
+        ++code_length_frequencies[symbol];
+    }
+    ttlet code_length_lengths = deflate_code_lengths(code_length_frequencies, 7);
+    auto nr_code_length_codes = 19;
+    while (nr_code_length_codes > 4 && code_length_lengths[deflate_code_length_order[nr_code_length_codes - 1]] == 0) {
+        --nr_code_length_codes;
+    }
+
+    // Calculate the size of each type of block.
+    uint64_t extra_bits = 0;
+    for (int i = 0; i != 29; ++i) {
+        extra_bits += static_cast<uint64_t>(_literal_frequencies[257 + i]) * deflate_length_extra[i];
+    }
+    for (int i = 0; i != 30; ++i) {
+        extra_bits += static_cast<uint64_t>(_distance_frequencies[i]) * deflate_distance_extra[i];
+    }
+
+    ttlet dynamic_bits = 3 + 5 + 5 + 4 + 3 * nr_code_length_codes + deflate_cost(code_length_frequencies, code_length_lengths) +
+        2 * code_length_frequencies[16] + 3 * code_length_frequencies[17] + 7 * code_length_frequencies[18] +
+        deflate_cost(_literal_frequencies, literal_lengths) + deflate_cost(_distance_frequencies, distance_lengths) + extra_bits;
+
+    ttlet fixed_bits = 3 + deflate_cost(_literal_frequencies, std::span(deflate_fixed_literal_lengths).first(286)) +
+        deflate_cost(_distance_frequencies, deflate_fixed_distance_lengths) + extra_bits;
+
+    ttlet nr_stored_blocks = std::max(ssize_t{1}, (size + 0xfffe) / 0xffff);
+    ttlet stored_bits = static_cast<uint64_t>(nr_stored_blocks * (3 + 7 + 32) + size * 8);
+
+    if (_level == 0 || (stored_bits <= dynamic_bits && stored_bits <= fixed_bits)) {
+        auto data = std::span<std::byte const>(_buffer).subspan(_block_start, size);
+        do {
+            ttlet n = std::min(std::ssize(data), ssize_t{0xffff});
+            writer.put(final_block && n == std::ssize(data) ? 1 : 0, 1);
+            writer.put(0, 2);
+            writer.align();
+            writer.put(static_cast<uint32_t>(n), 16);
+            writer.put(static_cast<uint32_t>(~n & 0xffff), 16);
+            writer.align();
+            writer.put_bytes(data.first(n));
+            data = data.subspan(n);
+        } while (!data.empty());
+
+    } else {
+        auto literal_codes = std::vector<uint16_t>{};
+        auto distance_codes = std::vector<uint16_t>{};
+        auto literal_code_lengths = std::span<int const>{};
+        auto distance_code_lengths = std::span<int const>{};
+
+        writer.put(final_block ? 1 : 0, 1);
+        if (fixed_bits <= dynamic_bits) {
+            writer.put(1, 2);
+            literal_code_lengths = deflate_fixed_literal_lengths;
+            distance_code_lengths = deflate_fixed_distance_lengths;
+
+        } else {
+            writer.put(2, 2);
+            writer.put(static_cast<uint32_t>(nr_literal_codes - 257), 5);
+            writer.put(static_cast<uint32_t>(nr_distance_codes - 1), 5);
+            writer.put(static_cast<uint32_t>(nr_code_length_codes - 4), 4);
+            for (int i = 0; i != nr_code_length_codes; ++i) {
+                writer.put(static_cast<uint32_t>(code_length_lengths[deflate_code_length_order[i]]), 3);
+            }
+
+            ttlet code_length_codes = deflate_codes(code_length_lengths);
+            for (ttlet &[symbol, extra] : code_length_symbols) {
+                writer.put(code_length_codes[symbol], code_length_lengths[symbol]);
+                if (symbol >= 16) {
+                    writer.put(static_cast<uint32_t>(extra), symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+                }
+            }
+
+            literal_code_lengths = literal_lengths;
+            distance_code_lengths = distance_lengths;
+        }
+        literal_codes = deflate_codes(literal_code_lengths);
+        distance_codes = deflate_codes(distance_code_lengths);
+
+        for (ttlet &symbol : _symbols) {
+            if (symbol.distance == 0) {
+                writer.put(literal_codes[symbol.value], literal_code_lengths[symbol.value]);
+
+            } else {
+                ttlet length_code = deflate_length_codes[symbol.value];
+                writer.put(literal_codes[257 + length_code], literal_code_lengths[257 + length_code]);
+                writer.put(symbol.value - deflate_length_base[length_code], deflate_length_extra[length_code]);
+
+                ttlet distance_code = deflate_distance_code(symbol.distance);
+                writer.put(distance_codes[distance_code], distance_code_lengths[distance_code]);
+                writer.put(symbol.distance - deflate_distance_base[distance_code], deflate_distance_extra[distance_code]);
+            }
+        }
+        writer.put(literal_codes[256], literal_code_lengths[256]);
+    }
+
+    if (final_block) {
+        writer.align();
+    }
+    _accumulator = writer.accumulator();
+    _bit_count = writer.bit_count();
+
+    _block_start += size;
+    _symbols.clear();
+    _literal_frequencies = {};
+    _distance_frequencies = {};
+}
+
+void deflate_compressor::compress(std::span<std::byte const> input, bstring &output) noexcept
+{
+    do {
+        ttlet n = std::min(window_size * 2 - std::ssize(_buffer), std::ssize(input));
+        _buffer.append(input.data(), n);
+        input = input.subspan(n);
+
+        process(output, false);
+    } while (!input.empty());
+}
+
+void deflate_compressor::finish(bstring &output) noexcept
+{
+    process(output, true);
+    write_block(output, true);
+}
+
+bstring deflate(std::span<std::byte const> bytes, int level) noexcept
+{
+    auto compressor = deflate_compressor{level};
+
+    auto r = bstring{};
+    compressor.compress(bytes, r);
+    compressor.finish(r);
+    return r;
+}
+
+} // namespace tt
@@ -0,0 +1,159 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../byte_string.hpp"
+#include <span>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+namespace tt {
+
+/** A streaming compressor of a deflate stream.
+ *
+ * Data can be passed in chunks of any size, the compressed data is appended to a string
+ * supplied by the caller. Compressed data is produced one block at a time; `finish()`
+ * must be called to write the last block.
+ *
+ * The compression level selects the algorithm:
+ *  - 0: Stored blocks, no compression.
+ *  - 1: Run-length encoding only, matches with a distance of one byte.
+ *  - 2-3: Greedy matching using hash chains.
+ *  - 4-9: Lazy matching using hash chains, with longer chains for higher levels.
+ *
+ * Each block is written as a stored, fixed-huffman or dynamic-huffman block, whichever is smallest.
+ */
+class deflate_compressor {
+public:
+    /** The maximum distance of a back-reference.
+     */
+    static constexpr ssize_t window_size = 32768;
+
+    /** Create a compressor.
+     *
+     * @param level The compression level between 0 and 9.
+     */
+    deflate_compressor(int level = 6) noexcept;
+
+    /** Compress the next chunk.
+     *
+     * @param input The data to compress.
+     * @param output The string to append compressed data to.
+     */
+    void compress(std::span<std::byte const> input, bstring &output) noexcept;
+
+    /** Compress the remaining data and write the final block.
+     *
+     * @param output The string to append compressed data to.
+     */
+    void finish(bstring &output) noexcept;
+
+private:
+    struct level_type {
+        /** Stop searching for a longer match when the match is at least this long.
+         */
+        int nice_length;
+
+        /** Do not search for a lazy match when the previous match is at least this long.
+         * For greedy matching, matches up to this length are inserted in the hash table.
+         */
+        int max_lazy;
+
+        /** Reduce the chain length when the previous match is at least this long.
+         */
+        int good_length;
+
+        /** The maximum number of positions to check in a hash chain.
+         */
+        int max_chain;
+    };
+
+    /** A literal or a length/distance pair.
+     */
+    struct symbol_type {
+        /** The literal byte, or the length of the match.
+         */
+        uint16_t value;
+
+        /** The distance of the match, or zero for a literal.
+         */
+        uint16_t distance;
+    };
+
+    static constexpr int hash_bits = 15;
+    static constexpr ssize_t hash_size = ssize_t{1} << hash_bits;
+    static constexpr int min_match = 3;
+    static constexpr int max_match = 258;
+
+    /** The amount of data needed after the current position, to be able to find a maximum length match.
+     */
+    static constexpr ssize_t min_lookahead = max_match + min_match + 1;
+
+    /** The maximum number of symbols in a block.
+     */
+    static constexpr ssize_t max_block_symbols = 0x4000;
+
+    int _level;
+    level_type _parameters;
+
+    /** The last 32 KiB of already compressed data, followed by data to be compressed.
+     */
+    bstring _buffer;
+
+    /** The position in the buffer of the next byte to compress.
+     */
+    ssize_t _position = 0;
+
+    /** The position in the buffer of the start of the current block.
+     */
+    ssize_t _block_start = 0;
+
+    /** For each hash value, the most recent position in the buffer, or -1.
+     */
+    std::vector<int32_t> _head;
+
+    /** For each position modulo the window size, the previous position with the same hash, or -1.
+     */
+    std::vector<int32_t> _prev;
+
+    /** State of lazy matching.
+     */
+    bool _match_available = false;
+    int _prev_length = min_match - 1;
+    int _prev_distance = 0;
+
+    std::vector<symbol_type> _symbols;
+    std::array<uint32_t, 286> _literal_frequencies = {};
+    std::array<uint32_t, 30> _distance_frequencies = {};
+
+    /** Bits carried over between calls.
+     */
+    uint64_t _accumulator = 0;
+    int _bit_count = 0;
+
+    [[nodiscard]] uint32_t hash(ssize_t position) const noexcept;
+    [[nodiscard]] int32_t insert(ssize_t position) noexcept;
+    [[nodiscard]] int longest_match(ssize_t position, int32_t chain, int prev_length, int &distance) const noexcept;
+    [[nodiscard]] int run_length(ssize_t position) const noexcept;
+    void add_literal(bstring &output, std::byte c) noexcept;
+    void add_match(bstring &output, int length, int distance) noexcept;
+    void slide(bstring &output) noexcept;
+    void process(bstring &output, bool finish) noexcept;
+    void process_greedy(bstring &output, bool finish) noexcept;
+    void process_lazy(bstring &output, bool finish) noexcept;
+    void write_block(bstring &output, bool final_block) noexcept;
+};
+
+/** Compress data using the deflate algorithm.
+ *
+ * @param bytes The data to compress.
+ * @param level The compression level between 0 and 9.
+ * @return The compressed data.
+ */
+[[nodiscard]] bstring deflate(std::span<std::byte const> bytes, int level = 6) noexcept;
+
+} // namespace tt
@@ -0,0 +1,178 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/deflate.hpp"
+#include "ttauri/codec/inflate.hpp"
+#include "ttauri/codec/zlib.hpp"
+#include "ttauri/codec/gzip.hpp"
+#include "ttauri/file_view.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace tt;
+
+/** Text-like data with many repeated words, larger than the window.
+ */
+static bstring make_text_bytes(ssize_t size)
+{
+    constexpr auto words = std::array{"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog. ", "ttauri ", "\n"};
+
+    auto r = bstring{};
+    auto generator = test_random{};
+    while (std::ssize(r) < size) {
+        for (auto c = words[generator() % words.size()]; *c != 0; ++c) {
+            r += static_cast<std::byte>(*c);
+        }
+    }
+    r.resize(size);
+    return r;
+}
+
+/** Long runs of a few different byte values.
+ */
+static bstring make_run_bytes(ssize_t size)
+{
+    auto r = bstring{};
+    auto generator = test_random{};
+    while (std::ssize(r) < size) {
+        ttlet x = generator();
+        r.append((x >> 16) % 1000 + 1, static_cast<std::byte>(x >> 30));
+    }
+    r.resize(size);
+    return r;
+}
+
+static bstring inflate_all(bstring const &compressed)
+{
+    ssize_t offset = 0;
+    auto r = inflate(compressed, offset);
+    EXPECT_EQ(offset, std::ssize(compressed));
+    return r;
+}
+
+TEST(Deflate, Empty) {
+    for (int level = 0; level <= 9; ++level) {
+        ASSERT_EQ(inflate_all(deflate(bstring{}, level)), bstring{});
+    }
+}
+
+TEST(Deflate, SingleByte) {
+    ttlet original = bstring(1, std::byte{'a'});
+    for (int level = 0; level <= 9; ++level) {
+        ASSERT_EQ(inflate_all(deflate(original, level)), original);
+    }
+}
+
+TEST(Deflate, Text) {
+    ttlet original = make_text_bytes(300000);
+    for (int level = 0; level <= 9; ++level) {
+        ttlet compressed = deflate(original, level);
+        ASSERT_EQ(inflate_all(compressed), original);
+        if (level == 1) {
+            // Run-length encoding only benefits from the huffman codes on text.
+            ASSERT_LT(std::ssize(compressed), std::ssize(original));
+        } else if (level > 1) {
+            ASSERT_LT(std::ssize(compressed), std::ssize(original) / 2);
+        }
+    }
+}
+
+TEST(Deflate, Random) {
+    ttlet original = make_random_bytes(100000);
+    for (int level = 0; level <= 9; ++level) {
+        ttlet compressed = deflate(original, level);
+        ASSERT_EQ(inflate_all(compressed), original);
+
+        // Incompressible data is written in stored blocks.
+        ASSERT_LT(std::ssize(compressed), std::ssize(original) + 1000);
+    }
+}
+
+TEST(Deflate, Runs) {
+    ttlet original = make_run_bytes(200000);
+    for (int level = 0; level <= 9; ++level) {
+        ttlet compressed = deflate(original, level);
+        ASSERT_EQ(inflate_all(compressed), original);
+        if (level > 0) {
+            ASSERT_LT(std::ssize(compressed), std::ssize(original) / 20);
+        }
+    }
+}
+
+TEST(Deflate, CpHTML) {
+    ttlet original = file_view(URL("file:gzip_test4.bin"));
+    ttlet original_bytes = bstring{original.bytes().begin(), original.bytes().end()};
+
+    for (int level = 0; level <= 9; ++level) {
+        ASSERT_EQ(inflate_all(deflate(original_bytes, level)), original_bytes);
+    }
+}
+
+TEST(Deflate, Streaming) {
+    ttlet text = make_text_bytes(100000);
+    ttlet random = make_random_bytes(50000);
+    ttlet original = text + random + text;
+
+    // Pass the input in chunks of different sizes, crossing the sliding window in every way.
+    for (ttlet level : {1, 3, 6, 9}) {
+        for (ttlet chunk_size : {ssize_t{1}, ssize_t{1000}, ssize_t{40000}}) {
+            auto compressor = deflate_compressor{level};
+            auto compressed = bstring{};
+
+            auto input = std::span<std::byte const>(original);
+            while (!input.empty()) {
+                ttlet n = std::min(chunk_size, std::ssize(input));
+                compressor.compress(input.first(n), compressed);
+                input = input.subspan(n);
+            }
+            compressor.finish(compressed);
+
+            ASSERT_EQ(inflate_all(compressed), original);
+        }
+    }
+}
+
+TEST(Deflate, StreamingDecompress) {
+    ttlet text = make_text_bytes(100000);
+    ttlet random = make_random_bytes(50000);
+    ttlet original = text + random + text;
+    ttlet compressed = deflate(original, 6);
+
+    // Produce the output in chunks of different sizes, wrapping around the sliding window in every way.
+    for (ttlet chunk_size : {ssize_t{1}, ssize_t{1000}, ssize_t{40000}}) {
+        auto decompressor = inflate_decompressor{};
+        auto decompressed = bstring{};
+        auto chunk = bstring(chunk_size, std::byte{0});
+
+        auto input = std::span<std::byte const>(compressed);
+        while (!decompressor.finished()) {
+            ttlet n = decompressor.decompress(input, chunk);
+            decompressed.append(chunk.data(), n);
+        }
+        ASSERT_EQ(decompressed, original);
+    }
+}
+
+TEST(Deflate, ZlibRoundTrip) {
+    ttlet original = make_text_bytes(100000);
+    for (int level = 0; level <= 9; ++level) {
+        ASSERT_EQ(zlib_decompress(zlib_compress(original, level)), original);
+    }
+}
+
+TEST(Deflate, GzipRoundTrip) {
+    ttlet original = make_text_bytes(100000);
+    for (int level = 0; level <= 9; ++level) {
+        ASSERT_EQ(gzip_decompress(gzip_compress(original, level)), original);
+    }
+
+    auto compressor = gzip_compressor{};
+    auto compressed = bstring{};
+    compressor.compress(std::span(original).first(12345), compressed);
+    compressor.compress(std::span(original).subspan(12345), compressed);
+    compressor.finish(compressed);
+    ASSERT_EQ(gzip_decompress(compressed), original);
+}
@@ -4,8 +4,19 @@
 
 #include "gzip.hpp"
 #include "inflate.hpp"
+#include "crc32.hpp"
 #include "../endian.hpp"
 #include "../placement.hpp"
+#include "../thread.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 namespace tt {
 
@@ -19,69 +30,491 @@ struct GZIPMemberHeader {
     uint8_t OS;
 };
 
-static bstring gzip_decompress_member(std::span<std::byte const> bytes, ssize_t &offset, ssize_t max_size)
-{
-    ttlet header = make_placement_ptr<GZIPMemberHeader>(bytes, offset);
+struct GZIPMemberTrailer {
+    little_uint32_buf_t CRC32;
+    little_uint32_buf_t ISIZE;
+};
 
-    tt_parse_check(header->ID1 == 31, "GZIP Member header ID1 must be 31");
-    tt_parse_check(header->ID2 == 139, "GZIP Member header ID2 must be 139");
-    tt_parse_check(header->CM == 8, "GZIP Member header CM must be 8");
-    tt_parse_check((header->FLG & 0xe0) == 0, "GZIP Member header FLG reserved bits must be 0");
-    tt_parse_check(header->XFL == 2 || header->XFL == 4, "GZIP Member header XFL must be 2 or 4");
-    [[maybe_unused]] ttlet FTEXT = static_cast<bool>(header->FLG & 1);
-    ttlet FHCRC = static_cast<bool>(header->FLG & 2);
-    ttlet FEXTRA = static_cast<bool>(header->FLG & 4);
-    ttlet FNAME = static_cast<bool>(header->FLG & 8);
-    ttlet FCOMMENT = static_cast<bool>(header->FLG & 16);
+/** Collect bytes of a header or trailer, which may be split over multiple chunks.
+ *
+ * @return true when `size` bytes are collected in the buffer.
+ */
+bool gzip_decompressor::collect(std::span<std::byte const> &input, ssize_t size) noexcept
+{
+    ttlet n = std::min(size - _buffer_size, std::ssize(input));
+    std::copy_n(input.begin(), n, _buffer.begin() + _buffer_size);
+    _buffer_size += n;
+    input = input.subspan(n);
+    return _buffer_size == size;
+}
 
-    if (FEXTRA) {
-        ttlet XLEN = make_placement_ptr<little_uint16_buf_t>(bytes, offset);
-        offset += XLEN->value();
+/** Skip over a zero terminated string.
+ *
+ * @return true when the terminating zero was found.
+ */
+bool gzip_decompressor::skip_string(std::span<std::byte const> &input) noexcept
+{
+    ttlet it = std::find(input.begin(), input.end(), std::byte{0});
+    if (it == input.end()) {
+        input = input.subspan(input.size());
+        return false;
+    } else {
+        input = input.subspan(std::distance(input.begin(), it) + 1);
+        return true;
     }
+}
 
-    if (FNAME) {
-        std::byte c;
-        do {
-            tt_parse_check(offset < std::ssize(bytes), "GZIP Member header FNAME reading beyond end of buffer");
-            c = bytes[offset++];
-        } while (c != std::byte{0});
+ssize_t gzip_decompressor::decompress(std::span<std::byte const> &input, std::span<std::byte> output)
+{
+    ssize_t produced = 0;
+
+    if (_state == state_type::finished && !input.empty()) {
+        // Start the next member.
+        _inflate = inflate_decompressor{};
+        _crc = 0;
+        _state = state_type::header;
     }
 
-    if (FCOMMENT) {
-        std::byte c;
-        do {
-            tt_parse_check(offset < std::ssize(bytes), "GZIP Member header FCOMMENT reading beyond end of buffer");
-            c = bytes[offset++];
-        } while (c != std::byte{0});
+    while (true) {
+        switch (_state) {
+        case state_type::header: {
+            if (!collect(input, ssizeof(GZIPMemberHeader))) {
+                return produced;
+            }
+
+            ssize_t offset = 0;
+            ttlet header = make_placement_ptr<GZIPMemberHeader>(std::span<std::byte const>(_buffer), offset);
+
+            tt_parse_check(header->ID1 == 31, "GZIP Member header ID1 must be 31");
+            tt_parse_check(header->ID2 == 139, "GZIP Member header ID2 must be 139");
+            tt_parse_check(header->CM == 8, "GZIP Member header CM must be 8");
+            tt_parse_check((header->FLG & 0xe0) == 0, "GZIP Member header FLG reserved bits must be 0");
+            // XFL is only informational; encoders use values other than 2 or 4.
+            _FLG = header->FLG;
+
+            _buffer_size = 0;
+            _state = state_type::extra_length;
+        } break;
+
+        case state_type::extra_length: {
+            ttlet FEXTRA = static_cast<bool>(_FLG & 4);
+            if (FEXTRA) {
+                if (!collect(input, ssizeof(little_uint16_buf_t))) {
+                    return produced;
+                }
+
+                ssize_t offset = 0;
+                ttlet XLEN = make_placement_ptr<little_uint16_buf_t>(std::span<std::byte const>(_buffer), offset);
+                _extra_size = XLEN->value();
+                _buffer_size = 0;
+            }
+            _state = state_type::extra;
+        } break;
+
+        case state_type::extra: {
+            ttlet n = std::min(_extra_size, std::ssize(input));
+            input = input.subspan(n);
+            _extra_size -= n;
+            if (_extra_size != 0) {
+                return produced;
+            }
+            _state = state_type::name;
+        } break;
+
+        case state_type::name: {
+            ttlet FNAME = static_cast<bool>(_FLG & 8);
+            if (FNAME && !skip_string(input)) {
+                return produced;
+            }
+            _state = state_type::comment;
+        } break;
+
+        case state_type::comment: {
+            ttlet FCOMMENT = static_cast<bool>(_FLG & 16);
+            if (FCOMMENT && !skip_string(input)) {
+                return produced;
+            }
+            _state = state_type::header_crc;
+        } break;
+
+        case state_type::header_crc: {
+            ttlet FHCRC = static_cast<bool>(_FLG & 2);
+            if (FHCRC) {
+                if (!collect(input, ssizeof(little_uint16_buf_t))) {
+                    return produced;
+                }
+                _buffer_size = 0;
+            }
+            _state = state_type::data;
+        } break;
+
+        case state_type::data: {
+            // The crc is calculated directly after decompressing, while the data is still in the cache.
+            ttlet n = _inflate.decompress(input, output.subspan(produced));
+            _crc = crc32(output.subspan(produced, n), _crc);
+            produced += n;
+            if (!_inflate.finished()) {
+                return produced;
+            }
+            _state = state_type::trailer;
+        } break;
+
+        case state_type::trailer: {
+            if (!collect(input, ssizeof(GZIPMemberTrailer))) {
+                return produced;
+            }
+
+            ssize_t offset = 0;
+            ttlet trailer = make_placement_ptr<GZIPMemberTrailer>(std::span<std::byte const>(_buffer), offset);
+
+            tt_parse_check(trailer->CRC32.value() == _crc, "GZIP Member trailer CRC32 checksum failed.");
+            tt_parse_check(
+                trailer->ISIZE.value() == (_inflate.total_out() & 0xffffffff),
+                "GZIP Member header ISIZE must be same as the lower 32 bits of the inflated size.");
+
+            _buffer_size = 0;
+            _state = state_type::finished;
+        } break;
+
+        case state_type::finished:
+            return produced;
+
+        default:
+            tt_no_default();
+        }
     }
+}
+
+gzip_compressor::gzip_compressor(int level) noexcept : _level(level), _deflate(level) {}
 
-    if (FHCRC) {
-        [[maybe_unused]] ttlet CRC16 = make_placement_ptr<little_uint16_buf_t>(bytes, offset);
+void gzip_compressor::write_header(bstring &output) noexcept
+{
+    ttlet header = std::array<uint8_t, 10>{
+        31, // ID1
+        139, // ID2
+        8, // CM: deflate
+        0, // FLG
+        0, 0, 0, 0, // MTIME: not available
+        static_cast<uint8_t>(_level == 9 ? 2 : _level <= 1 ? 4 : 0), // XFL: maximum compression or fastest algorithm
+        255 // OS: unknown
+    };
+
+    output.append(reinterpret_cast<std::byte const *>(header.data()), header.size());
+    _header_written = true;
+}
+
+void gzip_compressor::compress(std::span<std::byte const> input, bstring &output) noexcept
+{
+    if (!_header_written) {
+        write_header(output);
     }
 
-    auto r = inflate(bytes, offset, max_size);
+    _crc = crc32(input, _crc);
+    _size += static_cast<uint32_t>(input.size());
+    _deflate.compress(input, output);
+}
 
-    [[maybe_unused]] auto CRC32 = make_placement_ptr<little_uint32_buf_t>(bytes, offset);
-    [[maybe_unused]] auto ISIZE = make_placement_ptr<little_uint32_buf_t>(bytes, offset);
+void gzip_compressor::finish(bstring &output) noexcept
+{
+    if (!_header_written) {
+        write_header(output);
+    }
 
-    tt_parse_check(
-        ISIZE->value() == (size(r) & 0xffffffff),
-        "GZIP Member header ISIZE must be same as the lower 32 bits of the inflated size.");
-    return r;
+    _deflate.finish(output);
+
+    ttlet CRC32 = native_to_little(_crc);
+    ttlet ISIZE = native_to_little(_size);
+    output.append(reinterpret_cast<std::byte const *>(&CRC32), sizeof(CRC32));
+    output.append(reinterpret_cast<std::byte const *>(&ISIZE), sizeof(ISIZE));
 }
 
 bstring gzip_decompress(std::span<std::byte const> bytes, ssize_t max_size)
 {
+    auto decompressor = gzip_decompressor{};
+
+    // The ISIZE field of the trailer of the last member is used as a hint for the decompressed size.
+    ssize_t size_hint = 0;
+    if (std::ssize(bytes) >= ssizeof(GZIPMemberHeader) + ssizeof(GZIPMemberTrailer)) {
+        ssize_t offset = std::ssize(bytes) - ssizeof(GZIPMemberTrailer);
+        ttlet trailer = make_placement_ptr<GZIPMemberTrailer>(bytes, offset);
+        size_hint = static_cast<ssize_t>(trailer->ISIZE.value());
+    }
+
     auto r = bstring{};
+    while (!bytes.empty()) {
+        decompress_append(decompressor, bytes, r, max_size, size_hint);
+    }
+    return r;
+}
 
-    ssize_t offset = 0;
-    while (offset < std::ssize(bytes)) {
-        auto member = gzip_decompress_member(bytes, offset, max_size);
-        max_size -= std::ssize(member);
-        r.append(member);
+/** Check if a member header may start at the offset.
+ * Besides the magic, the reserved flags and the OS field are checked, to reduce the
+ * number of false positives when scanning through compressed data.
+ */
+[[nodiscard]] static bool gzip_is_member_header(std::span<std::byte const> bytes, ssize_t offset) noexcept
+{
+    if (offset + ssizeof(GZIPMemberHeader) > std::ssize(bytes)) {
+        return false;
     }
 
+    ttlet header = make_placement_ptr<GZIPMemberHeader>(bytes, offset);
+    return header->ID1 == 31 && header->ID2 == 139 && header->CM == 8 && (header->FLG & 0xe0) == 0 &&
+        (header->OS <= 13 || header->OS == 255);
+}
+
+/** Find the offsets of the members in a gzip stream.
+ *
+ * @return The offsets of the candidate member headers, starting with zero.
+ */
+[[nodiscard]] static std::vector<ssize_t> gzip_find_members(std::span<std::byte const> bytes) noexcept
+{
+    // The smallest member is a header, an empty fixed-huffman block and a trailer.
+    constexpr ssize_t min_member_size = ssizeof(GZIPMemberHeader) + 2 + ssizeof(GZIPMemberTrailer);
+
+    auto r = std::vector<ssize_t>{0};
+
+    auto offset = min_member_size;
+    while (offset + min_member_size <= std::ssize(bytes)) {
+        ttlet *first = bytes.data() + offset;
+        ttlet *found = static_cast<std::byte const *>(std::memchr(first, 31, bytes.size() - offset));
+        if (found == nullptr) {
+            break;
+        }
+
+        offset += found - first;
+        if (gzip_is_member_header(bytes, offset) && offset + min_member_size <= std::ssize(bytes)) {
+            r.push_back(offset);
+            offset += min_member_size;
+        } else {
+            ++offset;
+        }
+    }
+    return r;
+}
+
+/** Decompress a single member into a buffer of exactly the decompressed size.
+ *
+ * @param input The bytes of a single member.
+ * @param output The buffer that must be exactly filled by the member.
+ * @return true if the member was decoded, filled the output and ended at the end of the input.
+ */
+[[nodiscard]] static bool gzip_decompress_member(std::span<std::byte const> input, std::span<std::byte> output) noexcept
+{
+    try {
+        auto decompressor = gzip_decompressor{};
+
+        ssize_t size = 0;
+        while (!decompressor.finished()) {
+            ttlet input_size = std::ssize(input);
+            ttlet produced = decompressor.decompress(input, output.subspan(size));
+            size += produced;
+
+            if (produced == 0 && std::ssize(input) == input_size && !decompressor.finished()) {
+                return false;
+            }
+        }
+        return input.empty() && size == std::ssize(output);
+
+    } catch (parse_error const &) {
+        return false;
+    }
+}
+
+/** Persistent worker threads for decompressing the members of a gzip stream in parallel.
+ *
+ * The threads are started when they are first needed and are reused by later calls.
+ */
+class gzip_worker_pool {
+public:
+    gzip_worker_pool() noexcept = default;
+
+    ~gzip_worker_pool()
+    {
+        {
+            ttlet lock = std::scoped_lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+    }
+
+    gzip_worker_pool(gzip_worker_pool const &) = delete;
+    gzip_worker_pool(gzip_worker_pool &&) = delete;
+    gzip_worker_pool &operator=(gzip_worker_pool const &) = delete;
+    gzip_worker_pool &operator=(gzip_worker_pool &&) = delete;
+
+    [[nodiscard]] static gzip_worker_pool &global() noexcept
+    {
+        static gzip_worker_pool r;
+        return r;
+    }
+
+    /** Run a task on the current thread and concurrently on worker threads.
+     *
+     * The task must take its share of the work from a shared counter, and must not throw.
+     * When the current thread finishes the task, the calls that have not yet started on a
+     * worker thread are cancelled, so that the task does not wait for workers that are busy
+     * with another stream.
+     *
+     * @param task The task to run.
+     * @param nr_threads The number of threads to run the task on, including the current thread.
+     * @throws std::system_error When a worker thread could not be started.
+     */
+    void run(std::function<void()> const &task, ssize_t nr_threads)
+    {
+        auto job = job_type{task};
+        {
+            ttlet lock = std::scoped_lock(_mutex);
+
+            ttlet max_nr_workers = std::max(ssize_t{1}, static_cast<ssize_t>(std::thread::hardware_concurrency())) - 1;
+            while (std::ssize(_threads) < std::min(nr_threads - 1, max_nr_workers)) {
+                _threads.emplace_back([this] {
+                    set_thread_name("gzip");
+                    loop();
+                });
+            }
+
+            for (ssize_t i = 1; i < nr_threads; ++i) {
+                _queue.push_back(&job);
+            }
+        }
+        _condition.notify_all();
+
+        task();
+
+        auto lock = std::unique_lock(_mutex);
+        std::erase(_queue, &job);
+        _done.wait(lock, [&job] {
+            return job.nr_running == 0;
+        });
+    }
+
+private:
+    struct job_type {
+        std::function<void()> const &task;
+
+        /** The number of worker threads currently running the task.
+         */
+        int nr_running = 0;
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::condition_variable _done;
+    std::vector<std::thread> _threads;
+    std::deque<job_type *> _queue;
+    bool _stop = false;
+
+    void loop() noexcept
+    {
+        auto lock = std::unique_lock(_mutex);
+        while (true) {
+            _condition.wait(lock, [this] {
+                return _stop || !_queue.empty();
+            });
+            if (_stop) {
+                return;
+            }
+
+            auto job = _queue.front();
+            _queue.pop_front();
+            ++job->nr_running;
+
+            lock.unlock();
+            job->task();
+            lock.lock();
+
+            if (--job->nr_running == 0) {
+                _done.notify_all();
+            }
+        }
+    }
+};
+
+bstring gzip_decompress_parallel(std::span<std::byte const> bytes, ssize_t max_size, int nr_threads)
+{
+    ttlet members = gzip_find_members(bytes);
+    if (std::ssize(members) < 2) {
+        return gzip_decompress(bytes, max_size);
+    }
+
+    ttlet nr_members = std::ssize(members);
+    ttlet member_end = [&](ssize_t i) {
+        return i + 1 == nr_members ? std::ssize(bytes) : members[i + 1];
+    };
+
+    enum class member_state : uint8_t { skipped, failed, decoded };
+    auto states = std::vector<member_state>(members.size(), member_state::failed);
+
+    // The ISIZE field directly before the next member is the size of the member, and determines where
+    // the member is written in the output. The members from the first one that would make the output larger
+    // than max_size are skipped, they are decoded serially below which reports the error.
+    auto offsets = std::vector<ssize_t>{0};
+    for (ssize_t i = 0; i != nr_members; ++i) {
+        ssize_t trailer_offset = member_end(i) - ssizeof(GZIPMemberTrailer);
+        ttlet trailer = make_placement_ptr<GZIPMemberTrailer>(bytes, trailer_offset);
+        auto size = static_cast<ssize_t>(trailer->ISIZE.value());
+
+        if ((i != 0 && states[i - 1] == member_state::skipped) || offsets.back() + size > max_size) {
+            states[i] = member_state::skipped;
+        }
+        offsets.push_back(offsets.back() + (states[i] == member_state::skipped ? 0 : size));
+    }
+
+    auto r = bstring(static_cast<size_t>(offsets.back()), std::byte{0});
+
+    std::atomic<ssize_t> next_member = 0;
+    ttlet decode_members = std::function<void()>{[&] {
+        for (auto i = next_member++; i < nr_members; i = next_member++) {
+            if (states[i] != member_state::skipped) {
+                ttlet input = bytes.subspan(members[i], member_end(i) - members[i]);
+                ttlet output = std::span(r).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+                states[i] = gzip_decompress_member(input, output) ? member_state::decoded : member_state::failed;
+            }
+        }
+    }};
+
+    if (nr_threads <= 0) {
+        nr_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    gzip_worker_pool::global().run(decode_members, std::min(ssize_t{nr_threads}, nr_members));
+
+    if (std::ranges::all_of(states, [](ttlet state) { return state == member_state::decoded; })) {
+        return r;
+    }
+
+    // A member fails to decode when a member header was found inside compressed data, or when the data is
+    // corrupt. A decoded member ends exactly at the start of the next member, therefor each run of members
+    // that were not decoded starts at a real member boundary and can be decoded serially on its own.
+    auto result = bstring{};
+    for (ssize_t i = 0; i != nr_members;) {
+        if (states[i] == member_state::decoded) {
+            result.append(r, offsets[i], offsets[i + 1] - offsets[i]);
+            ++i;
+
+        } else {
+            auto j = i + 1;
+            while (j != nr_members && states[j] != member_state::decoded) {
+                ++j;
+            }
+            result += gzip_decompress(bytes.subspan(members[i], member_end(j - 1) - members[i]), max_size - std::ssize(result));
+            i = j;
+        }
+    }
+    return result;
+}
+
+bstring gzip_compress(std::span<std::byte const> bytes, int level) noexcept
+{
+    auto compressor = gzip_compressor{level};
+
+    auto r = bstring{};
+    compressor.compress(bytes, r);
+    compressor.finish(r);
     return r;
 }
 
-} // namespace tt
\ No newline at end of file
+} // namespace tt
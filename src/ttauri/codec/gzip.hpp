@@ -4,17 +4,146 @@
 
 #pragma once
 
+#include "inflate.hpp"
+#include "deflate.hpp"
 #include "../URL.hpp"
 #include "../byte_string.hpp"
 #include "../resource_view.hpp"
+#include <array>
 #include <cstddef>
 
 namespace tt {
 
+/** A resumable decompressor of a gzip stream.
+ *
+ * The member headers and trailers are parsed incrementally, so that the stream can be
+ * passed in chunks of any size.
+ *
+ * A gzip stream may consist of multiple members, `finished()` returns true after each
+ * complete member. Calling `decompress()` with more input after a member has finished will
+ * start decompressing the next member.
+ */
+class gzip_decompressor {
+public:
+    /** Decompress the next chunk.
+     *
+     * @param input The compressed input. On return the consumed bytes are removed from the front of the span.
+     * @param output The buffer to write decompressed data into.
+     * @return The number of bytes written into output.
+     * @throw parse_error When the compressed data is invalid.
+     */
+    [[nodiscard]] ssize_t decompress(std::span<std::byte const> &input, std::span<std::byte> output);
+
+    /** Check if the current member, including the trailer, was completely decoded.
+     */
+    [[nodiscard]] bool finished() const noexcept
+    {
+        return _state == state_type::finished;
+    }
+
+private:
+    enum class state_type : uint8_t { header, extra_length, extra, name, comment, header_crc, data, trailer, finished };
+
+    state_type _state = state_type::header;
+    inflate_decompressor _inflate;
+
+    /** The CRC-32 of the decompressed data of the current member.
+     */
+    uint32_t _crc = 0;
+
+    /** The flags from the member header.
+     */
+    uint8_t _FLG = 0;
+
+    /** The number of bytes of the extra field still to be skipped.
+     */
+    ssize_t _extra_size = 0;
+
+    /** Header or trailer bytes collected from previous chunks.
+     */
+    std::array<std::byte, 10> _buffer;
+    ssize_t _buffer_size = 0;
+
+    [[nodiscard]] bool collect(std::span<std::byte const> &input, ssize_t size) noexcept;
+    [[nodiscard]] bool skip_string(std::span<std::byte const> &input) noexcept;
+};
+
+/** A streaming compressor of a gzip stream.
+ *
+ * The data is written as a single gzip member. Data can be passed in chunks of any size,
+ * the compressed data is appended to a string supplied by the caller. `finish()` must be called
+ * to write the last block and the trailer.
+ */
+class gzip_compressor {
+public:
+    /** Create a compressor.
+     *
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     */
+    gzip_compressor(int level = 6) noexcept;
+
+    /** Compress the next chunk.
+     *
+     * @param input The data to compress.
+     * @param output The string to append compressed data to.
+     */
+    void compress(std::span<std::byte const> input, bstring &output) noexcept;
+
+    /** Compress the remaining data and write the trailer.
+     *
+     * @param output The string to append compressed data to.
+     */
+    void finish(bstring &output) noexcept;
+
+private:
+    int _level;
+    bool _header_written = false;
+    deflate_compressor _deflate;
+
+    /** The CRC-32 and size of the uncompressed data so far.
+     */
+    uint32_t _crc = 0;
+    uint32_t _size = 0;
+
+    void write_header(bstring &output) noexcept;
+};
+
 bstring gzip_decompress(std::span<std::byte const> bytes, ssize_t max_size=0x01000000);
 
+/** Decompress a gzip stream consisting of multiple members using multiple threads.
+ *
+ * The members of a gzip stream are independent of each other. The member boundaries are
+ * found by scanning for member headers, and the ISIZE field in the trailer before each
+ * boundary determines where the member is written in the pre-sized output buffer.
+ * The members are then decompressed concurrently by the calling thread and a pool of
+ * persistent worker threads.
+ *
+ * When a member can not be decoded exactly as scanned, for example because the bytes
+ * of a member header appeared inside compressed data, only that part of the stream is
+ * decompressed serially. The result is therefore always identical to `gzip_decompress()`.
+ *
+ * @param bytes The compressed data.
+ * @param max_size The maximum size of the decompressed data.
+ * @param nr_threads The maximum number of threads to use, or 0 for the number of hardware threads.
+ * @return The decompressed data.
+ * @throw parse_error When the compressed data is invalid or too large.
+ */
+bstring gzip_decompress_parallel(std::span<std::byte const> bytes, ssize_t max_size=0x01000000, int nr_threads=0);
+
+/** Compress data into a gzip stream.
+ *
+ * @param bytes The data to compress.
+ * @param level The compression level between 0 and 9, see `deflate_compressor`.
+ * @return The compressed data.
+ */
+[[nodiscard]] bstring gzip_compress(std::span<std::byte const> bytes, int level = 6) noexcept;
+
 inline bstring gzip_decompress(URL const &url, ssize_t max_size=0x01000000) {
     return gzip_decompress(*url.loadView(), max_size);
 }
 
+inline bstring gzip_decompress_parallel(URL const &url, ssize_t max_size=0x01000000, int nr_threads=0) {
+    return gzip_decompress_parallel(*url.loadView(), max_size, nr_threads);
+}
+
 }
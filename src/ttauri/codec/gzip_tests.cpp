@@ -3,9 +3,12 @@
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 #include "ttauri/codec/gzip.hpp"
 #include "ttauri/file_view.hpp"
+#include "ttauri/random_tests.hpp"
 #include "ttauri/required.hpp"
 #include <gtest/gtest.h>
-#include <iostream>
+#include <array>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace tt;
@@ -116,3 +119,130 @@ TEST(GZip, UnzipXargs1) {
         ASSERT_EQ(decompressed[i], original_bytes[i]);
     }
 }
+
+TEST(GZip, UnzipStreaming) {
+    ttlet compressed = file_view(URL("file:gzip_test4.bin.gz"));
+    ttlet compressed_bytes = compressed.bytes();
+
+    ttlet original = file_view(URL("file:gzip_test4.bin"));
+    ttlet original_bytes = original.bytes();
+
+    // Pass the input in small chunks and use a small output buffer, so that the
+    // decompressor is suspended and resumed in every state.
+    auto decompressor = gzip_decompressor{};
+    auto decompressed = bstring{};
+    auto buffer = std::array<std::byte, 5>{};
+
+    for (ssize_t offset = 0; offset < std::ssize(compressed_bytes); offset += 3) {
+        auto chunk = compressed_bytes.subspan(offset, std::min(ssize_t{3}, std::ssize(compressed_bytes) - offset));
+        while (!chunk.empty()) {
+            ttlet size = decompressor.decompress(chunk, buffer);
+            decompressed.append(buffer.data(), size);
+        }
+    }
+    while (!decompressor.finished()) {
+        auto chunk = std::span<std::byte const>{};
+        ttlet size = decompressor.decompress(chunk, buffer);
+        ASSERT_NE(size, 0);
+        decompressed.append(buffer.data(), size);
+    }
+
+    ASSERT_EQ(std::ssize(decompressed), std::ssize(original_bytes));
+
+    for (ssize_t i = 0; i != std::ssize(decompressed); ++i) {
+        ASSERT_EQ(decompressed[i], original_bytes[i]);
+    }
+}
+
+TEST(GZip, UnzipBadCRC) {
+    ttlet compressed = file_view(URL("file:gzip_test3.bin.gz"));
+    auto compressed_bytes = bstring{compressed.bytes().begin(), compressed.bytes().end()};
+
+    // The CRC32 is the first field of the 8 byte trailer.
+    compressed_bytes[std::ssize(compressed_bytes) - 8] ^= std::byte{1};
+    ASSERT_THROW(gzip_decompress(compressed_bytes), parse_error);
+}
+
+/** Concatenate members, each compressing a slice of text-like data.
+ */
+static bstring make_multi_member(ssize_t nr_members, ssize_t member_size)
+{
+    auto compressed = bstring{};
+    auto generator = test_random{};
+    for (ssize_t i = 0; i != nr_members; ++i) {
+        auto member = bstring{};
+        for (ssize_t j = 0; j != member_size; ++j) {
+            member += static_cast<std::byte>('a' + generator() % 8);
+        }
+        compressed += gzip_compress(member, static_cast<int>(i % 10));
+    }
+    return compressed;
+}
+
+TEST(GZip, UnzipParallel) {
+    ttlet compressed = make_multi_member(37, 30000);
+
+    ttlet serial = gzip_decompress(compressed);
+    ASSERT_EQ(std::ssize(serial), 37 * 30000);
+
+    for (ttlet nr_threads : {1, 2, 3, 8, 0}) {
+        ASSERT_EQ(gzip_decompress_parallel(compressed, 0x0100'0000, nr_threads), serial);
+    }
+}
+
+TEST(GZip, UnzipParallelFalseHeader) {
+    // A stored member containing the bytes of a member header preceded by a plausible ISIZE,
+    // so that the scan finds a false boundary.
+    auto data = bstring(1000, std::byte{'x'});
+    ttlet fake_trailer_and_header = std::array<uint8_t, 14>{100, 0, 0, 0, 31, 139, 8, 0, 0, 0, 0, 0, 0, 3};
+    for (ssize_t i = 0; i != std::ssize(fake_trailer_and_header); ++i) {
+        data[500 + i] = static_cast<std::byte>(fake_trailer_and_header[i]);
+    }
+
+    ttlet compressed = gzip_compress(data, 0) + make_multi_member(3, 1000) + gzip_compress(data, 0);
+    ttlet serial = gzip_decompress(compressed);
+    ASSERT_EQ(gzip_decompress_parallel(compressed, 0x0100'0000, 4), serial);
+}
+
+TEST(GZip, UnzipParallelFalseHeaders) {
+    // False boundaries in several members, separated by members that decode in parallel.
+    auto data = bstring(1000, std::byte{'x'});
+    ttlet fake_trailer_and_header = std::array<uint8_t, 14>{100, 0, 0, 0, 31, 139, 8, 0, 0, 0, 0, 0, 0, 3};
+    for (ssize_t i = 0; i != std::ssize(fake_trailer_and_header); ++i) {
+        data[500 + i] = static_cast<std::byte>(fake_trailer_and_header[i]);
+    }
+    ttlet false_member = gzip_compress(data, 0);
+
+    ttlet compressed = false_member + make_multi_member(5, 1000) + false_member + false_member + make_multi_member(5, 1000) +
+        false_member;
+    ttlet serial = gzip_decompress(compressed);
+
+    // Several streams at once share the worker threads.
+    auto threads = std::vector<std::thread>{};
+    auto results = std::vector<bstring>(4);
+    for (auto &result : results) {
+        threads.emplace_back([&] {
+            for (int i = 0; i != 10; ++i) {
+                result = gzip_decompress_parallel(compressed, 0x0100'0000, 4);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (ttlet &result : results) {
+        ASSERT_EQ(result, serial);
+    }
+}
+
+TEST(GZip, UnzipParallelErrors) {
+    auto compressed = make_multi_member(4, 1000);
+
+    // Too large for the maximum size.
+    ASSERT_THROW(gzip_decompress_parallel(compressed, 3000, 4), parse_error);
+
+    // The CRC32 of the last member.
+    compressed[std::ssize(compressed) - 8] ^= std::byte{1};
+    ASSERT_THROW(gzip_decompress_parallel(compressed, 0x0100'0000, 4), parse_error);
+}
@@ -0,0 +1,169 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "image_loader.hpp"
+#include "png.hpp"
+#include "../thread.hpp"
+#include "../exception.hpp"
+#include <algorithm>
+
+namespace tt {
+
+image_loader::image_loader(int max_nr_threads, ssize_t max_cache_size) noexcept :
+    _max_nr_threads(max_nr_threads), _max_cache_size(max_cache_size)
+{
+    if (_max_nr_threads <= 0) {
+        // Leave a CPU for the GUI thread.
+        _max_nr_threads = std::clamp(narrow_cast<int>(std::thread::hardware_concurrency()) - 1, 1, 4);
+    }
+}
+
+image_loader::~image_loader()
+{
+    auto queue = decltype(_queue){};
+    {
+        ttlet lock = std::scoped_lock(_mutex);
+        _stop = true;
+        std::swap(queue, _queue);
+    }
+    _condition.notify_all();
+
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+
+    // Complete the requests that were never started, so that every callback is called.
+    for (ttlet &entry : queue) {
+        entry->promise.set_exception(
+            std::make_exception_ptr(operation_error("Image loader was stopped before loading {}", to_string(entry->url))));
+        for (ttlet &callback : entry->callbacks) {
+            callback(entry->future);
+        }
+    }
+}
+
+[[nodiscard]] std::shared_ptr<image_loader::entry_type> image_loader::find_or_add(URL const &url)
+{
+    auto it = _entries.find(url);
+    if (it != _entries.end()) {
+        auto &entry = *it->second;
+        if (entry.ready) {
+            _lru.splice(_lru.begin(), _lru, entry.lru_it);
+        }
+        return it->second;
+    }
+
+    // Start the worker threads as they are needed. This is done before the entry is queued
+    // so that nothing is changed when the thread can not be started.
+    if (std::ssize(_threads) < _max_nr_threads) {
+        _threads.emplace_back([this]() {
+            set_thread_name("image_loader");
+            loop();
+        });
+    }
+
+    auto entry = std::make_shared<entry_type>(url);
+    _entries.emplace(url, entry);
+    _queue.push_back(entry);
+
+    _condition.notify_one();
+    return entry;
+}
+
+[[nodiscard]] image_loader::future_type image_loader::load(URL const &url)
+{
+    ttlet lock = std::scoped_lock(_mutex);
+    return find_or_add(url)->future;
+}
+
+void image_loader::load(URL const &url, callback_type callback)
+{
+    auto lock = std::unique_lock(_mutex);
+    ttlet entry = find_or_add(url);
+    if (entry->ready) {
+        ttlet future = entry->future;
+        lock.unlock();
+        callback(future);
+    } else {
+        entry->callbacks.push_back(std::move(callback));
+    }
+}
+
+void image_loader::clear_cache() noexcept
+{
+    ttlet lock = std::scoped_lock(_mutex);
+    for (auto entry : _lru) {
+        // The entry is owned by _entries, don't pass its url by reference to erase().
+        _entries.erase(_entries.find(entry->url));
+    }
+    _lru.clear();
+    _cache_size = 0;
+}
+
+[[nodiscard]] ssize_t image_loader::cache_size() const noexcept
+{
+    ttlet lock = std::scoped_lock(_mutex);
+    return _cache_size;
+}
+
+void image_loader::add_to_cache(entry_type &entry) noexcept
+{
+    entry.ready = true;
+    _lru.push_front(&entry);
+    entry.lru_it = _lru.begin();
+    _cache_size += entry.size;
+
+    // The entry that was just added is kept, even when it is larger than the cache.
+    while (_cache_size > _max_cache_size && _lru.back() != &entry) {
+        auto oldest = _lru.back();
+        _lru.pop_back();
+        _cache_size -= oldest->size;
+        _entries.erase(_entries.find(oldest->url));
+    }
+}
+
+void image_loader::loop() noexcept
+{
+    while (true) {
+        auto lock = std::unique_lock(_mutex);
+        _condition.wait(lock, [this] {
+            return _stop || !_queue.empty();
+        });
+        if (_stop) {
+            return;
+        }
+
+        auto entry = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+
+        auto image = image_ptr{};
+        auto error = std::exception_ptr{};
+        try {
+            image = std::make_shared<image_type const>(png::load(entry->url));
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (image) {
+            entry->size = image->width() * image->height() * ssizeof(sfloat_rgba16);
+            entry->promise.set_value(std::move(image));
+            add_to_cache(*entry);
+        } else {
+            // Errors are not cached, a later request will try again.
+            entry->promise.set_exception(error);
+            _entries.erase(entry->url);
+        }
+        auto callbacks = std::move(entry->callbacks);
+        lock.unlock();
+
+        // Call the callbacks outside the lock, they may request more images.
+        for (ttlet &callback : callbacks) {
+            callback(entry->future);
+        }
+    }
+}
+
+} // namespace tt
@@ -0,0 +1,152 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include "../URL.hpp"
+#include "../pixel_map.hpp"
+#include "../color/sfloat_rgba16.hpp"
+#include <memory>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+
+namespace tt {
+
+/** A service to load images asynchronously.
+ *
+ * Images are decoded on a bounded pool of worker threads, the input files are memory mapped
+ * through `URL::loadView()`. Requests for a URL that is already being decoded are merged with
+ * the earlier request. Decoded images are kept in a cache which is bounded by the total size of the
+ * images; the least recently requested images are removed first.
+ *
+ * Decoded images are shared between all requesters and must not be modified; use
+ * `pixel_map::copy()` to get a modifiable image.
+ */
+class image_loader {
+public:
+    using image_type = pixel_map<sfloat_rgba16>;
+    using image_ptr = std::shared_ptr<image_type const>;
+    using future_type = std::shared_future<image_ptr>;
+
+    /** Completion callback.
+     * Called on a worker thread, or on the calling thread when the image was already in the cache.
+     *
+     * @param future A ready future; `future.get()` returns the image or throws the error from decoding.
+     */
+    using callback_type = std::function<void(future_type const &)>;
+
+    /** Global image loader.
+     */
+    inline static std::unique_ptr<image_loader> global;
+
+    /** Create an image loader.
+     *
+     * @param max_nr_threads The maximum number of worker threads, or zero to select based on the number of CPUs.
+     * @param max_cache_size The maximum total size in bytes of the decoded images in the cache.
+     */
+    image_loader(int max_nr_threads = 0, ssize_t max_cache_size = 0x0400'0000) noexcept;
+
+    /** Stop the worker threads.
+     * Requests that are being decoded are finished first. Requests that have not started decoding
+     * are completed with an `operation_error`, their callbacks are called from the destructor.
+     */
+    ~image_loader();
+
+    image_loader(image_loader const &) = delete;
+    image_loader(image_loader &&) = delete;
+    image_loader &operator=(image_loader const &) = delete;
+    image_loader &operator=(image_loader &&) = delete;
+
+    /** Load an image.
+     *
+     * @param url The location of the image.
+     * @return A future for the decoded image, which throws an exception when the image could not be loaded.
+     * @throws std::system_error When a worker thread could not be started.
+     */
+    [[nodiscard]] future_type load(URL const &url);
+
+    /** Load an image and call a function when it is decoded.
+     *
+     * @param url The location of the image.
+     * @param callback The function to call with the ready future.
+     * @throws std::system_error When a worker thread could not be started.
+     */
+    void load(URL const &url, callback_type callback);
+
+    /** Remove all images from the cache.
+     * Images still referenced by a requester stay alive until they are released.
+     */
+    void clear_cache() noexcept;
+
+    /** The total size in bytes of the decoded images in the cache.
+     */
+    [[nodiscard]] ssize_t cache_size() const noexcept;
+
+private:
+    /** An image which is being decoded, or which is in the cache.
+     */
+    struct entry_type {
+        URL url;
+        std::promise<image_ptr> promise;
+        future_type future;
+
+        /** Callbacks to call when the decoding is finished.
+         */
+        std::vector<callback_type> callbacks;
+
+        /** Set when the image was decoded and the entry is in the cache.
+         */
+        bool ready = false;
+        ssize_t size = 0;
+
+        /** The location of the entry in the least-recently-used list.
+         */
+        std::list<entry_type *>::iterator lru_it;
+
+        entry_type(URL const &url) noexcept : url(url), future(promise.get_future().share()) {}
+    };
+
+    int _max_nr_threads;
+    ssize_t _max_cache_size;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::vector<std::thread> _threads;
+    bool _stop = false;
+
+    /** Entries being decoded and in the cache, by URL.
+     */
+    std::unordered_map<URL, std::shared_ptr<entry_type>> _entries;
+
+    /** Entries waiting to be decoded.
+     */
+    std::deque<std::shared_ptr<entry_type>> _queue;
+
+    /** Entries in the cache, the most recently requested first.
+     */
+    std::list<entry_type *> _lru;
+    ssize_t _cache_size = 0;
+
+    /** Find or create the entry for a URL.
+     * When the entry is found in the cache it is marked as the most recently used.
+     * A worker thread is started when a new entry is queued and not all threads are running.
+     */
+    [[nodiscard]] std::shared_ptr<entry_type> find_or_add(URL const &url);
+
+    /** Add the decoded entry to the cache and remove the least recently used entries.
+     */
+    void add_to_cache(entry_type &entry) noexcept;
+
+    void loop() noexcept;
+};
+
+} // namespace tt
@@ -0,0 +1,170 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/image_loader.hpp"
+#include "ttauri/codec/png.hpp"
+#include "ttauri/required.hpp"
+#include "ttauri/exception.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace tt;
+
+static std::vector<URL> test_images()
+{
+    return {
+        URL("file:png_test_g8.png"),
+        URL("file:png_test_ga8.png"),
+        URL("file:png_test_rgb8.png"),
+        URL("file:png_test_rgba8.png"),
+        URL("file:png_test_g16.png"),
+        URL("file:png_test_ga16.png"),
+        URL("file:png_test_rgb16.png")};
+}
+
+static bool equal_images(pixel_map<sfloat_rgba16> const &lhs, pixel_map<sfloat_rgba16> const &rhs)
+{
+    if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
+        return false;
+    }
+    for (ssize_t y = 0; y != lhs.height(); ++y) {
+        for (ssize_t x = 0; x != lhs.width(); ++x) {
+            if (lhs[y][x] != rhs[y][x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(ImageLoader, SameAsSerial) {
+    ttlet urls = test_images();
+
+    auto expected = std::vector<pixel_map<sfloat_rgba16>>{};
+    for (ttlet &url : urls) {
+        expected.push_back(png::load(url));
+    }
+
+    auto loader = image_loader{4};
+
+    // Request every image several times from several threads at once.
+    auto futures = std::vector<std::vector<image_loader::future_type>>(4);
+    auto threads = std::vector<std::thread>{};
+    for (auto &thread_futures : futures) {
+        threads.emplace_back([&] {
+            for (int i = 0; i != 3; ++i) {
+                for (ttlet &url : urls) {
+                    thread_futures.push_back(loader.load(url));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (ttlet &thread_futures : futures) {
+        for (ssize_t i = 0; i != std::ssize(thread_futures); ++i) {
+            ttlet image = thread_futures[i].get();
+            ASSERT_TRUE(equal_images(*image, expected[i % std::ssize(urls)])) << urls[i % std::ssize(urls)];
+        }
+    }
+
+    // Requests for the same URL share the decoded image.
+    for (ssize_t i = 0; i != std::ssize(urls); ++i) {
+        ASSERT_EQ(futures[0][i].get(), futures[3][i].get());
+    }
+}
+
+TEST(ImageLoader, Callback) {
+    ttlet urls = test_images();
+
+    auto loader = image_loader{2};
+    auto count = std::atomic<int>{0};
+    auto nr_loaded = std::atomic<int>{0};
+    auto promise = std::promise<void>{};
+
+    // The results are checked on this thread, a failed assert in a callback would never set the promise.
+    for (ttlet &url : urls) {
+        loader.load(url, [&](image_loader::future_type const &future) {
+            if (future.get() != nullptr) {
+                ++nr_loaded;
+            }
+            if (++count == std::ssize(urls)) {
+                promise.set_value();
+            }
+        });
+    }
+    promise.get_future().get();
+    ASSERT_EQ(nr_loaded, std::ssize(urls));
+
+    // All images are in the cache, the callback is called immediately.
+    auto called = false;
+    loader.load(urls[0], [&](image_loader::future_type const &) {
+        called = true;
+    });
+    ASSERT_TRUE(called);
+}
+
+TEST(ImageLoader, CallbackOnDestruction) {
+    ttlet urls = test_images();
+
+    auto count = std::atomic<int>{0};
+    auto nr_stopped = std::atomic<int>{0};
+    {
+        auto loader = image_loader{1};
+        for (ttlet &url : urls) {
+            for (int i = 0; i != 10; ++i) {
+                // Each callback is called once, either by the worker thread or by the destructor.
+                loader.load(url, [&](image_loader::future_type const &future) {
+                    ++count;
+                    try {
+                        std::ignore = future.get();
+                    } catch (operation_error const &) {
+                        ++nr_stopped;
+                    }
+                });
+            }
+        }
+    }
+    ASSERT_EQ(count, 10 * std::ssize(urls));
+    ASSERT_GT(nr_stopped, 0);
+}
+
+TEST(ImageLoader, Error) {
+    auto loader = image_loader{1};
+
+    // A file that does not exist, and a file which is not a PNG image.
+    ASSERT_ANY_THROW(loader.load(URL("file:png_test_does_not_exist.png")).get());
+    ASSERT_ANY_THROW(loader.load(URL("file:file_view.txt")).get());
+    ASSERT_EQ(loader.cache_size(), 0);
+
+    ASSERT_NE(loader.load(URL("file:png_test_g8.png")).get(), nullptr);
+}
+
+TEST(ImageLoader, Cache) {
+    ttlet urls = test_images();
+
+    // The cache can hold a single 64 x 33 image.
+    auto loader = image_loader{2, 64 * 33 * ssizeof(sfloat_rgba16)};
+
+    ttlet first = loader.load(urls[3]).get();
+    ASSERT_EQ(loader.cache_size(), 64 * 33 * ssizeof(sfloat_rgba16));
+    ASSERT_EQ(loader.load(urls[3]).get(), first);
+
+    // Loading other images removes the first image from the cache.
+    for (ttlet &url : urls) {
+        std::ignore = loader.load(url).get();
+        ASSERT_LE(loader.cache_size(), 64 * 33 * ssizeof(sfloat_rgba16));
+    }
+    ttlet second = loader.load(urls[3]).get();
+    ASSERT_NE(second, first);
+    ASSERT_TRUE(equal_images(*second, *first));
+
+    loader.clear_cache();
+    ASSERT_EQ(loader.cache_size(), 0);
+}
@@ -1,161 +1,74 @@
-// Copyright Take Vos 2020.
+// Copyright Take Vos 2020-2021.
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
 #include "inflate.hpp"
-#include "../bits.hpp"
-#include "../placement.hpp"
+#include "../bit_reader.hpp"
 #include "../huffman.hpp"
 #include <array>
+#include <algorithm>
+#include <cstring>
 
 namespace tt {
 
-static void inflate_copy_block(std::span<std::byte const> bytes, ssize_t &bit_offset, ssize_t max_size, bstring &r)
-{
-    auto offset = (bit_offset + 7) / 8;
-
-    auto LEN = make_placement_ptr<little_uint16_buf_t>(bytes, offset);
-    [[maybe_unused]] auto NLEN = make_placement_ptr<little_uint16_buf_t>(bytes, offset);
-
-    tt_parse_check((offset + LEN->value()) <= std::ssize(bytes), "input buffer overrun");
-    tt_parse_check((std::ssize(r) + LEN->value()) <= max_size, "output buffer overrun");
-    r.append(&bytes[offset], LEN->value());
-
-    bit_offset = offset * 8;
-}
-
-[[nodiscard]] static int inflate_decode_length(
-    std::span<std::byte const> bytes,
-    ssize_t &bit_offset,
-    int symbol)
-{
-    switch (symbol) {
-    case 257: return 3;
-    case 258: return 4;
-    case 259: return 5;
-    case 260: return 6;
-    case 261: return 7;
-    case 262: return 8;
-    case 263: return 9;
-    case 264: return 10;
-    case 265: return get_bits(bytes, bit_offset, 1) + 11;
-    case 266: return get_bits(bytes, bit_offset, 1) + 13;
-    case 267: return get_bits(bytes, bit_offset, 1) + 15;
-    case 268: return get_bits(bytes, bit_offset, 1) + 17;
-    case 269: return get_bits(bytes, bit_offset, 2) + 19;
-    case 270: return get_bits(bytes, bit_offset, 2) + 23;
-    case 271: return get_bits(bytes, bit_offset, 2) + 27;
-    case 272: return get_bits(bytes, bit_offset, 2) + 31;
-    case 273: return get_bits(bytes, bit_offset, 3) + 35;
-    case 274: return get_bits(bytes, bit_offset, 3) + 43;
-    case 275: return get_bits(bytes, bit_offset, 3) + 51;
-    case 276: return get_bits(bytes, bit_offset, 3) + 59;
-    case 277: return get_bits(bytes, bit_offset, 4) + 67;
-    case 278: return get_bits(bytes, bit_offset, 4) + 83;
-    case 279: return get_bits(bytes, bit_offset, 4) + 99;
-    case 280: return get_bits(bytes, bit_offset, 4) + 115;
-    case 281: return get_bits(bytes, bit_offset, 5) + 131;
-    case 282: return get_bits(bytes, bit_offset, 5) + 163;
-    case 283: return get_bits(bytes, bit_offset, 5) + 195;
-    case 284: return get_bits(bytes, bit_offset, 5) + 227;
-    case 285: return 258;
-    default:
-        throw parse_error(fmt::format("Literal/Length symbol out of range {}", symbol)); 
+/** The meaning of each symbol of the literal/length alphabet.
+ * The length symbols are folded into a base length and the number of extra bits.
+ */
+constexpr auto inflate_literal_symbols = []() {
+    constexpr auto length_base = std::array<uint16_t, 29>{
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    constexpr auto length_extra = std::array<uint8_t, 29>{
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+    auto r = std::array<huffman_symbol, 288>{};
+    for (int i = 0; i != 256; ++i) {
+        r[i] = huffman_symbol{static_cast<uint16_t>(i), 0, huffman_kind::literal};
     }
-}
-
-[[nodiscard]] static int inflate_decode_distance(
-    std::span<std::byte const> bytes,
-    ssize_t &bit_offset,
-    int symbol)
-{
-    switch (symbol) {
-    case 0: return 1;
-    case 1: return 2;
-    case 2: return 3;
-    case 3: return 4;
-    case 4: return get_bits(bytes, bit_offset, 1) + 5;
-    case 5: return get_bits(bytes, bit_offset, 1) + 7;
-    case 6: return get_bits(bytes, bit_offset, 2) + 9;
-    case 7: return get_bits(bytes, bit_offset, 2) + 13;
-    case 8: return get_bits(bytes, bit_offset, 3) + 17;
-    case 9: return get_bits(bytes, bit_offset, 3) + 25;
-    case 10: return get_bits(bytes, bit_offset, 4) + 33;
-    case 11: return get_bits(bytes, bit_offset, 4) + 49;
-    case 12: return get_bits(bytes, bit_offset, 5) + 65;
-    case 13: return get_bits(bytes, bit_offset, 5) + 97;
-    case 14: return get_bits(bytes, bit_offset, 6) + 129;
-    case 15: return get_bits(bytes, bit_offset, 6) + 193;
-    case 16: return get_bits(bytes, bit_offset, 7) + 257;
-    case 17: return get_bits(bytes, bit_offset, 7) + 385;
-    case 18: return get_bits(bytes, bit_offset, 8) + 513;
-    case 19: return get_bits(bytes, bit_offset, 8) + 769;
-    case 20: return get_bits(bytes, bit_offset, 9) + 1025;
-    case 21: return get_bits(bytes, bit_offset, 9) + 1537;
-    case 22: return get_bits(bytes, bit_offset, 10) + 2049;
-    case 23: return get_bits(bytes, bit_offset, 10) + 3073;
-    case 24: return get_bits(bytes, bit_offset, 11) + 4097;
-    case 25: return get_bits(bytes, bit_offset, 11) + 6145;
-    case 26: return get_bits(bytes, bit_offset, 12) + 8193;
-    case 27: return get_bits(bytes, bit_offset, 12) + 12289;
-    case 28: return get_bits(bytes, bit_offset, 13) + 16385;
-    case 29: return get_bits(bytes, bit_offset, 13) + 24577;
-    default:
-        throw parse_error(fmt::format("Distance symbol out of range {}", symbol)); 
+    r[256] = huffman_symbol{256, 0, huffman_kind::end_of_block};
+    for (int i = 0; i != 29; ++i) {
+        r[257 + i] = huffman_symbol{length_base[i], length_extra[i], huffman_kind::base};
     }
-}
-
-static void inflate_block(
-    std::span<std::byte const> bytes,
-    ssize_t &bit_offset,
-    ssize_t max_size,
-    huffman_tree<int16_t> const &literal_tree,
-    huffman_tree<int16_t> const &distance_tree,
-    bstring &r)
-{
-    while (true) {
-        // Test only every get_symbol, the trailer is at least 32 bits (Checksum)
-        // - 15 bits maximum huffman code.
-        // -  5 bits extra length.
-        // -  7 bits rounding up to byte.
-        tt_parse_check(((bit_offset + 27) >> 3) <= std::ssize(bytes), "Input buffer overrun");
-
-        auto literal_symbol = literal_tree.get_symbol(bytes, bit_offset);
-
-        if (literal_symbol <= 255) {
-            tt_parse_check(std::ssize(r) < max_size, "Output buffer overrun");
-            r.push_back(static_cast<std::byte>(literal_symbol));
+    // Symbols 286 and 287 are part of the fixed huffman code, but may not be used.
+    r[286] = huffman_symbol{286, 0, huffman_kind::invalid};
+    r[287] = huffman_symbol{287, 0, huffman_kind::invalid};
+    return r;
+}();
 
-        } else if (literal_symbol == 256) {
-            // End-of-block.
-            return;
+/** The meaning of each symbol of the distance alphabet.
+ */
+constexpr auto inflate_distance_symbols = []() {
+    constexpr auto distance_base = std::array<uint16_t, 30>{
+        1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    constexpr auto distance_extra = std::array<uint8_t, 30>{
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    auto r = std::array<huffman_symbol, 32>{};
+    for (int i = 0; i != 30; ++i) {
+        r[i] = huffman_symbol{distance_base[i], distance_extra[i], huffman_kind::base};
+    }
+    // Symbols 30 and 31 are part of the fixed huffman code, but may not be used.
+    r[30] = huffman_symbol{30, 0, huffman_kind::invalid};
+    r[31] = huffman_symbol{31, 0, huffman_kind::invalid};
+    return r;
+}();
 
-        } else {
-            auto length = inflate_decode_length(bytes, bit_offset, literal_symbol); 
-            tt_parse_check(std::ssize(r) + length <= max_size, "Output buffer overrun");
-
-            // Test only every get_symbol, the trailer is at least 32 bits (Checksum)
-            // - 15 bits maximum huffman code.
-            // -  7 bits rounding up to byte.
-            tt_parse_check(((bit_offset + 22) >> 3) <= std::ssize(bytes), "Input buffer overrun");
-            auto distance_symbol = distance_tree.get_symbol(bytes, bit_offset);
-
-            // Test only every inflate_decode_distance, the trailer is at least 32 bits (Checksum)
-            // - 13 bits extra length.
-            // -  7 bits rounding up to byte.
-            tt_parse_check(((bit_offset + 20) >> 3) <= std::ssize(bytes), "Input buffer overrun");
-            auto distance = inflate_decode_distance(bytes, bit_offset, distance_symbol);
-
-            tt_parse_check(distance <= std::ssize(r), "Distance beyond start of decompressed data");
-            auto src_i = std::ssize(r) - distance;
-            for (auto i = 0; i != length; ++i) {
-                r.push_back(r[src_i++]);
-            }
-        }
+/** The meaning of each symbol of the code length alphabet.
+ * The repeat symbols keep their symbol value, but include the number of extra bits
+ * so that the symbol and the repeat count are decoded together.
+ */
+constexpr auto inflate_code_length_symbols = []() {
+    auto r = std::array<huffman_symbol, 19>{};
+    for (int i = 0; i != 16; ++i) {
+        r[i] = huffman_symbol{static_cast<uint16_t>(i), 0, huffman_kind::literal};
     }
-}
+    r[16] = huffman_symbol{16, 2, huffman_kind::literal};
+    r[17] = huffman_symbol{17, 3, huffman_kind::literal};
+    r[18] = huffman_symbol{18, 7, huffman_kind::literal};
+    return r;
+}();
 
-huffman_tree<int16_t> deflate_fixed_literal_tree = []() {
+static inflate_decompressor::literal_table_type const deflate_fixed_literal_table = []() {
     std::vector<int> lengths;
 
     for (int i = 0; i <= 143; ++i) {
@@ -171,144 +84,437 @@ huffman_tree<int16_t> deflate_fixed_literal_tree = []() {
         lengths.push_back(8);
     }
 
-    return huffman_tree<int16_t>::from_lengths(lengths);
+    return inflate_decompressor::literal_table_type::from_lengths(lengths, inflate_literal_symbols);
 }();
 
-huffman_tree<int16_t> deflate_fixed_distance_tree = []() {
+static inflate_decompressor::distance_table_type const deflate_fixed_distance_table = []() {
     std::vector<int> lengths;
 
     for (int i = 0; i <= 31; ++i) {
         lengths.push_back(5);
     }
 
-    return huffman_tree<int16_t>::from_lengths(lengths);
+    return inflate_decompressor::distance_table_type::from_lengths(lengths, inflate_distance_symbols);
 }();
 
+/** Decode a huffman code and its extra bits, using only the bits available in the reader.
+ *
+ * @return The entry, or nullptr when more input is needed.
+ * @throw parse_error When the code is not in the table.
+ */
+template<typename Table>
+[[nodiscard]] static typename Table::entry_type const *inflate_try_decode(bit_reader &reader, Table const &table)
+{
+    while (true) {
+        ttlet &entry = table.find(reader.peek());
+        if (entry.kind != huffman_kind::invalid) {
+            if (entry.code_length + entry.extra_bits <= reader.bit_count()) {
+                return &entry;
+            }
+        } else {
+            tt_parse_check(reader.bit_count() < Table::max_code_length, "Code not in huffman table.");
+        }
+
+        if (!reader.try_refill(reader.bit_count() + 8)) {
+            return nullptr;
+        }
+    }
+}
+
+/** Copy a match that lies completely inside the output buffer.
+ *
+ * The match is copied 8 or 16 bytes at a time, which means that up to 15 bytes beyond
+ * the end of the match may be written. The caller must leave `inflate_decompressor::fast_output_margin`
+ * bytes between `out` and the end of the output buffer.
+ *
+ * @param out The output iterator, on return directly after the match.
+ * @param out_end The end of the output buffer.
+ * @param distance The distance to the start of the match, at most `out - out_begin`.
+ * @param length The length of the match.
+ */
+static tt_force_inline void
+inflate_copy_match_fast(std::byte *&out, std::byte const *out_end, ssize_t distance, int length) noexcept
+{
+    tt_axiom(length <= 258);
+    tt_axiom(out_end - out >= inflate_decompressor::fast_output_margin);
+
+    auto const *src = out - distance;
+    auto *dst = out;
+    ttlet dst_end = out + length;
+
+    if (distance >= 16) {
+        do {
+            std::memcpy(dst, src, 16);
+            dst += 16;
+            src += 16;
+        } while (dst < dst_end);
+
+    } else if (distance >= 8) {
+        do {
+            std::memcpy(dst, src, 8);
+            dst += 8;
+            src += 8;
+        } while (dst < dst_end);
+
+    } else if (distance == 1) {
+        // A run of the same byte.
+        std::memset(dst, static_cast<int>(*src), length);
+
+    } else {
+        // Short repeating pattern. Copy single bytes until the pattern is repeated enough times
+        // that a copy at a multiple of the distance is at least 8 bytes apart.
+        ttlet wide_distance = ((8 + distance - 1) / distance) * distance;
+        ttlet head_end = std::min(dst_end, dst + (wide_distance - distance));
+        while (dst < head_end) {
+            *dst++ = *src++;
+        }
+
+        src = dst - wide_distance;
+        while (dst < dst_end) {
+            std::memcpy(dst, src, 8);
+            dst += 8;
+            src += 8;
+        }
+    }
 
+    out = dst_end;
+}
 
-static void inflate_fixed_block(std::span<std::byte const> bytes, ssize_t &bit_offset, ssize_t max_size, bstring &r)
+void inflate_decompressor::copy_match(std::byte *out_begin, std::byte *&out, int length) const noexcept
 {
-    inflate_block(bytes, bit_offset, max_size, deflate_fixed_literal_tree, deflate_fixed_distance_tree, r);
+    ttlet distance = static_cast<ssize_t>(_distance);
+    ttlet produced = out - out_begin;
+
+    if (distance > produced) {
+        // The start of the match is in the window, from before this call.
+        ttlet window_distance = distance - produced;
+        tt_axiom(window_distance <= _window_fill);
+
+        auto src_i = (_window_offset - window_distance + window_size) % window_size;
+        ttlet nr_window_bytes = std::min(static_cast<ssize_t>(length), window_distance);
+        for (ssize_t i = 0; i != nr_window_bytes; ++i) {
+            *out++ = _window[src_i];
+            src_i = (src_i + 1) % window_size;
+        }
+        length -= static_cast<int>(nr_window_bytes);
+    }
+
+    auto const *src = out - distance;
+    for (int i = 0; i != length; ++i) {
+        *out++ = *src++;
+    }
 }
 
-[[nodiscard]] static huffman_tree<int16_t> inflate_code_lengths(std::span<std::byte const> bytes, ssize_t &bit_offset, int nr_symbols)
+void inflate_decompressor::update_window(std::span<std::byte const> output) noexcept
 {
-    // The symbols are in different order in the table.
-    constexpr auto symbols = std::array{
-        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
-    };
+    if (_window.empty()) {
+        // The window is allocated lazily, it is not needed when the stream is decompressed in a single call.
+        _window.resize(window_size);
+    }
+
+    if (std::ssize(output) >= window_size) {
+        std::copy(output.end() - window_size, output.end(), _window.begin());
+        _window_offset = 0;
+        _window_fill = window_size;
 
-    tt_parse_check(((bit_offset + (3 * static_cast<ssize_t>(nr_symbols)) + 7) >> 3) <= std::ssize(bytes), "Input buffer overrun");
+    } else {
+        // Copy up to the end of the ring buffer, then the rest to the start of the ring buffer.
+        ttlet first_size = std::min(std::ssize(output), window_size - _window_offset);
+        std::copy(output.begin(), output.begin() + first_size, _window.begin() + _window_offset);
+        std::copy(output.begin() + first_size, output.end(), _window.begin());
 
-    auto lengths = std::vector<int>(std::ssize(symbols), 0);
-    for (int i = 0; i != nr_symbols; ++i) {
-        ttlet symbol = symbols[i];
-        lengths[symbol] = get_bits(bytes, bit_offset, 3);
+        _window_offset = (_window_offset + std::ssize(output)) % window_size;
+        _window_fill = std::min(_window_fill + std::ssize(output), window_size);
     }
-    return huffman_tree<int16_t>::from_lengths(std::move(lengths));
 }
 
-std::vector<int> inflate_lengths(
-    std::span<std::byte const> bytes,
-    ssize_t &bit_offset,
-    int nr_symbols,
-    huffman_tree<int16_t> const &code_length_tree)
+/** Read the code lengths of the literal/length and distance alphabets.
+ *
+ * @return true when all code lengths are read, false when more input is needed.
+ */
+bool inflate_decompressor::decode_code_lengths(bit_reader &reader)
 {
-    auto r = std::vector<int>{};
-    r.reserve(nr_symbols);
-
-    auto prev_length = 0;
-    while (std::ssize(r) < nr_symbols) {
-        // Test only every get_symbol, the trailer is at least 32 bits (Checksum)
-        // -  7 bits maximum huffman code.
-        // -  7 bits extra length.
-        // -  7 bits rounding up to byte.
-        tt_parse_check(((bit_offset + 21) >> 3) <= std::ssize(bytes), "Input buffer overrun");
-        auto symbol = code_length_tree.get_symbol(bytes, bit_offset);
+    ttlet nr_code_lengths = _nr_literal_codes + _nr_distance_codes;
 
+    while (_code_length_index < nr_code_lengths) {
+        ttlet *entry = inflate_try_decode(reader, _code_length_table);
+        if (entry == nullptr) {
+            return false;
+        }
+
+        ttlet symbol = entry->value;
+        reader.skip(entry->code_length);
+        ttlet extra = static_cast<int>(reader.get(entry->extra_bits));
+
+        int repeat;
+        int length;
         switch (symbol) {
-        case 16: {
-                auto copy_length = get_bits(bytes, bit_offset, 2) + 3;
-                while (copy_length--) {
-                    r.push_back(prev_length);
-                }
-            } break;
-        case 17: {
-                auto copy_length = get_bits(bytes, bit_offset, 3) + 3;
-                while (copy_length--) {
-                    r.push_back(0);
-                }
-            } break;
-        case 18: {
-                auto copy_length = get_bits(bytes, bit_offset, 7) + 11;
-                while (copy_length--) {
-                    r.push_back(0);
-                }
-            } break;
+        case 16:
+            tt_parse_check(_code_length_index > 0, "Repeat of previous code length at start of table");
+            length = _code_lengths[_code_length_index - 1];
+            repeat = 3 + extra;
+            break;
+        case 17:
+            length = 0;
+            repeat = 3 + extra;
+            break;
+        case 18:
+            length = 0;
+            repeat = 11 + extra;
+            break;
         default:
-            r.push_back(prev_length = symbol);
+            length = symbol;
+            repeat = 1;
+        }
+
+        tt_parse_check(_code_length_index + repeat <= nr_code_lengths, "Repeated code lengths beyond end of table");
+        for (int i = 0; i != repeat; ++i) {
+            _code_lengths[_code_length_index++] = length;
         }
     }
 
-    return r;
+    tt_parse_check(_code_lengths[256] != 0, "The end-of-block symbol must be in the table");
+
+    _dynamic_literal_table = literal_table_type::from_lengths(_code_lengths.data(), _nr_literal_codes, inflate_literal_symbols);
+    _dynamic_distance_table =
+        distance_table_type::from_lengths(&_code_lengths[_nr_literal_codes], _nr_distance_codes, inflate_distance_symbols);
+    _fixed_tables = false;
+    return true;
 }
 
-void inflate_dynamic_block(std::span<std::byte const> bytes, ssize_t &bit_offset, ssize_t max_size, bstring &r)
+ssize_t inflate_decompressor::decompress(std::span<std::byte const> &input, std::span<std::byte> output)
 {
-    // Test all lengths, the trailer is at least 32 bits (Checksum)
-    // - 14 bits lengths
-    // -  7 bits rounding up to byte.
-    tt_parse_check(((bit_offset + 21) >> 3) <= std::ssize(bytes), "Input buffer overrun");
-    ttlet HLIT = get_bits(bytes, bit_offset, 5);
-    ttlet HDIST = get_bits(bytes, bit_offset, 5);
-    ttlet HCLEN = get_bits(bytes, bit_offset, 4);
+    auto reader = bit_reader{input, _accumulator, _bit_count};
 
-    ttlet code_length_tree = inflate_code_lengths(bytes, bit_offset, HCLEN + 4);
+    ttlet out_begin = output.data();
+    ttlet out_end = out_begin + std::ssize(output);
+    auto out = out_begin;
 
-    ttlet lengths = inflate_lengths(bytes, bit_offset, HLIT + HDIST + 258, code_length_tree);
-    tt_parse_check(lengths[256] != 0, "The end-of-block symbol must be in the table");
+    while (true) {
+        switch (_state) {
+        case state_type::block_header: {
+            if (!reader.try_refill(3)) {
+                goto need_input;
+            }
 
-    ttlet lengths_ptr = lengths.data();
-    ttlet literal_tree = huffman_tree<int16_t>::from_lengths(lengths_ptr, HLIT + 257);
-    ttlet distance_tree = huffman_tree<int16_t>::from_lengths(&lengths_ptr[HLIT + 257], HDIST + 1);
+            _final_block = reader.get_bit();
+            ttlet BTYPE = reader.get(2);
+            switch (BTYPE) {
+            case 0:
+                reader.align();
+                _state = state_type::stored_header;
+                break;
+            case 1:
+                _fixed_tables = true;
+                _state = state_type::literal;
+                break;
+            case 2:
+                _state = state_type::table_header;
+                break;
+            default:
+                throw parse_error("Reserved block type");
+            }
+        } break;
 
-    inflate_block(bytes, bit_offset, max_size, literal_tree, distance_tree, r);
-}
+        case state_type::stored_header: {
+            if (!reader.try_refill(32)) {
+                goto need_input;
+            }
 
-bstring inflate(std::span<std::byte const> bytes, ssize_t &offset, ssize_t max_size)
-{
-    ssize_t bit_offset = offset * 8;
+            ttlet LEN = reader.get(16);
+            ttlet NLEN = reader.get(16);
+            tt_parse_check(LEN == (~NLEN & 0xffff), "Stored block length does not match its complement");
+            _length = static_cast<int>(LEN);
+            _state = state_type::stored_data;
+        } break;
+
+        case state_type::stored_data: {
+            // First copy the whole bytes that are still in the accumulator.
+            while (_length != 0 && reader.bit_count() != 0 && out != out_end) {
+                *out++ = static_cast<std::byte>(reader.get(8));
+                --_length;
+            }
 
-    auto r = bstring{};
+            if (_length != 0 && reader.bit_count() == 0) {
+                ttlet data = reader.take_bytes(std::min(static_cast<ssize_t>(_length), out_end - out));
+                out = std::copy(data.begin(), data.end(), out);
+                _length -= static_cast<int>(std::ssize(data));
+            }
 
-    bool BFINAL;
-    do {
-        // Test all lengths, the trailer is at least 32 bits (Checksum)
-        // - 3 bits header
-        // - 7 bits rounding up to byte.
-        tt_parse_check(((bit_offset + 10) >> 3) <= std::ssize(bytes), "Input buffer overrun");
+            if (_length != 0) {
+                goto suspend;
+            }
+            _state = _final_block ? state_type::finished : state_type::block_header;
+        } break;
 
-        BFINAL = get_bits(bytes, bit_offset, 1);
-        ttlet BTYPE = get_bits(bytes, bit_offset, 2);
+        case state_type::table_header: {
+            if (!reader.try_refill(14)) {
+                goto need_input;
+            }
 
-        switch (BTYPE) {
-        case 0:
-            inflate_copy_block(bytes, bit_offset, max_size - std::ssize(r), r);
-            break;
-        case 1:
-            inflate_fixed_block(bytes, bit_offset, max_size - std::ssize(r), r);
-            break;
-        case 2:
-            inflate_dynamic_block(bytes, bit_offset, max_size - std::ssize(r), r);
+            _nr_literal_codes = reader.get(5) + 257;
+            _nr_distance_codes = reader.get(5) + 1;
+            _nr_code_length_codes = reader.get(4) + 4;
+            tt_parse_check(_nr_literal_codes <= 286, "Too many literal/length codes");
+            tt_parse_check(_nr_distance_codes <= 30, "Too many distance codes");
+
+            _code_lengths = {};
+            _code_length_index = 0;
+            _state = state_type::code_length_lengths;
+        } break;
+
+        case state_type::code_length_lengths: {
+            // The code lengths of the code length alphabet are in a different order.
+            constexpr auto symbols = std::array{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+            while (_code_length_index < _nr_code_length_codes) {
+                if (!reader.try_refill(3)) {
+                    goto need_input;
+                }
+                _code_lengths[symbols[_code_length_index++]] = reader.get(3);
+            }
+
+            _code_length_table = code_length_table_type::from_lengths(_code_lengths.data(), std::ssize(symbols), inflate_code_length_symbols);
+            _code_lengths = {};
+            _code_length_index = 0;
+            _state = state_type::code_lengths;
+        } break;
+
+        case state_type::code_lengths:
+            if (!decode_code_lengths(reader)) {
+                goto need_input;
+            }
+            _state = state_type::literal;
             break;
+
+        case state_type::literal: {
+            ttlet &literal_table = _fixed_tables ? deflate_fixed_literal_table : _dynamic_literal_table;
+            ttlet &distance_table = _fixed_tables ? deflate_fixed_distance_table : _dynamic_distance_table;
+
+            // Fast path, while a complete length/distance pair is available in the input and
+            // a maximum length match, including the overshoot of the wide copy, fits in the output:
+            // - 15 bits maximum literal/length huffman code.
+            // -  5 bits extra length.
+            // - 15 bits maximum distance huffman code.
+            // - 13 bits extra distance.
+            while (reader.available() >= 8 && out_end - out >= fast_output_margin) {
+                reader.refill();
+
+                ttlet &literal = literal_table.get(reader.peek());
+                reader.skip(literal.code_length);
+
+                if (literal.kind == huffman_kind::literal) {
+                    *out++ = static_cast<std::byte>(literal.value);
+
+                } else if (literal.kind == huffman_kind::end_of_block) {
+                    _state = _final_block ? state_type::finished : state_type::block_header;
+                    break;
+
+                } else {
+                    ttlet length = literal.value + static_cast<int>(reader.get(literal.extra_bits));
+
+                    ttlet &distance = distance_table.get(reader.peek());
+                    reader.skip(distance.code_length);
+                    _distance = distance.value + static_cast<int>(reader.get(distance.extra_bits));
+                    tt_parse_check(_distance <= _total_out + (out - out_begin), "Distance beyond start of decompressed data");
+
+                    if (_distance <= out - out_begin) [[likely]] {
+                        inflate_copy_match_fast(out, out_end, _distance, length);
+                    } else {
+                        copy_match(out_begin, out, length);
+                    }
+                }
+            }
+            if (_state != state_type::literal) {
+                break;
+            }
+
+            // Slow path, near the end of the input or output buffer.
+            ttlet *literal = inflate_try_decode(reader, literal_table);
+            if (literal == nullptr) {
+                goto need_input;
+            }
+
+            if (literal->kind == huffman_kind::literal) {
+                if (out == out_end) {
+                    goto suspend;
+                }
+                reader.skip(literal->code_length);
+                *out++ = static_cast<std::byte>(literal->value);
+
+            } else if (literal->kind == huffman_kind::end_of_block) {
+                reader.skip(literal->code_length);
+                _state = _final_block ? state_type::finished : state_type::block_header;
+
+            } else {
+                reader.skip(literal->code_length);
+                _length = literal->value + static_cast<int>(reader.get(literal->extra_bits));
+                _state = state_type::distance;
+            }
+        } break;
+
+        case state_type::distance: {
+            ttlet *distance = inflate_try_decode(reader, _fixed_tables ? deflate_fixed_distance_table : _dynamic_distance_table);
+            if (distance == nullptr) {
+                goto need_input;
+            }
+
+            reader.skip(distance->code_length);
+            _distance = distance->value + static_cast<int>(reader.get(distance->extra_bits));
+            tt_parse_check(_distance <= _total_out + (out - out_begin), "Distance beyond start of decompressed data");
+            _state = state_type::match;
+        } break;
+
+        case state_type::match: {
+            ttlet length = static_cast<int>(std::min(static_cast<ssize_t>(_length), out_end - out));
+            copy_match(out_begin, out, length);
+            _length -= length;
+
+            if (_length != 0) {
+                goto suspend;
+            }
+            _state = state_type::literal;
+        } break;
+
+        case state_type::finished:
+            reader.align();
+            goto suspend;
+
         default:
-            throw parse_error("Reserved block type");
+            tt_no_default();
         }
+    }
+
+suspend:
+    // Return the unused whole bytes in the accumulator to the input, so that the
+    // data following the deflate stream can be read by the caller.
+    reader.rewind();
+
+need_input:
+    // When more input is needed, the bytes in the accumulator are part of a partially decoded
+    // code and are kept; all of the input is consumed.
+    _accumulator = reader.accumulator();
+    _bit_count = reader.bit_count();
+    input = input.subspan(reader.consumed());
+
+    ttlet produced = out - out_begin;
+    if (_state != state_type::finished) {
+        update_window({out_begin, static_cast<size_t>(produced)});
+    }
+    _total_out += produced;
+    return produced;
+}
 
-    } while (!BFINAL);
+bstring inflate(std::span<std::byte const> bytes, ssize_t &offset, ssize_t max_size)
+{
+    auto decompressor = inflate_decompressor{};
+    auto input = bytes.subspan(offset);
 
-    offset = (bit_offset + 7) / 8;
+    auto r = bstring{};
+    decompress_append(decompressor, input, r, max_size);
+
+    offset = std::ssize(bytes) - std::ssize(input);
     return r;
 }
 
-}
\ No newline at end of file
+}
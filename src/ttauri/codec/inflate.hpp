@@ -1,4 +1,4 @@
-// Copyright Take Vos 2020.
+// Copyright Take Vos 2020-2021.
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
@@ -6,23 +6,175 @@
 
 #include "../required.hpp"
 #include "../byte_string.hpp"
+#include "../huffman.hpp"
+#include "../check.hpp"
 #include <span>
+#include <array>
+#include <cstdint>
+#include <algorithm>
 
 namespace tt {
 
+class bit_reader;
+
+/** A resumable decompressor of a deflate stream.
+ *
+ * The compressed data can be passed in chunks of any size, and the decompressed data is
+ * written into buffers supplied by the caller. The decompressor suspends when it runs out of input
+ * or output, and can be resumed at any byte boundary with more input or a new output buffer.
+ *
+ * Only the last 32 KiB of output is retained in a sliding window for resolving back-references,
+ * so the memory use is constant independent of the size of the stream.
+ */
+class inflate_decompressor {
+public:
+    using literal_table_type = huffman_table<10>;
+    using distance_table_type = huffman_table<8>;
+    using code_length_table_type = huffman_table<7>;
+
+    /** The maximum distance of a back-reference.
+     */
+    static constexpr ssize_t window_size = 32768;
+
+    /** The number of bytes of output that must remain for the fast path of the decoder.
+     * A maximum length match of 258 bytes, plus up to 15 bytes which the wide copies of a match
+     * write beyond its end. The last part of the output buffer is decoded one symbol at a time.
+     */
+    static constexpr ssize_t fast_output_margin = 258 + 16;
+
+    /** Decompress the next chunk.
+     *
+     * The bytes of output beyond the returned size may be overwritten as well.
+     *
+     * @param input The compressed input. On return the consumed bytes are removed from the front of the span.
+     * @param output The buffer to write decompressed data into.
+     * @return The number of bytes written into output.
+     * @throw parse_error When the compressed data is invalid.
+     */
+    [[nodiscard]] ssize_t decompress(std::span<std::byte const> &input, std::span<std::byte> output);
+
+    /** Check if the final block of the stream was completely decoded.
+     */
+    [[nodiscard]] bool finished() const noexcept
+    {
+        return _state == state_type::finished;
+    }
+
+    /** The total number of bytes decompressed so far.
+     */
+    [[nodiscard]] int64_t total_out() const noexcept
+    {
+        return _total_out;
+    }
+
+private:
+    enum class state_type : uint8_t {
+        block_header,
+        stored_header,
+        stored_data,
+        table_header,
+        code_length_lengths,
+        code_lengths,
+        literal,
+        distance,
+        match,
+        finished
+    };
+
+    state_type _state = state_type::block_header;
+    bool _final_block = false;
+
+    /** Bits carried over between calls.
+     */
+    uint64_t _accumulator = 0;
+    int _bit_count = 0;
+
+    /** Length of the current match, or the remaining size of the stored block.
+     */
+    int _length = 0;
+    int _distance = 0;
+
+    /** State while reading the code lengths of a dynamic block.
+     */
+    int _nr_literal_codes = 0;
+    int _nr_distance_codes = 0;
+    int _nr_code_length_codes = 0;
+    int _code_length_index = 0;
+    std::array<int, 320> _code_lengths = {};
+    code_length_table_type _code_length_table;
+
+    literal_table_type _dynamic_literal_table;
+    distance_table_type _dynamic_distance_table;
+
+    /** The current block uses the fixed huffman tables instead of the dynamic tables.
+     */
+    bool _fixed_tables = false;
+
+    /** The last 32 KiB of output, as a ring buffer.
+     */
+    bstring _window;
+    ssize_t _window_offset = 0;
+    ssize_t _window_fill = 0;
+    int64_t _total_out = 0;
+
+    [[nodiscard]] bool decode_code_lengths(bit_reader &reader);
+    void copy_match(std::byte *out_begin, std::byte *&out, int length) const noexcept;
+    void update_window(std::span<std::byte const> output) noexcept;
+};
+
+/** Decompress a complete stream and append it to a string.
+ *
+ * @param decompressor A resumable decompressor, such as `inflate_decompressor`.
+ * @param input The compressed data. On return the bytes of the stream are removed from the front of the span.
+ * @param r The string to append the decompressed data to.
+ * @param max_size The maximum size of the string.
+ * @param size_hint The expected size of the string, used to allocate the string in one go.
+ * @throw parse_error When the compressed data is invalid, truncated or too large.
+ */
+template<typename Decompressor>
+void decompress_append(
+    Decompressor &decompressor,
+    std::span<std::byte const> &input,
+    bstring &r,
+    ssize_t max_size,
+    ssize_t size_hint = 0)
+{
+    auto size = std::ssize(r);
+    if (size_hint > size) {
+        // Allocate the margin beyond the expected size, so that the stream is decoded on the fast path
+        // up to its end and the end of the stream is found without growing the string.
+        r.resize(std::min(size_hint + inflate_decompressor::fast_output_margin, max_size));
+    }
+
+    do {
+        if (size == std::ssize(r) && size < max_size) {
+            r.resize(std::min(std::max(size * 2, ssize_t{0x1'0000}), max_size));
+        }
+
+        ttlet input_size = std::ssize(input);
+        ttlet produced = decompressor.decompress(input, std::span(r).subspan(size));
+        size += produced;
+
+        if (produced == 0 && std::ssize(input) == input_size && !decompressor.finished()) {
+            tt_parse_check(size < max_size, "Output buffer overrun");
+            throw parse_error("Input buffer overrun");
+        }
+    } while (!decompressor.finished());
+    r.resize(size);
+}
+
 /** Inflate compressed data using the deflate algorithm
- * `bytes` should include at least 32 bit of trailer, for the overflow check which
- * will slightly overrun the actual compressed data for performance reasons.
  *
  * - gzip has a CRC32+ISIZE trailer.
- *   Since gzip has no end-of-segment indicator, we need to include the trailer
- *   in the byte array passed to inflate anyway.
  * - zlib has a 32 bit check value.
- *   Since zlib has no end-of-segment indicator, we need to include the trailer
- *   in the byte array passed to inflate anyway.
  * - png IDAT chunks include the full zlib-format, including the 32 bit check value.
+ *
+ * @param bytes The compressed data.
+ * @param offset The offset of the deflate stream in bytes, on return the offset directly after the stream.
+ * @param max_size The maximum size of the decompressed data.
+ * @return The decompressed data.
+ * @throw parse_error When the compressed data is invalid or too large.
  */
 bstring inflate(std::span<std::byte const> bytes, ssize_t &offset, ssize_t max_size=0x0100'0000);
 
 }
-
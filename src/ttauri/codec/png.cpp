@@ -4,11 +4,17 @@
 
 #include "png.hpp"
 #include "zlib.hpp"
+#include "crc32.hpp"
+#include "png_filter.hpp"
 #include "../endian.hpp"
 #include "../placement.hpp"
 #include "../color/sRGB.hpp"
 #include "../color/Rec2100.hpp"
 #include "../color/color_space.hpp"
+#include <immintrin.h>
+#include <array>
+#include <vector>
+#include <cstring>
 
 namespace tt {
 
@@ -256,9 +262,11 @@ void png::read_chunks(std::span<std::byte const> bytes, ssize_t &offset)
         default:;
         }
 
-        // Skip over the data, and extract the crc32.
+        // Skip over the data, and check the crc32 of the chunk type and data.
+        ttlet crc_bytes = bytes.subspan(offset - ssizeof(header->type), length + ssizeof(header->type));
         offset += length;
-        [[maybe_unused]] ttlet crc = make_placement_ptr<big_uint32_buf_t>(bytes, offset);
+        ttlet crc = make_placement_ptr<big_uint32_buf_t>(bytes, offset);
+        tt_parse_check(crc->value() == crc32(crc_bytes), "Chunk CRC check failed.");
     }
 
     tt_parse_check(!IHDR_bytes.empty(), "Missing IHDR chunk.");
@@ -301,200 +309,459 @@ png::png(std::unique_ptr<resource_view> view) :
     read_chunks(bytes, offset);
 }
 
-bstring png::decompress_IDATs(ssize_t image_data_size) const {
-    if (std::ssize(idat_chunk_data) == 1) {
-        return zlib_decompress(idat_chunk_data[0], image_data_size);
-    } else {
-        // Merge all idat chunks together.
-        ttlet compressed_data_size = std::accumulate(
-            idat_chunk_data.cbegin(), idat_chunk_data.cend(), ssize_t{0},
-            [](ttlet &a, ttlet &b) {
-            return a + std::ssize(b);
+/** Decompresses the IDAT chunks as a single zlib stream, one line at a time.
+ */
+class png_IDAT_reader {
+public:
+    png_IDAT_reader(std::vector<std::span<std::byte const>> const &chunks) noexcept :
+        _chunk_it(chunks.begin()), _chunk_end(chunks.end())
+    {
+    }
+
+    /** Decompress exactly enough data to fill a line.
+     *
+     * @param line The buffer to fill.
+     * @throw parse_error When the compressed data is invalid or truncated.
+     */
+    void read(std::span<std::byte> line)
+    {
+        ssize_t size = 0;
+        while (size != std::ssize(line)) {
+            if (_input.empty()) {
+                tt_parse_check(_chunk_it != _chunk_end, "Compressed image data is truncated.");
+                _input = *_chunk_it++;
+                continue;
+            }
+
+            ttlet input_size = std::ssize(_input);
+            ttlet produced = _decompressor.decompress(_input, line.subspan(size));
+            size += produced;
+
+            if (produced == 0 && std::ssize(_input) == input_size) {
+                tt_parse_check(!_decompressor.finished(), "Uncompressed image data has incorrect size.");
+                throw parse_error("Compressed image data is truncated.");
+            }
         }
-        );
+    }
 
-        bstring compressed_data;
-        compressed_data.reserve(compressed_data_size);
-        for (ttlet &chunk_data : idat_chunk_data) {
-            std::copy(chunk_data.begin(), chunk_data.end(), std::back_inserter(compressed_data));
+    /** Decompress the end of the stream, after all lines have been read.
+     *
+     * @throw parse_error When there is more image data, or when the stream is invalid or truncated.
+     */
+    void finish()
+    {
+        auto extra = std::array<std::byte, 1>{};
+        while (!_decompressor.finished()) {
+            if (_input.empty()) {
+                tt_parse_check(_chunk_it != _chunk_end, "Compressed image data is truncated.");
+                _input = *_chunk_it++;
+                continue;
+            }
+
+            ttlet input_size = std::ssize(_input);
+            ttlet produced = _decompressor.decompress(_input, extra);
+            tt_parse_check(produced == 0, "Uncompressed image data is too large.");
+            tt_parse_check(std::ssize(_input) != input_size || _decompressor.finished(), "Compressed image data is invalid.");
         }
 
-        return zlib_decompress(compressed_data, image_data_size);
+        tt_parse_check(_input.empty() && _chunk_it == _chunk_end, "Extra data after end of compressed image data.");
     }
-}
 
-void png::unfilter_line_sub(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept
-{
-    for (int i = 0; i != bytes_per_line; ++i) {
-        int j = i - bytes_per_pixel;
+private:
+    zlib_decompressor _decompressor;
+    std::span<std::byte const> _input;
+    std::vector<std::span<std::byte const>>::const_iterator _chunk_it;
+    std::vector<std::span<std::byte const>>::const_iterator _chunk_end;
+};
 
-        uint8_t prev_raw = j >= 0 ? line[j] : 0;
-        line[i] += prev_raw;
+void png::unfilter_line(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const
+{
+    switch (line[0]) {
+    case 0: return;
+    case 1: return png_unfilter_sub(line.subspan(1, bytes_per_line), bytes_per_pixel);
+    case 2: return png_unfilter_up(line.subspan(1, bytes_per_line), prev_line);
+    case 3: return png_unfilter_average(line.subspan(1, bytes_per_line), prev_line, bytes_per_pixel);
+    case 4: return png_unfilter_paeth(line.subspan(1, bytes_per_line), prev_line, bytes_per_pixel);
+    default:
+        throw parse_error("Unknown line-filter type");
     }
 }
 
-void png::unfilter_line_up(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept
+/** Read a sample of a pixel.
+ *
+ * @tparam BitDepth The number of bits of a sample, 8 or 16. 16 bit samples are big-endian.
+ * @param bytes The bytes of a line.
+ * @param index The index of the sample in the line.
+ */
+template<int BitDepth>
+[[nodiscard]] static tt_force_inline int png_get_sample(std::byte const *bytes, ssize_t index) noexcept
 {
-    for (int i = 0; i != bytes_per_line; ++i) {
-        line[i] += prev_line[i];
+    if constexpr (BitDepth == 16) {
+        return (static_cast<int>(bytes[index * 2]) << 8) | static_cast<int>(bytes[index * 2 + 1]);
+    } else {
+        return static_cast<int>(bytes[index]);
     }
 }
 
-void png::unfilter_line_average(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept
+/** Convert 8 pixels of a line.
+ *
+ * The samples are looked up in the transfer function one at a time, after which the color
+ * matrix and alpha are applied to 8 pixels at a time, one color component per register.
+ * The components are then transposed into pixels and converted to half-float.
+ *
+ * The calculation is done in the same order as `matrix * color`, so that the result is
+ * identical to converting one pixel at a time.
+ *
+ * @tparam Channels The number of samples per pixel: gray, gray+alpha, RGB or RGBA.
+ * @tparam BitDepth The number of bits per sample, 8 or 16.
+ * @param bytes The bytes of the first pixel in the line.
+ * @param nr_pixels The number of pixels to convert, at most 8.
+ * @param pixels The pixels to write, exactly `nr_pixels` pixels are written.
+ */
+template<int Channels, int BitDepth>
+static tt_force_inline void png_convert_pixels(
+    std::byte const *bytes,
+    ssize_t nr_pixels,
+    sfloat_rgba16 *pixels,
+    float const *transfer_function,
+    __m256 const (&matrix)[12],
+    __m256 alpha_mul) noexcept
 {
-    for (int i = 0; i != bytes_per_line; ++i) {
-        int j = i - bytes_per_pixel;
-
-        uint8_t prev_raw = j >= 0 ? line[j] : 0;
-        line[i] += (prev_raw + prev_line[i]) / 2;
+    constexpr bool is_color = Channels >= 3;
+    constexpr bool has_alpha = Channels == 2 || Channels == 4;
+    constexpr int max_value = (1 << BitDepth) - 1;
+
+    alignas(32) std::array<float, 8> r_samples = {};
+    alignas(32) std::array<float, 8> g_samples = {};
+    alignas(32) std::array<float, 8> b_samples = {};
+    alignas(32) std::array<int32_t, 8> a_samples = {};
+
+    for (ssize_t i = 0; i != nr_pixels; ++i) {
+        ttlet index = i * Channels;
+        if constexpr (is_color) {
+            r_samples[i] = transfer_function[png_get_sample<BitDepth>(bytes, index)];
+            g_samples[i] = transfer_function[png_get_sample<BitDepth>(bytes, index + 1)];
+            b_samples[i] = transfer_function[png_get_sample<BitDepth>(bytes, index + 2)];
+        } else {
+            r_samples[i] = g_samples[i] = b_samples[i] = transfer_function[png_get_sample<BitDepth>(bytes, index)];
+        }
+        if constexpr (has_alpha) {
+            a_samples[i] = png_get_sample<BitDepth>(bytes, index + Channels - 1);
+        } else {
+            a_samples[i] = max_value;
+        }
     }
-}
 
-static uint8_t paeth_predictor(uint8_t _a, uint8_t _b, uint8_t _c) noexcept {
-    auto a = static_cast<int>(_a);
-    auto b = static_cast<int>(_b);
-    auto c = static_cast<int>(_c);
-
-    auto p = a + b - c;
-    auto pa = std::abs(p - a);
-    auto pb = std::abs(p - b);
-    auto pc = std::abs(p - c);
-
-    if (pa <= pb && pa <= pc) {
-        return static_cast<uint8_t>(a);
-    } else if (pb <= pc) {
-        return static_cast<uint8_t>(b);
+    ttlet r_in = _mm256_load_ps(r_samples.data());
+    ttlet g_in = _mm256_load_ps(g_samples.data());
+    ttlet b_in = _mm256_load_ps(b_samples.data());
+
+    // matrix contains the broadcasted elements of the color matrix in column-major order.
+    ttlet r = _mm256_add_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(matrix[0], r_in), _mm256_mul_ps(matrix[3], g_in)), _mm256_mul_ps(matrix[6], b_in)),
+        matrix[9]);
+    ttlet g = _mm256_add_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(matrix[1], r_in), _mm256_mul_ps(matrix[4], g_in)), _mm256_mul_ps(matrix[7], b_in)),
+        matrix[10]);
+    ttlet b = _mm256_add_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(matrix[2], r_in), _mm256_mul_ps(matrix[5], g_in)), _mm256_mul_ps(matrix[8], b_in)),
+        matrix[11]);
+    ttlet a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_load_si256(reinterpret_cast<__m256i const *>(a_samples.data()))), alpha_mul);
+
+    // Transpose the components into pixels; each 128 bit lane holds pixel n and n + 4.
+    ttlet rg_lo = _mm256_unpacklo_ps(r, g);
+    ttlet rg_hi = _mm256_unpackhi_ps(r, g);
+    ttlet ba_lo = _mm256_unpacklo_ps(b, a);
+    ttlet ba_hi = _mm256_unpackhi_ps(b, a);
+    ttlet p04 = _mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(1, 0, 1, 0));
+    ttlet p15 = _mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(3, 2, 3, 2));
+    ttlet p26 = _mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(1, 0, 1, 0));
+    ttlet p37 = _mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(3, 2, 3, 2));
+
+    ttlet h01 = _mm256_cvtps_ph(_mm256_permute2f128_ps(p04, p15, 0x20), _MM_FROUND_CUR_DIRECTION);
+    ttlet h23 = _mm256_cvtps_ph(_mm256_permute2f128_ps(p26, p37, 0x20), _MM_FROUND_CUR_DIRECTION);
+    ttlet h45 = _mm256_cvtps_ph(_mm256_permute2f128_ps(p04, p15, 0x31), _MM_FROUND_CUR_DIRECTION);
+    ttlet h67 = _mm256_cvtps_ph(_mm256_permute2f128_ps(p26, p37, 0x31), _MM_FROUND_CUR_DIRECTION);
+
+    if (nr_pixels == 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels), h01);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + 2), h23);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + 4), h45);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + 6), h67);
     } else {
-        return static_cast<uint8_t>(c);
+        alignas(16) std::array<sfloat_rgba16, 8> tmp;
+        _mm_store_si128(reinterpret_cast<__m128i *>(tmp.data()), h01);
+        _mm_store_si128(reinterpret_cast<__m128i *>(tmp.data() + 2), h23);
+        _mm_store_si128(reinterpret_cast<__m128i *>(tmp.data() + 4), h45);
+        _mm_store_si128(reinterpret_cast<__m128i *>(tmp.data() + 6), h67);
+        std::copy_n(tmp.begin(), nr_pixels, pixels);
     }
 }
 
-void png::unfilter_line_paeth(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept
+template<int Channels, int BitDepth>
+static void png_convert_line(
+    std::span<std::byte const> bytes,
+    pixel_row<sfloat_rgba16> &line,
+    std::vector<float> const &transfer_function,
+    __m256 const (&matrix)[12],
+    __m256 alpha_mul) noexcept
 {
-    for (int i = 0; i != bytes_per_line; ++i) {
-        int j = i - bytes_per_pixel;
-
-        uint8_t up = prev_line[i];
-        uint8_t left = j >= 0 ? line[j] : 0;
-        uint8_t left_up = j >= 0 ? prev_line[j] : 0;
-        line[i] += paeth_predictor(left, up, left_up);
+    constexpr ssize_t bytes_per_pixel = Channels * BitDepth / 8;
+
+    ttlet width = line.width();
+    tt_axiom(std::ssize(bytes) >= width * bytes_per_pixel);
+
+    for (ssize_t x = 0; x < width; x += 8) {
+        png_convert_pixels<Channels, BitDepth>(
+            bytes.data() + x * bytes_per_pixel,
+            std::min(width - x, ssize_t{8}),
+            line.data() + x,
+            transfer_function.data(),
+            matrix,
+            alpha_mul);
     }
 }
 
-void png::unfilter_line(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const
+void png::data_to_image_line(std::span<std::byte const> bytes, pixel_row<sfloat_rgba16> &line) const noexcept
 {
-    switch (line[0]) {
-    case 0: return;
-    case 1: return unfilter_line_sub(line.subspan(1, bytes_per_line), prev_line);
-    case 2: return unfilter_line_up(line.subspan(1, bytes_per_line), prev_line);
-    case 3: return unfilter_line_average(line.subspan(1, bytes_per_line), prev_line);
-    case 4: return unfilter_line_paeth(line.subspan(1, bytes_per_line), prev_line);
-    default:
-        throw parse_error("Unknown line-filter type");
+    tt_axiom(bit_depth == 8 || bit_depth == 16);
+    tt_axiom(!is_palletted);
+
+    ttlet columns = std::array{get<0>(color_to_sRGB), get<1>(color_to_sRGB), get<2>(color_to_sRGB), get<3>(color_to_sRGB)};
+    __m256 matrix[12];
+    for (int column = 0; column != 4; ++column) {
+        for (int row = 0; row != 3; ++row) {
+            matrix[column * 3 + row] = _mm256_set1_ps(columns[column][row]);
+        }
+    }
+
+    ttlet alpha_mul = _mm256_set1_ps(bit_depth == 16 ? 1.0f / 65535.0f : 1.0f / 255.0f);
+
+    switch (samples_per_pixel * 100 + bit_depth) {
+    case 108: return png_convert_line<1, 8>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 208: return png_convert_line<2, 8>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 308: return png_convert_line<3, 8>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 408: return png_convert_line<4, 8>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 116: return png_convert_line<1, 16>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 216: return png_convert_line<2, 16>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 316: return png_convert_line<3, 16>(bytes, line, transfer_function, matrix, alpha_mul);
+    case 416: return png_convert_line<4, 16>(bytes, line, transfer_function, matrix, alpha_mul);
+    default: tt_no_default();
     }
 }
 
-void png::unfilter_lines(bstring &image_data) const
+void png::decode_image(pixel_map<sfloat_rgba16> &image) const
 {
-    auto image_bytes = std::span(reinterpret_cast<uint8_t *>(image_data.data()), std::ssize(image_data));
-    auto zero_line = bstring(bytes_per_line, std::byte{0});
+    // Each line is decompressed into a ring buffer of two lines, unfiltered against
+    // the previous line and then converted directly into the image.
+    // There is a filter selection byte in front of every line.
+    auto lines = bstring(stride * 2, std::byte{0});
+    auto lines_span = std::span(lines);
 
-    auto prev_line = std::span(reinterpret_cast<uint8_t *>(zero_line.data()), std::ssize(zero_line));
+    auto reader = png_IDAT_reader{idat_chunk_data};
     for (int y = 0; y != height; ++y) {
-        auto line = image_bytes.subspan(y * stride, stride);
-        unfilter_line(line, prev_line);
-        prev_line = line.subspan(1, bytes_per_line);
+        ttlet line = lines_span.subspan((y % 2) * stride, stride);
+        ttlet prev_line = lines_span.subspan(((y + 1) % 2) * stride + 1, bytes_per_line);
+
+        reader.read(line);
+        unfilter_line(
+            std::span(reinterpret_cast<uint8_t *>(line.data()), line.size()),
+            std::span(reinterpret_cast<uint8_t const *>(prev_line.data()), prev_line.size()));
+
+        // PNG images are stored top to bottom, the pixel_map is bottom to top.
+        auto pixel_line = image[height - y - 1];
+        data_to_image_line(line.subspan(1, bytes_per_line), pixel_line);
     }
+    reader.finish();
 }
 
-static int get_sample(std::span<std::byte const> bytes, ssize_t &offset, bool two_bytes)
+pixel_map<sfloat_rgba16> png::load(URL const &url)
 {
-    int value = static_cast<uint8_t>(bytes[offset++]);
-    if (two_bytes) {
-        value = (value << 8) | static_cast<uint8_t>(bytes[offset++]);
-    }
-    return value;
+    ttlet png_data = png(url);
+    auto image = pixel_map<sfloat_rgba16>{png_data.extent()};
+    png_data.decode_image(image);
+    return image;
 }
 
-i32x4 png::extract_pixel_from_line(std::span<std::byte const> bytes, int x) const noexcept
+/** Append a chunk, including the length and CRC, to a PNG file.
+ */
+static void png_write_chunk(bstring &output, char const (&type)[5], std::span<std::byte const> data) noexcept
 {
-    tt_axiom(bit_depth == 8 || bit_depth == 16);
-    tt_axiom(!is_palletted);
-
-    int r = 0;
-    int g = 0;
-    int b = 0;
-    int a = 0;
+    auto header = ChunkHeader{};
+    header.length = narrow_cast<uint32_t>(std::ssize(data));
+    std::memcpy(header.type, type, 4);
+
+    ttlet offset = std::ssize(output);
+    output.append(reinterpret_cast<std::byte const *>(&header), sizeof(header));
+    output.append(data.begin(), data.end());
+
+    // The CRC is calculated over the chunk type and data.
+    auto crc = big_uint32_buf_t{};
+    crc = crc32(std::span(output).subspan(offset + 4));
+    output.append(reinterpret_cast<std::byte const *>(&crc), sizeof(crc));
+}
 
-    ssize_t offset = x * bytes_per_pixel;
-    if (is_color) {
-        r = get_sample(bytes, offset, bit_depth == 16);
-        g = get_sample(bytes, offset, bit_depth == 16);
-        b = get_sample(bytes, offset, bit_depth == 16);
-    } else {
-        r = g = b = get_sample(bytes, offset, bit_depth == 16);
-    }
-    if (has_alpha) {
-        a = get_sample(bytes, offset, bit_depth == 16);
-    } else {
-        a = (bit_depth == 16) ? 65535 : 255;
+/** Write the compressed image data into IDAT chunks.
+ */
+class png_IDAT_writer {
+public:
+    png_IDAT_writer(bstring &output, int level) noexcept : _output(output), _compressor(level) {}
+
+    /** Compress a filtered line, including the filter-type byte.
+     */
+    void write(std::span<std::byte const> line) noexcept
+    {
+        _compressor.compress(line, _buffer);
+        if (std::ssize(_buffer) >= chunk_size) {
+            flush();
+        }
     }
 
-    return {r, g, b, a};
-}
-
-void png::data_to_image_line(std::span<std::byte const> bytes, pixel_row<sfloat_rgba16> &line) const noexcept
-{
-    ttlet alpha_mul = bit_depth == 16 ? 1.0f/65535.0f : 1.0f/255.0f;
-    for (int x = 0; x != width; ++x) {
-        ttlet value = extract_pixel_from_line(bytes, x);
+    /** Compress the end of the stream and write the last IDAT chunk.
+     */
+    void finish() noexcept
+    {
+        _compressor.finish(_buffer);
+        flush();
+    }
 
-        ttlet linear_color = color(
-            transfer_function[value.x()],
-            transfer_function[value.y()],
-            transfer_function[value.z()]
-        );
+private:
+    static constexpr ssize_t chunk_size = 0x10000;
 
-        auto lesRGB_color = color_to_sRGB * linear_color;
-        lesRGB_color.a() = static_cast<float>(value.w()) * alpha_mul;
+    bstring &_output;
+    zlib_compressor _compressor;
+    bstring _buffer;
 
-        line[x] = lesRGB_color;
+    void flush() noexcept
+    {
+        if (!_buffer.empty()) {
+            png_write_chunk(_output, "IDAT", _buffer);
+            _buffer.clear();
+        }
     }
-}
+};
 
-void png::data_to_image(bstring bytes, pixel_map<sfloat_rgba16> &image) const noexcept
+/** Encode an image.
+ *
+ * Each line is converted to PNG samples, filtered against the previous line and compressed
+ * before the next line is converted; so that the converted, filtered and compressed data of
+ * a line is still in the cache when it is used.
+ *
+ * @param convert_line A function `(pixel_row<T> const &, std::span<uint8_t>) -> std::span<uint8_t const>`
+ *                     which converts a row of the image to PNG samples. It may return the
+ *                     row itself when the pixels are already in the PNG format.
+ */
+template<typename T, typename ConvertLine>
+[[nodiscard]] static bstring png_encode(
+    pixel_map<T> const &image,
+    int color_type,
+    int bit_depth,
+    int bytes_per_pixel,
+    bool is_sRGB,
+    int level,
+    ConvertLine const &convert_line) noexcept
 {
-    auto bytes_span = std::span(bytes);
+    tt_axiom(image.width() > 0 && image.height() > 0);
+
+    ttlet width = image.width();
+    ttlet height = image.height();
+    ttlet bytes_per_line = width * bytes_per_pixel;
+
+    auto r = bstring{};
+    r.append(reinterpret_cast<std::byte const *>("\x89PNG\r\n\x1a\n"), 8);
+
+    auto ihdr = IHDR{};
+    ihdr.width = narrow_cast<uint32_t>(width);
+    ihdr.height = narrow_cast<uint32_t>(height);
+    ihdr.bit_depth = narrow_cast<uint8_t>(bit_depth);
+    ihdr.color_type = narrow_cast<uint8_t>(color_type);
+    ihdr.compression_method = 0;
+    ihdr.filter_method = 0;
+    ihdr.interlace_method = 0;
+    png_write_chunk(r, "IHDR", std::as_bytes(std::span(&ihdr, 1)));
+
+    if (is_sRGB) {
+        // Rendering intent: perceptual.
+        ttlet srgb = sRGB{0};
+        png_write_chunk(r, "sRGB", std::as_bytes(std::span(&srgb, 1)));
+    }
 
-    for (int y = 0; y != height; ++y) {
-        int inv_y = height - y - 1;
+    // Two buffers for converted lines, the previous line starts as zeros.
+    auto lines = std::vector<uint8_t>(bytes_per_line * 2, 0);
+    auto prev_line = std::span<uint8_t const>(lines.data() + bytes_per_line, bytes_per_line);
+    auto filtered_line = std::vector<uint8_t>(bytes_per_line + 1);
 
-        auto bytes_line = bytes_span.subspan(inv_y * stride + 1, bytes_per_line);
-        auto pixel_line = image[y];
-        data_to_image_line(bytes_line, pixel_line);
+    auto writer = png_IDAT_writer{r, level};
+    for (ssize_t y = 0; y != height; ++y) {
+        // PNG images are stored top to bottom, the pixel_map is bottom to top.
+        ttlet line = convert_line(image[height - y - 1], std::span(lines.data() + (y % 2) * bytes_per_line, bytes_per_line));
+
+        png_filter_line(line, prev_line, bytes_per_pixel, filtered_line);
+        writer.write(std::as_bytes(std::span(filtered_line)));
+        prev_line = line;
     }
+    writer.finish();
+
+    png_write_chunk(r, "IEND", {});
+    return r;
 }
 
-void png::decode_image(pixel_map<sfloat_rgba16> &image) const
+bstring png::encode(pixel_map<uint8_t> const &image, int level) noexcept
 {
-    // There is a filter selection byte in front of every line.
-    ttlet image_data_size = stride * height;
-
-    auto image_data = decompress_IDATs(image_data_size);
-    tt_parse_check(std::ssize(image_data) == image_data_size, "Uncompressed image data has incorrect size.");
+    return png_encode(image, 0, 8, 1, false, level, [](pixel_row<uint8_t> const &row, std::span<uint8_t>) {
+        return std::span<uint8_t const>(row.data(), row.width());
+    });
+}
 
-    unfilter_lines(image_data);
+bstring png::encode(pixel_map<sdf_r8> const &image, int level) noexcept
+{
+    return png_encode(image, 0, 8, 1, false, level, [](pixel_row<sdf_r8> const &row, std::span<uint8_t> line) {
+        for (ssize_t x = 0; x != row.width(); ++x) {
+            line[x] = static_cast<uint8_t>(row[x].value) ^ 0x80;
+        }
+        return std::span<uint8_t const>(line);
+    });
+}
 
-    data_to_image(image_data, image);
+/** A table to convert the bits of a float16 to 16 bit PNG samples.
+ *
+ * @param is_color Convert a color value using the sRGB transfer function, otherwise convert alpha linearly.
+ */
+[[nodiscard]] static std::vector<uint16_t> png_float16_to_sample_table(bool is_color) noexcept
+{
+    auto r = std::vector<uint16_t>(65536);
+    for (int i = 0; i != 65536; ++i) {
+        ttlet value = static_cast<float>(float16{narrow_cast<uint16_t>(i), true});
+        ttlet u = is_color ? sRGB_linear_to_gamma(value) : value;
 
+        // Negative values and NaN become zero.
+        r[i] = u >= 1.0f ? uint16_t{65535} : u > 0.0f ? static_cast<uint16_t>(u * 65535.0f + 0.5f) : uint16_t{0};
+    }
+    return r;
 }
 
-pixel_map<sfloat_rgba16> png::load(URL const &url)
+bstring png::encode(pixel_map<sfloat_rgba16> const &image, int level) noexcept
 {
-    ttlet png_data = png(url);
-    auto image = pixel_map<sfloat_rgba16>{png_data.extent()};
-    png_data.decode_image(image);
-    return image;
+    static ttlet color_table = png_float16_to_sample_table(true);
+    static ttlet alpha_table = png_float16_to_sample_table(false);
+
+    return png_encode(image, 6, 16, 8, true, level, [](pixel_row<sfloat_rgba16> const &row, std::span<uint8_t> line) {
+        static_assert(sizeof(sfloat_rgba16) == sizeof(std::array<uint16_t, 4>));
+
+        for (ssize_t x = 0; x != row.width(); ++x) {
+            std::array<uint16_t, 4> pixel;
+            std::memcpy(pixel.data(), &row[x], sizeof(pixel));
+
+            // PNG samples are big-endian.
+            ttlet sample = std::array{
+                native_to_big(color_table[pixel[0]]),
+                native_to_big(color_table[pixel[1]]),
+                native_to_big(color_table[pixel[2]]),
+                native_to_big(alpha_table[pixel[3]])};
+            std::memcpy(line.data() + x * 8, sample.data(), sizeof(sample));
+        }
+        return std::span<uint8_t const>(line);
+    });
 }
 
 
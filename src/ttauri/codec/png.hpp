@@ -8,10 +8,12 @@
 #include "../required.hpp"
 #include "../pixel_map.hpp"
 #include "../color/sfloat_rgba16.hpp"
+#include "../color/sdf_r8.hpp"
 #include "../geometry/identity.hpp"
 #include "../numeric_array.hpp"
 #include "../URL.hpp"
 #include "../resource_view.hpp"
+#include "../file.hpp"
 #include "../byte_string.hpp"
 #include <span>
 #include <vector>
@@ -37,6 +39,53 @@ public:
 
     static pixel_map<sfloat_rgba16> load(URL const &url);
 
+    /** Encode a gray scale image as an 8 bit PNG file.
+     *
+     * Each line is filtered with the filter selected by `png_filter_line()` and passed
+     * directly to a streaming zlib compressor.
+     *
+     * @param image The image to encode.
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     * @return The PNG file.
+     */
+    [[nodiscard]] static bstring encode(pixel_map<uint8_t> const &image, int level = 2) noexcept;
+
+    /** Encode a signed distance field as an 8 bit gray scale PNG file.
+     *
+     * The signed values are stored with an offset of 128, so that a distance of zero is mid-gray.
+     *
+     * @param image The image to encode.
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     * @return The PNG file.
+     */
+    [[nodiscard]] static bstring encode(pixel_map<sdf_r8> const &image, int level = 2) noexcept;
+
+    /** Encode an image as a 16 bit RGBA PNG file.
+     *
+     * The linear color values are converted to the sRGB transfer function and clamped between 0.0 and 1.0,
+     * alpha is stored linearly.
+     *
+     * @param image The image to encode.
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     * @return The PNG file.
+     */
+    [[nodiscard]] static bstring encode(pixel_map<sfloat_rgba16> const &image, int level = 2) noexcept;
+
+    /** Encode an image and write it to a PNG file.
+     *
+     * @param url The location of the file to create or overwrite.
+     * @param image The image to encode.
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     * @throw io_error
+     */
+    template<typename T>
+    static void save(URL const &url, pixel_map<T> const &image, int level = 2)
+    {
+        ttlet bytes = encode(image, level);
+        auto f = file(url, access_mode::truncate_or_create_for_write);
+        f.write(bytes);
+    }
+
 private:
     /** Matrix to convert png color values to sRGB.
      * The default are sRGB color primaries and white-point.
@@ -83,16 +132,8 @@ private:
     void generate_sRGB_transfer_function() noexcept;
     void generate_Rec2100_transfer_function() noexcept;
     void generate_gamma_transfer_function(float gamma) noexcept;
-    bstring decompress_IDATs(ssize_t image_data_size) const;
-    void unfilter_lines(bstring &image_data) const;
     void unfilter_line(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const;
-    void unfilter_line_sub(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept;
-    void unfilter_line_up(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept;
-    void unfilter_line_average(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept;
-    void unfilter_line_paeth(std::span<uint8_t> line, std::span<uint8_t const> prev_line) const noexcept;
-    void data_to_image(bstring bytes, pixel_map<sfloat_rgba16> &image) const noexcept;
     void data_to_image_line(std::span<std::byte const> bytes, pixel_row<sfloat_rgba16> &row) const noexcept;
-    i32x4 extract_pixel_from_line(std::span<std::byte const> bytes, int x) const noexcept;
 
 };
 
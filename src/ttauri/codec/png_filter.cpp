@@ -0,0 +1,369 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "png_filter.hpp"
+#include "../assert.hpp"
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdlib>
+
+namespace tt {
+
+/** Load the bytes of a single pixel in the low bytes of a register, the other bytes are zero.
+ */
+template<int BytesPerPixel>
+[[nodiscard]] static tt_force_inline __m128i png_load_pixel(uint8_t const *ptr) noexcept
+{
+    if constexpr (BytesPerPixel == 8) {
+        return _mm_loadl_epi64(reinterpret_cast<__m128i const *>(ptr));
+    } else {
+        uint64_t r = 0;
+        std::memcpy(&r, ptr, BytesPerPixel);
+        return _mm_cvtsi64_si128(static_cast<int64_t>(r));
+    }
+}
+
+/** Store the low bytes of a register as a single pixel.
+ */
+template<int BytesPerPixel>
+static tt_force_inline void png_store_pixel(uint8_t *ptr, __m128i pixel) noexcept
+{
+    if constexpr (BytesPerPixel == 8) {
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(ptr), pixel);
+    } else {
+        ttlet r = static_cast<uint64_t>(_mm_cvtsi128_si64(pixel));
+        std::memcpy(ptr, &r, BytesPerPixel);
+    }
+}
+
+/** Unfilter sub, 16 bytes at a time.
+ *
+ * A register holds as many whole pixels as fit; the pixels are summed using a
+ * prefix-sum over the pixels in log2 steps, starting with the last pixel of the previous register.
+ */
+template<int BytesPerPixel>
+static void png_unfilter_sub(uint8_t *line, ssize_t size) noexcept
+{
+    constexpr int chunk_size = 16 / BytesPerPixel * BytesPerPixel;
+
+    ttlet index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    // The bytes in the register beyond the last whole pixel keep their filtered value.
+    ttlet partial_mask = _mm_cmpgt_epi8(index, _mm_set1_epi8(chunk_size - 1));
+    ttlet pixel_mask = _mm_cmplt_epi8(index, _mm_set1_epi8(BytesPerPixel));
+
+    auto left = _mm_setzero_si128();
+    ssize_t i = 0;
+    for (; i + 16 <= size; i += chunk_size) {
+        ttlet raw = _mm_loadu_si128(reinterpret_cast<__m128i const *>(line + i));
+
+        auto x = _mm_add_epi8(raw, left);
+        x = _mm_add_epi8(x, _mm_slli_si128(x, BytesPerPixel));
+        if constexpr (BytesPerPixel * 2 < chunk_size) {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, BytesPerPixel * 2));
+        }
+        if constexpr (BytesPerPixel * 4 < chunk_size) {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, BytesPerPixel * 4));
+        }
+        if constexpr (BytesPerPixel * 8 < chunk_size) {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, BytesPerPixel * 8));
+        }
+        x = _mm_blendv_epi8(x, raw, partial_mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(line + i), x);
+
+        left = _mm_and_si128(_mm_srli_si128(x, chunk_size - BytesPerPixel), pixel_mask);
+    }
+
+    // The first pixel of the line is not changed.
+    for (i = std::max(i, ssize_t{BytesPerPixel}); i < size; ++i) {
+        line[i] += line[i - BytesPerPixel];
+    }
+}
+
+/** Unfilter average, one pixel at a time.
+ */
+template<int BytesPerPixel>
+static void png_unfilter_average(uint8_t *line, uint8_t const *prev_line, ssize_t size) noexcept
+{
+    ttlet one = _mm_set1_epi8(1);
+
+    auto a = _mm_setzero_si128();
+    for (ssize_t i = 0; i + BytesPerPixel <= size; i += BytesPerPixel) {
+        ttlet b = png_load_pixel<BytesPerPixel>(prev_line + i);
+        ttlet x = png_load_pixel<BytesPerPixel>(line + i);
+
+        // _mm_avg_epu8() rounds up, subtract the lowest bit when the sum is odd.
+        ttlet average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(x, average);
+        png_store_pixel<BytesPerPixel>(line + i, a);
+    }
+}
+
+/** Unfilter paeth, one pixel at a time.
+ *
+ * The predictor is calculated with 16 bit samples:
+ *  - pa = |p - a| = |b - c|
+ *  - pb = |p - b| = |a - c|
+ *  - pc = |p - c| = |(b - c) + (a - c)|
+ */
+template<int BytesPerPixel>
+static void png_unfilter_paeth(uint8_t *line, uint8_t const *prev_line, ssize_t size) noexcept
+{
+    ttlet zero = _mm_setzero_si128();
+
+    auto a = zero;
+    auto c = zero;
+    for (ssize_t i = 0; i + BytesPerPixel <= size; i += BytesPerPixel) {
+        ttlet b = _mm_unpacklo_epi8(png_load_pixel<BytesPerPixel>(prev_line + i), zero);
+        ttlet x = png_load_pixel<BytesPerPixel>(line + i);
+
+        ttlet b_c = _mm_sub_epi16(b, c);
+        ttlet a_c = _mm_sub_epi16(a, c);
+        ttlet pa = _mm_abs_epi16(b_c);
+        ttlet pb = _mm_abs_epi16(a_c);
+        ttlet pc = _mm_abs_epi16(_mm_add_epi16(b_c, a_c));
+        ttlet smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+        // On ties the order of preference is a, b, c.
+        auto predictor = _mm_blendv_epi8(b, c, _mm_cmpeq_epi16(smallest, pc));
+        predictor = _mm_blendv_epi8(predictor, b, _mm_cmpeq_epi16(smallest, pb));
+        predictor = _mm_blendv_epi8(predictor, a, _mm_cmpeq_epi16(smallest, pa));
+
+        ttlet r = _mm_add_epi8(x, _mm_packus_epi16(predictor, predictor));
+        png_store_pixel<BytesPerPixel>(line + i, r);
+
+        a = _mm_unpacklo_epi8(r, zero);
+        c = b;
+    }
+}
+
+[[nodiscard]] static uint8_t png_paeth_predictor(uint8_t _a, uint8_t _b, uint8_t _c) noexcept
+{
+    auto a = static_cast<int>(_a);
+    auto b = static_cast<int>(_b);
+    auto c = static_cast<int>(_c);
+
+    auto p = a + b - c;
+    auto pa = std::abs(p - a);
+    auto pb = std::abs(p - b);
+    auto pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return static_cast<uint8_t>(a);
+    } else if (pb <= pc) {
+        return static_cast<uint8_t>(b);
+    } else {
+        return static_cast<uint8_t>(c);
+    }
+}
+
+void png_unfilter_sub(std::span<uint8_t> line, int bytes_per_pixel) noexcept
+{
+    ttlet size = std::ssize(line);
+
+    switch (bytes_per_pixel) {
+    case 1: return png_unfilter_sub<1>(line.data(), size);
+    case 2: return png_unfilter_sub<2>(line.data(), size);
+    case 3: return png_unfilter_sub<3>(line.data(), size);
+    case 4: return png_unfilter_sub<4>(line.data(), size);
+    case 6: return png_unfilter_sub<6>(line.data(), size);
+    case 8: return png_unfilter_sub<8>(line.data(), size);
+    default:
+        for (ssize_t i = bytes_per_pixel; i < size; ++i) {
+            line[i] += line[i - bytes_per_pixel];
+        }
+    }
+}
+
+void png_unfilter_up(std::span<uint8_t> line, std::span<uint8_t const> prev_line) noexcept
+{
+    tt_axiom(std::ssize(prev_line) >= std::ssize(line));
+
+    ttlet size = std::ssize(line);
+    ssize_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        ttlet x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(line.data() + i));
+        ttlet b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(prev_line.data() + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(line.data() + i), _mm_add_epi8(x, b));
+    }
+    for (; i < size; ++i) {
+        line[i] += prev_line[i];
+    }
+}
+
+void png_unfilter_average(std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel) noexcept
+{
+    tt_axiom(std::ssize(prev_line) >= std::ssize(line));
+
+    ttlet size = std::ssize(line);
+    switch (bytes_per_pixel) {
+    case 3: return png_unfilter_average<3>(line.data(), prev_line.data(), size);
+    case 4: return png_unfilter_average<4>(line.data(), prev_line.data(), size);
+    case 6: return png_unfilter_average<6>(line.data(), prev_line.data(), size);
+    case 8: return png_unfilter_average<8>(line.data(), prev_line.data(), size);
+    default:
+        for (ssize_t i = 0; i < std::min(ssize_t{bytes_per_pixel}, size); ++i) {
+            line[i] += prev_line[i] / 2;
+        }
+        for (ssize_t i = bytes_per_pixel; i < size; ++i) {
+            line[i] += static_cast<uint8_t>((line[i - bytes_per_pixel] + prev_line[i]) / 2);
+        }
+    }
+}
+
+void png_unfilter_paeth(std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel) noexcept
+{
+    tt_axiom(std::ssize(prev_line) >= std::ssize(line));
+
+    ttlet size = std::ssize(line);
+    switch (bytes_per_pixel) {
+    case 3: return png_unfilter_paeth<3>(line.data(), prev_line.data(), size);
+    case 4: return png_unfilter_paeth<4>(line.data(), prev_line.data(), size);
+    case 6: return png_unfilter_paeth<6>(line.data(), prev_line.data(), size);
+    case 8: return png_unfilter_paeth<8>(line.data(), prev_line.data(), size);
+    default:
+        // With a and c zero the predictor of the first pixel is always b.
+        for (ssize_t i = 0; i < std::min(ssize_t{bytes_per_pixel}, size); ++i) {
+            line[i] += prev_line[i];
+        }
+        for (ssize_t i = bytes_per_pixel; i < size; ++i) {
+            line[i] += png_paeth_predictor(line[i - bytes_per_pixel], prev_line[i], prev_line[i - bytes_per_pixel]);
+        }
+    }
+}
+
+/** The predicted value of a byte for each filter.
+ */
+[[nodiscard]] static tt_force_inline uint8_t png_predict(int filter, uint8_t a, uint8_t b, uint8_t c) noexcept
+{
+    switch (filter) {
+    case 0: return 0;
+    case 1: return a;
+    case 2: return b;
+    case 3: return static_cast<uint8_t>((static_cast<int>(a) + static_cast<int>(b)) / 2);
+    case 4: return png_paeth_predictor(a, b, c);
+    default: tt_no_default();
+    }
+}
+
+/** The predicted value of 8 bytes for the paeth filter, with 16 bit samples.
+ */
+[[nodiscard]] static tt_force_inline __m128i png_paeth_predict(__m128i a, __m128i b, __m128i c) noexcept
+{
+    ttlet b_c = _mm_sub_epi16(b, c);
+    ttlet a_c = _mm_sub_epi16(a, c);
+    ttlet pa = _mm_abs_epi16(b_c);
+    ttlet pb = _mm_abs_epi16(a_c);
+    ttlet pc = _mm_abs_epi16(_mm_add_epi16(b_c, a_c));
+    ttlet smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+    auto r = _mm_blendv_epi8(b, c, _mm_cmpeq_epi16(smallest, pc));
+    r = _mm_blendv_epi8(r, b, _mm_cmpeq_epi16(smallest, pb));
+    return _mm_blendv_epi8(r, a, _mm_cmpeq_epi16(smallest, pa));
+}
+
+/** The predicted value of 16 bytes for each filter.
+ */
+template<int Filter>
+[[nodiscard]] static tt_force_inline __m128i png_predict(__m128i a, __m128i b, __m128i c) noexcept
+{
+    if constexpr (Filter == 0) {
+        return _mm_setzero_si128();
+    } else if constexpr (Filter == 1) {
+        return a;
+    } else if constexpr (Filter == 2) {
+        return b;
+    } else if constexpr (Filter == 3) {
+        return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+    } else {
+        ttlet zero = _mm_setzero_si128();
+        ttlet lo = png_paeth_predict(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        ttlet hi = png_paeth_predict(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        return _mm_packus_epi16(lo, hi);
+    }
+}
+
+/** Filter a line, or calculate the cost of filtering a line.
+ *
+ * The filter does not depend on previous results, so all filters are calculated 16 bytes at a time.
+ *
+ * @param output The filtered bytes, or nullptr to only calculate the cost.
+ * @return The sum of the absolute values of the filtered bytes as signed values.
+ */
+template<int Filter>
+static uint64_t png_filter(uint8_t const *line, uint8_t const *prev_line, ssize_t size, int bytes_per_pixel, uint8_t *output) noexcept
+{
+    ttlet bpp = std::min(ssize_t{bytes_per_pixel}, size);
+
+    uint64_t cost = 0;
+    auto filter_byte = [&](ssize_t i, uint8_t a, uint8_t c) {
+        ttlet x = static_cast<uint8_t>(line[i] - png_predict(Filter, a, prev_line[i], c));
+        cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(x)));
+        if (output) {
+            output[i] = x;
+        }
+    };
+
+    // The first pixel has no neighbours on the left.
+    ssize_t i = 0;
+    for (; i != bpp; ++i) {
+        filter_byte(i, 0, 0);
+    }
+
+    ttlet zero = _mm_setzero_si128();
+    auto vector_cost = zero;
+    for (; i + 16 <= size; i += 16) {
+        ttlet x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(line + i));
+        ttlet a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(line + i - bytes_per_pixel));
+        ttlet b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(prev_line + i));
+        ttlet c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(prev_line + i - bytes_per_pixel));
+
+        ttlet r = _mm_sub_epi8(x, png_predict<Filter>(a, b, c));
+        vector_cost = _mm_add_epi64(vector_cost, _mm_sad_epu8(_mm_abs_epi8(r), zero));
+        if (output) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), r);
+        }
+    }
+    cost += static_cast<uint64_t>(_mm_cvtsi128_si64(vector_cost)) + static_cast<uint64_t>(_mm_extract_epi64(vector_cost, 1));
+
+    for (; i < size; ++i) {
+        filter_byte(i, line[i - bytes_per_pixel], prev_line[i - bytes_per_pixel]);
+    }
+    return cost;
+}
+
+void png_filter_line(
+    std::span<uint8_t const> line,
+    std::span<uint8_t const> prev_line,
+    int bytes_per_pixel,
+    std::span<uint8_t> output) noexcept
+{
+    tt_axiom(std::ssize(prev_line) >= std::ssize(line));
+    tt_axiom(std::ssize(output) == std::ssize(line) + 1);
+
+    ttlet size = std::ssize(line);
+    ttlet costs = std::array{
+        png_filter<0>(line.data(), prev_line.data(), size, bytes_per_pixel, nullptr),
+        png_filter<1>(line.data(), prev_line.data(), size, bytes_per_pixel, nullptr),
+        png_filter<2>(line.data(), prev_line.data(), size, bytes_per_pixel, nullptr),
+        png_filter<3>(line.data(), prev_line.data(), size, bytes_per_pixel, nullptr),
+        png_filter<4>(line.data(), prev_line.data(), size, bytes_per_pixel, nullptr)};
+    ttlet filter = static_cast<int>(std::distance(costs.begin(), std::min_element(costs.begin(), costs.end())));
+
+    output[0] = static_cast<uint8_t>(filter);
+    ttlet filtered = output.data() + 1;
+    switch (filter) {
+    case 0: std::copy(line.begin(), line.end(), filtered); break;
+    case 1: png_filter<1>(line.data(), prev_line.data(), size, bytes_per_pixel, filtered); break;
+    case 2: png_filter<2>(line.data(), prev_line.data(), size, bytes_per_pixel, filtered); break;
+    case 3: png_filter<3>(line.data(), prev_line.data(), size, bytes_per_pixel, filtered); break;
+    case 4: png_filter<4>(line.data(), prev_line.data(), size, bytes_per_pixel, filtered); break;
+    default: tt_no_default();
+    }
+}
+
+} // namespace tt
@@ -0,0 +1,65 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "../required.hpp"
+#include <span>
+#include <cstdint>
+
+namespace tt {
+
+/** Reverse the sub filter of a line of a PNG image.
+ * Each byte is predicted from the byte of the pixel on the left.
+ *
+ * @param line The filtered bytes of the line, without the filter-type byte. Unfiltered in place.
+ * @param bytes_per_pixel The number of bytes per complete pixel, rounded up to 1.
+ */
+void png_unfilter_sub(std::span<uint8_t> line, int bytes_per_pixel) noexcept;
+
+/** Reverse the up filter of a line of a PNG image.
+ * Each byte is predicted from the byte of the pixel above.
+ *
+ * @param line The filtered bytes of the line, without the filter-type byte. Unfiltered in place.
+ * @param prev_line The unfiltered bytes of the previous line, or zeros for the first line.
+ */
+void png_unfilter_up(std::span<uint8_t> line, std::span<uint8_t const> prev_line) noexcept;
+
+/** Reverse the average filter of a line of a PNG image.
+ * Each byte is predicted from the average of the bytes of the pixels on the left and above.
+ *
+ * @param line The filtered bytes of the line, without the filter-type byte. Unfiltered in place.
+ * @param prev_line The unfiltered bytes of the previous line, or zeros for the first line.
+ * @param bytes_per_pixel The number of bytes per complete pixel, rounded up to 1.
+ */
+void png_unfilter_average(std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel) noexcept;
+
+/** Reverse the paeth filter of a line of a PNG image.
+ * Each byte is predicted from the byte of the pixel on the left, above or left-above.
+ *
+ * @param line The filtered bytes of the line, without the filter-type byte. Unfiltered in place.
+ * @param prev_line The unfiltered bytes of the previous line, or zeros for the first line.
+ * @param bytes_per_pixel The number of bytes per complete pixel, rounded up to 1.
+ */
+void png_unfilter_paeth(std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel) noexcept;
+
+/** Filter a line of a PNG image.
+ *
+ * The filter is selected with the minimum sum of absolute differences heuristic: each filter
+ * is tried, and the filter for which the sum of the filtered bytes, as signed values,
+ * is the smallest is used.
+ *
+ * @param line The unfiltered bytes of the line.
+ * @param prev_line The unfiltered bytes of the previous line, or zeros for the first line.
+ * @param bytes_per_pixel The number of bytes per complete pixel, rounded up to 1.
+ * @param [out] output The filter-type byte followed by the filtered bytes of the line;
+ *                     must be one byte larger than the line.
+ */
+void png_filter_line(
+    std::span<uint8_t const> line,
+    std::span<uint8_t const> prev_line,
+    int bytes_per_pixel,
+    std::span<uint8_t> output) noexcept;
+
+} // namespace tt
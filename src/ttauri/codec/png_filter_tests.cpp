@@ -0,0 +1,126 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/png_filter.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+using namespace tt;
+
+static std::vector<uint8_t> make_test_bytes(ssize_t size, uint64_t seed)
+{
+    auto generator = test_random{seed};
+    auto r = std::vector<uint8_t>{};
+    for (ssize_t i = 0; i != size; ++i) {
+        r.push_back(static_cast<uint8_t>(generator() >> 24));
+    }
+    return r;
+}
+
+/** Reference implementation, one byte at a time as described in the PNG specification.
+ */
+static void unfilter_reference(int filter, std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel)
+{
+    for (ssize_t i = 0; i != std::ssize(line); ++i) {
+        ttlet a = static_cast<int>(i >= bytes_per_pixel ? line[i - bytes_per_pixel] : 0);
+        ttlet b = static_cast<int>(prev_line[i]);
+        ttlet c = static_cast<int>(i >= bytes_per_pixel ? prev_line[i - bytes_per_pixel] : 0);
+
+        switch (filter) {
+        case 1: line[i] += static_cast<uint8_t>(a); break;
+        case 2: line[i] += static_cast<uint8_t>(b); break;
+        case 3: line[i] += static_cast<uint8_t>((a + b) / 2); break;
+        case 4: {
+            ttlet p = a + b - c;
+            ttlet pa = std::abs(p - a);
+            ttlet pb = std::abs(p - b);
+            ttlet pc = std::abs(p - c);
+            line[i] += static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+        } break;
+        }
+    }
+}
+
+static void unfilter(int filter, std::span<uint8_t> line, std::span<uint8_t const> prev_line, int bytes_per_pixel)
+{
+    switch (filter) {
+    case 1: return png_unfilter_sub(line, bytes_per_pixel);
+    case 2: return png_unfilter_up(line, prev_line);
+    case 3: return png_unfilter_average(line, prev_line, bytes_per_pixel);
+    case 4: return png_unfilter_paeth(line, prev_line, bytes_per_pixel);
+    }
+}
+
+TEST(PNGFilter, SameAsReference) {
+    for (int filter = 1; filter <= 4; ++filter) {
+        for (ttlet bytes_per_pixel : {1, 2, 3, 4, 6, 8}) {
+            for (ttlet width : {0, 1, 2, 5, 16, 33, 100}) {
+                ttlet size = width * bytes_per_pixel;
+                ttlet prev_line = make_test_bytes(size, 1);
+                ttlet original = make_test_bytes(size, 2);
+
+                auto expected = original;
+                unfilter_reference(filter, expected, prev_line, bytes_per_pixel);
+
+                auto result = original;
+                unfilter(filter, result, prev_line, bytes_per_pixel);
+
+                ASSERT_EQ(result, expected) << "filter=" << filter << " bytes_per_pixel=" << bytes_per_pixel << " width=" << width;
+            }
+        }
+    }
+}
+
+TEST(PNGFilter, PaethTies) {
+    // Equal and extreme samples exercise the tie-breaking order of the paeth predictor.
+    for (ttlet bytes_per_pixel : {1, 3, 4, 6, 8}) {
+        for (ttlet value : {0, 1, 127, 128, 255}) {
+            ttlet size = 32 * bytes_per_pixel;
+            auto prev_line = std::vector<uint8_t>(size, static_cast<uint8_t>(value));
+            for (ssize_t i = 0; i < size; i += 3) {
+                prev_line[i] = static_cast<uint8_t>(255 - value);
+            }
+            ttlet original = std::vector<uint8_t>(size, static_cast<uint8_t>(value));
+
+            auto expected = original;
+            unfilter_reference(4, expected, prev_line, bytes_per_pixel);
+
+            auto result = original;
+            png_unfilter_paeth(result, prev_line, bytes_per_pixel);
+
+            ASSERT_EQ(result, expected);
+        }
+    }
+}
+
+TEST(PNGFilter, FilterRoundTrip) {
+    for (ttlet bytes_per_pixel : {1, 2, 3, 4, 6, 8}) {
+        for (ttlet width : {0, 1, 2, 5, 16, 33, 100}) {
+            ttlet size = width * bytes_per_pixel;
+            ttlet prev_line = make_test_bytes(size, 1);
+
+            // A smooth gradient, a noisy line and a copy of the previous line select different filters.
+            auto gradient = std::vector<uint8_t>{};
+            for (ssize_t i = 0; i != size; ++i) {
+                gradient.push_back(static_cast<uint8_t>(i / bytes_per_pixel));
+            }
+
+            for (ttlet &original : {gradient, make_test_bytes(size, 2), prev_line}) {
+                auto filtered = std::vector<uint8_t>(size + 1);
+                png_filter_line(original, prev_line, bytes_per_pixel, filtered);
+
+                ttlet filter = static_cast<int>(filtered[0]);
+                ASSERT_LE(filter, 4);
+
+                auto result = std::vector<uint8_t>(filtered.begin() + 1, filtered.end());
+                unfilter(filter, result, prev_line, bytes_per_pixel);
+                ASSERT_EQ(result, original) << "filter=" << filter << " bytes_per_pixel=" << bytes_per_pixel << " width=" << width;
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/codec/png.hpp"
+#include "ttauri/color/sRGB.hpp"
+#include "ttauri/random_tests.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+#include <cstring>
+
+using namespace std;
+using namespace tt;
+
+/** Count the chunks of a type in a PNG file.
+ */
+static int count_chunks(bstring const &bytes, char const *type)
+{
+    auto r = 0;
+    for (size_t i = 8; i + 8 <= bytes.size();) {
+        ttlet length = (static_cast<size_t>(bytes[i]) << 24) | (static_cast<size_t>(bytes[i + 1]) << 16) |
+            (static_cast<size_t>(bytes[i + 2]) << 8) | static_cast<size_t>(bytes[i + 3]);
+        if (std::memcmp(bytes.data() + i + 4, type, 4) == 0) {
+            ++r;
+        }
+        i += length + 12;
+    }
+    return r;
+}
+
+static pixel_map<sfloat_rgba16> decode(bstring const &bytes)
+{
+    ttlet png_data = png(bytes);
+    auto image = pixel_map<sfloat_rgba16>{png_data.extent()};
+    png_data.decode_image(image);
+    return image;
+}
+
+TEST(PNG, GrayRoundTrip) {
+    auto image = pixel_map<uint8_t>(37, 23);
+    auto generator = test_random{};
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            // The left half is a gradient, the right half is noise.
+            image[y][x] = static_cast<uint8_t>(x < 18 ? x * 7 + y : generator() >> 24);
+        }
+    }
+
+    ttlet bytes = png::encode(image);
+    ASSERT_EQ(bytes.substr(1, 3), (bstring{std::byte{'P'}, std::byte{'N'}, std::byte{'G'}}));
+
+    ttlet result = decode(bytes);
+    ASSERT_EQ(result.extent(), image.extent());
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            ttlet expected = sRGB_gamma_to_linear(image[y][x] / 255.0f);
+            ttlet pixel = static_cast<f32x4>(result[y][x]);
+            ASSERT_NEAR(pixel.r(), expected, 0.02f) << "x=" << x << " y=" << y;
+            ASSERT_EQ(pixel.r(), pixel.g());
+            ASSERT_EQ(pixel.r(), pixel.b());
+            ASSERT_EQ(pixel.a(), 1.0f);
+        }
+    }
+}
+
+TEST(PNG, SDFRoundTrip) {
+    auto image = pixel_map<sdf_r8>(16, 16);
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            image[y][x] = (narrow_cast<float>(x) - 7.5f) / 7.5f * sdf_r8::max_distance;
+        }
+    }
+
+    ttlet result = decode(png::encode(image));
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            // The distance is stored with an offset, a distance of zero is mid-gray.
+            ttlet sample = image[y][x].value + 128;
+            ttlet expected = sRGB_gamma_to_linear(sample / 255.0f);
+            ASSERT_NEAR(static_cast<f32x4>(result[y][x]).r(), expected, 0.02f) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+TEST(PNG, RGBA16RoundTrip) {
+    auto image = pixel_map<sfloat_rgba16>(19, 11);
+    auto generator = test_random{};
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            ttlet r = (generator() % 1001) / 1000.0f;
+            ttlet g = (generator() % 1001) / 1000.0f;
+            ttlet b = narrow_cast<float>(x) / 18.0f;
+            ttlet a = narrow_cast<float>(y) / 10.0f;
+            image[y][x] = f32x4{r, g, b, a};
+        }
+    }
+
+    ttlet result = decode(png::encode(image, 6));
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            ttlet expected = static_cast<f32x4>(image[y][x]);
+            ttlet pixel = static_cast<f32x4>(result[y][x]);
+            for (int i = 0; i != 4; ++i) {
+                ASSERT_NEAR(pixel[i], expected[i], 0.002f) << "x=" << x << " y=" << y << " i=" << i;
+            }
+        }
+    }
+}
+
+TEST(PNG, RGBA16Clamp) {
+    auto image = pixel_map<sfloat_rgba16>(3, 1);
+    image[0][0] = f32x4{-1.0f, 2.0f, 0.5f, 3.0f};
+    image[0][1] = f32x4{std::numeric_limits<float>::quiet_NaN(), 0.0f, 1.0f, -1.0f};
+    image[0][2] = f32x4{std::numeric_limits<float>::infinity(), 1.0f, 0.0f, 0.5f};
+
+    ttlet result = decode(png::encode(image));
+    ASSERT_NEAR(static_cast<f32x4>(result[0][0]).r(), 0.0f, 0.002f);
+    ASSERT_NEAR(static_cast<f32x4>(result[0][0]).g(), 1.0f, 0.002f);
+    ASSERT_NEAR(static_cast<f32x4>(result[0][0]).a(), 1.0f, 0.002f);
+    ASSERT_NEAR(static_cast<f32x4>(result[0][1]).r(), 0.0f, 0.002f);
+    ASSERT_NEAR(static_cast<f32x4>(result[0][1]).a(), 0.0f, 0.002f);
+    ASSERT_NEAR(static_cast<f32x4>(result[0][2]).r(), 1.0f, 0.002f);
+}
+
+TEST(PNG, MultipleChunks) {
+    // Noise does not compress, so the image data is split over several IDAT chunks.
+    auto image = pixel_map<uint8_t>(1000, 300);
+    auto generator = test_random{};
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            image[y][x] = static_cast<uint8_t>(generator() >> 24);
+        }
+    }
+
+    ttlet bytes = png::encode(image);
+    ASSERT_GT(count_chunks(bytes, "IDAT"), 1);
+
+    ttlet result = decode(bytes);
+    for (ssize_t y = 0; y != image.height(); ++y) {
+        for (ssize_t x = 0; x != image.width(); ++x) {
+            ttlet expected = sRGB_gamma_to_linear(image[y][x] / 255.0f);
+            ASSERT_NEAR(static_cast<f32x4>(result[y][x]).r(), expected, 0.02f) << "x=" << x << " y=" << y;
+        }
+    }
+}
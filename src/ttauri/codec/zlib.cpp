@@ -4,6 +4,7 @@
 
 #include "zlib.hpp"
 #include "inflate.hpp"
+#include "adler32.hpp"
 #include "../endian.hpp"
 #include "../placement.hpp"
 
@@ -14,29 +15,131 @@ struct zlib_header {
     uint8_t FLG;
 };
 
-bstring zlib_decompress(std::span<std::byte const> bytes, ssize_t max_size)
+/** Collect bytes of a header or trailer, which may be split over multiple chunks.
+ *
+ * @return true when `size` bytes are collected in the buffer.
+ */
+bool zlib_decompressor::collect(std::span<std::byte const> &input, ssize_t size) noexcept
+{
+    ttlet n = std::min(size - _buffer_size, std::ssize(input));
+    std::copy_n(input.begin(), n, _buffer.begin() + _buffer_size);
+    _buffer_size += n;
+    input = input.subspan(n);
+    return _buffer_size == size;
+}
+
+ssize_t zlib_decompressor::decompress(std::span<std::byte const> &input, std::span<std::byte> output)
+{
+    ssize_t produced = 0;
+
+    while (true) {
+        switch (_state) {
+        case state_type::header: {
+            if (!collect(input, ssizeof(zlib_header))) {
+                return produced;
+            }
+
+            ssize_t offset = 0;
+            ttlet header = make_placement_ptr<zlib_header>(std::span<std::byte const>(_buffer), offset);
+
+            ttlet header_chksum = header->CMF * 256 + header->FLG;
+            tt_parse_check(header_chksum % 31 == 0, "zlib header checksum failed.");
+
+            tt_parse_check((header->CMF & 0xf) == 8, "zlib compression method must be 8");
+            tt_parse_check(((header->CMF >> 4) & 0xf) <= 7, "zlib LZ77 window too large");
+            tt_parse_check((header->FLG & 0x20) == 0, "zlib must not use a preset dicationary");
+
+            _buffer_size = 0;
+            _state = state_type::data;
+        } break;
+
+        case state_type::data: {
+            // The checksum is calculated directly after decompressing, while the data is still in the cache.
+            ttlet n = _inflate.decompress(input, output.subspan(produced));
+            _adler = adler32(output.subspan(produced, n), _adler);
+            produced += n;
+            if (!_inflate.finished()) {
+                return produced;
+            }
+            _state = state_type::trailer;
+        } break;
+
+        case state_type::trailer: {
+            if (!collect(input, ssizeof(big_uint32_buf_t))) {
+                return produced;
+            }
+
+            ssize_t offset = 0;
+            ttlet ADLER32 = make_placement_ptr<big_uint32_buf_t>(std::span<std::byte const>(_buffer), offset);
+            tt_parse_check(ADLER32->value() == _adler, "zlib ADLER32 checksum failed.");
+
+            _buffer_size = 0;
+            _state = state_type::finished;
+        } break;
+
+        case state_type::finished:
+            return produced;
+
+        default:
+            tt_no_default();
+        }
+    }
+}
+
+zlib_compressor::zlib_compressor(int level) noexcept : _level(level), _deflate(level) {}
+
+void zlib_compressor::write_header(bstring &output) noexcept
 {
-    ssize_t offset = 0;
+    // Deflate with a 32 KiB window; FLEVEL is informational.
+    ttlet CMF = uint8_t{0x78};
+    ttlet FLEVEL = _level <= 1 ? 0 : _level <= 5 ? 1 : _level == 6 ? 2 : 3;
+    auto FLG = static_cast<uint8_t>(FLEVEL << 6);
+    FLG += static_cast<uint8_t>(31 - (CMF * 256 + FLG) % 31);
 
-    ttlet header = make_placement_ptr<zlib_header>(bytes, offset);
+    output += static_cast<std::byte>(CMF);
+    output += static_cast<std::byte>(FLG);
+    _header_written = true;
+}
 
-    ttlet header_chksum = header->CMF * 256 + header->FLG;
-    tt_parse_check(header_chksum % 31 == 0, "zlib header checksum failed.");
+void zlib_compressor::compress(std::span<std::byte const> input, bstring &output) noexcept
+{
+    if (!_header_written) {
+        write_header(output);
+    }
 
-    tt_parse_check((header->CMF & 0xf) == 8, "zlib compression method must be 8");
-    tt_parse_check(((header->CMF >> 4) & 0xf) <= 7, "zlib LZ77 window too large");
-    tt_parse_check((header->FLG & 0x20) == 0, "zlib must not use a preset dicationary");
+    _adler = adler32(input, _adler);
+    _deflate.compress(input, output);
+}
 
-    if (header->FLG & 0x20) {
-        [[maybe_unused]] auto FDICT = make_placement_ptr<big_uint32_buf_t>(bytes, offset);
+void zlib_compressor::finish(bstring &output) noexcept
+{
+    if (!_header_written) {
+        write_header(output);
     }
 
-    auto r = inflate(bytes, offset, max_size);
+    _deflate.finish(output);
 
-    [[maybe_unused]] auto ADLER32 = make_placement_ptr<big_uint32_buf_t>(bytes, offset);
+    ttlet ADLER32 = native_to_big(_adler);
+    output.append(reinterpret_cast<std::byte const *>(&ADLER32), sizeof(ADLER32));
+}
 
+bstring zlib_decompress(std::span<std::byte const> bytes, ssize_t max_size)
+{
+    auto decompressor = zlib_decompressor{};
+
+    auto r = bstring{};
+    decompress_append(decompressor, bytes, r, max_size);
     return r;
 }
 
+bstring zlib_compress(std::span<std::byte const> bytes, int level) noexcept
+{
+    auto compressor = zlib_compressor{level};
+
+    auto r = bstring{};
+    compressor.compress(bytes, r);
+    compressor.finish(r);
+    return r;
+}
 
-}
\ No newline at end of file
+}
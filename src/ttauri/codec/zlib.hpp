@@ -4,15 +4,105 @@
 
 #pragma once
 
+#include "inflate.hpp"
+#include "deflate.hpp"
 #include "../URL.hpp"
 #include "../byte_string.hpp"
 #include "../file_view.hpp"
+#include <array>
 #include <cstddef>
 
 namespace tt {
 
+/** A resumable decompressor of a zlib stream.
+ *
+ * The zlib header and trailer are parsed incrementally, so that the stream can be
+ * passed in chunks of any size; for example the IDAT chunks of a PNG file.
+ */
+class zlib_decompressor {
+public:
+    /** Decompress the next chunk.
+     *
+     * @param input The compressed input. On return the consumed bytes are removed from the front of the span.
+     * @param output The buffer to write decompressed data into.
+     * @return The number of bytes written into output.
+     * @throw parse_error When the compressed data is invalid.
+     */
+    [[nodiscard]] ssize_t decompress(std::span<std::byte const> &input, std::span<std::byte> output);
+
+    /** Check if the stream, including the trailer, was completely decoded.
+     */
+    [[nodiscard]] bool finished() const noexcept
+    {
+        return _state == state_type::finished;
+    }
+
+private:
+    enum class state_type : uint8_t { header, data, trailer, finished };
+
+    state_type _state = state_type::header;
+    inflate_decompressor _inflate;
+
+    /** The Adler-32 checksum of the decompressed data so far.
+     */
+    uint32_t _adler = 1;
+
+    /** Header or trailer bytes collected from previous chunks.
+     */
+    std::array<std::byte, 4> _buffer;
+    ssize_t _buffer_size = 0;
+
+    [[nodiscard]] bool collect(std::span<std::byte const> &input, ssize_t size) noexcept;
+};
+
+/** A streaming compressor of a zlib stream.
+ *
+ * Data can be passed in chunks of any size, the compressed data is appended to a string
+ * supplied by the caller. `finish()` must be called to write the last block and the trailer.
+ */
+class zlib_compressor {
+public:
+    /** Create a compressor.
+     *
+     * @param level The compression level between 0 and 9, see `deflate_compressor`.
+     */
+    zlib_compressor(int level = 6) noexcept;
+
+    /** Compress the next chunk.
+     *
+     * @param input The data to compress.
+     * @param output The string to append compressed data to.
+     */
+    void compress(std::span<std::byte const> input, bstring &output) noexcept;
+
+    /** Compress the remaining data and write the trailer.
+     *
+     * @param output The string to append compressed data to.
+     */
+    void finish(bstring &output) noexcept;
+
+private:
+    int _level;
+    bool _header_written = false;
+    deflate_compressor _deflate;
+
+    /** The Adler-32 checksum of the uncompressed data so far.
+     */
+    uint32_t _adler = 1;
+
+    void write_header(bstring &output) noexcept;
+};
+
 bstring zlib_decompress(std::span<std::byte const> bytes, ssize_t max_size=0x01000000);
 
+/** Compress data into a zlib stream.
+ *
+ * @param bytes The data to compress.
+ * @param level The compression level between 0 and 9, see `deflate_compressor`.
+ * @return The compressed data.
+ */
+[[nodiscard]] bstring zlib_compress(std::span<std::byte const> bytes, int level = 6) noexcept;
+
 inline bstring zlib_decompress(URL const &url, ssize_t max_size=0x01000000) {
     return zlib_decompress(file_view(url), max_size);
 }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "required.hpp"
+#include "assert.hpp"
 #include "URL.hpp"
 #include "decimal.hpp"
 #include "memory.hpp"
@@ -13,11 +14,14 @@
 #include "math.hpp"
 #include "algorithm.hpp"
 #include "byte_string.hpp"
+#include "flat_hash_map.hpp"
 #include "codec/base_n.hpp"
 #include <date/date.h>
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <memory_resource>
+#include <atomic>
 #include <cstring>
 #include <cstdint>
 #include <variant>
@@ -27,20 +31,21 @@
 #include <ostream>
 #include <numeric>
 #include <string_view>
+#include <array>
 #include <cmath>
 
 namespace tt {
-template<bool HasLargeObjects>
+template<bool HasLargeObjects, bool IsThreadSafe = true>
 class datum_impl;
 
 }
 
 namespace std {
 
-template<bool HasLargeObjects>
-class hash<tt::datum_impl<HasLargeObjects>> {
+template<bool HasLargeObjects, bool IsThreadSafe>
+class hash<tt::datum_impl<HasLargeObjects, IsThreadSafe>> {
 public:
-    size_t operator()(tt::datum_impl<HasLargeObjects> const &value) const;
+    size_t operator()(tt::datum_impl<HasLargeObjects, IsThreadSafe> const &value) const;
 };
 
 } // namespace std
@@ -95,9 +100,9 @@ inline std::ostream &operator<<(std::ostream &lhs, datum_type_t rhs)
  *  - Break
  *  - Continue
  *  - Undefined
- *  - String
+ *  - String, strings of up to 6 UTF-8 code units are stored inside the datum.
  *  - Vector of datum
- *  - Unordered map of datum:datum.
+ *  - Map of datum:datum, iterated in insertion order.
  *  - YearMonthDay.
  *  - Bytes.
  *
@@ -105,12 +110,23 @@ inline std::ostream &operator<<(std::ostream &lhs, datum_type_t rhs)
  * you can serialize your own types by adding conversion constructor and
  * operator to and from the datum on your type.
  *
+ * Large objects are reference counted and copied on write: copying a datum
+ * shares the object, and a datum that modifies a shared object first makes
+ * its own copy. References to the elements of a vector or map, obtained from
+ * a non-const datum, must not be kept while the datum is copied.
+ *
  * @param HasLargeObjects true when the datum will manage memory for large objects
+ * @param IsThreadSafe true when datums sharing a large object may be used from different threads.
  */
-template<bool HasLargeObjects>
+template<bool HasLargeObjects, bool IsThreadSafe>
 class datum_impl {
 private:
     /** Encode 0 to 6 UTF-8 code units in to a uint64_t.
+     *
+     * The code units are stored big-endian in the lower 48 bits, right aligned.
+     * A string of 0 to 5 code units stores its length in bits 47:40. A string of
+     * 6 code units fills all 48 bits; this is recognized by the first code unit
+     * being larger than 5, which excludes only strings starting with a control character.
      *
      * @param str String to encode into an uint64_t
      * @return Encoded string, or zero if `str` did not fit.
@@ -119,16 +135,16 @@ private:
     {
         ttlet len = str.size();
 
-        if (len > 5) {
+        if (len > 6 || (len == 6 && static_cast<uint8_t>(str[0]) <= 5)) {
             return 0;
         }
 
         uint64_t x = 0;
         for (uint64_t i = 0; i < len; i++) {
             x <<= 8;
-            x |= str[i];
+            x |= static_cast<uint8_t>(str[i]);
         }
-        return (string_mask + (len << 40)) | x;
+        return string_mask | (len < 6 ? len << 40 : 0) | x;
     }
 
     /** Encode a pointer into a uint64_t.
@@ -339,37 +355,186 @@ private:
         return static_cast<int64_t>(u64 << 16) >> 16;
     }
 
-    /** Extract a pointer for an existing object from datum's storage.
+    /** The reference count of a large object.
+     */
+    using reference_count_type = std::conditional_t<IsThreadSafe, std::atomic<uint32_t>, uint32_t>;
+
+    /** A large object together with its reference count.
+     */
+    template<typename O>
+    struct box {
+        /** The number of datums holding the object.
+         */
+        reference_count_type count;
+
+        /** The object may be shared between datums.
+         * An object allocated from an arena, such as a `datum_document`, is copied
+         * instead, so that the copy may outlive the arena.
+         */
+        bool is_shareable;
+
+        O value;
+
+        /** Construct the object.
+         * An allocator-aware object is constructed with `resource`, like a standard container.
+         */
+        template<typename... Args>
+        box(std::pmr::memory_resource *resource, Args &&...args) :
+            count(1),
+            is_shareable(resource == std::pmr::get_default_resource()),
+            value(std::make_obj_using_allocator<O>(std::pmr::polymorphic_allocator<>{resource}, std::forward<Args>(args)...))
+        {
+        }
+
+        void retain() noexcept
+        {
+            if constexpr (IsThreadSafe) {
+                count.fetch_add(1, std::memory_order::relaxed);
+            } else {
+                ++count;
+            }
+        }
+
+        /** Release a reference.
+         * @return true when this was the last reference.
+         */
+        [[nodiscard]] bool release() noexcept
+        {
+            if constexpr (IsThreadSafe) {
+                return count.fetch_sub(1, std::memory_order::acq_rel) == 1;
+            } else {
+                return --count == 0;
+            }
+        }
+
+        [[nodiscard]] bool is_unique() const noexcept
+        {
+            if constexpr (IsThreadSafe) {
+                return count.load(std::memory_order::acquire) == 1;
+            } else {
+                return count == 1;
+            }
+        }
+    };
+
+    /** Extract a pointer to the box of a large object from datum's storage.
      * Canonical pointers on x86 and ARM are at most 48 bit and are sign extended to 64 bit.
      * Since the pointer is stored as a 48 bit integer, this function will launder it.
      */
     template<typename O>
-    O *get_pointer() const
+    [[nodiscard]] box<O> *get_box() const noexcept
+    {
+        return std::launder(reinterpret_cast<box<O> *>(get_signed_integer()));
+    }
+
+    /** Get a pointer to the large object, to read it.
+     * The object may be shared with other datums.
+     */
+    template<typename O>
+    [[nodiscard]] O const *get_pointer() const noexcept
+    {
+        return &get_box<O>()->value;
+    }
+
+    /** Get a pointer to the large object, to modify it.
+     * An object that is shared with other datums is first copied, so that they are not modified.
+     * This invalidates pointers and references into the object previously returned.
+     */
+    template<typename O>
+    [[nodiscard]] O *get_mutable_pointer() noexcept
     {
-        return std::launder(reinterpret_cast<O *>(get_signed_integer()));
+        auto *ptr = get_box<O>();
+        if (!ptr->is_unique()) {
+            auto *const copy = new_object<O>(std::pmr::get_default_resource(), std::as_const(ptr->value));
+            if (ptr->release()) {
+                delete_object(ptr);
+            }
+            u64 = make_pointer(u64 & ~pointer_mask, copy);
+            ptr = copy;
+        }
+        return &ptr->value;
     }
 
-    /** Delete the object that the datum is pointing to.
+    /** Allocate a large object.
+     * A string, vector or map is allocated from a memory resource, and is constructed
+     * with the same memory resource so that the object and its elements are allocated together.
+     * Other objects are allocated with `new`.
+     *
+     * @param resource The memory resource to allocate from.
+     * @param args The arguments passed to the constructor of the object.
+     * @return The box holding the new object, with a reference count of one.
+     */
+    template<typename O, typename... Args>
+    [[nodiscard]] static box<O> *new_object(std::pmr::memory_resource *resource, Args &&...args)
+    {
+        if constexpr (std::uses_allocator_v<O, std::pmr::polymorphic_allocator<>>) {
+            return std::pmr::polymorphic_allocator<>{resource}.new_object<box<O>>(resource, std::forward<Args>(args)...);
+        } else {
+            tt_axiom(resource == std::pmr::get_default_resource());
+            return new box<O>(resource, std::forward<Args>(args)...);
+        }
+    }
+
+    /** Destroy and deallocate an object created by `new_object()`.
+     * When the object was allocated from a monotonic arena the deallocation does nothing,
+     * only the elements that were allocated elsewhere are released.
+     */
+    template<typename O>
+    static void delete_object(box<O> *ptr) noexcept
+    {
+        if constexpr (std::uses_allocator_v<O, std::pmr::polymorphic_allocator<>>) {
+            auto allocator = std::pmr::polymorphic_allocator<>{ptr->value.get_allocator()};
+            allocator.delete_object(ptr);
+        } else {
+            delete ptr;
+        }
+    }
+
+    template<typename O>
+    void release_object() noexcept
+    {
+        auto *const ptr = get_box<O>();
+        if (ptr->release()) {
+            delete_object(ptr);
+        }
+    }
+
+    /** Release the object that the datum is pointing to.
+     * The object is deleted when this was the last datum holding it.
      * This function should only be called on a datum that holds a pointer.
      */
-    void delete_pointer() noexcept
+    void release_pointer() noexcept
     {
         if constexpr (HasLargeObjects) {
             switch (type_id()) {
-            case phy_integer_ptr_id: delete get_pointer<int64_t>(); break;
-            case phy_string_ptr_id: delete get_pointer<std::string>(); break;
-            case phy_url_ptr_id: delete get_pointer<URL>(); break;
-            case phy_vector_ptr_id: delete get_pointer<datum_impl::vector>(); break;
-            case phy_map_ptr_id: delete get_pointer<datum_impl::map>(); break;
-            case phy_decimal_ptr_id: delete get_pointer<decimal>(); break;
-            case phy_bytes_ptr_id: delete get_pointer<bstring>(); break;
+            case phy_integer_ptr_id: release_object<int64_t>(); break;
+            case phy_string_ptr_id: release_object<string_type>(); break;
+            case phy_url_ptr_id: release_object<URL>(); break;
+            case phy_vector_ptr_id: release_object<datum_impl::vector>(); break;
+            case phy_map_ptr_id: release_object<datum_impl::map>(); break;
+            case phy_decimal_ptr_id: release_object<decimal>(); break;
+            case phy_bytes_ptr_id: release_object<bstring>(); break;
             default: tt_no_default();
             }
         }
     }
 
-    /** Copy the object pointed to by the other datum into this datum.
+    template<typename O>
+    void share_object(datum_impl const &other) noexcept
+    {
+        auto *const ptr = other.template get_box<O>();
+        if (ptr->is_shareable) {
+            ptr->retain();
+            u64 = other.u64;
+        } else {
+            u64 = make_pointer(other.u64 & ~pointer_mask, new_object<O>(std::pmr::get_default_resource(), ptr->value));
+        }
+    }
+
+    /** Share the object pointed to by the other datum with this datum.
      * Other datum must point to an object. This datum must not point to an object.
+     * An object allocated from an arena is copied instead, like copying a container
+     * the copy is allocated from the default memory resource.
      *
      * @param other The other datum which holds a pointer to an object.
      */
@@ -377,49 +542,46 @@ private:
     {
         if constexpr (HasLargeObjects) {
             switch (other.type_id()) {
-            case phy_integer_ptr_id: {
-                auto *const p = new int64_t(*other.get_pointer<int64_t>());
-                u64 = make_pointer(integer_ptr_mask, p);
-            } break;
-
-            case phy_string_ptr_id: {
-                auto *const p = new std::string(*other.get_pointer<std::string>());
-                u64 = make_pointer(string_ptr_mask, p);
-            } break;
-
-            case phy_url_ptr_id: {
-                auto *const p = new URL(*other.get_pointer<URL>());
-                u64 = make_pointer(url_ptr_mask, p);
-            } break;
-
-            case phy_vector_ptr_id: {
-                auto *const p = new datum_impl::vector(*other.get_pointer<datum_impl::vector>());
-                u64 = make_pointer(vector_ptr_mask, p);
-            } break;
-
-            case phy_map_ptr_id: {
-                auto *const p = new datum_impl::map(*other.get_pointer<datum_impl::map>());
-                u64 = make_pointer(map_ptr_mask, p);
-            } break;
-
-            case phy_decimal_ptr_id: {
-                auto *const p = new decimal(*other.get_pointer<decimal>());
-                u64 = make_pointer(decimal_ptr_mask, p);
-            } break;
-
-            case phy_bytes_ptr_id: {
-                auto *const p = new bstring(*other.get_pointer<bstring>());
-                u64 = make_pointer(bytes_ptr_mask, p);
-            } break;
-
+            case phy_integer_ptr_id: share_object<int64_t>(other); break;
+            case phy_string_ptr_id: share_object<string_type>(other); break;
+            case phy_url_ptr_id: share_object<URL>(other); break;
+            case phy_vector_ptr_id: share_object<datum_impl::vector>(other); break;
+            case phy_map_ptr_id: share_object<datum_impl::map>(other); break;
+            case phy_decimal_ptr_id: share_object<decimal>(other); break;
+            case phy_bytes_ptr_id: share_object<bstring>(other); break;
             default: tt_no_default();
             }
         }
     }
 
+    /** The type of a string that does not fit inside the datum.
+     */
+    using string_type = std::pmr::string;
+
 public:
-    using vector = std::vector<datum_impl>;
-    using map = std::unordered_map<datum_impl, datum_impl>;
+    /** A vector of datum.
+     * The vector allocates from a `std::pmr::memory_resource`; a datum constructed by moving
+     * a vector keeps using the vector's memory resource, a copy uses the default memory resource.
+     */
+    using vector = std::pmr::vector<datum_impl>;
+
+    /** A map of datum to datum.
+     * Like `vector`, a datum constructed by moving a map keeps using the map's memory resource.
+     *
+     * Items are iterated in insertion order; see `flat_hash_map` for the invalidation rules.
+     */
+    using map = flat_hash_map<
+        datum_impl,
+        datum_impl,
+        std::hash<datum_impl>,
+        std::equal_to<datum_impl>,
+        std::pmr::polymorphic_allocator<std::pair<datum_impl, datum_impl>>>;
+
+    /** Storage for the characters of a string that is stored inside the datum.
+     * @see string_view()
+     */
+    using string_buffer_type = std::array<char, 6>;
+
     struct undefined {
     };
     struct null {
@@ -434,7 +596,7 @@ public:
     ~datum_impl() noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
     }
 
@@ -453,7 +615,7 @@ public:
     {
         if (this != &other) {
             if (is_phy_pointer()) {
-                [[unlikely]] delete_pointer();
+                [[unlikely]] release_pointer();
             }
 
             if (other.is_phy_pointer()) {
@@ -477,10 +639,14 @@ public:
     datum_impl &operator=(datum_impl &&other) noexcept
     {
         if (this != &other) {
+            if (is_phy_pointer()) {
+                [[unlikely]] release_pointer();
+            }
+
             // We do a memcpy, because we don't know the type in the union.
             std::memcpy(this, &other, sizeof(*this));
+            other.u64 = undefined_mask;
         }
-        other.u64 = undefined_mask;
         return *this;
     }
 
@@ -504,7 +670,7 @@ public:
         if (m < minimum_mantissa || m > maximum_mantissa) {
             [[unlikely]] if constexpr (HasLargeObjects)
             {
-                auto *const p = new decimal(value);
+                auto *const p = new_object<decimal>(std::pmr::get_default_resource(), value);
                 u64 = make_pointer(decimal_ptr_mask, p);
             }
             else
@@ -532,7 +698,7 @@ public:
         if (value > maximum_int) {
             [[unlikely]] if constexpr (HasLargeObjects)
             {
-                auto *const p = new uint64_t(value);
+                auto *const p = new_object<int64_t>(std::pmr::get_default_resource(), static_cast<int64_t>(value));
                 u64 = make_pointer(integer_ptr_mask, p);
             }
             else
@@ -552,7 +718,7 @@ public:
             [[unlikely]]
             {
                 if constexpr (HasLargeObjects) {
-                    auto *const p = new int64_t(value);
+                    auto *const p = new_object<int64_t>(std::pmr::get_default_resource(), value);
                     u64 = make_pointer(integer_ptr_mask, p);
                 } else {
                     throw overflow_error(
@@ -566,13 +732,20 @@ public:
     datum_impl(signed char value) noexcept : datum_impl(static_cast<signed long long>(value)) {}
 
     datum_impl(bool value) noexcept : u64(value ? true_mask : false_mask) {}
-    datum_impl(char value) noexcept : u64(string_mask | (uint64_t{1} << 40) | value) {}
+    datum_impl(char value) noexcept : u64(string_mask | (uint64_t{1} << 40) | static_cast<uint8_t>(value)) {}
+
+    datum_impl(std::string_view value) noexcept : datum_impl(value, std::pmr::get_default_resource()) {}
 
-    datum_impl(std::string_view value) noexcept : u64(make_string(value))
+    /** Construct a string datum.
+     *
+     * @param value The string.
+     * @param resource The memory resource to allocate the string from, if it does not fit inside the datum.
+     */
+    datum_impl(std::string_view value, std::pmr::memory_resource *resource) noexcept : u64(make_string(value))
     {
         if (u64 == 0) {
             if constexpr (HasLargeObjects) {
-                auto *const p = new std::string(value);
+                auto *const p = new_object<string_type>(resource, value);
                 u64 = make_pointer(string_ptr_mask, p);
             } else {
                 throw std::overflow_error(fmt::format("Constructing string {} to datum, larger than 6 characters", value));
@@ -586,49 +759,49 @@ public:
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(URL const &value) noexcept
     {
-        auto *const p = new URL(value);
+        auto *const p = new_object<URL>(std::pmr::get_default_resource(), value);
         u64 = make_pointer(url_ptr_mask, p);
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(URL &&value) noexcept
     {
-        auto *const p = new URL(std::move(value));
+        auto *const p = new_object<URL>(std::pmr::get_default_resource(), std::move(value));
         u64 = make_pointer(url_ptr_mask, p);
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(datum_impl::vector const &value) noexcept
     {
-        auto *const p = new datum_impl::vector(value);
+        auto *const p = new_object<datum_impl::vector>(std::pmr::get_default_resource(), value);
         u64 = make_pointer(vector_ptr_mask, p);
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(datum_impl::vector &&value) noexcept
     {
-        auto *const p = new datum_impl::vector(std::move(value));
+        auto *const p = new_object<datum_impl::vector>(value.get_allocator().resource(), std::move(value));
         u64 = make_pointer(vector_ptr_mask, p);
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(datum_impl::map const &value) noexcept
     {
-        auto *const p = new datum_impl::map(value);
+        auto *const p = new_object<datum_impl::map>(std::pmr::get_default_resource(), value);
         u64 = make_pointer(map_ptr_mask, p);
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
     datum_impl(datum_impl::map &&value) noexcept
     {
-        auto *const p = new datum_impl::map(std::move(value));
+        auto *const p = new_object<datum_impl::map>(value.get_allocator().resource(), std::move(value));
         u64 = make_pointer(map_ptr_mask, p);
     }
 
     datum_impl &operator=(datum_impl::undefined rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
         u64 = undefined_mask;
         return *this;
@@ -637,7 +810,7 @@ public:
     datum_impl &operator=(datum_impl::null rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
         u64 = null_mask;
         return *this;
@@ -646,7 +819,7 @@ public:
     datum_impl &operator=(datum_impl::_break rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
         u64 = break_mask;
         return *this;
@@ -655,7 +828,7 @@ public:
     datum_impl &operator=(datum_impl::_continue rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
         u64 = continue_mask;
         return *this;
@@ -664,7 +837,7 @@ public:
     datum_impl &operator=(double rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         if (rhs == rhs) {
@@ -682,14 +855,14 @@ public:
     datum_impl &operator=(decimal rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         long long m = rhs.mantissa();
         if (m < minimum_mantissa || m > maximum_mantissa) {
             [[unlikely]] if constexpr (HasLargeObjects)
             {
-                auto *const p = new decimal(rhs);
+                auto *const p = new_object<decimal>(std::pmr::get_default_resource(), rhs);
                 u64 = make_pointer(decimal_ptr_mask, p);
             }
             else
@@ -707,7 +880,7 @@ public:
     datum_impl &operator=(date::year_month_day const &ymd) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         u64 = ymd_mask |
@@ -721,14 +894,14 @@ public:
     datum_impl &operator=(unsigned long long rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         u64 = integer_mask | static_cast<uint64_t>(rhs);
         if (rhs > maximum_int) {
             [[unlikely]] if constexpr (HasLargeObjects)
             {
-                auto *const p = new uint64_t(rhs);
+                auto *const p = new_object<int64_t>(std::pmr::get_default_resource(), static_cast<int64_t>(rhs));
                 u64 = make_pointer(integer_ptr_mask, p);
             }
             else
@@ -758,14 +931,14 @@ public:
     datum_impl &operator=(signed long long rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         u64 = integer_mask | (static_cast<uint64_t>(rhs) & 0x0000ffff'ffffffff);
         if (rhs < minimum_int || rhs > maximum_int) {
             [[unlikely]] if constexpr (HasLargeObjects)
             {
-                auto *const p = new int64_t(rhs);
+                auto *const p = new_object<int64_t>(std::pmr::get_default_resource(), rhs);
                 u64 = make_pointer(integer_ptr_mask, p);
             }
             else
@@ -796,7 +969,7 @@ public:
     datum_impl &operator=(bool rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
         u64 = rhs ? true_mask : false_mask;
         return *this;
@@ -805,22 +978,22 @@ public:
     datum_impl &operator=(char rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
-        u64 = string_mask | (uint64_t{1} << 40) | static_cast<uint64_t>(rhs);
+        u64 = string_mask | (uint64_t{1} << 40) | static_cast<uint8_t>(rhs);
         return *this;
     }
 
     datum_impl &operator=(std::string_view rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
         u64 = make_string(rhs);
         if (u64 == 0) {
             if constexpr (HasLargeObjects) {
-                auto *const p = new std::string(rhs);
+                auto *const p = new_object<string_type>(std::pmr::get_default_resource(), rhs);
                 u64 = make_pointer(string_ptr_mask, p);
             } else {
                 throw std::overflow_error(fmt::format("Assigning string {} to datum, larger than 6 characters", rhs));
@@ -845,10 +1018,10 @@ public:
     datum_impl &operator=(URL const &rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new URL(rhs);
+        auto *const p = new_object<URL>(std::pmr::get_default_resource(), rhs);
         u64 = make_pointer(url_ptr_mask, p);
         return *this;
     }
@@ -857,10 +1030,10 @@ public:
     datum_impl &operator=(URL &&rhs) noexcept
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new URL(std::move(rhs));
+        auto *const p = new_object<URL>(std::pmr::get_default_resource(), std::move(rhs));
         u64 = make_pointer(url_ptr_mask, p);
         return *this;
     }
@@ -869,10 +1042,10 @@ public:
     datum_impl &operator=(datum_impl::vector const &rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new datum_impl::vector(rhs);
+        auto *const p = new_object<datum_impl::vector>(std::pmr::get_default_resource(), rhs);
         u64 = make_pointer(vector_ptr_mask, p);
 
         return *this;
@@ -882,10 +1055,10 @@ public:
     datum_impl &operator=(datum_impl::vector &&rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new datum_impl::vector(std::move(rhs));
+        auto *const p = new_object<datum_impl::vector>(rhs.get_allocator().resource(), std::move(rhs));
         u64 = make_pointer(vector_ptr_mask, p);
 
         return *this;
@@ -895,10 +1068,10 @@ public:
     datum_impl &operator=(datum_impl::map const &rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new datum_impl::map(rhs);
+        auto *const p = new_object<datum_impl::map>(std::pmr::get_default_resource(), rhs);
         u64 = make_pointer(map_ptr_mask, p);
 
         return *this;
@@ -908,10 +1081,10 @@ public:
     datum_impl &operator=(datum_impl::map &&rhs)
     {
         if (is_phy_pointer()) {
-            [[unlikely]] delete_pointer();
+            [[unlikely]] release_pointer();
         }
 
-        auto *const p = new datum_impl::map(std::move(rhs));
+        auto *const p = new_object<datum_impl::map>(rhs.get_allocator().resource(), std::move(rhs));
         u64 = make_pointer(map_ptr_mask, p);
 
         return *this;
@@ -986,7 +1159,7 @@ public:
         if (is_phy_integer()) {
             return get_signed_integer();
         } else if (is_phy_integer_ptr()) {
-            return *get_pointer<signed long long>();
+            return *get_pointer<int64_t>();
         } else if (is_phy_float()) {
             return static_cast<signed long long>(f64);
         } else if (is_phy_small()) {
@@ -1118,7 +1291,7 @@ public:
         if (is_phy_string() && size() == 1) {
             return u64 & 0xff;
         } else if (is_phy_string_ptr() && size() == 1) {
-            return get_pointer<std::string>()->at(0);
+            return get_pointer<string_type>()->at(0);
         } else {
             throw operation_error(
                 "Value {} of type {} can not be converted to a char", this->repr(), this->type_name());
@@ -1139,6 +1312,33 @@ public:
         }
     }
 
+    /** Get the characters of a string without copying a large string.
+     *
+     * @param buffer Storage for the characters of a string that is stored inside the datum.
+     * @return A view of the characters, valid while both the datum and the buffer are unmodified.
+     */
+    [[nodiscard]] std::string_view string_view(string_buffer_type &buffer) const
+    {
+        switch (type_id()) {
+        case phy_string_id: {
+            ttlet length = size();
+            for (size_t i = 0; i != length; ++i) {
+                buffer[i] = (u64 >> ((length - i - 1) * 8)) & 0xff;
+            }
+            return std::string_view{buffer.data(), length};
+        }
+
+        case phy_string_ptr_id:
+            if constexpr (HasLargeObjects) {
+                return *get_pointer<string_type>();
+            } else {
+                tt_no_default();
+            }
+
+        default: throw operation_error("string_view() expect datum to be a string, but it is a {}.", this->type_name());
+        }
+    }
+
     explicit operator std::string() const noexcept
     {
         switch (type_id()) {
@@ -1164,17 +1364,13 @@ public:
             }
 
         case phy_string_id: {
-            ttlet length = size();
-            char buffer[5];
-            for (int i = 0; i < length; i++) {
-                buffer[i] = (u64 >> ((length - i - 1) * 8)) & 0xff;
-            }
-            return std::string(buffer, length);
+            auto buffer = string_buffer_type{};
+            return std::string{string_view(buffer)};
         }
 
         case phy_string_ptr_id:
             if constexpr (HasLargeObjects) {
-                return *get_pointer<std::string>();
+                return std::string{std::string_view{*get_pointer<string_type>()}};
             } else {
                 tt_no_default();
             }
@@ -1293,26 +1489,27 @@ public:
      * This datum must hold a vector, map or undefined.
      * When this datum holds undefined it is treated as if datum holds an empty map.
      * When this datum holds a vector, the index must be datum holding an integer.
+     * A vector or map which is shared with other datums is copied first.
      *
      * @param rhs An index into the map or vector.
      */
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
-    datum_impl &operator[](datum_impl const &rhs)
+    datum_impl &operator[](datum_impl const &rhs) &
     {
         if (is_undefined()) {
             // When accessing a name on an undefined it means we need replace it with an empty map.
-            auto *p = new datum_impl::map();
+            auto *p = new_object<datum_impl::map>(std::pmr::get_default_resource());
             u64 = map_ptr_mask | (reinterpret_cast<uint64_t>(p) & pointer_mask);
         }
 
         if (is_map()) {
-            auto &m = *get_pointer<datum_impl::map>();
+            auto &m = *get_mutable_pointer<datum_impl::map>();
             auto [i, did_insert] = m.try_emplace(rhs);
             return i->second;
 
         } else if (is_vector() && rhs.is_integer()) {
             auto index = static_cast<int64_t>(rhs);
-            auto &v = *get_pointer<datum_impl::vector>();
+            auto &v = *get_mutable_pointer<datum_impl::vector>();
 
             if (index < 0) {
                 index = std::ssize(v) + index;
@@ -1334,11 +1531,12 @@ public:
      * This datum must hold a vector, map or undefined.
      * When this datum holds undefined it is treated as if datum holds an empty map.
      * When this datum holds a vector, the index must be datum holding an integer.
+     * This is also used to index a temporary datum, so that it is not copied.
      *
      * @param rhs An index into the map or vector.
      */
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
-    datum_impl operator[](datum_impl const &rhs) const
+    datum_impl operator[](datum_impl const &rhs) const &
     {
         if (is_map()) {
             ttlet &m = *get_pointer<datum_impl::map>();
@@ -1409,12 +1607,12 @@ public:
     {
         if (is_undefined()) {
             // When appending on undefined it means we need replace it with an empty vector.
-            auto *p = new datum_impl::vector();
+            auto *p = new_object<datum_impl::vector>(std::pmr::get_default_resource());
             u64 = vector_ptr_mask | (reinterpret_cast<uint64_t>(p) & pointer_mask);
         }
 
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             v->emplace_back();
             return v->back();
 
@@ -1428,12 +1626,12 @@ public:
     {
         if (is_undefined()) {
             // When appending on undefined it means we need replace it with an empty vector.
-            auto *p = new datum_impl::vector();
+            auto *p = new_object<datum_impl::vector>(std::pmr::get_default_resource());
             u64 = vector_ptr_mask | (reinterpret_cast<uint64_t>(p) & pointer_mask);
         }
 
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             v->emplace_back(std::forward<Args>(args)...);
 
         } else {
@@ -1446,12 +1644,12 @@ public:
     {
         if (is_undefined()) {
             // When appending on undefined it means we need replace it with an empty vector.
-            auto *p = new datum_impl::vector();
+            auto *p = new_object<datum_impl::vector>(std::pmr::get_default_resource());
             u64 = vector_ptr_mask | (reinterpret_cast<uint64_t>(p) & pointer_mask);
         }
 
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             v->push_back(std::forward<Arg>(arg));
 
         } else {
@@ -1462,7 +1660,7 @@ public:
     void pop_back()
     {
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             v->pop_back();
 
         } else {
@@ -1521,7 +1719,7 @@ public:
     datum_impl &front()
     {
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             return v->front();
 
         } else {
@@ -1543,7 +1741,7 @@ public:
     datum_impl &back()
     {
         if (is_vector()) {
-            auto *v = get_pointer<datum_impl::vector>();
+            auto *v = get_mutable_pointer<datum_impl::vector>();
             return v->back();
 
         } else {
@@ -1780,8 +1978,11 @@ public:
     size_t size() const
     {
         switch (type_id()) {
-        case phy_string_id: return (u64 >> 40) & 0xff;
-        case phy_string_ptr_id: return get_pointer<std::string>()->size();
+        case phy_string_id: {
+            ttlet length = (u64 >> 40) & 0xff;
+            return length <= 5 ? length : 6;
+        }
+        case phy_string_ptr_id: return get_pointer<string_type>()->size();
         case phy_vector_ptr_id: return get_pointer<datum_impl::vector>()->size();
         case phy_map_ptr_id: return get_pointer<datum_impl::map>()->size();
         case phy_bytes_ptr_id: return get_pointer<bstring>()->size();
@@ -1790,20 +1991,20 @@ public:
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
-    typename map::const_iterator map_begin() const
+    [[nodiscard]] auto map_begin() const
     {
         if (is_phy_map_ptr()) {
-            return get_pointer<datum_impl::map>()->begin();
+            return get_pointer<datum_impl::map>()->cbegin();
         } else {
             throw operation_error("map_begin() expect datum to be a map, but it is a {}.", this->type_name());
         }
     }
 
     template<bool P = HasLargeObjects, std::enable_if_t<P, int> = 0>
-    typename map::const_iterator map_end() const
+    [[nodiscard]] auto map_end() const
     {
         if (is_phy_map_ptr()) {
-            return get_pointer<datum_impl::map>()->end();
+            return get_pointer<datum_impl::map>()->cend();
         } else {
             throw operation_error("map_end() expect datum to be a map, but it is a {}.", this->type_name());
         }
@@ -1837,14 +2038,14 @@ public:
         } else if (is_phy_pointer()) {
             [[unlikely]] switch (type_id())
             {
-            case phy_string_ptr_id: return std::hash<std::string>{}(*get_pointer<std::string>());
+            case phy_string_ptr_id: return std::hash<string_type>{}(*get_pointer<string_type>());
             case phy_url_ptr_id: return std::hash<URL>{}(*get_pointer<URL>());
             case phy_vector_ptr_id:
                 return std::accumulate(vector_begin(), vector_end(), size_t{0}, [](size_t a, auto x) {
                     return a ^ x.hash();
                 });
             case phy_map_ptr_id:
-                return std::accumulate(map_begin(), map_end(), size_t{0}, [](size_t a, auto x) {
+                return std::accumulate(map_begin(), map_end(), size_t{0}, [](size_t a, auto const &x) {
                     return a ^ (x.first.hash() ^ x.second.hash());
                 });
             case phy_decimal_ptr_id: return std::hash<decimal>{}(*get_pointer<decimal>());
@@ -1976,6 +2177,11 @@ public:
 
     friend bool operator==(datum_impl const &lhs, datum_impl const &rhs) noexcept
     {
+        if (lhs.u64 == rhs.u64) {
+            // The same value, or a pointer to the same object; a datum never holds a NaN.
+            return true;
+        }
+
         switch (lhs.type_id()) {
         case datum_impl::phy_small_id: return rhs.is_phy_small() && lhs.get_unsigned_integer() == rhs.get_unsigned_integer();
         case datum_impl::phy_integer_id:
@@ -1993,9 +2199,22 @@ public:
         case datum_impl::phy_ymd_id: return rhs.is_ymd() && lhs.get_unsigned_integer() == rhs.get_unsigned_integer();
         case datum_impl::phy_string_id:
         case datum_impl::phy_string_ptr_id:
-            return (
-                (rhs.is_string() && static_cast<std::string>(lhs) == static_cast<std::string>(rhs)) ||
-                (rhs.is_url() && static_cast<URL>(lhs) == static_cast<URL>(rhs)));
+            if (rhs.is_string()) {
+                // Strings are compared without copying, as this is how the keys of a map are found.
+                // A string is stored inside the datum if and only if it is short enough, so
+                // strings stored in different ways are never equal.
+                if (lhs.type_id() != rhs.type_id()) {
+                    return false;
+                } else if (lhs.is_phy_string()) {
+                    return lhs.u64 == rhs.u64;
+                } else if constexpr (HasLargeObjects) {
+                    return *lhs.get_pointer<string_type>() == *rhs.get_pointer<string_type>();
+                } else {
+                    tt_no_default();
+                }
+            } else {
+                return rhs.is_url() && static_cast<URL>(lhs) == static_cast<URL>(rhs);
+            }
         case datum_impl::phy_url_ptr_id:
             return (rhs.is_url() || rhs.is_string()) && static_cast<URL>(lhs) == static_cast<URL>(rhs);
         case datum_impl::phy_vector_ptr_id:
@@ -2052,7 +2271,9 @@ public:
         case datum_impl::phy_string_id:
         case datum_impl::phy_string_ptr_id:
             if (rhs.is_string()) {
-                return static_cast<std::string>(lhs) < static_cast<std::string>(rhs);
+                auto lhs_buffer = datum_impl::string_buffer_type{};
+                auto rhs_buffer = datum_impl::string_buffer_type{};
+                return lhs.string_view(lhs_buffer) < rhs.string_view(rhs_buffer);
             } else if (rhs.is_url()) {
                 return static_cast<URL>(lhs) < static_cast<URL>(rhs);
             } else {
@@ -2426,7 +2647,7 @@ public:
         if (lhs.is_map() && rhs.is_map()) {
             result = lhs;
 
-            auto result_map = result.get_pointer<datum_impl::map>();
+            auto result_map = result.get_mutable_pointer<datum_impl::map>();
             for (auto rhs_i = rhs.map_begin(); rhs_i != rhs.map_end(); rhs_i++) {
                 auto result_i = result_map->find(rhs_i->first);
                 if (result_i == result_map->end()) {
@@ -2439,7 +2660,7 @@ public:
         } else if (lhs.is_vector() && rhs.is_vector()) {
             result = lhs;
 
-            auto result_vector = result.get_pointer<datum_impl::vector>();
+            auto result_vector = result.get_mutable_pointer<datum_impl::vector>();
             for (auto rhs_i = rhs.vector_begin(); rhs_i != rhs.vector_end(); rhs_i++) {
                 result_vector->push_back(*rhs_i);
             }
@@ -2462,8 +2683,8 @@ public:
     }
 };
 
-template<typename T, bool HasLargeObjects>
-inline bool will_cast_to(datum_impl<HasLargeObjects> const &rhs)
+template<typename T, bool HasLargeObjects, bool IsThreadSafe>
+inline bool will_cast_to(datum_impl<HasLargeObjects, IsThreadSafe> const &rhs)
 {
     if constexpr (std::is_same_v<T, bool>) {
         return true;
@@ -2471,17 +2692,17 @@ inline bool will_cast_to(datum_impl<HasLargeObjects> const &rhs)
         return rhs.is_string();
     } else if constexpr (std::is_arithmetic_v<T>) {
         return rhs.is_numeric();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::undefined>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::undefined>) {
         return rhs.is_undefined();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::null>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::null>) {
         return rhs.is_null();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::_break>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::_break>) {
         return rhs.is_break();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::_continue>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::_continue>) {
         return rhs.is_continue();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::vector>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::vector>) {
         return rhs.is_vector();
-    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects>::map>) {
+    } else if constexpr (std::is_same_v<T, typename datum_impl<HasLargeObjects, IsThreadSafe>::map>) {
         return rhs.is_map();
     } else if constexpr (std::is_same_v<T, URL>) {
         return rhs.is_url() || rhs.is_string();
@@ -2492,15 +2713,15 @@ inline bool will_cast_to(datum_impl<HasLargeObjects> const &rhs)
     }
 }
 
-template<bool HasLargeObjects>
+template<bool HasLargeObjects, bool IsThreadSafe>
 bool operator<(
-    typename datum_impl<HasLargeObjects>::map const &lhs,
-    typename datum_impl<HasLargeObjects>::map const &rhs) noexcept
+    typename datum_impl<HasLargeObjects, IsThreadSafe>::map const &lhs,
+    typename datum_impl<HasLargeObjects, IsThreadSafe>::map const &rhs) noexcept
 {
-    auto lhs_keys = transform<datum_impl<HasLargeObjects>::vector>(lhs, [](auto x) {
+    auto lhs_keys = transform<datum_impl<HasLargeObjects, IsThreadSafe>::vector>(lhs, [](auto x) {
         return x.first;
     });
-    auto rhs_keys = transform<datum_impl<HasLargeObjects>::vector>(lhs, [](auto x) {
+    auto rhs_keys = transform<datum_impl<HasLargeObjects, IsThreadSafe>::vector>(lhs, [](auto x) {
         return x.first;
     });
 
@@ -2523,12 +2744,18 @@ bool operator<(
 using datum = datum_impl<true>;
 using sdatum = datum_impl<false>;
 
+/** A datum for use by a single thread.
+ * The reference counts of shared large objects are not atomic.
+ */
+using local_datum = datum_impl<true, false>;
+
 } // namespace tt
 
 namespace std {
 
-template<bool HasLargeObjects>
-inline size_t hash<tt::datum_impl<HasLargeObjects>>::operator()(tt::datum_impl<HasLargeObjects> const &value) const
+template<bool HasLargeObjects, bool IsThreadSafe>
+inline size_t hash<tt::datum_impl<HasLargeObjects, IsThreadSafe>>::operator()(
+    tt::datum_impl<HasLargeObjects, IsThreadSafe> const &value) const
 {
     return value.hash();
 }
@@ -0,0 +1,92 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "datum.hpp"
+#include "assert.hpp"
+#include <memory_resource>
+#include <memory>
+
+namespace tt {
+
+/** A tree of datum values which is allocated from a single arena.
+ *
+ * A parsed JSON or BON8 document is read many times and released as a whole.
+ * Building it as a normal `datum` costs an allocation for each string, vector and map,
+ * and the same number of frees when it is destroyed. The parsers can instead allocate
+ * these from the monotonic arena of a `datum_document`, which is released in one go.
+ *
+ * The values in the document may still be modified. Values copied into, or out of,
+ * the document are allocated from the default memory resource, so they may outlive it.
+ *
+ * A value that is moved out of the document, for example `auto value = std::move(document.root())`,
+ * keeps the arena of the document as its memory resource. Such a value dangles once the document
+ * is destroyed; copy values out of the document when they need to outlive it.
+ */
+class datum_document {
+public:
+    /** Create an empty document.
+     *
+     * @param initial_size The size of the first block of the arena.
+     * @param upstream The memory resource from which the arena allocates its blocks.
+     */
+    explicit datum_document(
+        size_t initial_size = 4096,
+        std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept :
+        _arena(std::make_unique<std::pmr::monotonic_buffer_resource>(initial_size, upstream)), _root()
+    {
+    }
+
+    datum_document(datum_document const &) = delete;
+    datum_document &operator=(datum_document const &) = delete;
+    datum_document(datum_document &&other) noexcept = default;
+
+    datum_document &operator=(datum_document &&other) noexcept
+    {
+        // The root must be destroyed before the arena it was allocated from.
+        _root = datum{};
+        _arena = std::move(other._arena);
+        _root = std::move(other._root);
+        return *this;
+    }
+
+    /** The arena of this document.
+     * Use it to allocate new strings, vectors and maps in the document:
+     * `datum{text, document.resource()}`, `datum::vector(document.resource())`.
+     */
+    [[nodiscard]] std::pmr::memory_resource *resource() const noexcept
+    {
+        tt_axiom(_arena);
+        return _arena.get();
+    }
+
+    /** The value of the document.
+     *
+     * Do not move the value, or a value inside it, out of the document unless the document outlives it;
+     * a moved value keeps the arena of this document as its memory resource. A copy is allocated from
+     * the default memory resource and is independent of the document.
+     */
+    [[nodiscard]] datum &root() noexcept
+    {
+        return _root;
+    }
+
+    /** The value of the document.
+     */
+    [[nodiscard]] datum const &root() const noexcept
+    {
+        return _root;
+    }
+
+private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> _arena;
+
+    /** The value of the document.
+     * Declared after `_arena`, so that it is destroyed first.
+     */
+    datum _root;
+};
+
+} // namespace tt
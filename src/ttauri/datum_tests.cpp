@@ -3,10 +3,12 @@
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
 #include "ttauri/datum.hpp"
+#include "ttauri/datum_document.hpp"
 #include "ttauri/exception.hpp"
 #include <gtest/gtest.h>
 #include <iostream>
 #include <string>
+#include <memory_resource>
 
 using namespace std;
 using namespace std::literals;
@@ -128,3 +130,207 @@ TEST(Datum, ArrayOperations) {
     ASSERT_EQ(v[-2], 14);
     ASSERT_EQ(v[-1], 15);
 }
+
+/** A memory resource which counts the number of allocations.
+ */
+class counting_resource : public std::pmr::memory_resource {
+public:
+    size_t count = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        ++count;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST(Datum, ShortStringOperations) {
+    auto heap = counting_resource{};
+    auto *const previous_default = std::pmr::set_default_resource(&heap);
+
+    {
+        for (ttlet str : {""s, "a"s, "foo"s, "12345"s, "123456"s, "caf\xc3\xa9"s, "\xe2\x82\xac\xe2\x82\xac"s}) {
+            heap.count = 0;
+            ttlet v = datum{str};
+            ttlet w = datum{std::string_view{str}};
+            auto buffer = datum::string_buffer_type{};
+            ASSERT_EQ(v.size(), str.size());
+            ASSERT_EQ(v.string_view(buffer), str);
+            ASSERT_EQ(v, w);
+            ASSERT_EQ(v.hash(), w.hash());
+            ASSERT_FALSE(v < w);
+            ASSERT_EQ(heap.count, 0);
+
+            ASSERT_EQ(static_cast<std::string>(v), str);
+            ASSERT_EQ(static_cast<std::string>(sdatum{str}), str);
+        }
+
+        // Longer strings, and 6 code unit strings starting with a control character, are allocated.
+        heap.count = 0;
+        ttlet long_str = datum{"1234567"};
+        ttlet control_str = datum{"\x01" "23456"};
+        ASSERT_EQ(heap.count, 2);
+        ASSERT_EQ(long_str.size(), 7);
+        ASSERT_EQ(control_str.size(), 6);
+        ASSERT_EQ(static_cast<std::string>(control_str), "\x01" "23456"s);
+
+        ASSERT_TRUE(datum{"abc"} < datum{"abd"});
+        ASSERT_TRUE(datum{"abc"} < datum{"abcdef"});
+        ASSERT_FALSE(long_str < datum{"1234"});
+        ASSERT_TRUE(datum{"1234"} < long_str);
+        ASSERT_NE(datum{"abcdef"}, datum{"abcdeg"});
+        ASSERT_NE(datum{"\xc3\xa9"}, datum{"\xc3\xa8"});
+    }
+
+    std::pmr::set_default_resource(previous_default);
+}
+
+TEST(Datum, CharOperations) {
+    ttlet v = datum{'\xe9'};
+    ASSERT_TRUE(v.is_string());
+    ASSERT_EQ(v.size(), 1);
+    ASSERT_EQ(static_cast<char>(v), '\xe9');
+    ASSERT_EQ(static_cast<std::string>(v), "\xe9"s);
+    ASSERT_EQ(v, datum{"\xe9"});
+
+    auto w = datum{datum::vector{"A long string"}};
+    w = '\xe9';
+    ASSERT_TRUE(w.is_string());
+    ASSERT_EQ(w, v);
+}
+
+TEST(Datum, MoveAssignment) {
+    auto v = datum{datum::vector{"Hello World", 2}};
+    v = datum{"Goodbye World"};
+    ASSERT_EQ(v, "Goodbye World");
+
+    auto w = datum{datum::vector{"Hello World", 2}};
+    v = std::move(w);
+    ASSERT_EQ(v, (datum::vector{"Hello World", 2}));
+    ASSERT_TRUE(w.is_undefined());
+}
+
+TEST(Datum, CopyOnWrite) {
+    auto heap = counting_resource{};
+    auto *const previous_default = std::pmr::set_default_resource(&heap);
+
+    {
+        auto original = datum{datum::vector{"A long string", datum::vector{1, 2, 3}}};
+
+        // Copies share the vector.
+        heap.count = 0;
+        auto copy = original;
+        ttlet const_copy = original;
+        ASSERT_EQ(heap.count, 0);
+        ASSERT_EQ(copy, original);
+        ASSERT_EQ(const_copy[1][2], 3);
+        ASSERT_EQ(heap.count, 0);
+
+        // Modifying a copy copies the vector, the elements are still shared.
+        copy.push_back(4);
+        ASSERT_NE(heap.count, 0);
+        ASSERT_EQ(copy.size(), 3);
+        ASSERT_EQ(original.size(), 2);
+
+        copy[1][0] = 42;
+        ASSERT_EQ(copy[1][0], 42);
+        ASSERT_EQ(original[1][0], 1);
+        ASSERT_EQ(const_copy[1][0], 1);
+
+        // A datum which is not shared is modified in place.
+        heap.count = 0;
+        copy[1][1] = 43;
+        ASSERT_EQ(heap.count, 0);
+    }
+
+    std::pmr::set_default_resource(previous_default);
+}
+
+TEST(Datum, CopyOnWriteMap) {
+    auto object = datum{datum::map{}};
+    object["foo"] = "A long string";
+    object["bar"] = datum::map{};
+
+    auto copy = object;
+    copy["bar"]["baz"] = 1;
+    copy["foo"] = 2;
+
+    ASSERT_EQ(object["foo"], "A long string");
+    ASSERT_EQ(object["bar"].size(), 0);
+    ASSERT_EQ(copy["foo"], 2);
+    ASSERT_EQ(copy["bar"]["baz"], 1);
+
+    auto merged = deep_merge(object, copy);
+    ASSERT_EQ(merged["bar"]["baz"], 1);
+    ASSERT_EQ(object["bar"].size(), 0);
+}
+
+TEST(Datum, MapAliasing) {
+    auto object = datum{datum::map{}};
+    for (int i = 0; i != 16; ++i) {
+        object[i] = i + 16;
+    }
+
+    // The key is a value in the map, while the map grows.
+    object[object[3]] = 42;
+    ASSERT_EQ(object.size(), 17);
+    ASSERT_EQ(object[3], 19);
+    ASSERT_EQ(object[19], 42);
+}
+
+TEST(Datum, LocalDatum) {
+    auto original = local_datum{local_datum::vector{"A long string", 2}};
+    auto copy = original;
+    copy.push_back(3);
+    ASSERT_EQ(original.size(), 2);
+    ASSERT_EQ(copy.size(), 3);
+    ASSERT_EQ(copy[0], "A long string");
+}
+
+TEST(DatumDocument, Arena) {
+    auto heap = counting_resource{};
+    auto arena = counting_resource{};
+    auto *const previous_default = std::pmr::set_default_resource(&heap);
+
+    {
+        auto document = datum_document{4096, &arena};
+        ttlet r = document.resource();
+
+        auto list = datum::vector(r);
+        list.emplace_back("A long string in the arena", r);
+        list.emplace_back(42);
+        auto object = datum::map(r);
+        object.emplace(datum{"A long key in the arena", r}, datum{std::move(list)});
+        document.root() = datum{std::move(object)};
+
+        ASSERT_EQ(heap.count, 0);
+        ASSERT_EQ(arena.count, 1);
+        ASSERT_EQ(document.root()["A long key in the arena"][0], "A long string in the arena");
+        ASSERT_EQ(document.root()["A long key in the arena"][1], 42);
+
+        // Values added later are allocated on the heap, and are released with the document.
+        document.root()["A long key in the arena"].push_back("A long string on the heap");
+        ASSERT_NE(heap.count, 0);
+
+        // A copy is allocated on the heap, so that it may outlive the document.
+        heap.count = 0;
+        auto copy = document.root();
+        document = datum_document{};
+        ASSERT_NE(heap.count, 0);
+        ASSERT_EQ(copy["A long key in the arena"][0], "A long string in the arena");
+        ASSERT_EQ(copy["A long key in the arena"][2], "A long string on the heap");
+    }
+
+    std::pmr::set_default_resource(previous_default);
+}
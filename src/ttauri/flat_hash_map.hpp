@@ -0,0 +1,700 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "required.hpp"
+#include "assert.hpp"
+#include <emmintrin.h>
+#include <memory>
+#include <utility>
+#include <tuple>
+#include <functional>
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <bit>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace tt {
+
+/** A hash map which stores its items in a single array, in insertion order.
+ *
+ * Most maps hold only a few items. Up to `inline_capacity` items are stored inside
+ * the map object itself and are found by a linear search, without hashing the key.
+ * When a map grows beyond that the items are moved to an allocated array, and a
+ * Swiss-table style index is added: open addressing over slots which hold the position
+ * of an item and a control byte with 7 bits of its hash, probed 16 slots at a time.
+ *
+ * Iteration order is insertion order, also after the map has switched to the index.
+ * Assigning to an existing key keeps its position; erasing an item moves the items
+ * after it forward, which makes `erase()` O(n).
+ *
+ * Like `std::vector`, and unlike `std::unordered_map`, inserting or erasing items
+ * invalidates iterators, pointers and references to the items.
+ *
+ * The allocator is used for the item array and the index. With a
+ * `std::pmr::polymorphic_allocator` the map is allocator-aware in the same way
+ * as the standard containers: copies select the default memory resource, while
+ * moves keep the memory resource of the source.
+ *
+ * @tparam Key The key type.
+ * @tparam T The mapped type.
+ * @tparam Hash The hash function for the key; its result is mixed before use.
+ * @tparam KeyEqual The equality function for the key.
+ * @tparam Allocator The allocator of `std::pair<Key, T>`.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = std::hash<Key>,
+    typename KeyEqual = std::equal_to<Key>,
+    typename Allocator = std::allocator<std::pair<Key, T>>>
+class flat_hash_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = value_type const &;
+    using pointer = value_type *;
+    using const_pointer = value_type const *;
+    using iterator = value_type *;
+    using const_iterator = value_type const *;
+
+    static_assert(std::is_nothrow_move_constructible_v<value_type>, "Items are relocated by moving them.");
+
+    /** The number of items that are stored inside the map object.
+     * Maps with more items use an allocated array and a hash index.
+     */
+    static constexpr size_type inline_capacity = 8;
+
+    flat_hash_map() noexcept(noexcept(allocator_type())) : flat_hash_map(allocator_type{}) {}
+
+    explicit flat_hash_map(allocator_type const &allocator) noexcept : _allocator(allocator), _items(inline_items()) {}
+
+    flat_hash_map(std::initializer_list<value_type> init, allocator_type const &allocator = allocator_type{}) :
+        flat_hash_map(allocator)
+    {
+        reserve(init.size());
+        for (ttlet &item : init) {
+            insert(item);
+        }
+    }
+
+    flat_hash_map(flat_hash_map const &other) :
+        flat_hash_map(other, item_traits::select_on_container_copy_construction(other._allocator))
+    {
+    }
+
+    flat_hash_map(flat_hash_map const &other, allocator_type const &allocator) : flat_hash_map(allocator)
+    {
+        copy_from(other);
+    }
+
+    flat_hash_map(flat_hash_map &&other) noexcept : flat_hash_map(other._allocator)
+    {
+        steal_from(other);
+    }
+
+    flat_hash_map(flat_hash_map &&other, allocator_type const &allocator) : flat_hash_map(allocator)
+    {
+        if (_allocator == other._allocator) {
+            steal_from(other);
+        } else {
+            move_from(other);
+        }
+    }
+
+    flat_hash_map &operator=(flat_hash_map const &other)
+    {
+        if (this != &other) {
+            clear();
+            if constexpr (item_traits::propagate_on_container_copy_assignment::value) {
+                if (_allocator != other._allocator) {
+                    release();
+                    _allocator = other._allocator;
+                }
+            }
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    flat_hash_map &operator=(flat_hash_map &&other) noexcept(item_traits::is_always_equal::value)
+    {
+        if (this != &other) {
+            clear();
+            if constexpr (item_traits::propagate_on_container_move_assignment::value) {
+                release();
+                _allocator = other._allocator;
+                steal_from(other);
+
+            } else if (_allocator == other._allocator) {
+                release();
+                steal_from(other);
+
+            } else {
+                move_from(other);
+            }
+        }
+        return *this;
+    }
+
+    ~flat_hash_map()
+    {
+        clear();
+        release();
+    }
+
+    [[nodiscard]] allocator_type get_allocator() const noexcept
+    {
+        return _allocator;
+    }
+
+    [[nodiscard]] size_type size() const noexcept
+    {
+        return _size;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return _size == 0;
+    }
+
+    [[nodiscard]] size_type capacity() const noexcept
+    {
+        return _capacity;
+    }
+
+    [[nodiscard]] iterator begin() noexcept
+    {
+        return _items;
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept
+    {
+        return _items;
+    }
+
+    [[nodiscard]] const_iterator cbegin() const noexcept
+    {
+        return _items;
+    }
+
+    [[nodiscard]] iterator end() noexcept
+    {
+        return _items + _size;
+    }
+
+    [[nodiscard]] const_iterator end() const noexcept
+    {
+        return _items + _size;
+    }
+
+    [[nodiscard]] const_iterator cend() const noexcept
+    {
+        return _items + _size;
+    }
+
+    /** Reserve room for items.
+     * This does not build the index; it is built when the number of items exceeds `inline_capacity`.
+     *
+     * @param new_capacity The number of items the map should be able to hold without reallocating.
+     */
+    void reserve(size_type new_capacity)
+    {
+        if (new_capacity <= _capacity) {
+            return;
+        }
+
+        move_items(item_traits::allocate(_allocator, new_capacity), new_capacity);
+    }
+
+    /** Remove all items.
+     * The item array is retained, the index is released.
+     */
+    void clear() noexcept
+    {
+        for (size_type i = 0; i != _size; ++i) {
+            item_traits::destroy(_allocator, _items + i);
+        }
+        _size = 0;
+        deallocate_index();
+    }
+
+    [[nodiscard]] iterator find(key_type const &key) noexcept
+    {
+        return _items + find_index(key);
+    }
+
+    [[nodiscard]] const_iterator find(key_type const &key) const noexcept
+    {
+        return _items + find_index(key);
+    }
+
+    [[nodiscard]] bool contains(key_type const &key) const noexcept
+    {
+        return find_index(key) != _size;
+    }
+
+    [[nodiscard]] size_type count(key_type const &key) const noexcept
+    {
+        return contains(key) ? 1 : 0;
+    }
+
+    /** Get the value of a key.
+     * @throw std::out_of_range When the key is not in the map.
+     */
+    [[nodiscard]] mapped_type &at(key_type const &key)
+    {
+        ttlet i = find_index(key);
+        if (i == _size) {
+            throw std::out_of_range("flat_hash_map::at(): key not found");
+        }
+        return _items[i].second;
+    }
+
+    /** Get the value of a key.
+     * @throw std::out_of_range When the key is not in the map.
+     */
+    [[nodiscard]] mapped_type const &at(key_type const &key) const
+    {
+        ttlet i = find_index(key);
+        if (i == _size) {
+            throw std::out_of_range("flat_hash_map::at(): key not found");
+        }
+        return _items[i].second;
+    }
+
+    mapped_type &operator[](key_type const &key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    mapped_type &operator[](key_type &&key)
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type const &key, Args &&...args)
+    {
+        return emplace_key(key, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type &&key, Args &&...args)
+    {
+        return emplace_key(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type const &key, M &&obj)
+    {
+        auto r = emplace_key(key, std::forward<M>(obj));
+        if (!r.second) {
+            r.first->second = std::forward<M>(obj);
+        }
+        return r;
+    }
+
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&obj)
+    {
+        auto r = emplace_key(std::move(key), std::forward<M>(obj));
+        if (!r.second) {
+            r.first->second = std::forward<M>(obj);
+        }
+        return r;
+    }
+
+    std::pair<iterator, bool> insert(value_type const &value)
+    {
+        return emplace_key(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value)
+    {
+        return emplace_key(std::move(value.first), std::move(value.second));
+    }
+
+    /** Construct an item and insert it, unless its key is already in the map.
+     */
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args)
+    {
+        auto item = value_type(std::forward<Args>(args)...);
+        return emplace_key(std::move(item.first), std::move(item.second));
+    }
+
+    /** Erase an item.
+     * The items after it are moved forward to keep the insertion order.
+     *
+     * @return An iterator to the item after the erased item.
+     */
+    iterator erase(const_iterator pos)
+    {
+        tt_axiom(pos >= begin() && pos < end());
+        ttlet i = static_cast<size_type>(pos - _items);
+
+        std::move(_items + i + 1, _items + _size, _items + i);
+        item_traits::destroy(_allocator, _items + --_size);
+        rebuild_index();
+        return _items + i;
+    }
+
+    size_type erase(key_type const &key)
+    {
+        ttlet i = find_index(key);
+        if (i == _size) {
+            return 0;
+        } else {
+            erase(_items + i);
+            return 1;
+        }
+    }
+
+    /** Compare two maps.
+     * The maps are equal when they have the same items, in any order.
+     */
+    [[nodiscard]] friend bool operator==(flat_hash_map const &lhs, flat_hash_map const &rhs) noexcept
+    {
+        if (lhs._size != rhs._size) {
+            return false;
+        }
+        for (ttlet &item : lhs) {
+            ttlet i = rhs.find_index(item.first);
+            if (i == rhs._size || !(rhs._items[i].second == item.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    using item_traits = std::allocator_traits<allocator_type>;
+    using slot_allocator_type = typename item_traits::template rebind_alloc<uint32_t>;
+    using slot_traits = typename item_traits::template rebind_traits<uint32_t>;
+
+    static constexpr size_type group_size = 16;
+    static constexpr uint8_t empty_control = 0x80;
+
+    allocator_type _allocator;
+
+    /** The items, either `_inline_items` or an allocated array.
+     */
+    value_type *_items;
+    size_type _size = 0;
+    size_type _capacity = inline_capacity;
+
+    /** The index, `nullptr` while the map holds `inline_capacity` items or less.
+     * A single allocation of `_bucket_count` slots, followed by `_bucket_count` control bytes.
+     * A slot holds the position of an item in `_items`. A control byte is either
+     * `empty_control` or the low 7 bits of the hash of the item in the slot.
+     */
+    uint32_t *_slots = nullptr;
+    size_type _bucket_count = 0;
+
+    alignas(value_type) std::byte _inline_items[sizeof(value_type) * inline_capacity];
+
+    [[nodiscard]] value_type *inline_items() noexcept
+    {
+        return std::launder(reinterpret_cast<value_type *>(_inline_items));
+    }
+
+    [[nodiscard]] bool is_inline() const noexcept
+    {
+        return reinterpret_cast<std::byte const *>(_items) == _inline_items;
+    }
+
+    [[nodiscard]] uint8_t *control_bytes() const noexcept
+    {
+        return reinterpret_cast<uint8_t *>(_slots + _bucket_count);
+    }
+
+    /** Hash a key.
+     * `std::hash` of integers is often the identity, so the bits are mixed;
+     * the low 7 bits go into the control byte, the rest select a group.
+     */
+    [[nodiscard]] static uint64_t hash_of(key_type const &key) noexcept
+    {
+        auto h = static_cast<uint64_t>(hasher{}(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /** Find the position of a key.
+     * @return The position of the item, or `_size` when the key was not found.
+     */
+    [[nodiscard]] size_type find_index(key_type const &key) const noexcept
+    {
+        if (_slots == nullptr) {
+            for (size_type i = 0; i != _size; ++i) {
+                if (key_equal{}(_items[i].first, key)) {
+                    return i;
+                }
+            }
+            return _size;
+        } else {
+            return find_index(key, hash_of(key));
+        }
+    }
+
+    [[nodiscard]] size_type find_index(key_type const &key, uint64_t hash) const noexcept
+    {
+        tt_axiom(_slots != nullptr);
+
+        ttlet control_bytes_ = control_bytes();
+        ttlet group_mask = _bucket_count / group_size - 1;
+        ttlet h2 = _mm_set1_epi8(static_cast<char>(hash & 0x7f));
+
+        auto group = (hash >> 7) & group_mask;
+        for (size_type step = 1;; ++step) {
+            ttlet control = _mm_loadu_si128(reinterpret_cast<__m128i const *>(control_bytes_ + group * group_size));
+
+            auto matches = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(control, h2)));
+            while (matches != 0) {
+                ttlet i = _slots[group * group_size + std::countr_zero(matches)];
+                if (key_equal{}(_items[i].first, key)) {
+                    return i;
+                }
+                matches &= matches - 1;
+            }
+
+            // A probe sequence ends at the first group with an empty slot.
+            if (_mm_movemask_epi8(control) != 0) {
+                return _size;
+            }
+
+            // Triangular probing visits every group when the number of groups is a power of two.
+            group = (group + step) & group_mask;
+        }
+    }
+
+    /** Add the item at position `i` to the index.
+     */
+    void index_insert(size_type i, uint64_t hash) noexcept
+    {
+        tt_axiom(_slots != nullptr);
+
+        ttlet control_bytes_ = control_bytes();
+        ttlet group_mask = _bucket_count / group_size - 1;
+
+        auto group = (hash >> 7) & group_mask;
+        for (size_type step = 1;; ++step) {
+            ttlet control = _mm_loadu_si128(reinterpret_cast<__m128i const *>(control_bytes_ + group * group_size));
+            ttlet empty = static_cast<uint32_t>(_mm_movemask_epi8(control));
+            if (empty != 0) {
+                ttlet slot = group * group_size + std::countr_zero(empty);
+                control_bytes_[slot] = static_cast<uint8_t>(hash & 0x7f);
+                _slots[slot] = static_cast<uint32_t>(i);
+                return;
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    void allocate_index(size_type bucket_count)
+    {
+        tt_axiom(_slots == nullptr);
+        tt_axiom(bucket_count % group_size == 0 && std::has_single_bit(bucket_count));
+
+        auto allocator = slot_allocator_type{_allocator};
+        _slots = slot_traits::allocate(allocator, bucket_count + bucket_count / sizeof(uint32_t));
+        _bucket_count = bucket_count;
+        std::memset(control_bytes(), empty_control, bucket_count);
+    }
+
+    void deallocate_index() noexcept
+    {
+        if (_slots != nullptr) {
+            auto allocator = slot_allocator_type{_allocator};
+            slot_traits::deallocate(allocator, _slots, _bucket_count + _bucket_count / sizeof(uint32_t));
+            _slots = nullptr;
+            _bucket_count = 0;
+        }
+    }
+
+    /** Rebuild the index for the current items.
+     * Small maps do not have an index; larger maps get an index which is at most 7/8 full.
+     */
+    void rebuild_index()
+    {
+        deallocate_index();
+        if (_size <= inline_capacity) {
+            return;
+        }
+
+        auto bucket_count = group_size * 2;
+        while (bucket_count * 7 < _size * 8) {
+            bucket_count *= 2;
+        }
+
+        allocate_index(bucket_count);
+        for (size_type i = 0; i != _size; ++i) {
+            index_insert(i, hash_of(_items[i].first));
+        }
+    }
+
+    /** Move the items to a newly allocated array, and release the old array.
+     *
+     * @param new_items The new array, with room for at least `_size` items.
+     * @param new_capacity The number of items allocated for `new_items`.
+     */
+    void move_items(value_type *new_items, size_type new_capacity) noexcept
+    {
+        for (size_type i = 0; i != _size; ++i) {
+            item_traits::construct(_allocator, new_items + i, std::move(_items[i]));
+            item_traits::destroy(_allocator, _items + i);
+        }
+
+        if (!is_inline()) {
+            item_traits::deallocate(_allocator, _items, _capacity);
+        }
+        _items = new_items;
+        _capacity = new_capacity;
+    }
+
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> emplace_key(K &&key, Args &&...args)
+    {
+        auto hash = uint64_t{0};
+        if (_slots == nullptr) {
+            ttlet i = find_index(key);
+            if (i != _size) {
+                return {_items + i, false};
+            }
+        } else {
+            hash = hash_of(key);
+            ttlet i = find_index(key, hash);
+            if (i != _size) {
+                return {_items + i, false};
+            }
+        }
+
+        if (_size == _capacity) {
+            // The key or the arguments may refer to an item of this map, therefor the new item
+            // is constructed in the new array before the items are moved and the old array is released.
+            ttlet new_capacity = _capacity * 2;
+            auto *const new_items = item_traits::allocate(_allocator, new_capacity);
+            try {
+                item_traits::construct(
+                    _allocator,
+                    new_items + _size,
+                    std::piecewise_construct,
+                    std::forward_as_tuple(std::forward<K>(key)),
+                    std::forward_as_tuple(std::forward<Args>(args)...));
+            } catch (...) {
+                item_traits::deallocate(_allocator, new_items, new_capacity);
+                throw;
+            }
+            move_items(new_items, new_capacity);
+
+        } else {
+            item_traits::construct(
+                _allocator,
+                _items + _size,
+                std::piecewise_construct,
+                std::forward_as_tuple(std::forward<K>(key)),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        ttlet i = _size++;
+
+        if (_slots != nullptr && _size * 8 <= _bucket_count * 7) {
+            index_insert(i, hash);
+        } else if (_size > inline_capacity) {
+            rebuild_index();
+        }
+        return {_items + i, true};
+    }
+
+    /** Release the item array and the index.
+     * The map must be empty.
+     */
+    void release() noexcept
+    {
+        tt_axiom(_size == 0);
+        deallocate_index();
+        if (!is_inline()) {
+            item_traits::deallocate(_allocator, _items, _capacity);
+            _items = inline_items();
+            _capacity = inline_capacity;
+        }
+    }
+
+    /** Copy the items, and the index, of another map.
+     * This map must be empty.
+     */
+    void copy_from(flat_hash_map const &other)
+    {
+        tt_axiom(_size == 0);
+        reserve(other._size);
+        for (ttlet &item : other) {
+            item_traits::construct(_allocator, _items + _size, item);
+            ++_size;
+        }
+
+        deallocate_index();
+        if (other._slots != nullptr) {
+            allocate_index(other._bucket_count);
+            std::memcpy(_slots, other._slots, _bucket_count * (sizeof(uint32_t) + 1));
+        } else {
+            rebuild_index();
+        }
+    }
+
+    /** Move the items of another map, which uses a different allocator.
+     * This map must be empty.
+     */
+    void move_from(flat_hash_map &other)
+    {
+        tt_axiom(_size == 0);
+        reserve(other._size);
+        for (auto &item : other) {
+            item_traits::construct(_allocator, _items + _size, std::move(item));
+            ++_size;
+        }
+        rebuild_index();
+        other.clear();
+    }
+
+    /** Take over the allocations of another map, which uses an equal allocator.
+     * This map must be empty and own no allocations.
+     */
+    void steal_from(flat_hash_map &other) noexcept
+    {
+        tt_axiom(_size == 0 && is_inline() && _slots == nullptr);
+
+        if (other.is_inline()) {
+            for (size_type i = 0; i != other._size; ++i) {
+                item_traits::construct(_allocator, _items + i, std::move(other._items[i]));
+            }
+            _size = other._size;
+            other.clear();
+
+        } else {
+            _items = std::exchange(other._items, other.inline_items());
+            _size = std::exchange(other._size, 0);
+            _capacity = std::exchange(other._capacity, inline_capacity);
+            _slots = std::exchange(other._slots, nullptr);
+            _bucket_count = std::exchange(other._bucket_count, 0);
+        }
+    }
+};
+
+} // namespace tt
@@ -0,0 +1,221 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/flat_hash_map.hpp"
+#include "ttauri/datum.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <memory_resource>
+
+using namespace std;
+using namespace tt;
+
+/** A hash function which puts every key in the same group, to exercise probing.
+ */
+struct bad_hash {
+    size_t operator()(int) const noexcept
+    {
+        return 0;
+    }
+};
+
+TEST(FlatHashMap, Small)
+{
+    auto items = flat_hash_map<int, std::string>{};
+    ASSERT_TRUE(items.empty());
+
+    ASSERT_TRUE(items.try_emplace(30, "thirty").second);
+    ASSERT_TRUE(items.try_emplace(10, "ten").second);
+    ASSERT_FALSE(items.try_emplace(30, "THIRTY").second);
+    items[20] = "twenty";
+    ASSERT_EQ(items.size(), 3);
+
+    ASSERT_EQ(items.at(10), "ten");
+    ASSERT_EQ(items.at(30), "thirty");
+    ASSERT_EQ(items[20], "twenty");
+    ASSERT_TRUE(items.contains(10));
+    ASSERT_FALSE(items.contains(40));
+    ASSERT_EQ(items.find(40), items.end());
+    ASSERT_THROW((void)items.at(40), std::out_of_range);
+
+    // Items are iterated in insertion order.
+    auto keys = std::vector<int>{};
+    for (ttlet &item : items) {
+        keys.push_back(item.first);
+    }
+    ASSERT_EQ(keys, (std::vector<int>{30, 10, 20}));
+}
+
+TEST(FlatHashMap, Large)
+{
+    auto items = flat_hash_map<int, int>{};
+    for (int i = 0; i != 1000; ++i) {
+        ASSERT_TRUE(items.try_emplace(i * 7, i).second);
+    }
+    ASSERT_EQ(items.size(), 1000);
+
+    for (int i = 0; i != 1000; ++i) {
+        ASSERT_EQ(items.at(i * 7), i);
+        ASSERT_FALSE(items.contains(i * 7 + 1));
+    }
+
+    // The insertion order is kept after switching to the hash index.
+    for (int i = 0; i != 1000; ++i) {
+        ASSERT_EQ(items.begin()[i].first, i * 7);
+    }
+}
+
+TEST(FlatHashMap, Collisions)
+{
+    auto items = flat_hash_map<int, int, bad_hash>{};
+    for (int i = 0; i != 100; ++i) {
+        items[i] = i * 2;
+    }
+    for (int i = 0; i != 100; ++i) {
+        ASSERT_EQ(items.at(i), i * 2);
+    }
+    ASSERT_FALSE(items.contains(100));
+}
+
+TEST(FlatHashMap, InsertOrAssign)
+{
+    auto items = flat_hash_map<std::string, int>{};
+    ASSERT_TRUE(items.insert_or_assign("a", 1).second);
+    ASSERT_TRUE(items.insert_or_assign("b", 2).second);
+    ASSERT_FALSE(items.insert_or_assign("a", 3).second);
+    ASSERT_FALSE(items.insert({"b", 4}).second);
+    ASSERT_TRUE(items.emplace("c", 5).second);
+
+    ASSERT_EQ(items.size(), 3);
+    ASSERT_EQ(items.at("a"), 3);
+    ASSERT_EQ(items.at("b"), 2);
+    ASSERT_EQ(items.begin()->first, "a");
+}
+
+TEST(FlatHashMap, Aliasing)
+{
+    // The key of a new item refers to an item of the map, while the map grows.
+    for (ttlet size : {8, 16}) {
+        auto items = flat_hash_map<std::string, std::string>{};
+        for (int i = 0; i != size; ++i) {
+            items[std::to_string(i)] = "a long value which does not fit in a small string " + std::to_string(i);
+        }
+        ASSERT_EQ(items.capacity(), items.size());
+
+        ASSERT_TRUE(items.try_emplace(items["0"], items["1"]).second);
+        ASSERT_EQ(items.size(), size + 1);
+        ASSERT_EQ(items.at("0"), "a long value which does not fit in a small string 0");
+        ASSERT_EQ(items.at("a long value which does not fit in a small string 0"), "a long value which does not fit in a small string 1");
+    }
+}
+
+TEST(FlatHashMap, Erase)
+{
+    for (ttlet size : {5, 20}) {
+        auto items = flat_hash_map<int, int>{};
+        for (int i = 0; i != size; ++i) {
+            items[i] = i;
+        }
+
+        ASSERT_EQ(items.erase(2), 1);
+        ASSERT_EQ(items.erase(2), 0);
+        ASSERT_EQ(items.size(), size - 1);
+        ASSERT_FALSE(items.contains(2));
+
+        auto i = items.erase(items.begin());
+        ASSERT_EQ(i->first, 1);
+        ASSERT_EQ(items.size(), size - 2);
+
+        auto keys = std::vector<int>{};
+        for (ttlet &item : items) {
+            ASSERT_EQ(items.at(item.first), item.first);
+            keys.push_back(item.first);
+        }
+        ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    }
+}
+
+TEST(FlatHashMap, CopyMove)
+{
+    for (ttlet size : {3, 8, 9, 100}) {
+        auto items = flat_hash_map<std::string, int>{};
+        for (int i = 0; i != size; ++i) {
+            items[std::to_string(i)] = i;
+        }
+
+        auto copy = items;
+        ASSERT_EQ(copy, items);
+        ASSERT_EQ(copy.at("2"), 2);
+        copy["2"] = 42;
+        ASSERT_NE(copy, items);
+        ASSERT_EQ(items.at("2"), 2);
+
+        auto moved = std::move(copy);
+        ASSERT_TRUE(copy.empty());
+        ASSERT_EQ(moved.size(), size);
+        ASSERT_EQ(moved.at("2"), 42);
+
+        copy = moved;
+        ASSERT_EQ(copy, moved);
+        moved = std::move(items);
+        ASSERT_EQ(moved.at("2"), 2);
+        ASSERT_EQ(moved.at(std::to_string(size - 1)), size - 1);
+    }
+}
+
+TEST(FlatHashMap, Equality)
+{
+    auto a = flat_hash_map<int, int>{{1, 10}, {2, 20}, {3, 30}};
+    auto b = flat_hash_map<int, int>{{3, 30}, {1, 10}, {2, 20}};
+    auto c = flat_hash_map<int, int>{{3, 30}, {1, 10}, {2, 21}};
+    ASSERT_EQ(a, b);
+    ASSERT_NE(a, c);
+}
+
+TEST(FlatHashMap, MemoryResource)
+{
+    using map_type = flat_hash_map<int, int, std::hash<int>, std::equal_to<int>, std::pmr::polymorphic_allocator<std::pair<int, int>>>;
+
+    auto buffer = std::array<std::byte, 4096>{};
+    auto arena = std::pmr::monotonic_buffer_resource{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+
+    auto items = map_type(&arena);
+    for (int i = 0; i != 50; ++i) {
+        items[i] = i;
+    }
+
+    // Moving keeps the memory resource, a copy uses the default memory resource.
+    auto moved = std::move(items);
+    ASSERT_EQ(moved.get_allocator().resource(), &arena);
+    auto copy = moved;
+    ASSERT_EQ(copy.get_allocator().resource(), std::pmr::get_default_resource());
+    ASSERT_EQ(copy, moved);
+
+    // Moving between different memory resources moves the items.
+    auto other = map_type(std::pmr::get_default_resource());
+    other = std::move(moved);
+    ASSERT_EQ(other.get_allocator().resource(), std::pmr::get_default_resource());
+    ASSERT_EQ(other, copy);
+}
+
+TEST(FlatHashMap, Datum)
+{
+    auto object = datum::map{};
+    object["first"] = 1;
+    object["a long key"] = 2;
+    object[datum{3}] = 3;
+    object["first"] = 4;
+
+    ASSERT_EQ(object.size(), 3);
+    ASSERT_EQ(object.begin()->first, "first");
+    ASSERT_EQ(object.at("first"), 4);
+    ASSERT_EQ(object.at("a long key"), 2);
+    ASSERT_EQ(object.at(datum{3}), 3);
+
+    ttlet value = datum{object};
+    ASSERT_EQ(value["a long key"], 2);
+    ASSERT_TRUE(value.contains("first"));
+    ASSERT_FALSE(value.contains("second"));
+}
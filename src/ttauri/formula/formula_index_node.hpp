@@ -13,8 +13,8 @@ struct formula_index_node final : formula_binary_operator_node {
         formula_binary_operator_node(std::move(location), std::move(lhs), std::move(rhs)) {}
 
     datum evaluate(formula_evaluation_context& context) const override {
-        auto lhs_ = lhs->evaluate(context);
-        auto rhs_ = rhs->evaluate(context);
+        ttlet lhs_ = lhs->evaluate(context);
+        ttlet rhs_ = rhs->evaluate(context);
 
         if (!lhs_.contains(rhs_)) {
             tt_error_info().set<"parse_location">(location);
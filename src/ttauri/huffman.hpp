@@ -1,162 +1,253 @@
-// Copyright Take Vos 2020.
+// Copyright Take Vos 2020-2021.
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
+#pragma once
+
 #include "required.hpp"
-#include "bits.hpp"
+#include "bit_reader.hpp"
 #include "cast.hpp"
+#include "check.hpp"
 #include <span>
 #include <vector>
+#include <array>
+#include <cstdint>
 
 namespace tt {
 
-template<typename T>
-class huffman_tree {
-    static_assert(std::is_integral_v<T> && std::is_signed_v<T>);
+/** The kind of value stored in a huffman table entry.
+ */
+enum class huffman_kind : uint8_t {
+    /** The code was not assigned to a symbol.
+     */
+    invalid,
 
-    using state_t = T const *;
+    /** The entry links to a secondary table.
+     * `value` is the index of the secondary table, `extra_bits` is the number of bits
+     * used to index into the secondary table.
+     */
+    sub_table,
 
-    /** The internal data structure holding the tree.
-     * A pair of values are added to the list for each tree-node.
-     * The values have the following meaning:
-     *  - negative number are relative offset from the current
-     *    position to the next tree node. So that it is possible
-     *    to simply add the negative value to the iterator.
-     *  - positive number is the symbol value + 1.
-     *  - zero was unused or not yet assigned.
+    /** `value` is the symbol itself.
      */
-    std::vector<T> tree;
+    literal,
 
-public:
-    huffman_tree() {
-        tree.push_back(0);
-        tree.push_back(0);
-    }
+    /** `value` is a base value, to which `extra_bits` from the stream should be added.
+     */
+    base,
 
-    /** Add a symbol to the huffman_tree.
-     * 
+    /** The symbol marks the end of a block.
      */
-    void add(int symbol, int code, int code_length) noexcept {
-        tt_axiom(code_length >= 1);
-
-        int offset = 0;
-        while (--code_length > 0) {
-            int select = (code >> code_length) & 1;
-            offset += select;
-          
-            int value = tree[offset];
-
-            // value may not be a leaf.
-            tt_axiom(value <= 0); 
-
-            if (value == 0) {
-                // Unused node entry. Point to the first of two new entries.
-                value = -(static_cast<int>(std::ssize(tree)) - offset);
-
-                tree[offset] = narrow_cast<T>(value);
-                tree.push_back(0);
-                tree.push_back(0);
-            }
+    end_of_block
+};
 
-            // Go to the next entry.
-            offset -= value;
-        }
+/** The meaning of a symbol.
+ * A table of these is passed to `huffman_table::from_lengths()` so that
+ * the decoded entry directly contains the value and the number of extra bits
+ * instead of the symbol.
+ */
+struct huffman_symbol {
+    uint16_t value;
+    uint8_t extra_bits;
+    huffman_kind kind;
+};
 
-        // place the symbol as a leaf.
-        int select = code & 1;
-        offset += select;
+/** A table driven canonical-huffman decoder.
+ *
+ * The decoder peeks at the next `max_code_length` bits in the stream, the first `PrimaryBits`
+ * of those bits index directly into the primary table. Codes longer than `PrimaryBits` are
+ * found through a link to a secondary table, which is indexed by the remaining bits.
+ *
+ * Bits are ordered LSB first, as used by deflate. Huffman codes are stored MSB first
+ * in the stream; so the table is indexed by the bit-reversed code.
+ *
+ * @tparam PrimaryBits Number of bits used to index the primary table.
+ */
+template<int PrimaryBits>
+class huffman_table {
+public:
+    /** The maximum code length supported.
+     */
+    static constexpr int max_code_length = 15;
 
-        tt_axiom(tree[offset] == 0); 
-        tree[offset] = narrow_cast<T>(symbol + 1);
+    struct entry_type {
+        /** The symbol, base value or the index to the secondary table.
+         */
+        uint16_t value;
+
+        /** The number of bits of the huffman code.
+         * For a sub-table link this is `PrimaryBits`.
+         */
+        uint8_t code_length : 4;
+
+        /** The number of extra bits following the huffman code.
+         * For a sub-table link this is the number of bits of the secondary table index.
+         */
+        uint8_t extra_bits : 4;
+
+        huffman_kind kind;
+    };
+
+    static_assert(sizeof(entry_type) == 4);
+
+    huffman_table() noexcept = default;
+
+    /** Find the table entry for the next huffman code.
+     *
+     * @param bits At least `max_code_length` bits peeked from the stream, LSB first.
+     * @return The entry, which may be of kind `huffman_kind::invalid`.
+     */
+    [[nodiscard]] tt_force_inline entry_type const &find(uint32_t bits) const noexcept
+    {
+        tt_axiom(std::ssize(table) >= primary_size);
+        auto const *entry = &table[bits & primary_mask];
+        if (entry->kind == huffman_kind::sub_table) {
+            ttlet sub_mask = (uint32_t{1} << entry->extra_bits) - 1;
+            entry = &table[entry->value + ((bits >> PrimaryBits) & sub_mask)];
+        }
+        return *entry;
     }
 
-    [[nodiscard]] state_t start() const noexcept {
-        return tree.data();
+    /** Find the table entry for the next huffman code.
+     *
+     * @param bits At least `max_code_length` bits peeked from the stream, LSB first.
+     * @return The entry, which may be of kind `huffman_kind::invalid`.
+     * @throw parse_error When the code is not in the table.
+     */
+    [[nodiscard]] tt_force_inline entry_type const &get(uint32_t bits) const
+    {
+        auto const &entry = find(bits);
+        tt_parse_check(entry.kind != huffman_kind::invalid, "Code not in huffman table.");
+        return entry;
     }
 
-    /** Get a symbol from the huffman-tree.
+    /** Get the symbol from the stream.
+     * This also consumes the extra bits, which are added to the base value.
      *
-     * Before `get()` is called use `start()` to create a state to
-     * pass between invocations. State is invalid after `get()` returns
-     * a symbol or throws.
+     * The caller is responsible for refilling the reader with enough bits for
+     * the maximum code length and number of extra bits.
      *
-     * @param code_bit The next bit from the huffman encoded stream.
-     * @param state The state carried between invocations @see start().
-     * @return Positive numbers are symbols, negative means more code_bits
-     *         are needed.
-     * @throw parse-error on invalid code-bit sequence.
+     * @param reader The reader of the bit stream.
+     * @return The symbol or value including the extra bits.
+     * @throw parse_error When the code is not in the table.
      */
-    [[nodiscard]] int get(bool code_bit, state_t &state) const {
-        state += static_cast<ptrdiff_t>(code_bit);
+    [[nodiscard]] tt_force_inline int get_symbol(bit_reader &reader) const
+    {
+        ttlet &entry = get(reader.peek());
+        reader.skip(entry.code_length);
+        return entry.value + reader.get(entry.extra_bits);
+    }
 
-        if (*state == 0) {
-            throw parse_error("Code not in huffman tree.");
+    /** Build a canonical-huffman table from a set of lengths.
+     *
+     * @param lengths The code length for each symbol, zero means the symbol is unused.
+     * @param nr_symbols The number of symbols.
+     * @param symbols Optional meaning of each symbol, if empty the value is the symbol itself.
+     * @throw parse_error When the code lengths are invalid or over-subscribed.
+     */
+    [[nodiscard]] static huffman_table
+    from_lengths(int const *lengths, ssize_t nr_symbols, std::span<huffman_symbol const> symbols = {})
+    {
+        tt_axiom(std::ssize(symbols) == 0 || std::ssize(symbols) >= nr_symbols);
+
+        // Count the number of codes of each length and determine the first code of each length.
+        auto length_count = std::array<int, max_code_length + 1>{};
+        for (ssize_t symbol = 0; symbol != nr_symbols; ++symbol) {
+            ttlet length = lengths[symbol];
+            tt_parse_check(length >= 0 && length <= max_code_length, "Huffman code length out of range");
+            ++length_count[length];
+        }
+        length_count[0] = 0;
+
+        auto next_code = std::array<int, max_code_length + 2>{};
+        auto left = 1;
+        for (int length = 1; length <= max_code_length; ++length) {
+            left <<= 1;
+            left -= length_count[length];
+            tt_parse_check(left >= 0, "Huffman code lengths are over-subscribed");
+            next_code[length + 1] = (next_code[length] + length_count[length]) << 1;
         }
 
-        auto value = *state;
-        state -= static_cast<ptrdiff_t>(value);
-        return value - 1;
-    }
-
-    [[nodiscard]] int get_symbol(std::span<std::byte const> bytes, ssize_t &bit_offset) const noexcept {
-        auto state = start();
-        while (true) {
-            int symbol;
-            if ((symbol = get(get_bit(bytes, bit_offset), state)) >= 0) {
-                return symbol;
+        // Assign the canonical code to each symbol, bit reversed so it can be used as a table index.
+        auto codes = std::vector<uint16_t>(nr_symbols, 0);
+        for (ssize_t symbol = 0; symbol != nr_symbols; ++symbol) {
+            ttlet length = lengths[symbol];
+            if (length != 0) {
+                codes[symbol] = reverse_bits(next_code[length]++, length);
             }
         }
-    }
-    
-    /** Build a canonical-huffman table from a set of lengths.
-     */
-    [[nodiscard]] static huffman_tree from_lengths(int const *lengths, ssize_t nr_symbols) {
-        struct symbol_length_t {
-            int symbol;
-            int length;
 
-            symbol_length_t(int symbol, int length) : symbol(symbol), length(length) {}
-        };
+        // Determine the size of the secondary tables, by looking at the longest code for each primary prefix.
+        auto sub_table_bits = std::array<uint8_t, primary_size>{};
+        for (ssize_t symbol = 0; symbol != nr_symbols; ++symbol) {
+            ttlet length = lengths[symbol];
+            if (length > PrimaryBits) {
+                auto &bits = sub_table_bits[codes[symbol] & primary_mask];
+                bits = std::max(bits, narrow_cast<uint8_t>(length - PrimaryBits));
+            }
+        }
 
-        std::vector<symbol_length_t> symbol_lengths;
-        symbol_lengths.reserve(nr_symbols);
+        auto r = huffman_table{};
+        r.table.resize(primary_size, entry_type{0, 0, 0, huffman_kind::invalid});
 
-        for (int symbol = 0; symbol != nr_symbols; ++symbol) {
-            symbol_lengths.emplace_back(symbol, lengths[symbol]);
+        for (uint32_t prefix = 0; prefix != primary_size; ++prefix) {
+            if (ttlet bits = sub_table_bits[prefix]) {
+                r.table[prefix] = entry_type{narrow_cast<uint16_t>(std::ssize(r.table)), PrimaryBits, bits, huffman_kind::sub_table};
+                r.table.resize(r.table.size() + (size_t{1} << bits), entry_type{0, 0, 0, huffman_kind::invalid});
+            }
         }
 
-        // Sort the table based on the length of the code, followed by symbol
-        std::sort(symbol_lengths.begin(), symbol_lengths.end(), [](ttlet &a, ttlet &b) {
-            if (a.length == b.length) {
-                return a.symbol < b.symbol;
-            } else {
-                return a.length < b.length;
+        // Fill in the entries, duplicating them for each combination of the unused trailing bits.
+        for (ssize_t symbol = 0; symbol != nr_symbols; ++symbol) {
+            ttlet length = lengths[symbol];
+            if (length == 0) {
+                continue;
             }
-        });
 
-        auto r = huffman_tree{};
+            auto entry = std::ssize(symbols) != 0 ?
+                entry_type{symbols[symbol].value, 0, symbols[symbol].extra_bits, symbols[symbol].kind} :
+                entry_type{narrow_cast<uint16_t>(symbol), 0, 0, huffman_kind::literal};
+            entry.code_length = narrow_cast<uint8_t>(length);
 
-        int code = 0;
-        int prev_length = 0;
-        for (auto &&entry: symbol_lengths) {
-            if (entry.length != 0) {
-                code <<= (entry.length - prev_length);
+            ttlet code = codes[symbol];
+            if (length <= PrimaryBits) {
+                for (uint32_t i = code; i < primary_size; i += (uint32_t{1} << length)) {
+                    r.table[i] = entry;
+                }
 
-                r.add(entry.symbol, code, entry.length);
-                ++code;
+            } else {
+                ttlet &link = r.table[code & primary_mask];
+                ttlet sub_size = uint32_t{1} << link.extra_bits;
+                for (uint32_t i = code >> PrimaryBits; i < sub_size; i += (uint32_t{1} << (length - PrimaryBits))) {
+                    r.table[link.value + i] = entry;
+                }
             }
-
-            prev_length = entry.length;
         }
 
         return r;
     }
 
-    [[nodiscard]] static huffman_tree from_lengths(std::vector<int> const &lengths) {
-        return from_lengths(lengths.data(), std::ssize(lengths));
+    [[nodiscard]] static huffman_table from_lengths(std::vector<int> const &lengths, std::span<huffman_symbol const> symbols = {})
+    {
+        return from_lengths(lengths.data(), std::ssize(lengths), symbols);
     }
-};
 
+private:
+    static constexpr uint32_t primary_size = uint32_t{1} << PrimaryBits;
+    static constexpr uint32_t primary_mask = primary_size - 1;
 
+    /** The primary table, followed by the secondary tables.
+     */
+    std::vector<entry_type> table;
+
+    [[nodiscard]] static uint16_t reverse_bits(int code, int length) noexcept
+    {
+        uint32_t r = 0;
+        for (int i = 0; i != length; ++i) {
+            r = (r << 1) | ((code >> i) & 1);
+        }
+        return narrow_cast<uint16_t>(r);
+    }
+};
 
-}
+} // namespace tt
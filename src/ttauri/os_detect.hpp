@@ -136,6 +136,7 @@ enum class Processor {
 #define tt_assume2(condition, msg) __assume(condition)
 #define tt_force_inline __forceinline
 #define tt_no_inline __declspec(noinline)
+#define tt_target(features)
 #define clang_suppress(a)
 #define msvc_suppress(a) _Pragma(tt_stringify(warning(disable:a)))
 
@@ -145,6 +146,7 @@ enum class Processor {
 #define tt_assume2(condition, msg) __builtin_assume(static_cast<bool>(condition))
 #define tt_force_inline inline __attribute__((always_inline))
 #define tt_no_inline __attribute__((noinline))
+#define tt_target(features) __attribute__((target(features)))
 #define clang_suppress(a) _Pragma(tt_stringify(clang diagnostic ignored a))
 #define msvc_suppress(a)
 
@@ -154,6 +156,7 @@ enum class Processor {
 #define tt_assume2(condition, msg) do { if (!(condition)) tt_unreachable(); } while (false)
 #define tt_force_inline inline __attribute__((always_inline))
 #define tt_no_inline __attribute__((noinline))
+#define tt_target(features) __attribute__((target(features)))
 #define clang_suppress(a)
 #define msvc_suppress(a)
 
@@ -163,6 +166,7 @@ enum class Processor {
 #define tt_assume2(condition, msg) static_assert(sizeof(condition) == 1, msg)
 #define tt_force_inline inline
 #define tt_no_inline
+#define tt_target(features)
 #define clang_suppress(a)
 #define msvc_suppress(a)
 
@@ -0,0 +1,47 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "ttauri/byte_string.hpp"
+#include "ttauri/required.hpp"
+#include <cstdint>
+
+namespace tt {
+
+/** A deterministic pseudo random number generator for tests.
+ * A 64 bit linear congruential generator, of which only the high 32 bits are returned
+ * because the low bits repeat quickly.
+ */
+class test_random {
+public:
+    explicit test_random(uint64_t seed = 1) noexcept : _state(seed) {}
+
+    uint32_t operator()() noexcept
+    {
+        _state = _state * 6364136223846793005 + 1442695040888963407;
+        return static_cast<uint32_t>(_state >> 32);
+    }
+
+private:
+    uint64_t _state;
+};
+
+/** Make a string of pseudo random bytes.
+ *
+ * @param size The number of bytes.
+ * @param seed The seed, the same seed results in the same bytes.
+ */
+[[nodiscard]] inline bstring make_random_bytes(ssize_t size, uint64_t seed = 1)
+{
+    auto generator = test_random{seed};
+    auto r = bstring{};
+    r.reserve(static_cast<size_t>(size));
+    for (ssize_t i = 0; i != size; ++i) {
+        r += static_cast<std::byte>(generator() >> 24);
+    }
+    return r;
+}
+
+} // namespace tt
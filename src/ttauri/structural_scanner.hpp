@@ -0,0 +1,229 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "required.hpp"
+#include "int_overflow.hpp"
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#include <bit>
+#include <cstdint>
+
+namespace tt {
+
+/** The classes of the characters in a block of 64 bytes of text.
+ * Bit `i` of each mask corresponds to byte `i` of the block.
+ */
+struct structural_block {
+    /** The characters '{', '}', '[', ']', ':' and ','.
+     */
+    uint64_t structural;
+
+    /** The characters ' ', '\t', '\n', '\v', '\f' and '\r'.
+     */
+    uint64_t whitespace;
+
+    uint64_t quote;
+    uint64_t backslash;
+
+    /** The characters '#' and '/' which may start a comment.
+     */
+    uint64_t comment;
+};
+
+namespace detail {
+
+/** Classify 16 bytes using two nibble lookup tables.
+ *
+ * Each character class has its own bit, a byte belongs to a class when the bit is set both
+ * in the entry of its low nibble and in the entry of its high nibble.
+ *  - bit 0: ','
+ *  - bit 1: ':'
+ *  - bit 2: '[', ']', '{', '}'
+ *  - bit 3: '\t', '\n', '\v', '\f', '\r'
+ *  - bit 4: ' '
+ *  - bit 5: '"'
+ *  - bit 6: '#', '/'
+ *  - bit 7: '\\'
+ */
+[[nodiscard]] inline __m128i structural_classify(__m128i chars) noexcept
+{
+    ttlet lo_table = _mm_setr_epi8(0x10, 0, 0x20, 0x40, 0, 0, 0, 0, 0, 0x08, 0x0a, 0x0c, -0x77, 0x0c, 0, 0x40);
+    ttlet hi_table = _mm_setr_epi8(0x08, 0, 0x71, 0x02, 0, -0x7c, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+    ttlet nibble_mask = _mm_set1_epi8(0x0f);
+
+    // Bytes with the high bit set have a high nibble of 8 to 15, which are zero in hi_table.
+    ttlet lo = _mm_shuffle_epi8(lo_table, _mm_and_si128(chars, nibble_mask));
+    ttlet hi = _mm_shuffle_epi8(hi_table, _mm_and_si128(_mm_srli_epi16(chars, 4), nibble_mask));
+    return _mm_and_si128(lo, hi);
+}
+
+/** Get a bit for each byte which has any of the bits in mask set.
+ */
+[[nodiscard]] inline uint32_t structural_movemask(__m128i classes, int mask) noexcept
+{
+    ttlet zero = _mm_setzero_si128();
+    ttlet match = _mm_cmpeq_epi8(_mm_and_si128(classes, _mm_set1_epi8(static_cast<char>(mask))), zero);
+    return ~static_cast<uint32_t>(_mm_movemask_epi8(match)) & 0xffff;
+}
+
+} // namespace detail
+
+/** Classify 64 bytes of text.
+ *
+ * @param ptr A pointer to 64 readable bytes.
+ */
+[[nodiscard]] inline structural_block classify_structural_block(char const *ptr) noexcept
+{
+    auto r = structural_block{};
+    for (int i = 0; i != 4; ++i) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(ptr + i * 16));
+        ttlet classes = detail::structural_classify(chars);
+        ttlet shift = i * 16;
+
+        r.structural |= static_cast<uint64_t>(detail::structural_movemask(classes, 0x07)) << shift;
+        r.whitespace |= static_cast<uint64_t>(detail::structural_movemask(classes, 0x18)) << shift;
+        r.quote |= static_cast<uint64_t>(detail::structural_movemask(classes, 0x20)) << shift;
+        r.comment |= static_cast<uint64_t>(detail::structural_movemask(classes, 0x40)) << shift;
+        r.backslash |= static_cast<uint64_t>(detail::structural_movemask(classes, 0x80)) << shift;
+    }
+    return r;
+}
+
+/** Find the characters that are escaped by a backslash.
+ *
+ * A character is escaped when it is preceded by an odd number of backslashes, this includes
+ * the second backslash of an escaped backslash.
+ *
+ * @param backslash The mask of backslashes in the block.
+ * @param [in,out] carry On input, 1 if the first character of the block is escaped by the previous block.
+ *                       On output, 1 if the first character of the next block is escaped.
+ * @return The mask of escaped characters.
+ */
+[[nodiscard]] inline uint64_t escaped_characters(uint64_t backslash, uint64_t &carry) noexcept
+{
+    constexpr uint64_t even_bits = 0x5555'5555'5555'5555;
+
+    // A backslash which is escaped itself does not start an escape sequence.
+    backslash &= ~carry;
+    ttlet follows_escape = backslash << 1 | carry;
+
+    // Adding the start of a sequence of backslashes that starts on an odd bit to the sequence carries
+    // into the character after the sequence. Then the parity of the position of that character tells
+    // if the sequence has an odd or even length.
+    ttlet odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+    auto sequences_starting_on_even_bits = uint64_t{};
+    carry = add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits) ? 1 : 0;
+    ttlet invert_mask = sequences_starting_on_even_bits << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+/** Get a mask of the bytes inside strings.
+ *
+ * The opening quote is included in the mask, the closing quote is not.
+ *
+ * @param quote The mask of unescaped quotes.
+ * @param [in,out] in_string On input, all ones if the block starts inside a string, otherwise zero.
+ *                           On output the same for the next block.
+ */
+[[nodiscard]] inline uint64_t string_mask(uint64_t quote, uint64_t &in_string) noexcept
+{
+    // A carry-less multiply by all ones calculates the prefix-xor of the quotes.
+    ttlet quotes = _mm_cvtsi64_si128(static_cast<int64_t>(quote));
+    ttlet ones = _mm_set1_epi8(-1);
+    ttlet r = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(quotes, ones, 0))) ^ in_string;
+    in_string = static_cast<uint64_t>(static_cast<int64_t>(r) >> 63);
+    return r;
+}
+
+/** Find the end of the plain characters in a string.
+ *
+ * @param first The first character of the string body.
+ * @param last One beyond the last character of the text.
+ * @return A pointer to the first quote, backslash or control character, or last.
+ */
+[[nodiscard]] inline char const *find_string_special(char const *first, char const *last) noexcept
+{
+    ttlet quote = _mm_set1_epi8('"');
+    ttlet backslash = _mm_set1_epi8('\\');
+    ttlet space = _mm_set1_epi8(0x1f);
+
+    while (last - first >= 16) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+        ttlet is_control = _mm_cmpeq_epi8(_mm_max_epu8(chars, space), space);
+        ttlet is_special =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)), is_control);
+        if (ttlet mask = static_cast<uint32_t>(_mm_movemask_epi8(is_special))) {
+            return first + std::countr_zero(mask);
+        }
+        first += 16;
+    }
+
+    for (; first != last; ++first) {
+        ttlet c = static_cast<uint8_t>(*first);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return first;
+        }
+    }
+    return last;
+}
+
+/** Skip over a run of whitespace.
+ *
+ * Whitespace is ' ', '\t', '\n', '\v', '\f' and '\r'.
+ *
+ * @param first The first character.
+ * @param last One beyond the last character of the text.
+ * @return A pointer to the first character that is not whitespace, or last.
+ */
+[[nodiscard]] inline char const *skip_whitespace(char const *first, char const *last) noexcept
+{
+    // Most runs of whitespace are short, check the first character before loading a vector.
+    if (first != last && *first != ' ' && (*first < '\t' || *first > '\r')) {
+        return first;
+    }
+
+    while (last - first >= 16) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+        ttlet not_whitespace = ~detail::structural_movemask(detail::structural_classify(chars), 0x18) & 0xffff;
+        if (not_whitespace) {
+            return first + std::countr_zero(not_whitespace);
+        }
+        first += 16;
+    }
+
+    for (; first != last; ++first) {
+        if (*first != ' ' && (*first < '\t' || *first > '\r')) {
+            return first;
+        }
+    }
+    return last;
+}
+
+/** Skip over a run of spaces.
+ *
+ * @param first The first character.
+ * @param last One beyond the last character of the text.
+ * @return A pointer to the first character that is not a space, or last.
+ */
+[[nodiscard]] inline char const *skip_spaces(char const *first, char const *last) noexcept
+{
+    ttlet space = _mm_set1_epi8(' ');
+
+    while (last - first >= 16) {
+        ttlet chars = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+        ttlet not_space = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, space))) & 0xffff;
+        if (not_space) {
+            return first + std::countr_zero(not_space);
+        }
+        first += 16;
+    }
+
+    for (; first != last && *first == ' '; ++first) {}
+    return first;
+}
+
+} // namespace tt
@@ -0,0 +1,101 @@
+// Copyright Take Vos 2021.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ttauri/structural_scanner.hpp"
+#include "ttauri/required.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace std;
+using namespace tt;
+
+static uint64_t scalar_mask(std::string const &text, std::string_view characters)
+{
+    auto r = uint64_t{0};
+    for (int i = 0; i != 64; ++i) {
+        if (characters.find(text[i]) != std::string_view::npos) {
+            r |= uint64_t{1} << i;
+        }
+    }
+    return r;
+}
+
+TEST(structural_scanner, classify_all_bytes)
+{
+    // Check every byte value at every position of the block.
+    for (int first = 0; first < 256; first += 64) {
+        auto text = std::string(64, 'x');
+        for (int i = 0; i != 64; ++i) {
+            text[i] = static_cast<char>(first + i);
+        }
+
+        ttlet block = classify_structural_block(text.data());
+        ASSERT_EQ(block.structural, scalar_mask(text, "{}[]:,"));
+        ASSERT_EQ(block.whitespace, scalar_mask(text, " \t\n\v\f\r"));
+        ASSERT_EQ(block.quote, scalar_mask(text, "\""));
+        ASSERT_EQ(block.backslash, scalar_mask(text, "\\"));
+        ASSERT_EQ(block.comment, scalar_mask(text, "#/"));
+    }
+}
+
+TEST(structural_scanner, escaped_characters)
+{
+    auto carry = uint64_t{0};
+    ASSERT_EQ(escaped_characters(uint64_t{0b0000'0001}, carry), 0b0000'0010);
+    ASSERT_EQ(carry, 0);
+
+    // An escaped backslash is itself an escaped character.
+    ASSERT_EQ(escaped_characters(uint64_t{0b0000'0011}, carry), 0b0000'0010);
+    ASSERT_EQ(escaped_characters(uint64_t{0b0000'0111}, carry), 0b0000'1010);
+    ASSERT_EQ(escaped_characters(uint64_t{0b0000'1110}, carry), 0b0001'0100);
+    ASSERT_EQ(escaped_characters(uint64_t{0b0001'1100}, carry), 0b0010'1000);
+
+    // A backslash in the last byte escapes the first byte of the next block.
+    ASSERT_EQ(escaped_characters(uint64_t{1} << 63, carry), 0);
+    ASSERT_EQ(carry, 1);
+    ASSERT_EQ(escaped_characters(uint64_t{0b0000'0011}, carry), 0b0000'0101);
+    ASSERT_EQ(carry, 0);
+}
+
+TEST(structural_scanner, string_mask)
+{
+    auto in_string = uint64_t{0};
+    ASSERT_EQ(string_mask(0b0100'0010, in_string), 0b0011'1110);
+    ASSERT_EQ(in_string, 0);
+
+    ASSERT_EQ(string_mask(uint64_t{1} << 60, in_string), uint64_t{0xf} << 60);
+    ASSERT_EQ(in_string, ~uint64_t{0});
+    ASSERT_EQ(string_mask(0b0100, in_string), 0b0011);
+    ASSERT_EQ(in_string, 0);
+}
+
+TEST(structural_scanner, find_string_special)
+{
+    for (int length = 0; length != 40; ++length) {
+        for (ttlet special : {'"', '\\', '\n', '\x01'}) {
+            auto text = std::string(length, 'a') + special + std::string(20, 'b');
+            ASSERT_EQ(find_string_special(text.data(), text.data() + text.size()), text.data() + length);
+        }
+
+        auto text = std::string(length, '\xe0');
+        ASSERT_EQ(find_string_special(text.data(), text.data() + text.size()), text.data() + text.size());
+    }
+}
+
+TEST(structural_scanner, skip_whitespace)
+{
+    for (int length = 0; length != 40; ++length) {
+        auto text = std::string{};
+        for (int i = 0; i != length; ++i) {
+            text += " \t\n\r"[i % 4];
+        }
+        auto with_value = text + "1     ";
+
+        ASSERT_EQ(skip_whitespace(text.data(), text.data() + text.size()), text.data() + text.size());
+        ASSERT_EQ(skip_whitespace(with_value.data(), with_value.data() + with_value.size()), with_value.data() + length);
+
+        auto spaces = std::string(length, ' ') + "\t  ";
+        ASSERT_EQ(skip_spaces(spaces.data(), spaces.data() + spaces.size()), spaces.data() + length);
+    }
+}
@@ -3,6 +3,7 @@
 // (See accompanying file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
 
 #include "tokenizer.hpp"
+#include "structural_scanner.hpp"
 
 namespace tt {
 
@@ -974,6 +975,27 @@ struct tokenizer {
 
         auto transition = tokenizer_transition_t{};
         while (index != end) {
+            // Skip runs of spaces and plain string characters in bulk, they do not change the state.
+            if (state == tokenizer_state_t::String) {
+                ttlet plain_first = std::to_address(index);
+                ttlet plain_last = find_string_special(plain_first, std::to_address(end));
+                ttlet count = plain_last - plain_first;
+                token.value.append(plain_first, plain_last);
+                location.increment_column(narrow_cast<int>(count));
+                index += count;
+                if (index == end) {
+                    break;
+                }
+
+            } else if (state == tokenizer_state_t::Initial && *index == ' ') {
+                ttlet count = skip_spaces(std::to_address(index), std::to_address(end)) - std::to_address(index);
+                location.increment_column(narrow_cast<int>(count));
+                index += count;
+                if (index == end) {
+                    break;
+                }
+            }
+
             transition = transitionTable[get_offset(state, *index)];
             state = transition.next;
 
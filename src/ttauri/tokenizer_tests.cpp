@@ -244,6 +244,17 @@ TEST(Tokenizer, ParseString4) {
     ASSERT_TOKEN_EQ(tokens[1], ErrorEOTInString, "234");
 }
 
+TEST(Tokenizer, ParseLongString) {
+    auto str = std::string("                    \"") + std::string(40, 'a') + "\\\"" + std::string(40, 'b') + "\"  ++";
+    auto v = std::string_view(str);
+    auto tokens = parseTokens(v);
+    ASSERT_TOKEN_EQ(tokens[0], StringLiteral, std::string(40, 'a') + "\"" + std::string(40, 'b'));
+    ASSERT_EQ(tokens[0].location.column(), 21);
+    ASSERT_TOKEN_EQ(tokens[1], Operator, "++");
+    ASSERT_EQ(tokens[1].location.column(), 107);
+    ASSERT_TOKEN_EQ(tokens[2], End, "");
+}
+
 TEST(Tokenizer, ParseEmptyString) {
     auto str = "++\"\"++";
     auto v = std::string_view(str);